@@ -152,6 +152,21 @@ void *memcpy(void *__dest, __const void *__src, size_t __n)
 	return __dest;
 }
 
+/*
+ * inflate_fast() fills byte runs with memset() and a value that is not a
+ * constant, which asm/string.h turns into a call of the real function.
+ */
+#undef memset
+void *memset(void *__s, int __c, size_t __n)
+{
+	unsigned char *d = (unsigned char *)__s;
+
+	while (__n--)
+		*d++ = __c;
+
+	return __s;
+}
+
 /*
  * gzip delarations
  */
@@ -221,6 +221,9 @@ static struct s5p_media_device smdkc110_media_devs[] = {
 		.bank = 0, /* OneDRAM */
 		.memsize = S5PV210_ANDROID_PMEM_MEMSIZE_PMEM_GPU1,
 		.paddr = 0,
+#ifdef CONFIG_CMA
+		.cma = true,
+#endif
 	},
 	[9] = {
 		.id = S5P_MDEV_G2D,
@@ -1210,6 +1213,9 @@ static struct android_pmem_platform_data pmem_gpu1_pdata = {
 	.no_allocator = 1,
 	.cached = 1,
 	.buffered = 1,
+#ifdef CONFIG_CMA
+	.movable = 1,
+#endif
 	.start = 0,
 	.size = 0,
 };
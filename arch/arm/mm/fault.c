@@ -197,11 +197,11 @@ void do_bad_area(unsigned long addr, unsigned int fsr, struct pt_regs *regs)
 #define VM_FAULT_BADACCESS	0x020000
 
 /*
- * Check that the permissions on the VMA allow for the fault which occurred.
+ * The VMA permissions of which one allows for the fault which occurred.
  * If we encountered a write fault, we must have write permission, otherwise
  * we allow any permission.
  */
-static inline bool access_error(unsigned int fsr, struct vm_area_struct *vma)
+static inline unsigned int access_mask(unsigned int fsr)
 {
 	unsigned int mask = VM_READ | VM_WRITE | VM_EXEC;
 
@@ -210,7 +210,12 @@ static inline bool access_error(unsigned int fsr, struct vm_area_struct *vma)
 	if (fsr & FSR_LNX_PF)
 		mask = VM_EXEC;
 
-	return vma->vm_flags & mask ? false : true;
+	return mask;
+}
+
+static inline bool access_error(unsigned int fsr, struct vm_area_struct *vma)
+{
+	return vma->vm_flags & access_mask(fsr) ? false : true;
 }
 
 static int __kprobes
@@ -277,6 +282,21 @@ do_page_fault(unsigned long addr, unsigned int fsr, struct pt_regs *regs)
 	if (in_atomic() || !mm)
 		goto no_context;
 
+	/*
+	 * Most faults are on memory that was just allocated and can be
+	 * handled without waiting for mmap_sem behind another thread's
+	 * mmap() or munmap().
+	 */
+	fault = handle_speculative_fault(mm, addr,
+			(fsr & FSR_WRITE) ? FAULT_FLAG_WRITE : 0, access_mask(fsr));
+	if (likely(!(fault & VM_FAULT_RETRY))) {
+		if (fault & VM_FAULT_MAJOR)
+			tsk->maj_flt++;
+		else
+			tsk->min_flt++;
+		goto done;
+	}
+
 	/*
 	 * As per x86, we may deadlock here.  However, since the kernel only
 	 * validly references user space from well defined areas of the code,
@@ -303,6 +323,7 @@ do_page_fault(unsigned long addr, unsigned int fsr, struct pt_regs *regs)
 	fault = __do_page_fault(mm, addr, fsr, tsk);
 	up_read(&mm->mmap_sem);
 
+done:
 	perf_sw_event(PERF_COUNT_SW_PAGE_FAULTS, 1, 0, regs, addr);
 	if (fault & VM_FAULT_MAJOR)
 		perf_sw_event(PERF_COUNT_SW_PAGE_FAULTS_MAJ, 1, 0, regs, addr);
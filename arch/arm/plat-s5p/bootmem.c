@@ -13,6 +13,7 @@
 #include <linux/mm.h>
 #include <linux/bootmem.h>
 #include <linux/swap.h>
+#include <linux/cma.h>
 #include <asm/setup.h>
 #include <linux/io.h>
 #include <mach/memory.h>
@@ -81,6 +82,7 @@ void s5p_reserve_bootmem(struct s5p_media_device *mdevs, int nr_mdevs)
 {
 	struct s5p_media_device *mdev;
 	void *virt_mem;
+	unsigned long align;
 	int i;
 
 	media_devs = mdevs;
@@ -91,15 +93,24 @@ void s5p_reserve_bootmem(struct s5p_media_device *mdevs, int nr_mdevs)
 		if (mdev->memsize <= 0)
 			continue;
 
+		align = PAGE_SIZE;
+#ifdef CONFIG_CMA
+		if (mdev->cma) {
+			align = CMA_REGION_ALIGN;
+			mdev->memsize = ALIGN(mdev->memsize, align);
+		}
+#endif
 		if (mdev->paddr)
-			virt_mem = __alloc_bootmem(mdev->memsize, PAGE_SIZE,
+			virt_mem = __alloc_bootmem(mdev->memsize, align,
 					mdev->paddr);
 		else
-			virt_mem = __alloc_bootmem(mdev->memsize, PAGE_SIZE,
+			virt_mem = __alloc_bootmem(mdev->memsize, align,
 					meminfo.bank[mdev->bank].start);
 
 		if (virt_mem != NULL) {
 			mdev->paddr = virt_to_phys(virt_mem);
+			if (mdev->cma)
+				cma_declare_region(mdev->paddr, mdev->memsize);
 		} else {
 			mdev->paddr = (dma_addr_t)NULL;
 			printk(KERN_INFO "s5p: Failed to reserve system memory\n");
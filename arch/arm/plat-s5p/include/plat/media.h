@@ -22,6 +22,8 @@ struct s5p_media_device {
 	u32		bank;
 	size_t		memsize;
 	dma_addr_t	paddr;
+	/* lend the memory to movable pages while unused, see mm/cma.c */
+	bool		cma;
 };
 
 extern struct meminfo meminfo;
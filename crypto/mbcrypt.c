@@ -0,0 +1,365 @@
+/*
+ * Batching async crypto daemon.
+ *
+ * Like cryptd this turns a synchronous blkcipher into an asynchronous
+ * ablkcipher that runs in the crypto workqueue, but instead of waking
+ * the worker once per request it drains up to max_batch queued requests
+ * per run.  All requests of a batch are ciphered back to back on the
+ * same child transform and their completions are then signalled
+ * together, which amortises the workqueue round trip and keeps the key
+ * schedule and cipher tables hot when dm-crypt submits a burst of
+ * sector-sized requests.
+ *
+ * The worker never waits for a batch to fill up: it takes whatever has
+ * been queued by the time it runs, so a lone request sees the same
+ * latency as with cryptd.
+ *
+ * Based on crypto/cryptd.c.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ */
+
+#include <crypto/algapi.h>
+#include <crypto/crypto_wq.h>
+#include <linux/err.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/scatterlist.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+
+#define MBCRYPT_MAX_CPU_QLEN	128
+#define MBCRYPT_MAX_BATCH	32
+
+static unsigned int max_batch = 16;
+module_param(max_batch, uint, 0644);
+MODULE_PARM_DESC(max_batch, "Maximum number of requests handled per "
+			    "worker run (1-" __stringify(MBCRYPT_MAX_BATCH) ")");
+
+struct mbcrypt_cpu_queue {
+	struct crypto_queue queue;
+	struct work_struct work;
+};
+
+struct mbcrypt_queue {
+	struct mbcrypt_cpu_queue __percpu *cpu_queue;
+};
+
+struct mbcrypt_instance_ctx {
+	struct crypto_spawn spawn;
+	struct mbcrypt_queue *queue;
+};
+
+struct mbcrypt_blkcipher_ctx {
+	struct crypto_blkcipher *child;
+};
+
+struct mbcrypt_request_ctx {
+	int decrypt;
+	int err;
+};
+
+static void mbcrypt_queue_worker(struct work_struct *work);
+
+static int mbcrypt_init_queue(struct mbcrypt_queue *queue,
+			      unsigned int max_cpu_qlen)
+{
+	int cpu;
+	struct mbcrypt_cpu_queue *cpu_queue;
+
+	queue->cpu_queue = alloc_percpu(struct mbcrypt_cpu_queue);
+	if (!queue->cpu_queue)
+		return -ENOMEM;
+	for_each_possible_cpu(cpu) {
+		cpu_queue = per_cpu_ptr(queue->cpu_queue, cpu);
+		crypto_init_queue(&cpu_queue->queue, max_cpu_qlen);
+		INIT_WORK(&cpu_queue->work, mbcrypt_queue_worker);
+	}
+	return 0;
+}
+
+static void mbcrypt_fini_queue(struct mbcrypt_queue *queue)
+{
+	int cpu;
+	struct mbcrypt_cpu_queue *cpu_queue;
+
+	for_each_possible_cpu(cpu) {
+		cpu_queue = per_cpu_ptr(queue->cpu_queue, cpu);
+		BUG_ON(cpu_queue->queue.qlen);
+	}
+	free_percpu(queue->cpu_queue);
+}
+
+static int mbcrypt_enqueue_request(struct mbcrypt_queue *queue,
+				   struct crypto_async_request *request)
+{
+	int cpu, err;
+	struct mbcrypt_cpu_queue *cpu_queue;
+
+	cpu = get_cpu();
+	cpu_queue = this_cpu_ptr(queue->cpu_queue);
+	err = crypto_enqueue_request(&cpu_queue->queue, request);
+	queue_work_on(cpu, kcrypto_wq, &cpu_queue->work);
+	put_cpu();
+
+	return err;
+}
+
+static void mbcrypt_do_crypt(struct crypto_async_request *base)
+{
+	struct ablkcipher_request *req = ablkcipher_request_cast(base);
+	struct mbcrypt_request_ctx *rctx = ablkcipher_request_ctx(req);
+	struct mbcrypt_blkcipher_ctx *ctx = crypto_tfm_ctx(base->tfm);
+	struct blkcipher_desc desc;
+
+	desc.tfm = ctx->child;
+	desc.info = req->info;
+	desc.flags = CRYPTO_TFM_REQ_MAY_SLEEP;
+
+	if (rctx->decrypt)
+		rctx->err = crypto_blkcipher_crt(ctx->child)->decrypt(&desc,
+					req->dst, req->src, req->nbytes);
+	else
+		rctx->err = crypto_blkcipher_crt(ctx->child)->encrypt(&desc,
+					req->dst, req->src, req->nbytes);
+}
+
+/*
+ * Called in workqueue context.  Pull a batch of requests off this CPU's
+ * queue, cipher all of them, then complete them in one bh-disabled
+ * section.  Reschedule if more work arrived meanwhile.
+ */
+static void mbcrypt_queue_worker(struct work_struct *work)
+{
+	struct crypto_async_request *batch[MBCRYPT_MAX_BATCH];
+	struct crypto_async_request *backlog[MBCRYPT_MAX_BATCH];
+	struct mbcrypt_cpu_queue *cpu_queue;
+	unsigned int limit, n, i;
+
+	cpu_queue = container_of(work, struct mbcrypt_cpu_queue, work);
+	limit = clamp_t(unsigned int, max_batch, 1, MBCRYPT_MAX_BATCH);
+
+	/* preempt_disable/enable keeps mbcrypt_enqueue_request() out */
+	preempt_disable();
+	for (n = 0; n < limit; n++) {
+		backlog[n] = crypto_get_backlog(&cpu_queue->queue);
+		batch[n] = crypto_dequeue_request(&cpu_queue->queue);
+		if (!batch[n])
+			break;
+	}
+	preempt_enable();
+
+	if (!n)
+		return;
+
+	for (i = 0; i < n; i++)
+		if (backlog[i])
+			backlog[i]->complete(backlog[i], -EINPROGRESS);
+
+	for (i = 0; i < n; i++)
+		mbcrypt_do_crypt(batch[i]);
+
+	local_bh_disable();
+	for (i = 0; i < n; i++) {
+		struct mbcrypt_request_ctx *rctx;
+
+		rctx = ablkcipher_request_ctx(ablkcipher_request_cast(batch[i]));
+		batch[i]->complete(batch[i], rctx->err);
+	}
+	local_bh_enable();
+
+	if (cpu_queue->queue.qlen)
+		queue_work(kcrypto_wq, &cpu_queue->work);
+}
+
+static inline struct mbcrypt_queue *mbcrypt_get_queue(struct crypto_tfm *tfm)
+{
+	struct crypto_instance *inst = crypto_tfm_alg_instance(tfm);
+	struct mbcrypt_instance_ctx *ictx = crypto_instance_ctx(inst);
+	return ictx->queue;
+}
+
+static int mbcrypt_blkcipher_setkey(struct crypto_ablkcipher *parent,
+				    const u8 *key, unsigned int keylen)
+{
+	struct mbcrypt_blkcipher_ctx *ctx = crypto_ablkcipher_ctx(parent);
+	struct crypto_blkcipher *child = ctx->child;
+	int err;
+
+	crypto_blkcipher_clear_flags(child, CRYPTO_TFM_REQ_MASK);
+	crypto_blkcipher_set_flags(child, crypto_ablkcipher_get_flags(parent) &
+					  CRYPTO_TFM_REQ_MASK);
+	err = crypto_blkcipher_setkey(child, key, keylen);
+	crypto_ablkcipher_set_flags(parent, crypto_blkcipher_get_flags(child) &
+					    CRYPTO_TFM_RES_MASK);
+	return err;
+}
+
+static int mbcrypt_blkcipher_enqueue(struct ablkcipher_request *req,
+				     int decrypt)
+{
+	struct mbcrypt_request_ctx *rctx = ablkcipher_request_ctx(req);
+	struct crypto_ablkcipher *tfm = crypto_ablkcipher_reqtfm(req);
+	struct mbcrypt_queue *queue;
+
+	queue = mbcrypt_get_queue(crypto_ablkcipher_tfm(tfm));
+	rctx->decrypt = decrypt;
+	rctx->err = 0;
+
+	return mbcrypt_enqueue_request(queue, &req->base);
+}
+
+static int mbcrypt_blkcipher_encrypt_enqueue(struct ablkcipher_request *req)
+{
+	return mbcrypt_blkcipher_enqueue(req, 0);
+}
+
+static int mbcrypt_blkcipher_decrypt_enqueue(struct ablkcipher_request *req)
+{
+	return mbcrypt_blkcipher_enqueue(req, 1);
+}
+
+static int mbcrypt_blkcipher_init_tfm(struct crypto_tfm *tfm)
+{
+	struct crypto_instance *inst = crypto_tfm_alg_instance(tfm);
+	struct mbcrypt_instance_ctx *ictx = crypto_instance_ctx(inst);
+	struct crypto_spawn *spawn = &ictx->spawn;
+	struct mbcrypt_blkcipher_ctx *ctx = crypto_tfm_ctx(tfm);
+	struct crypto_blkcipher *cipher;
+
+	cipher = crypto_spawn_blkcipher(spawn);
+	if (IS_ERR(cipher))
+		return PTR_ERR(cipher);
+
+	ctx->child = cipher;
+	tfm->crt_ablkcipher.reqsize = sizeof(struct mbcrypt_request_ctx);
+	return 0;
+}
+
+static void mbcrypt_blkcipher_exit_tfm(struct crypto_tfm *tfm)
+{
+	struct mbcrypt_blkcipher_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	crypto_free_blkcipher(ctx->child);
+}
+
+static struct mbcrypt_queue queue;
+
+static int mbcrypt_create(struct crypto_template *tmpl, struct rtattr **tb)
+{
+	struct mbcrypt_instance_ctx *ctx;
+	struct crypto_instance *inst;
+	struct crypto_alg *alg;
+	int err;
+
+	err = crypto_check_attr_type(tb, CRYPTO_ALG_TYPE_BLKCIPHER);
+	if (err)
+		return err;
+
+	alg = crypto_get_attr_alg(tb, CRYPTO_ALG_TYPE_BLKCIPHER,
+				  CRYPTO_ALG_TYPE_MASK);
+	if (IS_ERR(alg))
+		return PTR_ERR(alg);
+
+	inst = kzalloc(sizeof(*inst) + sizeof(*ctx), GFP_KERNEL);
+	err = -ENOMEM;
+	if (!inst)
+		goto out_put_alg;
+
+	err = -ENAMETOOLONG;
+	if (snprintf(inst->alg.cra_driver_name, CRYPTO_MAX_ALG_NAME,
+		     "mbcrypt(%s)", alg->cra_driver_name) >= CRYPTO_MAX_ALG_NAME)
+		goto out_free_inst;
+
+	memcpy(inst->alg.cra_name, alg->cra_name, CRYPTO_MAX_ALG_NAME);
+
+	ctx = crypto_instance_ctx(inst);
+	ctx->queue = &queue;
+
+	err = crypto_init_spawn(&ctx->spawn, alg, inst,
+				CRYPTO_ALG_TYPE_MASK | CRYPTO_ALG_ASYNC);
+	if (err)
+		goto out_free_inst;
+
+	/* Rank just above cryptd, so async users pick us once instantiated */
+	inst->alg.cra_priority = alg->cra_priority + 60;
+	inst->alg.cra_blocksize = alg->cra_blocksize;
+	inst->alg.cra_alignmask = alg->cra_alignmask;
+
+	inst->alg.cra_flags = CRYPTO_ALG_TYPE_ABLKCIPHER | CRYPTO_ALG_ASYNC;
+	inst->alg.cra_type = &crypto_ablkcipher_type;
+
+	inst->alg.cra_ablkcipher.ivsize = alg->cra_blkcipher.ivsize;
+	inst->alg.cra_ablkcipher.min_keysize = alg->cra_blkcipher.min_keysize;
+	inst->alg.cra_ablkcipher.max_keysize = alg->cra_blkcipher.max_keysize;
+
+	inst->alg.cra_ablkcipher.geniv = alg->cra_blkcipher.geniv;
+
+	inst->alg.cra_ctxsize = sizeof(struct mbcrypt_blkcipher_ctx);
+
+	inst->alg.cra_init = mbcrypt_blkcipher_init_tfm;
+	inst->alg.cra_exit = mbcrypt_blkcipher_exit_tfm;
+
+	inst->alg.cra_ablkcipher.setkey = mbcrypt_blkcipher_setkey;
+	inst->alg.cra_ablkcipher.encrypt = mbcrypt_blkcipher_encrypt_enqueue;
+	inst->alg.cra_ablkcipher.decrypt = mbcrypt_blkcipher_decrypt_enqueue;
+
+	err = crypto_register_instance(tmpl, inst);
+	if (err) {
+		crypto_drop_spawn(&ctx->spawn);
+out_free_inst:
+		kfree(inst);
+	}
+
+out_put_alg:
+	crypto_mod_put(alg);
+	return err;
+}
+
+static void mbcrypt_free(struct crypto_instance *inst)
+{
+	struct mbcrypt_instance_ctx *ctx = crypto_instance_ctx(inst);
+
+	crypto_drop_spawn(&ctx->spawn);
+	kfree(inst);
+}
+
+static struct crypto_template mbcrypt_tmpl = {
+	.name = "mbcrypt",
+	.create = mbcrypt_create,
+	.free = mbcrypt_free,
+	.module = THIS_MODULE,
+};
+
+static int __init mbcrypt_init(void)
+{
+	int err;
+
+	err = mbcrypt_init_queue(&queue, MBCRYPT_MAX_CPU_QLEN);
+	if (err)
+		return err;
+
+	err = crypto_register_template(&mbcrypt_tmpl);
+	if (err)
+		mbcrypt_fini_queue(&queue);
+
+	return err;
+}
+
+static void __exit mbcrypt_exit(void)
+{
+	mbcrypt_fini_queue(&queue);
+	crypto_unregister_template(&mbcrypt_tmpl);
+}
+
+module_init(mbcrypt_init);
+module_exit(mbcrypt_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Batching software async crypto daemon");
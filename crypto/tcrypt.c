@@ -711,6 +711,117 @@ out:
 	crypto_free_ahash(tfm);
 }
 
+/*
+ * Used by test_mb_ablkcipher_speed(): number of sector-sized requests
+ * kept in flight per round, as dm-crypt would for one bio.
+ */
+#define MB_INFLIGHT	8
+#define MB_SECTOR_SIZE	4096
+
+static int test_mb_ablkcipher_round(struct ablkcipher_request **req,
+				    struct tcrypt_result *res, int enc)
+{
+	int i, ret, err = 0;
+
+	for (i = 0; i < MB_INFLIGHT; i++) {
+		if (enc)
+			ret = crypto_ablkcipher_encrypt(req[i]);
+		else
+			ret = crypto_ablkcipher_decrypt(req[i]);
+		if (ret == -EINPROGRESS || ret == -EBUSY)
+			continue;
+		/* completed synchronously */
+		res[i].err = ret;
+		complete(&res[i].completion);
+	}
+
+	for (i = 0; i < MB_INFLIGHT; i++) {
+		wait_for_completion(&res[i].completion);
+		INIT_COMPLETION(res[i].completion);
+		if (res[i].err)
+			err = res[i].err;
+	}
+	return err;
+}
+
+static void test_mb_ablkcipher_speed(const char *algo, int enc,
+				     unsigned int sec, unsigned int keylen)
+{
+	struct ablkcipher_request *req[MB_INFLIGHT];
+	struct tcrypt_result res[MB_INFLIGHT];
+	struct scatterlist sg[MB_INFLIGHT];
+	char *buf[MB_INFLIGHT];
+	char iv[MB_INFLIGHT][128];
+	struct crypto_ablkcipher *tfm;
+	unsigned long start, end, ops;
+	const char *e = enc ? "encryption" : "decryption";
+	char key[64];
+	int i, ret;
+
+	if (!sec)
+		sec = 1;
+
+	printk(KERN_INFO "\ntesting multi-buffer speed of %s %s\n", algo, e);
+
+	tfm = crypto_alloc_ablkcipher(algo, 0, 0);
+	if (IS_ERR(tfm)) {
+		pr_err("failed to load transform for %s: %ld\n", algo,
+		       PTR_ERR(tfm));
+		return;
+	}
+
+	memset(key, 0xff, sizeof(key));
+	ret = crypto_ablkcipher_setkey(tfm, key, keylen);
+	if (ret) {
+		pr_err("setkey() failed flags=%x\n",
+		       crypto_ablkcipher_get_flags(tfm));
+		goto out_free_tfm;
+	}
+
+	memset(req, 0, sizeof(req));
+	memset(buf, 0, sizeof(buf));
+	for (i = 0; i < MB_INFLIGHT; i++) {
+		buf[i] = (char *)__get_free_page(GFP_KERNEL);
+		req[i] = ablkcipher_request_alloc(tfm, GFP_KERNEL);
+		if (!buf[i] || !req[i]) {
+			pr_err("multi-buffer allocation failure\n");
+			goto out;
+		}
+		memset(buf[i], 0xff, MB_SECTOR_SIZE);
+		memset(iv[i], 0xff, sizeof(iv[i]));
+		sg_init_one(&sg[i], buf[i], MB_SECTOR_SIZE);
+		init_completion(&res[i].completion);
+		ablkcipher_request_set_callback(req[i],
+						CRYPTO_TFM_REQ_MAY_BACKLOG,
+						tcrypt_complete, &res[i]);
+		ablkcipher_request_set_crypt(req[i], &sg[i], &sg[i],
+					     MB_SECTOR_SIZE, iv[i]);
+	}
+
+	for (start = jiffies, end = start + sec * HZ, ops = 0;
+	     time_before(jiffies, end); ops += MB_INFLIGHT) {
+		ret = test_mb_ablkcipher_round(req, res, enc);
+		if (ret) {
+			pr_err("%s() failed ret=%d\n", e, ret);
+			goto out;
+		}
+	}
+
+	printk("%lu %u-byte operations in %u seconds (%lu IOPS, %lu KiB/s)\n",
+	       ops, MB_SECTOR_SIZE, sec, ops / sec,
+	       ops / sec * (MB_SECTOR_SIZE / 1024));
+
+out:
+	for (i = 0; i < MB_INFLIGHT; i++) {
+		if (req[i])
+			ablkcipher_request_free(req[i]);
+		if (buf[i])
+			free_page((unsigned long)buf[i]);
+	}
+out_free_tfm:
+	crypto_free_ablkcipher(tfm);
+}
+
 static void test_available(void)
 {
 	char **name = check;
@@ -1215,6 +1326,29 @@ static int do_test(int m)
 	case 499:
 		break;
 
+	case 500:
+		test_mb_ablkcipher_speed("cbc(aes)", ENCRYPT, sec, 16);
+		test_mb_ablkcipher_speed("cbc(aes)", DECRYPT, sec, 16);
+		if (mode > 500 && mode < 600) break;
+
+	case 501:
+		test_mb_ablkcipher_speed("cryptd(cbc(aes))", ENCRYPT, sec, 16);
+		test_mb_ablkcipher_speed("cryptd(cbc(aes))", DECRYPT, sec, 16);
+		if (mode > 500 && mode < 600) break;
+
+	case 502:
+		test_mb_ablkcipher_speed("mbcrypt(cbc(aes))", ENCRYPT, sec, 16);
+		test_mb_ablkcipher_speed("mbcrypt(cbc(aes))", DECRYPT, sec, 16);
+		if (mode > 500 && mode < 600) break;
+
+	case 503:
+		test_mb_ablkcipher_speed("mbcrypt(xts(aes))", ENCRYPT, sec, 32);
+		test_mb_ablkcipher_speed("mbcrypt(xts(aes))", DECRYPT, sec, 32);
+		if (mode > 500 && mode < 600) break;
+
+	case 599:
+		break;
+
 	case 1000:
 		test_available();
 		break;
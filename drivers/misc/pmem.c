@@ -23,7 +23,11 @@
 #include <linux/android_pmem.h>
 #include <linux/mempolicy.h>
 #include <linux/sched.h>
+#include <linux/cma.h>
+#include <linux/rbtree.h>
+#include <linux/ktime.h>
 #include <asm/io.h>
+#include <asm/div64.h>
 #include <asm/uaccess.h>
 #include <asm/cacheflush.h>
 
@@ -89,6 +93,28 @@ struct pmem_region_node {
 	struct list_head list;
 };
 
+/* a run of pages in a region managed by the best fit allocator */
+struct pmem_extent {
+	/* in the region's extents, sorted by offset */
+	struct rb_node node;
+	/* in the region's free extents, sorted by length, if free */
+	struct rb_node free_node;
+	/* offset and length, in units of PMEM_MIN_ALLOC */
+	unsigned long offset;
+	unsigned long len;
+	/* the longest free extent in the subtree rooted at node */
+	unsigned long max_free;
+	unsigned free;
+};
+
+struct pmem_stats {
+	unsigned long allocs;
+	unsigned long failed;
+	unsigned long frees;
+	u64 alloc_ns;
+	u64 max_alloc_ns;
+};
+
 #define PMEM_DEBUG_MSGS 0
 #if PMEM_DEBUG_MSGS
 #define DLOG(fmt,args...) \
@@ -118,11 +144,24 @@ struct pmem_info {
 	struct pmem_bits *bitmap;
 	/* indicates the region should not be managed with an allocator */
 	unsigned no_allocator;
+	/* the allocator managing the region otherwise */
+	enum pmem_allocator_type allocator_type;
+	/* for the best fit allocator: all extents of the region, each node
+	 * knowing the longest free extent below it, and the free ones */
+	struct rb_root extents;
+	struct rb_root free_extents;
+	unsigned long free_pages;
+	unsigned long nr_free_extents;
+	/* allocator statistics shown in debugfs */
+	struct pmem_stats stats;
 	/* indicates maps of this region should be cached, if a mix of
 	 * cached and uncached is desired, set this and open the device with
 	 * O_SYNC to get an uncached region */
 	unsigned cached;
 	unsigned buffered;
+	/* indicates the region is shared with movable pages while it is not
+	 * allocated, allocations claim their range back from them */
+	unsigned movable;
 	/* in no_allocator mode the first mapper gets the whole space and sets
 	 * this flag */
 	unsigned allocated;
@@ -142,6 +181,8 @@ struct pmem_info {
 	 *
 	 * IF YOU TAKE BOTH LOCKS TAKE THEM IN THIS ORDER:
 	 * down(pmem_data->sem) => down(bitmap_sem)
+	 *
+	 * bitmap_sem also protects the extent trees and the statistics
 	 */
 	struct rw_semaphore bitmap_sem;
 
@@ -168,6 +209,8 @@ static int id_count;
 #define PMEM_IS_PAGE_ALIGNED(addr) (!((addr) & (~PAGE_MASK)))
 #define PMEM_IS_SUBMAP(data) ((data->flags & PMEM_FLAGS_SUBMAP) && \
 	(!(data->flags & PMEM_FLAGS_UNSUBMAP)))
+#define PMEM_IS_BESTFIT(id) (!pmem[id].no_allocator && \
+	pmem[id].allocator_type == PMEM_ALLOCATORTYPE_BESTFIT)
 
 static int pmem_release(struct inode *, struct file *);
 static int pmem_mmap(struct file *, struct vm_area_struct *);
@@ -232,16 +275,265 @@ static int is_master_owner(struct file *file)
 	return ret;
 }
 
+/* take [start, start + len) back from whatever movable pages are using it */
+static int pmem_claim(int id, unsigned long start, unsigned long len)
+{
+#ifdef CONFIG_CMA
+	unsigned long pfn = start >> PAGE_SHIFT;
+	int ret;
+
+	if (!pmem[id].movable)
+		return 0;
+	len = PAGE_ALIGN(len);
+	ret = alloc_contig_range(pfn, pfn + (len >> PAGE_SHIFT));
+	if (ret) {
+		printk(KERN_WARNING "pmem: could not claim %lx bytes at %lx "
+		       "(%d)\n", len, start, ret);
+		return ret;
+	}
+	/* the previous users may have left dirty lines in the caches */
+	dmac_flush_range(__va(start), __va(start + len));
+	outer_flush_range(start, start + len);
+#endif
+	return 0;
+}
+
+static void pmem_unclaim(int id, unsigned long start, unsigned long len)
+{
+#ifdef CONFIG_CMA
+	if (pmem[id].movable)
+		free_contig_range(start >> PAGE_SHIFT,
+				  PAGE_ALIGN(len) >> PAGE_SHIFT);
+#endif
+}
+
+/*
+ * The best fit allocator keeps every extent of the region, allocated or
+ * free, in an rb-tree sorted by offset so that a freed extent finds its
+ * neighbours to merge with.  The tree is augmented with the longest free
+ * extent of each subtree, which tells in O(1) whether a request can be
+ * satisfied at all and how fragmented the region is.  The free extents
+ * are also kept in a second tree sorted by length, where the smallest one
+ * that fits is found in O(log n).
+ */
+static unsigned long pmem_max_free(struct rb_node *node)
+{
+	if (!node)
+		return 0;
+	return rb_entry(node, struct pmem_extent, node)->max_free;
+}
+
+static void pmem_extent_augment(struct rb_node *node, void *unused)
+{
+	struct pmem_extent *ext = rb_entry(node, struct pmem_extent, node);
+	unsigned long max_free = ext->free ? ext->len : 0;
+
+	max_free = max(max_free, pmem_max_free(node->rb_left));
+	max_free = max(max_free, pmem_max_free(node->rb_right));
+	ext->max_free = max_free;
+}
+
+static struct pmem_extent *pmem_extent_find(int id, unsigned long offset)
+{
+	struct rb_node *n = pmem[id].extents.rb_node;
+	struct pmem_extent *ext;
+
+	while (n) {
+		ext = rb_entry(n, struct pmem_extent, node);
+		if (offset < ext->offset)
+			n = n->rb_left;
+		else if (offset > ext->offset)
+			n = n->rb_right;
+		else
+			return ext;
+	}
+	return NULL;
+}
+
+static void pmem_extent_insert(int id, struct pmem_extent *ext)
+{
+	struct rb_node **p = &pmem[id].extents.rb_node, *parent = NULL;
+
+	while (*p) {
+		parent = *p;
+		if (ext->offset <
+		    rb_entry(parent, struct pmem_extent, node)->offset)
+			p = &parent->rb_left;
+		else
+			p = &parent->rb_right;
+	}
+	rb_link_node(&ext->node, parent, p);
+	rb_insert_color(&ext->node, &pmem[id].extents);
+	rb_augment_insert(&ext->node, pmem_extent_augment, NULL);
+}
+
+static void pmem_extent_erase(int id, struct pmem_extent *ext)
+{
+	struct rb_node *deepest = rb_augment_erase_begin(&ext->node);
+
+	rb_erase(&ext->node, &pmem[id].extents);
+	rb_augment_erase_end(deepest, pmem_extent_augment, NULL);
+}
+
+/* mark @ext free, the caller makes sure its neighbours are not */
+static void pmem_extent_set_free(int id, struct pmem_extent *ext)
+{
+	struct rb_node **p = &pmem[id].free_extents.rb_node, *parent = NULL;
+	struct pmem_extent *e;
+
+	while (*p) {
+		parent = *p;
+		e = rb_entry(parent, struct pmem_extent, free_node);
+		if (ext->len < e->len ||
+		    (ext->len == e->len && ext->offset < e->offset))
+			p = &parent->rb_left;
+		else
+			p = &parent->rb_right;
+	}
+	rb_link_node(&ext->free_node, parent, p);
+	rb_insert_color(&ext->free_node, &pmem[id].free_extents);
+
+	ext->free = 1;
+	pmem[id].free_pages += ext->len;
+	pmem[id].nr_free_extents++;
+	/* not an insertion, but it updates the path up from @ext */
+	rb_augment_insert(&ext->node, pmem_extent_augment, NULL);
+}
+
+static void pmem_extent_clear_free(int id, struct pmem_extent *ext)
+{
+	rb_erase(&ext->free_node, &pmem[id].free_extents);
+	ext->free = 0;
+	pmem[id].free_pages -= ext->len;
+	pmem[id].nr_free_extents--;
+	rb_augment_insert(&ext->node, pmem_extent_augment, NULL);
+}
+
+static int pmem_bestfit_init(int id)
+{
+	struct pmem_extent *ext;
+
+	ext = kzalloc(sizeof(*ext), GFP_KERNEL);
+	if (!ext)
+		return -ENOMEM;
+	pmem[id].extents = RB_ROOT;
+	pmem[id].free_extents = RB_ROOT;
+	ext->len = pmem[id].num_entries;
+	pmem_extent_insert(id, ext);
+	pmem_extent_set_free(id, ext);
+	return 0;
+}
+
+static int pmem_bestfit_allocate(int id, unsigned long len)
+{
+	/* caller should hold the write lock on pmem_sem! */
+	unsigned long pages = (len + PMEM_MIN_ALLOC - 1) / PMEM_MIN_ALLOC;
+	struct rb_node *n = pmem[id].free_extents.rb_node;
+	struct pmem_extent *ext, *best = NULL, *rest = NULL;
+
+	if (!pages || pmem_max_free(pmem[id].extents.rb_node) < pages) {
+		printk("pmem: no space left to allocate!\n");
+		return -1;
+	}
+
+	/* the shortest free extent that is long enough */
+	while (n) {
+		ext = rb_entry(n, struct pmem_extent, free_node);
+		if (ext->len >= pages) {
+			best = ext;
+			n = n->rb_left;
+		} else {
+			n = n->rb_right;
+		}
+	}
+	if (WARN_ON(!best))
+		return -1;
+
+	if (best->len > pages) {
+		rest = kmalloc(sizeof(*rest), GFP_KERNEL);
+		if (!rest)
+			return -1;
+	}
+	if (pmem_claim(id, PMEM_START_ADDR(id, best->offset),
+		       pages * PMEM_MIN_ALLOC)) {
+		kfree(rest);
+		return -1;
+	}
+
+	pmem_extent_clear_free(id, best);
+	if (rest) {
+		rest->offset = best->offset + pages;
+		rest->len = best->len - pages;
+		rest->free = 0;
+		best->len = pages;
+		pmem_extent_insert(id, rest);
+		pmem_extent_set_free(id, rest);
+	}
+	return best->offset;
+}
+
+static void pmem_bestfit_free(int id, int index)
+{
+	/* caller should hold the write lock on pmem_sem! */
+	struct pmem_extent *ext = pmem_extent_find(id, index), *near;
+	struct rb_node *n;
+
+	if (WARN_ON(!ext || ext->free))
+		return;
+	pmem_unclaim(id, PMEM_START_ADDR(id, ext->offset),
+		     ext->len * PMEM_MIN_ALLOC);
+
+	n = rb_prev(&ext->node);
+	if (n && rb_entry(n, struct pmem_extent, node)->free) {
+		near = rb_entry(n, struct pmem_extent, node);
+		pmem_extent_clear_free(id, near);
+		near->len += ext->len;
+		pmem_extent_erase(id, ext);
+		kfree(ext);
+		ext = near;
+	}
+	n = rb_next(&ext->node);
+	if (n && rb_entry(n, struct pmem_extent, node)->free) {
+		near = rb_entry(n, struct pmem_extent, node);
+		pmem_extent_clear_free(id, near);
+		ext->len += near->len;
+		pmem_extent_erase(id, near);
+		kfree(near);
+	}
+	pmem_extent_set_free(id, ext);
+}
+
+static unsigned long pmem_bestfit_len(int id, int index)
+{
+	struct pmem_extent *ext;
+	unsigned long len = 0;
+
+	down_read(&pmem[id].bitmap_sem);
+	ext = pmem_extent_find(id, index);
+	if (ext)
+		len = ext->len * PMEM_MIN_ALLOC;
+	up_read(&pmem[id].bitmap_sem);
+	return len;
+}
+
 static int pmem_free(int id, int index)
 {
 	/* caller should hold the write lock on pmem_sem! */
 	int buddy, curr = index;
 	DLOG("index %d\n", index);
 
+	pmem[id].stats.frees++;
 	if (pmem[id].no_allocator) {
+		/* in no_allocator mode index is the length */
+		pmem_unclaim(id, pmem[id].base, index);
 		pmem[id].allocated = 0;
 		return 0;
 	}
+	if (PMEM_IS_BESTFIT(id)) {
+		pmem_bestfit_free(id, index);
+		return 0;
+	}
+	pmem_unclaim(id, PMEM_START_ADDR(id, curr), PMEM_LEN(id, curr));
 	/* clean up the bitmap, merging any buddies */
 	pmem[id].bitmap[curr].allocated = 0;
 	/* find a slots buddy Buddy# = Slot# ^ (1 << order)
@@ -376,7 +668,7 @@ static unsigned long pmem_order(unsigned long len)
 	return i;
 }
 
-static int pmem_allocate(int id, unsigned long len)
+static int __pmem_allocate(int id, unsigned long len)
 {
 	/* caller should hold the write lock on pmem_sem! */
 	/* return the corresponding pdata[] entry */
@@ -389,10 +681,15 @@ static int pmem_allocate(int id, unsigned long len)
 		DLOG("no allocator");
 		if ((len > pmem[id].size) || pmem[id].allocated)
 			return -1;
+		if (pmem_claim(id, pmem[id].base, len))
+			return -1;
 		pmem[id].allocated = 1;
 		return len;
 	}
 
+	if (PMEM_IS_BESTFIT(id))
+		return pmem_bestfit_allocate(id, len);
+
 	if (order > PMEM_MAX_ORDER)
 		return -1;
 	DLOG("order %lx\n", order);
@@ -424,6 +721,11 @@ static int pmem_allocate(int id, unsigned long len)
 		return -1;
 	}
 
+	/* the slot keeps its index when split down to the requested order */
+	if (pmem_claim(id, PMEM_START_ADDR(id, best_fit),
+		       (1 << order) * PMEM_MIN_ALLOC))
+		return -1;
+
 	/* now partition the best fit:
 	 * 	split the slot into 2 buddies of order - 1
 	 * 	repeat until the slot is of the correct order
@@ -438,6 +740,27 @@ static int pmem_allocate(int id, unsigned long len)
 	return best_fit;
 }
 
+static int pmem_allocate(int id, unsigned long len)
+{
+	/* caller should hold the write lock on pmem_sem! */
+	struct pmem_stats *stats = &pmem[id].stats;
+	ktime_t start = ktime_get();
+	int index;
+	u64 ns;
+
+	index = __pmem_allocate(id, len);
+	if (index < 0) {
+		stats->failed++;
+		return index;
+	}
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	stats->allocs++;
+	stats->alloc_ns += ns;
+	if (ns > stats->max_alloc_ns)
+		stats->max_alloc_ns = ns;
+	return index;
+}
+
 static pgprot_t phys_mem_access_prot(struct file *file, pgprot_t vma_prot)
 {
 	int id = get_id(file);
@@ -470,6 +793,8 @@ static unsigned long pmem_len(int id, struct pmem_data *data)
 {
 	if (pmem[id].no_allocator)
 		return data->index;
+	else if (PMEM_IS_BESTFIT(id))
+		return pmem_bestfit_len(id, data->index);
 	else
 		return PMEM_LEN(id, data->index);
 }
@@ -1139,7 +1464,9 @@ static long pmem_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 			if (has_allocation(file))
 				return -EINVAL;
 			data = (struct pmem_data *)file->private_data;
+			down_write(&pmem[id].bitmap_sem);
 			data->index = pmem_allocate(id, arg);
+			up_write(&pmem[id].bitmap_sem);
 			break;
 		}
 	case PMEM_CONNECT:
@@ -1171,6 +1498,58 @@ static ssize_t debug_open(struct inode *inode, struct file *file)
 	return 0;
 }
 
+static int debug_stats(int id, char *buf, int size)
+{
+	static const char * const names[] = {
+		[PMEM_ALLOCATORTYPE_BUDDY] = "buddy",
+		[PMEM_ALLOCATORTYPE_BESTFIT] = "best fit",
+	};
+	struct pmem_stats *stats = &pmem[id].stats;
+	unsigned long free = 0, nr_free = 0, largest = 0, i;
+	u64 avg;
+	int n;
+
+	down_read(&pmem[id].bitmap_sem);
+	if (pmem[id].no_allocator) {
+		if (!pmem[id].allocated) {
+			free = largest = pmem[id].num_entries;
+			nr_free = 1;
+		}
+	} else if (PMEM_IS_BESTFIT(id)) {
+		free = pmem[id].free_pages;
+		nr_free = pmem[id].nr_free_extents;
+		largest = pmem_max_free(pmem[id].extents.rb_node);
+	} else {
+		for (i = 0; i < pmem[id].num_entries;
+		     i = PMEM_NEXT_INDEX(id, i)) {
+			if (!PMEM_IS_FREE(id, i))
+				continue;
+			free += 1 << PMEM_ORDER(id, i);
+			nr_free++;
+			largest = max(largest, 1UL << PMEM_ORDER(id, i));
+		}
+	}
+
+	avg = stats->alloc_ns;
+	if (stats->allocs)
+		do_div(avg, stats->allocs);
+	n = scnprintf(buf, size, "allocator: %s\n"
+		      "allocs %lu failed %lu frees %lu\n"
+		      "alloc latency: avg %llu ns max %llu ns\n"
+		      "free: %lu KB in %lu extents, largest %lu KB, "
+		      "fragmentation %lu%%\n",
+		      pmem[id].no_allocator ? "none" :
+		      names[pmem[id].allocator_type],
+		      stats->allocs, stats->failed, stats->frees,
+		      (unsigned long long)avg,
+		      (unsigned long long)stats->max_alloc_ns,
+		      free * (PMEM_MIN_ALLOC >> 10), nr_free,
+		      largest * (PMEM_MIN_ALLOC >> 10),
+		      free ? 100 - largest * 100 / free : 0);
+	up_read(&pmem[id].bitmap_sem);
+	return n;
+}
+
 static ssize_t debug_read(struct file *file, char __user *buf, size_t count,
 			  loff_t *ppos)
 {
@@ -1183,7 +1562,8 @@ static ssize_t debug_read(struct file *file, char __user *buf, size_t count,
 	int n = 0;
 
 	DLOG("debug open\n");
-	n = scnprintf(buffer, debug_bufmax,
+	n = debug_stats(id, buffer, debug_bufmax);
+	n += scnprintf(buffer + n, debug_bufmax - n,
 		      "pid #: mapped regions (offset, len) (offset,len)...\n");
 
 	down(&pmem[id].data_list_sem);
@@ -1233,10 +1613,18 @@ int pmem_setup(struct android_pmem_platform_data *pdata,
 	id_count++;
 
 	pmem[id].no_allocator = pdata->no_allocator;
+	pmem[id].allocator_type = pdata->allocator_type;
 	pmem[id].cached = pdata->cached;
 	pmem[id].buffered = pdata->buffered;
+	pmem[id].movable = pdata->movable;
 	pmem[id].base = pdata->start;
 	pmem[id].size = pdata->size;
+	if (pmem[id].movable &&
+	    !cma_region_contains(pmem[id].base, pmem[id].size)) {
+		printk(KERN_WARNING "%s: not a CMA region, using it as a "
+		       "carveout\n", pdata->name);
+		pmem[id].movable = 0;
+	}
 	pmem[id].ioctl = ioctl;
 	pmem[id].release = release;
 	init_rwsem(&pmem[id].bitmap_sem);
@@ -1254,6 +1642,12 @@ int pmem_setup(struct android_pmem_platform_data *pdata,
 	}
 	pmem[id].num_entries = pmem[id].size / PMEM_MIN_ALLOC;
 
+	if (PMEM_IS_BESTFIT(id)) {
+		if (pmem_bestfit_init(id))
+			goto err_no_mem_for_metadata;
+		goto remap;
+	}
+
 	pmem[id].bitmap = kmalloc(pmem[id].num_entries *
 				  sizeof(struct pmem_bits), GFP_KERNEL);
 	if (!pmem[id].bitmap)
@@ -1269,6 +1663,7 @@ int pmem_setup(struct android_pmem_platform_data *pdata,
 		}
 	}
 
+remap:
 	if (pmem[id].cached)
 		pmem[id].vbase = ioremap_cached(pmem[id].base,
 						pmem[id].size);
@@ -1294,6 +1689,9 @@ int pmem_setup(struct android_pmem_platform_data *pdata,
 	return 0;
 error_cant_remap:
 	kfree(pmem[id].bitmap);
+	if (pmem[id].extents.rb_node)
+		kfree(rb_entry(pmem[id].extents.rb_node, struct pmem_extent,
+			       node));
 err_no_mem_for_metadata:
 	misc_deregister(&pmem[id].dev);
 err_cant_register_device:
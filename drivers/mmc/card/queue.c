@@ -131,6 +131,17 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card, spinlock_t *lock
 	blk_queue_ordered(mq->queue, QUEUE_ORDERED_DRAIN, NULL);
 	queue_flag_set_unlocked(QUEUE_FLAG_NONROT, mq->queue);
 
+	/*
+	 * Report the erase unit, so that filesystems can align their
+	 * allocations to what the card's FTL erases as a whole.
+	 */
+	if (mmc_card_mmc(card) && card->ext_csd.hc_erase_size)
+		mq->queue->limits.discard_granularity =
+			card->ext_csd.hc_erase_size << 9;
+	else if (card->csd.erase_size)
+		mq->queue->limits.discard_granularity =
+			card->csd.erase_size << 9;
+
 #ifdef CONFIG_MMC_BLOCK_BOUNCE
 	if (host->max_hw_segs == 1) {
 		unsigned int bouncesz;
@@ -159,6 +159,14 @@ static int mmc_decode_csd(struct mmc_card *card)
 	csd->write_blkbits = UNSTUFF_BITS(resp, 22, 4);
 	csd->write_partial = UNSTUFF_BITS(resp, 21, 1);
 
+	/* erase group, in write blocks: (ERASE_GRP_SIZE + 1) * (MULT + 1) */
+	if (csd->mmca_vsn >= CSD_SPEC_VER_2 && csd->write_blkbits >= 9) {
+		e = UNSTUFF_BITS(resp, 42, 5);
+		m = UNSTUFF_BITS(resp, 37, 5);
+		csd->erase_size = (e + 1) * (m + 1) <<
+				  (csd->write_blkbits - 9);
+	}
+
 	return 0;
 }
 
@@ -250,6 +258,11 @@ static int mmc_read_ext_csd(struct mmc_card *card)
 	}
 	}
 
+	/* high capacity erase unit, in units of 512 KB */
+	if (card->ext_csd.rev >= 3)
+		card->ext_csd.hc_erase_size =
+			ext_csd[EXT_CSD_HC_ERASE_GRP_SIZE] << 10;
+
 #ifdef CONFIG_MMC_INAND_4_41
 	//switch (ext_csd[EXT_CSD_CARD_TYPE]) {
 	switch (ext_csd[EXT_CSD_CARD_TYPE] & EXT_CSD_CARD_TYPE_MASK) {
@@ -106,7 +106,9 @@ static void dentry_iput(struct dentry * dentry)
 {
 	struct inode *inode = dentry->d_inode;
 	if (inode) {
+		write_seqcount_begin(&dentry->d_seq);
 		dentry->d_inode = NULL;
+		write_seqcount_end(&dentry->d_seq);
 		list_del_init(&dentry->d_alias);
 		spin_unlock(&dentry->d_lock);
 		spin_unlock(&dcache_lock);
@@ -909,6 +911,7 @@ static int shrink_dcache_memory(struct shrinker *shrink, int nr, gfp_t gfp_mask)
 static struct shrinker dcache_shrinker = {
 	.shrink = shrink_dcache_memory,
 	.seeks = DEFAULT_SEEKS,
+	.name = "dcache",
 };
 
 /**
@@ -949,6 +952,7 @@ struct dentry *d_alloc(struct dentry * parent, const struct qstr *name)
 	atomic_set(&dentry->d_count, 1);
 	dentry->d_flags = DCACHE_UNHASHED;
 	spin_lock_init(&dentry->d_lock);
+	seqcount_init(&dentry->d_seq);
 	dentry->d_inode = NULL;
 	dentry->d_parent = NULL;
 	dentry->d_sb = NULL;
@@ -1431,6 +1435,86 @@ next:
  	return found;
 }
 
+/**
+ * __d_lookup_rcu - search for a dentry without taking any lock or reference
+ * @parent: parent dentry
+ * @name: qstr of name we wish to find
+ * @seq: returns the d_seq of the dentry found
+ *
+ * This is the lookup of the lock-free path walk, called under
+ * rcu_read_lock(). The dentry returned is only good as long as its d_seq
+ * still equals @seq: the caller must check that with read_seqcount_retry()
+ * after it is done reading it, and take a reference with __dget_seq().
+ *
+ * Unlike __d_lookup(), a dentry being renamed may be missed, and parents
+ * with their own d_compare() are not handled at all. The caller falls back
+ * to the ordinary walk when %NULL is returned.
+ */
+struct dentry *__d_lookup_rcu(struct dentry *parent, struct qstr *name,
+			      unsigned *seq)
+{
+	unsigned int len = name->len;
+	unsigned int hash = name->hash;
+	const unsigned char *str = name->name;
+	struct hlist_head *head = d_hash(parent, hash);
+	struct hlist_node *node;
+	struct dentry *dentry;
+
+	hlist_for_each_entry_rcu(dentry, node, head, d_hash) {
+		const unsigned char *dname;
+		unsigned int dlen;
+		unsigned s;
+
+		if (dentry->d_name.hash != hash)
+			continue;
+		if (dentry->d_parent != parent)
+			continue;
+
+		s = read_seqcount_begin(&dentry->d_seq);
+		if (dentry->d_parent != parent || d_unhashed(dentry))
+			continue;
+		/*
+		 * d_move() may be changing the name under us.  Only compare
+		 * a length and name pointer that belong together, which the
+		 * sequence count vouches for; RCU keeps the name itself
+		 * around until we are done with it.
+		 */
+		dlen = ACCESS_ONCE(dentry->d_name.len);
+		dname = ACCESS_ONCE(dentry->d_name.name);
+		if (read_seqcount_retry(&dentry->d_seq, s))
+			continue;
+		if (dlen != len || memcmp(dname, str, len))
+			continue;
+
+		*seq = s;
+		return dentry;
+	}
+	return NULL;
+}
+
+/**
+ * __dget_seq - take a reference to a dentry found by __d_lookup_rcu()
+ * @dentry: dentry to get a reference to
+ * @seq: d_seq the dentry was found with
+ *
+ * Returns %1 if the dentry was not renamed, unhashed or made negative since
+ * @seq was read and a reference was taken, and %0 otherwise. The caller
+ * must be in the same RCU read-side critical section the dentry was found
+ * in.
+ */
+int __dget_seq(struct dentry *dentry, unsigned seq)
+{
+	int ret = 0;
+
+	spin_lock(&dentry->d_lock);
+	if (!read_seqcount_retry(&dentry->d_seq, seq)) {
+		atomic_inc(&dentry->d_count);
+		ret = 1;
+	}
+	spin_unlock(&dentry->d_lock);
+	return ret;
+}
+
 /**
  * d_hash_and_lookup - hash the qstr then search for a dentry
  * @dir: Directory to search in
@@ -1663,6 +1747,8 @@ static void d_move_locked(struct dentry * dentry, struct dentry * target)
 		spin_lock(&dentry->d_lock);
 		spin_lock_nested(&target->d_lock, DENTRY_D_LOCK_NESTED);
 	}
+	write_seqcount_begin(&dentry->d_seq);
+	write_seqcount_begin(&target->d_seq);
 
 	/* Move the dentry to the target hash queue, if on different bucket */
 	if (d_unhashed(dentry))
@@ -1697,6 +1783,8 @@ already_unhashed:
 	}
 
 	list_add(&dentry->d_u.d_child, &dentry->d_parent->d_subdirs);
+	write_seqcount_end(&target->d_seq);
+	write_seqcount_end(&dentry->d_seq);
 	spin_unlock(&target->d_lock);
 	fsnotify_d_move(dentry);
 	spin_unlock(&dentry->d_lock);
@@ -33,6 +33,7 @@
 #include <linux/bitops.h>
 #include <linux/mutex.h>
 #include <linux/anon_inodes.h>
+#include <linux/percpu.h>
 #include <asm/uaccess.h>
 #include <asm/system.h>
 #include <asm/io.h>
@@ -69,6 +70,16 @@
  * Events that require holding "epmutex" are very rare, while for
  * normal operations the epoll private "ep->mtx" will guarantee
  * a better scalability.
+ *
+ * The poll callback does not take "ep->lock" to queue a ready item: every
+ * CPU has its own ready list in "ep->cpus", with its own spinlock, and
+ * the callback queues on the list of the CPU it runs on. "ep->lock" is
+ * only taken to wake up the waiters in "ep->wq", and only when the list
+ * goes from empty to non empty. The per-CPU lists are merged into
+ * "ep->rdllist", which is only touched with "ep->mtx" held, when events
+ * are collected. The EPI_QUEUED bit of an item tells whether it sits on
+ * one of those lists (or on the private list of a scan), so that it is
+ * never queued twice.
  */
 
 /* Epoll private bits inside the event mask */
@@ -79,7 +90,11 @@
 
 #define EP_MAX_EVENTS (INT_MAX / sizeof(struct epoll_event))
 
-#define EP_UNACTIVE_PTR ((void *) -1L)
+/* Maximum number of epoll instances for one EPIOC_WAIT_MULTI request */
+#define EP_MAX_WAIT_DESCS 64
+
+/* "struct epitem"->state bit, set while the item is on a ready list */
+#define EPI_QUEUED 0
 
 #define EP_ITEM_COST (sizeof(struct epitem) + sizeof(struct eppoll_entry))
 
@@ -118,11 +133,8 @@ struct epitem {
 	/* List header used to link this structure to the eventpoll ready list */
 	struct list_head rdllink;
 
-	/*
-	 * Works together "struct eventpoll"->ovflist in keeping the
-	 * single linked chain of items.
-	 */
-	struct epitem *next;
+	/* EPI_QUEUED, changed with atomic bitops */
+	unsigned long state;
 
 	/* The file descriptor information this item refers to */
 	struct epoll_filefd ffd;
@@ -143,13 +155,19 @@ struct epitem {
 	struct epoll_event event;
 };
 
+/* Ready list the poll callback queues items on, one per CPU */
+struct ep_cpu_ready {
+	spinlock_t lock;
+	struct list_head rdllist;
+};
+
 /*
  * This structure is stored inside the "private_data" member of the file
  * structure and rapresent the main data sructure for the eventpoll
  * interface.
  */
 struct eventpoll {
-	/* Protect the this structure access */
+	/* Protects the "wq" wait queue */
 	spinlock_t lock;
 
 	/*
@@ -166,19 +184,15 @@ struct eventpoll {
 	/* Wait queue used by file->poll() */
 	wait_queue_head_t poll_wait;
 
-	/* List of ready file descriptors */
+	/* List of ready file descriptors, protected by "mtx" */
 	struct list_head rdllist;
 
+	/* Per-CPU lists the poll callback queues ready items on */
+	struct ep_cpu_ready *cpus;
+
 	/* RB tree root used to store monitored fd structs */
 	struct rb_root rbr;
 
-	/*
-	 * This is a single linked list that chains all the "struct epitem" that
-	 * happened while transfering ready events to userspace w/out
-	 * holding ->lock.
-	 */
-	struct epitem *ovflist;
-
 	/* The user that created the eventpoll descriptor */
 	struct user_struct *user;
 };
@@ -431,6 +445,86 @@ static void ep_unregister_pollwait(struct eventpoll *ep, struct epitem *epi)
 	}
 }
 
+/*
+ * Tells whether there may be ready items, on "ep->rdllist" or on any of
+ * the per-CPU ready lists. It is called without locks, so it is only a
+ * hint, but a waiter that checks it after queueing itself on "ep->wq"
+ * will not miss the wake up of an item queued after the check.
+ */
+static int ep_events_available(struct eventpoll *ep)
+{
+	int cpu;
+
+	if (!list_empty(&ep->rdllist))
+		return 1;
+	for_each_possible_cpu(cpu)
+		if (!list_empty(&per_cpu_ptr(ep->cpus, cpu)->rdllist))
+			return 1;
+
+	return 0;
+}
+
+/*
+ * Moves the items the poll callback queued on the per-CPU ready lists to
+ * the tail of @head. Must be called with "mtx" held (or "epmutex" if
+ * called from ep_free). A list found empty is skipped without taking its
+ * lock: an item being queued on it concurrently wakes the waiters up and
+ * is picked up by the next scan.
+ */
+static void ep_merge_ready(struct eventpoll *ep, struct list_head *head)
+{
+	unsigned long flags;
+	struct ep_cpu_ready *epc;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		epc = per_cpu_ptr(ep->cpus, cpu);
+		if (list_empty(&epc->rdllist))
+			continue;
+		spin_lock_irqsave(&epc->lock, flags);
+		list_splice_tail_init(&epc->rdllist, head);
+		spin_unlock_irqrestore(&epc->lock, flags);
+	}
+}
+
+/*
+ * Queues the item on "ep->rdllist", unless it already is on a ready list.
+ * Must be called with "mtx" held. Returns 1 if the item was queued.
+ */
+static int ep_queue_ready(struct eventpoll *ep, struct epitem *epi)
+{
+	if (test_and_set_bit(EPI_QUEUED, &epi->state))
+		return 0;
+	list_add_tail(&epi->rdllink, &ep->rdllist);
+
+	return 1;
+}
+
+/*
+ * Wakes up (if active) both the eventpoll wait list and the ->poll() wait
+ * list, once an item has been queued on a ready list that was empty.
+ */
+static void ep_wake_waiters(struct eventpoll *ep)
+{
+	unsigned long flags;
+
+	/*
+	 * Order queueing the item before looking at the wait queues. Pairs
+	 * with the set_current_state() a waiter does after queueing itself
+	 * and before calling ep_events_available().
+	 */
+	smp_mb();
+	if (waitqueue_active(&ep->wq)) {
+		spin_lock_irqsave(&ep->lock, flags);
+		wake_up_locked(&ep->wq);
+		spin_unlock_irqrestore(&ep->lock, flags);
+	}
+
+	/* We have to call this outside the lock */
+	if (waitqueue_active(&ep->poll_wait))
+		ep_poll_safewake(&ep->poll_wait);
+}
+
 /**
  * ep_scan_ready_list - Scans the ready list in a way that makes possible for
  *                      the scan code, to call f_op->poll(). Also allows for
@@ -449,7 +543,6 @@ static int ep_scan_ready_list(struct eventpoll *ep,
 {
 	int error, pwake = 0;
 	unsigned long flags;
-	struct epitem *epi, *nepi;
 	LIST_HEAD(txlist);
 
 	/*
@@ -459,53 +552,27 @@ static int ep_scan_ready_list(struct eventpoll *ep,
 	mutex_lock(&ep->mtx);
 
 	/*
-	 * Steal the ready list, and re-init the original one to the
-	 * empty list. Also, set ep->ovflist to NULL so that events
-	 * happening while looping w/out locks, are not lost. We cannot
-	 * have the poll callback to queue directly on ep->rdllist,
-	 * because we want the "sproc" callback to be able to do it
-	 * in a lockless way.
+	 * Steal the ready lists: "ep->rdllist", which nobody else touches
+	 * while we hold "mtx", and the per-CPU ones the poll callback queues
+	 * items on. The items keep EPI_QUEUED while they are on "txlist", so
+	 * the poll callback leaves them alone and the "sproc" callback can
+	 * walk and requeue them in a lockless way.
 	 */
-	spin_lock_irqsave(&ep->lock, flags);
 	list_splice_init(&ep->rdllist, &txlist);
-	ep->ovflist = NULL;
-	spin_unlock_irqrestore(&ep->lock, flags);
+	ep_merge_ready(ep, &txlist);
 
 	/*
 	 * Now call the callback function.
 	 */
 	error = (*sproc)(ep, &txlist, priv);
 
-	spin_lock_irqsave(&ep->lock, flags);
-	/*
-	 * During the time we spent inside the "sproc" callback, some
-	 * other events might have been queued by the poll callback.
-	 * We re-insert them inside the main ready-list here.
-	 */
-	for (nepi = ep->ovflist; (epi = nepi) != NULL;
-	     nepi = epi->next, epi->next = EP_UNACTIVE_PTR) {
-		/*
-		 * We need to check if the item is already in the list.
-		 * During the "sproc" callback execution time, items are
-		 * queued into ->ovflist but the "txlist" might already
-		 * contain them, and the list_splice() below takes care of them.
-		 */
-		if (!ep_is_linked(&epi->rdllink))
-			list_add_tail(&epi->rdllink, &ep->rdllist);
-	}
-	/*
-	 * We need to set back ep->ovflist to EP_UNACTIVE_PTR, so that after
-	 * releasing the lock, events will be queued in the normal way inside
-	 * ep->rdllist.
-	 */
-	ep->ovflist = EP_UNACTIVE_PTR;
-
 	/*
 	 * Quickly re-inject items left on "txlist".
 	 */
 	list_splice(&txlist, &ep->rdllist);
 
-	if (!list_empty(&ep->rdllist)) {
+	spin_lock_irqsave(&ep->lock, flags);
+	if (ep_events_available(ep)) {
 		/*
 		 * Wake up (if active) both the eventpoll wait list and
 		 * the ->poll() wait list (delayed after we release the lock).
@@ -532,7 +599,6 @@ static int ep_scan_ready_list(struct eventpoll *ep,
  */
 static int ep_remove(struct eventpoll *ep, struct epitem *epi)
 {
-	unsigned long flags;
 	struct file *file = epi->ffd.file;
 
 	/*
@@ -553,10 +619,15 @@ static int ep_remove(struct eventpoll *ep, struct epitem *epi)
 
 	rb_erase(&epi->rbn, &ep->rbr);
 
-	spin_lock_irqsave(&ep->lock, flags);
-	if (ep_is_linked(&epi->rdllink))
+	/*
+	 * The poll callback cannot queue the item anymore. If it is queued,
+	 * it is on "ep->rdllist" or on a per-CPU list, which we merge into
+	 * the former first.
+	 */
+	if (test_bit(EPI_QUEUED, &epi->state)) {
+		ep_merge_ready(ep, &ep->rdllist);
 		list_del_init(&epi->rdllink);
-	spin_unlock_irqrestore(&ep->lock, flags);
+	}
 
 	/* At this point it is safe to free the eventpoll item */
 	kmem_cache_free(epi_cache, epi);
@@ -608,6 +679,7 @@ static void ep_free(struct eventpoll *ep)
 	mutex_unlock(&epmutex);
 	mutex_destroy(&ep->mtx);
 	free_uid(ep->user);
+	free_percpu(ep->cpus);
 	kfree(ep);
 }
 
@@ -625,19 +697,31 @@ static int ep_read_events_proc(struct eventpoll *ep, struct list_head *head,
 			       void *priv)
 {
 	struct epitem *epi, *tmp;
+	unsigned int revents;
 
 	list_for_each_entry_safe(epi, tmp, head, rdllink) {
-		if (epi->ffd.file->f_op->poll(epi->ffd.file, NULL) &
-		    epi->event.events)
+		/*
+		 * Take the item off and clear EPI_QUEUED before polling the
+		 * file, as ep_send_events_proc() does, so that the poll
+		 * callback can queue it again for an event coming after the
+		 * poll.
+		 */
+		list_del_init(&epi->rdllink);
+		clear_bit(EPI_QUEUED, &epi->state);
+		smp_mb__after_clear_bit();
+
+		revents = epi->ffd.file->f_op->poll(epi->ffd.file, NULL) &
+			epi->event.events;
+		if (revents) {
+			/* still ready, unless the poll callback got there */
+			ep_queue_ready(ep, epi);
 			return POLLIN | POLLRDNORM;
-		else {
-			/*
-			 * Item has been dropped into the ready list by the poll
-			 * callback, but it's not actually ready, as far as
-			 * caller requested events goes. We can remove it here.
-			 */
-			list_del_init(&epi->rdllink);
 		}
+		/*
+		 * Item has been dropped into the ready list by the poll
+		 * callback, but it's not actually ready, as far as caller
+		 * requested events goes. It stays off the ready lists.
+		 */
 	}
 
 	return 0;
@@ -668,10 +752,15 @@ static unsigned int ep_eventpoll_poll(struct file *file, poll_table *wait)
 	return pollflags != -1 ? pollflags : 0;
 }
 
+static long ep_eventpoll_ioctl(struct file *file, unsigned int cmd,
+			       unsigned long arg);
+
 /* File callbacks that implement the eventpoll file behaviour */
 static const struct file_operations eventpoll_fops = {
 	.release	= ep_eventpoll_release,
-	.poll		= ep_eventpoll_poll
+	.poll		= ep_eventpoll_poll,
+	.unlocked_ioctl	= ep_eventpoll_ioctl,
+	.compat_ioctl	= ep_eventpoll_ioctl
 };
 
 /* Fast test to see if the file is an evenpoll file */
@@ -721,29 +810,39 @@ void eventpoll_release_file(struct file *file)
 
 static int ep_alloc(struct eventpoll **pep)
 {
-	int error;
+	int error, cpu;
 	struct user_struct *user;
 	struct eventpoll *ep;
+	struct ep_cpu_ready *epc;
 
 	user = get_current_user();
 	error = -ENOMEM;
 	ep = kzalloc(sizeof(*ep), GFP_KERNEL);
 	if (unlikely(!ep))
 		goto free_uid;
+	ep->cpus = alloc_percpu(struct ep_cpu_ready);
+	if (unlikely(!ep->cpus))
+		goto free_ep;
 
 	spin_lock_init(&ep->lock);
 	mutex_init(&ep->mtx);
 	init_waitqueue_head(&ep->wq);
 	init_waitqueue_head(&ep->poll_wait);
 	INIT_LIST_HEAD(&ep->rdllist);
+	for_each_possible_cpu(cpu) {
+		epc = per_cpu_ptr(ep->cpus, cpu);
+		spin_lock_init(&epc->lock);
+		INIT_LIST_HEAD(&epc->rdllist);
+	}
 	ep->rbr = RB_ROOT;
-	ep->ovflist = EP_UNACTIVE_PTR;
 	ep->user = user;
 
 	*pep = ep;
 
 	return 0;
 
+free_ep:
+	kfree(ep);
 free_uid:
 	free_uid(user);
 	return error;
@@ -785,12 +884,11 @@ static struct epitem *ep_find(struct eventpoll *ep, struct file *file, int fd)
  */
 static int ep_poll_callback(wait_queue_t *wait, unsigned mode, int sync, void *key)
 {
-	int pwake = 0;
+	int first;
 	unsigned long flags;
 	struct epitem *epi = ep_item_from_wait(wait);
 	struct eventpoll *ep = epi->ep;
-
-	spin_lock_irqsave(&ep->lock, flags);
+	struct ep_cpu_ready *epc;
 
 	/*
 	 * If the event mask does not contain any poll(2) event, we consider the
@@ -799,7 +897,7 @@ static int ep_poll_callback(wait_queue_t *wait, unsigned mode, int sync, void *k
 	 * until the next EPOLL_CTL_MOD will be issued.
 	 */
 	if (!(epi->event.events & ~EP_PRIVATE_BITS))
-		goto out_unlock;
+		return 1;
 
 	/*
 	 * Check the events coming with the callback. At this stage, not
@@ -808,41 +906,32 @@ static int ep_poll_callback(wait_queue_t *wait, unsigned mode, int sync, void *k
 	 * test for "key" != NULL before the event match test.
 	 */
 	if (key && !((unsigned long) key & epi->event.events))
-		goto out_unlock;
+		return 1;
 
 	/*
-	 * If we are trasfering events to userspace, we can hold no locks
-	 * (because we're accessing user memory, and because of linux f_op->poll()
-	 * semantics). All the events that happens during that period of time are
-	 * chained in ep->ovflist and requeued later on.
+	 * If this file is already in a ready list we exit soon. That includes
+	 * the private list of a scan transferring events to userspace, which
+	 * clears EPI_QUEUED before it polls the file again.
 	 */
-	if (unlikely(ep->ovflist != EP_UNACTIVE_PTR)) {
-		if (epi->next == EP_UNACTIVE_PTR) {
-			epi->next = ep->ovflist;
-			ep->ovflist = epi;
-		}
-		goto out_unlock;
-	}
-
-	/* If this file is already in the ready list we exit soon */
-	if (!ep_is_linked(&epi->rdllink))
-		list_add_tail(&epi->rdllink, &ep->rdllist);
+	if (test_and_set_bit(EPI_QUEUED, &epi->state))
+		return 1;
 
 	/*
-	 * Wake up ( if active ) both the eventpoll wait list and the ->poll()
-	 * wait list.
+	 * Any of the per-CPU lists would do, as each has its own lock; the
+	 * one of this CPU is the least likely to be contended.
 	 */
-	if (waitqueue_active(&ep->wq))
-		wake_up_locked(&ep->wq);
-	if (waitqueue_active(&ep->poll_wait))
-		pwake++;
+	epc = per_cpu_ptr(ep->cpus, raw_smp_processor_id());
+	spin_lock_irqsave(&epc->lock, flags);
+	first = list_empty(&epc->rdllist);
+	list_add_tail(&epi->rdllink, &epc->rdllist);
+	spin_unlock_irqrestore(&epc->lock, flags);
 
-out_unlock:
-	spin_unlock_irqrestore(&ep->lock, flags);
-
-	/* We have to call this outside the lock */
-	if (pwake)
-		ep_poll_safewake(&ep->poll_wait);
+	/*
+	 * Whoever queued the items already on the list woke the waiters up,
+	 * and they did not collect the items yet.
+	 */
+	if (first)
+		ep_wake_waiters(ep);
 
 	return 1;
 }
@@ -895,8 +984,7 @@ static void ep_rbtree_insert(struct eventpoll *ep, struct epitem *epi)
 static int ep_insert(struct eventpoll *ep, struct epoll_event *event,
 		     struct file *tfile, int fd)
 {
-	int error, revents, pwake = 0;
-	unsigned long flags;
+	int error, revents;
 	struct epitem *epi;
 	struct ep_pqueue epq;
 
@@ -914,7 +1002,7 @@ static int ep_insert(struct eventpoll *ep, struct epoll_event *event,
 	ep_set_ffd(&epi->ffd, tfile, fd);
 	epi->event = *event;
 	epi->nwait = 0;
-	epi->next = EP_UNACTIVE_PTR;
+	epi->state = 0;
 
 	/* Initialize the poll table using the queue callback */
 	epq.epi = epi;
@@ -949,27 +1037,14 @@ static int ep_insert(struct eventpoll *ep, struct epoll_event *event,
 	 */
 	ep_rbtree_insert(ep, epi);
 
-	/* We have to drop the new item inside our item list to keep track of it */
-	spin_lock_irqsave(&ep->lock, flags);
-
-	/* If the file is already "ready" we drop it inside the ready list */
-	if ((revents & event->events) && !ep_is_linked(&epi->rdllink)) {
-		list_add_tail(&epi->rdllink, &ep->rdllist);
-
-		/* Notify waiting tasks that events are available */
-		if (waitqueue_active(&ep->wq))
-			wake_up_locked(&ep->wq);
-		if (waitqueue_active(&ep->poll_wait))
-			pwake++;
-	}
-
-	spin_unlock_irqrestore(&ep->lock, flags);
-
 	atomic_inc(&ep->user->epoll_watches);
 
-	/* We have to call this outside the lock */
-	if (pwake)
-		ep_poll_safewake(&ep->poll_wait);
+	/*
+	 * If the file is already "ready" we drop it inside the ready list
+	 * and notify waiting tasks that events are available.
+	 */
+	if ((revents & event->events) && ep_queue_ready(ep, epi))
+		ep_wake_waiters(ep);
 
 	return 0;
 
@@ -978,14 +1053,13 @@ error_unregister:
 
 	/*
 	 * We need to do this because an event could have been arrived on some
-	 * allocated wait queue. Note that we don't care about the ep->ovflist
-	 * list, since that is used/cleaned only inside a section bound by "mtx".
-	 * And ep_insert() is called with "mtx" held.
+	 * allocated wait queue, and the poll callback queued the item on a
+	 * per-CPU ready list.
 	 */
-	spin_lock_irqsave(&ep->lock, flags);
-	if (ep_is_linked(&epi->rdllink))
+	if (test_bit(EPI_QUEUED, &epi->state)) {
+		ep_merge_ready(ep, &ep->rdllist);
 		list_del_init(&epi->rdllink);
-	spin_unlock_irqrestore(&ep->lock, flags);
+	}
 
 	kmem_cache_free(epi_cache, epi);
 
@@ -998,7 +1072,6 @@ error_unregister:
  */
 static int ep_modify(struct eventpoll *ep, struct epitem *epi, struct epoll_event *event)
 {
-	int pwake = 0;
 	unsigned int revents;
 
 	/*
@@ -1016,26 +1089,11 @@ static int ep_modify(struct eventpoll *ep, struct epitem *epi, struct epoll_even
 	revents = epi->ffd.file->f_op->poll(epi->ffd.file, NULL);
 
 	/*
-	 * If the item is "hot" and it is not registered inside the ready
-	 * list, push it inside.
+	 * If the item is "hot" and it is not registered inside a ready
+	 * list, push it inside and notify waiting tasks.
 	 */
-	if (revents & event->events) {
-		spin_lock_irq(&ep->lock);
-		if (!ep_is_linked(&epi->rdllink)) {
-			list_add_tail(&epi->rdllink, &ep->rdllist);
-
-			/* Notify waiting tasks that events are available */
-			if (waitqueue_active(&ep->wq))
-				wake_up_locked(&ep->wq);
-			if (waitqueue_active(&ep->poll_wait))
-				pwake++;
-		}
-		spin_unlock_irq(&ep->lock);
-	}
-
-	/* We have to call this outside the lock */
-	if (pwake)
-		ep_poll_safewake(&ep->poll_wait);
+	if ((revents & event->events) && ep_queue_ready(ep, epi))
+		ep_wake_waiters(ep);
 
 	return 0;
 }
@@ -1060,6 +1118,14 @@ static int ep_send_events_proc(struct eventpoll *ep, struct list_head *head,
 
 		list_del_init(&epi->rdllink);
 
+		/*
+		 * From here on the poll callback may queue the item again,
+		 * on a per-CPU list. Clear the bit before polling the file,
+		 * so that an event coming after the poll is not lost.
+		 */
+		clear_bit(EPI_QUEUED, &epi->state);
+		smp_mb__after_clear_bit();
+
 		revents = epi->ffd.file->f_op->poll(epi->ffd.file, NULL) &
 			epi->event.events;
 
@@ -1072,7 +1138,8 @@ static int ep_send_events_proc(struct eventpoll *ep, struct list_head *head,
 		if (revents) {
 			if (__put_user(revents, &uevent->events) ||
 			    __put_user(epi->event.data, &uevent->data)) {
-				list_add(&epi->rdllink, head);
+				if (!test_and_set_bit(EPI_QUEUED, &epi->state))
+					list_add(&epi->rdllink, head);
 				return eventcnt ? eventcnt : -EFAULT;
 			}
 			eventcnt++;
@@ -1089,9 +1156,9 @@ static int ep_send_events_proc(struct eventpoll *ep, struct list_head *head,
 				 * into ep->rdllist besides us. The epoll_ctl()
 				 * callers are locked out by
 				 * ep_scan_ready_list() holding "mtx" and the
-				 * poll callback will queue them in ep->ovflist.
+				 * poll callback queues on the per-CPU lists.
 				 */
-				list_add_tail(&epi->rdllink, &ep->rdllist);
+				ep_queue_ready(ep, epi);
 			}
 		}
 	}
@@ -1110,31 +1177,44 @@ static int ep_send_events(struct eventpoll *ep,
 	return ep_scan_ready_list(ep, ep_send_events_proc, &esed);
 }
 
-static int ep_poll(struct eventpoll *ep, struct epoll_event __user *events,
-		   int maxevents, long timeout)
+/*
+ * Sets up the expiry time for schedule_hrtimeout_range() from an epoll_wait()
+ * timeout in milliseconds. Returns 1 if the caller must not sleep at all.
+ */
+static int ep_timeout_init(long timeout, ktime_t **to, ktime_t *expires,
+			   long *slack)
 {
-	int res, eavail, timed_out = 0;
-	unsigned long flags;
-	long slack;
-	wait_queue_t wait;
 	struct timespec end_time;
-	ktime_t expires, *to = NULL;
 
+	*to = NULL;
+	*slack = 0;
 	if (timeout > 0) {
 		ktime_get_ts(&end_time);
 		timespec_add_ns(&end_time, (u64)timeout * NSEC_PER_MSEC);
-		slack = select_estimate_accuracy(&end_time);
-		to = &expires;
-		*to = timespec_to_ktime(end_time);
-	} else if (timeout == 0) {
-		timed_out = 1;
+		*slack = select_estimate_accuracy(&end_time);
+		*to = expires;
+		**to = timespec_to_ktime(end_time);
 	}
 
+	return timeout == 0;
+}
+
+static int ep_poll(struct eventpoll *ep, struct epoll_event __user *events,
+		   int maxevents, long timeout)
+{
+	int res, eavail, timed_out;
+	unsigned long flags;
+	long slack;
+	wait_queue_t wait;
+	ktime_t expires, *to;
+
+	timed_out = ep_timeout_init(timeout, &to, &expires, &slack);
+
 retry:
 	spin_lock_irqsave(&ep->lock, flags);
 
 	res = 0;
-	if (list_empty(&ep->rdllist)) {
+	if (!ep_events_available(ep)) {
 		/*
 		 * We don't have any available event to return to the caller.
 		 * We need to sleep here, and we will be wake up by
@@ -1150,7 +1230,7 @@ retry:
 			 * to TASK_INTERRUPTIBLE before doing the checks.
 			 */
 			set_current_state(TASK_INTERRUPTIBLE);
-			if (!list_empty(&ep->rdllist) || timed_out)
+			if (ep_events_available(ep) || timed_out)
 				break;
 			if (signal_pending(current)) {
 				res = -EINTR;
@@ -1165,10 +1245,18 @@ retry:
 		}
 		__remove_wait_queue(&ep->wq, &wait);
 
+		/*
+		 * The poll callback only wakes us up when a ready list goes
+		 * from empty to non empty. If we leave on a signal with our
+		 * wake up unused, pass it on to another waiter.
+		 */
+		if (res && ep_events_available(ep) && waitqueue_active(&ep->wq))
+			wake_up_locked(&ep->wq);
+
 		set_current_state(TASK_RUNNING);
 	}
 	/* Is it worth to try to dig for events ? */
-	eavail = !list_empty(&ep->rdllist) || ep->ovflist != EP_UNACTIVE_PTR;
+	eavail = ep_events_available(ep);
 
 	spin_unlock_irqrestore(&ep->lock, flags);
 
@@ -1184,6 +1272,102 @@ retry:
 	return res;
 }
 
+/* An eventpoll file EPIOC_WAIT_MULTI collects events from */
+struct ep_wait_multi {
+	struct file *file;
+	struct eventpoll *ep;
+	struct epoll_wait_desc desc;
+	wait_queue_t wait;
+};
+
+static int ep_multi_available(struct ep_wait_multi *m, int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+		if (ep_events_available(m[i].ep))
+			return 1;
+
+	return 0;
+}
+
+/*
+ * Same as ep_poll(), for several eventpoll files: sleeps until any of them
+ * has events, then transfers those of every one that has some. The counts
+ * in the user descriptors must have been cleared by the caller.
+ */
+static int ep_poll_multi(struct ep_wait_multi *m, int n,
+			 struct epoll_wait_desc __user *descs, long timeout)
+{
+	int i, res, count, total, timed_out;
+	unsigned long flags;
+	long slack;
+	ktime_t expires, *to;
+
+	timed_out = ep_timeout_init(timeout, &to, &expires, &slack);
+
+retry:
+	res = 0;
+	if (!ep_multi_available(m, n)) {
+		/*
+		 * Our waits are not exclusive, so that we never take away a
+		 * wake up meant for an epoll_wait() caller of one of the
+		 * files, nor does one of them take ours.
+		 */
+		for (i = 0; i < n; i++) {
+			init_waitqueue_entry(&m[i].wait, current);
+			spin_lock_irqsave(&m[i].ep->lock, flags);
+			__add_wait_queue(&m[i].ep->wq, &m[i].wait);
+			spin_unlock_irqrestore(&m[i].ep->lock, flags);
+		}
+
+		for (;;) {
+			/* See ep_poll() */
+			set_current_state(TASK_INTERRUPTIBLE);
+			if (ep_multi_available(m, n) || timed_out)
+				break;
+			if (signal_pending(current)) {
+				res = -EINTR;
+				break;
+			}
+			if (!schedule_hrtimeout_range(to, slack, HRTIMER_MODE_ABS))
+				timed_out = 1;
+		}
+		set_current_state(TASK_RUNNING);
+
+		for (i = 0; i < n; i++) {
+			spin_lock_irqsave(&m[i].ep->lock, flags);
+			__remove_wait_queue(&m[i].ep->wq, &m[i].wait);
+			spin_unlock_irqrestore(&m[i].ep->lock, flags);
+		}
+		if (res)
+			return res;
+	}
+
+	for (i = 0, total = 0; i < n; i++) {
+		if (!ep_events_available(m[i].ep))
+			continue;
+		count = ep_send_events(m[i].ep, (struct epoll_event __user *)
+				       (unsigned long)m[i].desc.events,
+				       m[i].desc.maxevents);
+		if (count > 0 && __put_user(count, &descs[i].nr_events))
+			count = -EFAULT;
+		if (count < 0) {
+			res = count;
+			break;
+		}
+		total += count;
+	}
+
+	/* Events already transferred take precedence over an error */
+	if (total)
+		return total;
+	if (!res && !timed_out)
+		goto retry;
+
+	return res;
+}
+
 /*
  * Open an eventpoll file descriptor.
  */
@@ -1367,6 +1551,85 @@ error_return:
 	return error;
 }
 
+/*
+ * Waits for events on several eventpoll files at once, so that a thread
+ * serving many of them needs a single system call and a single sleep.
+ * Returns the total number of events; the number for each file is stored
+ * in its descriptor, next to the events.
+ */
+static long ep_wait_multi(struct epoll_wait_desc __user *descs, int ndescs,
+			  int timeout)
+{
+	int i, error;
+	struct ep_wait_multi *m;
+
+	if (ndescs <= 0 || ndescs > EP_MAX_WAIT_DESCS)
+		return -EINVAL;
+	if (!access_ok(VERIFY_WRITE, descs, ndescs * sizeof(*descs)))
+		return -EFAULT;
+
+	m = kcalloc(ndescs, sizeof(*m), GFP_KERNEL);
+	if (!m)
+		return -ENOMEM;
+
+	for (i = 0; i < ndescs; i++) {
+		error = -EFAULT;
+		if (__copy_from_user(&m[i].desc, &descs[i], sizeof(m[i].desc)) ||
+		    __put_user(0, &descs[i].nr_events))
+			goto error_fput;
+
+		/* Same checks as epoll_wait(), for every descriptor */
+		error = -EINVAL;
+		if (m[i].desc.maxevents <= 0 ||
+		    m[i].desc.maxevents > EP_MAX_EVENTS)
+			goto error_fput;
+		error = -EFAULT;
+		if (m[i].desc.events != (unsigned long)m[i].desc.events ||
+		    !access_ok(VERIFY_WRITE,
+			       (void __user *)(unsigned long)m[i].desc.events,
+			       m[i].desc.maxevents * sizeof(struct epoll_event)))
+			goto error_fput;
+
+		error = -EBADF;
+		m[i].file = fget(m[i].desc.epfd);
+		if (!m[i].file)
+			goto error_fput;
+		error = -EINVAL;
+		if (!is_file_epoll(m[i].file))
+			goto error_fput;
+		m[i].ep = m[i].file->private_data;
+	}
+
+	/* Time to fish for events ... */
+	error = ep_poll_multi(m, ndescs, descs, timeout);
+
+error_fput:
+	for (i = 0; i < ndescs && m[i].file; i++)
+		fput(m[i].file);
+	kfree(m);
+
+	return error;
+}
+
+static long ep_eventpoll_ioctl(struct file *file, unsigned int cmd,
+			       unsigned long arg)
+{
+	struct epoll_wait_multi wm;
+
+	switch (cmd) {
+	case EPIOC_WAIT_MULTI:
+		if (copy_from_user(&wm, (void __user *)arg, sizeof(wm)))
+			return -EFAULT;
+		if (wm.descs != (unsigned long)wm.descs)
+			return -EFAULT;
+		return ep_wait_multi((struct epoll_wait_desc __user *)
+				     (unsigned long)wm.descs, wm.ndescs,
+				     wm.timeout);
+	}
+
+	return -ENOTTY;
+}
+
 #ifdef HAVE_SET_RESTORE_SIGMASK
 
 /*
@@ -2981,6 +2981,20 @@ static int ext4_da_writepages(struct address_space *mapping,
 	else
 		desired_nr_to_write = ext4_num_dirty_pages(inode, index,
 							   max_pages);
+
+	/*
+	 * On flash, write back whole erase blocks at a time, so that the
+	 * blocks mballoc padded the allocation out to are filled in one go.
+	 */
+	if (sbi->s_erase_block) {
+		unsigned int erase_pages = max_t(unsigned int, 1,
+			sbi->s_erase_block >>
+			(PAGE_CACHE_SHIFT - inode->i_blkbits));
+
+		max_pages = roundup(max_pages, erase_pages);
+		desired_nr_to_write = roundup(desired_nr_to_write,
+					      erase_pages);
+	}
 	if (desired_nr_to_write > max_pages)
 		desired_nr_to_write = max_pages;
 
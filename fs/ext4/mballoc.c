@@ -131,7 +131,10 @@
  * /sys/fs/ext4/<partition/mb_group_prealloc. The value is represented in
  * terms of number of blocks. If we have mounted the file system with -O
  * stripe=<value> option the group prealloc request is normalized to the
- * stripe value (sbi->s_stripe)
+ * stripe value (sbi->s_stripe).  With the flash_align option it is rounded
+ * up to whole erase blocks (sbi->s_erase_block) instead, so that the small
+ * files of a locality group share erase-block aligned regions, and inode
+ * preallocations are padded out to whole erase blocks as well.
  *
  * The regular allocator(using the buddy cache) supports few tunables.
  *
@@ -142,9 +145,10 @@
  * The regular allocator uses buddy scan only if the request len is power of
  * 2 blocks and the order of allocation is >= sbi->s_mb_order2_reqs. The
  * value of s_mb_order2_reqs can be tuned via
- * /sys/fs/ext4/<partition>/mb_order2_req.  If the request len is equal to
- * stripe size (sbi->s_stripe), we try to search for contiguous block in
- * stripe size. This should result in better allocation on RAID setups. If
+ * /sys/fs/ext4/<partition>/mb_order2_req.  If the request len is a
+ * multiple of the erase block or, without flash_align, of the stripe size,
+ * we try to search for contiguous blocks starting at a multiple of it.
+ * This should result in better allocation on RAID setups and on flash. If
  * not, we search in the specific group using bitmap for best extents. The
  * tunable min_to_scan and max_to_scan control the behaviour here.
  * min_to_scan indicate how long the mballoc __must__ look for a best
@@ -1661,6 +1665,22 @@ int ext4_mb_try_best_found(struct ext4_allocation_context *ac,
 	return 0;
 }
 
+/*
+ * Allocations are aligned to the flash erase block with flash_align, to
+ * the RAID stripe otherwise, if either is known.
+ */
+static inline unsigned long ext4_mb_align_unit(struct ext4_sb_info *sbi)
+{
+	return sbi->s_erase_block ? sbi->s_erase_block : sbi->s_stripe;
+}
+
+static inline int ext4_mb_aligned_request(struct ext4_allocation_context *ac)
+{
+	unsigned long unit = ext4_mb_align_unit(EXT4_SB(ac->ac_sb));
+
+	return unit && ac->ac_g_ex.fe_len % unit == 0;
+}
+
 static noinline_for_stack
 int ext4_mb_find_by_goal(struct ext4_allocation_context *ac,
 				struct ext4_buddy *e4b)
@@ -1682,13 +1702,13 @@ int ext4_mb_find_by_goal(struct ext4_allocation_context *ac,
 	max = mb_find_extent(e4b, 0, ac->ac_g_ex.fe_start,
 			     ac->ac_g_ex.fe_len, &ex);
 
-	if (max >= ac->ac_g_ex.fe_len && ac->ac_g_ex.fe_len == sbi->s_stripe) {
+	if (max >= ac->ac_g_ex.fe_len && ext4_mb_aligned_request(ac)) {
 		ext4_fsblk_t start;
 
 		start = ext4_group_first_block_no(ac->ac_sb, e4b->bd_group) +
 			ex.fe_start;
 		/* use do_div to get remainder (would be 64-bit modulo) */
-		if (do_div(start, sbi->s_stripe) == 0) {
+		if (do_div(start, ext4_mb_align_unit(sbi)) == 0) {
 			ac->ac_found++;
 			ac->ac_b_ex = ex;
 			ext4_mb_use_best_found(ac, e4b);
@@ -1820,9 +1840,9 @@ void ext4_mb_complex_scan_group(struct ext4_allocation_context *ac,
 }
 
 /*
- * This is a special case for storages like raid5
- * we try to find stripe-aligned chunks for stripe-size requests
- * XXX should do so at least for multiples of stripe size as well
+ * This is a special case for storages like raid5 and flash
+ * we try to find stripe- or erase block-aligned chunks for requests
+ * that are a multiple of the stripe or erase block size
  */
 static noinline_for_stack
 void ext4_mb_scan_aligned(struct ext4_allocation_context *ac,
@@ -1832,31 +1852,33 @@ void ext4_mb_scan_aligned(struct ext4_allocation_context *ac,
 	struct ext4_sb_info *sbi = EXT4_SB(sb);
 	void *bitmap = EXT4_MB_BITMAP(e4b);
 	struct ext4_free_extent ex;
+	unsigned long unit = ext4_mb_align_unit(sbi);
 	ext4_fsblk_t first_group_block;
 	ext4_fsblk_t a;
 	ext4_grpblk_t i;
 	int max;
 
-	BUG_ON(sbi->s_stripe == 0);
+	BUG_ON(unit == 0);
 
-	/* find first stripe-aligned block in group */
+	/* find first aligned block in group */
 	first_group_block = ext4_group_first_block_no(sb, e4b->bd_group);
 
-	a = first_group_block + sbi->s_stripe - 1;
-	do_div(a, sbi->s_stripe);
-	i = (a * sbi->s_stripe) - first_group_block;
+	a = first_group_block + unit - 1;
+	do_div(a, unit);
+	i = (a * unit) - first_group_block;
 
 	while (i < EXT4_BLOCKS_PER_GROUP(sb)) {
 		if (!mb_test_bit(i, bitmap)) {
-			max = mb_find_extent(e4b, 0, i, sbi->s_stripe, &ex);
-			if (max >= sbi->s_stripe) {
+			max = mb_find_extent(e4b, 0, i, ac->ac_g_ex.fe_len,
+					     &ex);
+			if (max >= ac->ac_g_ex.fe_len) {
 				ac->ac_found++;
 				ac->ac_b_ex = ex;
 				ext4_mb_use_best_found(ac, e4b);
 				break;
 			}
 		}
-		i += sbi->s_stripe;
+		i += unit;
 	}
 }
 
@@ -2094,8 +2116,7 @@ repeat:
 			ac->ac_groups_scanned++;
 			if (cr == 0)
 				ext4_mb_simple_scan_group(ac, &e4b);
-			else if (cr == 1 &&
-					ac->ac_g_ex.fe_len == sbi->s_stripe)
+			else if (cr == 1 && ext4_mb_aligned_request(ac))
 				ext4_mb_scan_aligned(ac, &e4b);
 			else
 				ext4_mb_complex_scan_group(ac, &e4b);
@@ -2821,20 +2842,31 @@ out_err:
  * here we normalize request for locality group
  * Group request are normalized to s_strip size if we set the same via mount
  * option. If not we set it to s_mb_group_prealloc which can be configured via
- * /sys/fs/ext4/<partition>/mb_group_prealloc
+ * /sys/fs/ext4/<partition>/mb_group_prealloc, rounded up to whole erase
+ * blocks with flash_align
  *
  * XXX: should we try to preallocate more than the group has now?
  */
 static void ext4_mb_normalize_group_request(struct ext4_allocation_context *ac)
 {
 	struct super_block *sb = ac->ac_sb;
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
 	struct ext4_locality_group *lg = ac->ac_lg;
 
 	BUG_ON(lg == NULL);
-	if (EXT4_SB(sb)->s_stripe)
-		ac->ac_g_ex.fe_len = EXT4_SB(sb)->s_stripe;
-	else
-		ac->ac_g_ex.fe_len = EXT4_SB(sb)->s_mb_group_prealloc;
+	if (sbi->s_erase_block) {
+		unsigned long len = roundup(sbi->s_mb_group_prealloc,
+					    sbi->s_erase_block);
+
+		if (len > EXT4_BLOCKS_PER_GROUP(sb))
+			len = EXT4_BLOCKS_PER_GROUP(sb) -
+			      EXT4_BLOCKS_PER_GROUP(sb) % sbi->s_erase_block;
+		ac->ac_g_ex.fe_len = len;
+	} else if (sbi->s_stripe) {
+		ac->ac_g_ex.fe_len = sbi->s_stripe;
+	} else {
+		ac->ac_g_ex.fe_len = sbi->s_mb_group_prealloc;
+	}
 	mb_debug(1, "#%u: goal %u blocks for locality group\n",
 		current->pid, ac->ac_g_ex.fe_len);
 }
@@ -2851,6 +2883,7 @@ ext4_mb_normalize_request(struct ext4_allocation_context *ac,
 	ext4_lblk_t end;
 	loff_t size, orig_size, start_off;
 	ext4_lblk_t start, orig_start;
+	unsigned long erase_block = EXT4_SB(ac->ac_sb)->s_erase_block;
 	struct ext4_inode_info *ei = EXT4_I(ac->ac_inode);
 	struct ext4_prealloc_space *pa;
 
@@ -2925,6 +2958,23 @@ ext4_mb_normalize_request(struct ext4_allocation_context *ac,
 	orig_size = size = size >> bsbits;
 	orig_start = start = start_off >> bsbits;
 
+	/*
+	 * On flash, pad the request out to whole erase blocks, so that the
+	 * file's data doesn't share an erase block with other data that is
+	 * rewritten or freed at another time.
+	 */
+	if (erase_block) {
+		ext4_lblk_t pad_start = start - start % erase_block;
+		ext4_lblk_t pad_end = roundup(start + (ext4_lblk_t)size,
+					      erase_block);
+
+		if (pad_end > pad_start &&
+		    pad_end - pad_start <= EXT4_BLOCKS_PER_GROUP(ac->ac_sb)) {
+			start = pad_start;
+			size = pad_end - pad_start;
+		}
+	}
+
 	/* don't cover already allocated blocks in selected range */
 	if (ar->pleft && start <= ar->lleft) {
 		size -= ar->lleft + 1 - start;
@@ -77,7 +77,7 @@ static struct file_system_type ext3_fs_type = {
 	.name		= "ext3",
 	.get_sb		= ext4_get_sb,
 	.kill_sb	= kill_block_super,
-	.fs_flags	= FS_REQUIRES_DEV,
+	.fs_flags	= FS_REQUIRES_DEV | FS_INODE_RCU,
 };
 #define IS_EXT3_SB(sb) ((sb)->s_bdev->bd_holder == &ext3_fs_type)
 #else
@@ -801,7 +801,8 @@ static int init_inodecache(void)
 	ext4_inode_cachep = kmem_cache_create("ext4_inode_cache",
 					     sizeof(struct ext4_inode_info),
 					     0, (SLAB_RECLAIM_ACCOUNT|
-						SLAB_MEM_SPREAD),
+						SLAB_MEM_SPREAD|
+						SLAB_DESTROY_BY_RCU),
 					     init_once);
 	if (ext4_inode_cachep == NULL)
 		return -ENOMEM;
@@ -932,7 +933,7 @@ static int ext4_show_options(struct seq_file *seq, struct vfsmount *vfs)
 	}
 	if (sbi->s_max_batch_time != EXT4_DEF_MAX_BATCH_TIME) {
 		seq_printf(seq, ",max_batch_time=%u",
-			   (unsigned) sbi->s_min_batch_time);
+			   (unsigned) sbi->s_max_batch_time);
 	}
 
 	/*
@@ -980,6 +981,9 @@ static int ext4_show_options(struct seq_file *seq, struct vfsmount *vfs)
 	if (test_opt(sb, DISCARD))
 		seq_puts(seq, ",discard");
 
+	if (test_opt(sb, FLASH_ALIGN))
+		seq_printf(seq, ",flash_align=%lu", sbi->s_erase_block);
+
 	if (test_opt(sb, NOLOAD))
 		seq_puts(seq, ",norecovery");
 
@@ -1160,7 +1164,7 @@ enum {
 	Opt_block_validity, Opt_noblock_validity,
 	Opt_inode_readahead_blks, Opt_journal_ioprio,
 	Opt_dioread_nolock, Opt_dioread_lock,
-	Opt_discard, Opt_nodiscard,
+	Opt_discard, Opt_nodiscard, Opt_flash_align, Opt_noflash_align,
 };
 
 static const match_table_t tokens = {
@@ -1231,6 +1235,9 @@ static const match_table_t tokens = {
 	{Opt_dioread_lock, "dioread_lock"},
 	{Opt_discard, "discard"},
 	{Opt_nodiscard, "nodiscard"},
+	{Opt_flash_align, "flash_align=%u"},
+	{Opt_flash_align, "flash_align"},
+	{Opt_noflash_align, "noflash_align"},
 	{Opt_err, NULL},
 };
 
@@ -1693,6 +1700,21 @@ set_qf_format:
 		case Opt_nodiscard:
 			clear_opt(sbi->s_mount_opt, DISCARD);
 			break;
+		case Opt_flash_align:
+			if (args[0].from) {
+				if (match_int(&args[0], &option))
+					return 0;
+				if (option < 0)
+					return 0;
+			} else
+				option = 0;	/* No argument, ask the device */
+			set_opt(sbi->s_mount_opt, FLASH_ALIGN);
+			sbi->s_erase_block = option;
+			break;
+		case Opt_noflash_align:
+			clear_opt(sbi->s_mount_opt, FLASH_ALIGN);
+			sbi->s_erase_block = 0;
+			break;
 		case Opt_dioread_nolock:
 			set_opt(sbi->s_mount_opt, DIOREAD_NOLOCK);
 			break;
@@ -2213,6 +2235,42 @@ static unsigned long ext4_get_stripe_size(struct ext4_sb_info *sbi)
 	return 0;
 }
 
+/**
+ * ext4_get_erase_block: Get the flash erase block size.
+ * @sb: super block
+ *
+ * With flash_align=<blocks> use the mount option value, with a plain
+ * flash_align the erase unit the device reports in its queue limits:
+ * the discard granularity, or else the optimal I/O size.  Allocations
+ * are aligned to it, so it has to be more than a block and no more than
+ * the blocks per group, or flash_align is turned off again.
+ */
+static unsigned long ext4_get_erase_block(struct super_block *sb)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct request_queue *q = bdev_get_queue(sb->s_bdev);
+	unsigned long erase_block = sbi->s_erase_block;
+
+	if (!test_opt(sb, FLASH_ALIGN))
+		return 0;
+
+	if (!erase_block && q) {
+		unsigned int bytes = q->limits.discard_granularity;
+
+		if (!bytes)
+			bytes = queue_io_opt(q);
+		erase_block = bytes >> sb->s_blocksize_bits;
+	}
+
+	if (erase_block < 2 || erase_block > sbi->s_blocks_per_group) {
+		ext4_msg(sb, KERN_WARNING, "no usable erase block size, "
+			 "disabling flash_align");
+		clear_opt(sbi->s_mount_opt, FLASH_ALIGN);
+		return 0;
+	}
+	return erase_block;
+}
+
 /* sysfs supprt */
 
 struct ext4_attr {
@@ -2818,6 +2876,7 @@ static int ext4_fill_super(struct super_block *sb, void *data, int silent)
 	}
 
 	sbi->s_stripe = ext4_get_stripe_size(sbi);
+	sbi->s_erase_block = ext4_get_erase_block(sb);
 	sbi->s_max_writeback_mb_bump = 128;
 
 	/*
@@ -3615,6 +3674,7 @@ static int ext4_remount(struct super_block *sb, int *flags, char *data)
 	old_opts.s_commit_interval = sbi->s_commit_interval;
 	old_opts.s_min_batch_time = sbi->s_min_batch_time;
 	old_opts.s_max_batch_time = sbi->s_max_batch_time;
+	old_opts.s_erase_block = sbi->s_erase_block;
 #ifdef CONFIG_QUOTA
 	old_opts.s_jquota_fmt = sbi->s_jquota_fmt;
 	for (i = 0; i < MAXQUOTAS; i++)
@@ -3631,6 +3691,7 @@ static int ext4_remount(struct super_block *sb, int *flags, char *data)
 		err = -EINVAL;
 		goto restore_opts;
 	}
+	sbi->s_erase_block = ext4_get_erase_block(sb);
 
 	if (sbi->s_mount_flags & EXT4_MF_FS_ABORTED)
 		ext4_abort(sb, __func__, "Abort forced by user");
@@ -3756,6 +3817,7 @@ restore_opts:
 	sbi->s_commit_interval = old_opts.s_commit_interval;
 	sbi->s_min_batch_time = old_opts.s_min_batch_time;
 	sbi->s_max_batch_time = old_opts.s_max_batch_time;
+	sbi->s_erase_block = old_opts.s_erase_block;
 #ifdef CONFIG_QUOTA
 	sbi->s_jquota_fmt = old_opts.s_jquota_fmt;
 	for (i = 0; i < MAXQUOTAS; i++) {
@@ -4120,7 +4182,7 @@ static struct file_system_type ext2_fs_type = {
 	.name		= "ext2",
 	.get_sb		= ext4_get_sb,
 	.kill_sb	= kill_block_super,
-	.fs_flags	= FS_REQUIRES_DEV,
+	.fs_flags	= FS_REQUIRES_DEV | FS_INODE_RCU,
 };
 
 static inline void register_as_ext2(void)
@@ -4165,7 +4227,7 @@ static struct file_system_type ext4_fs_type = {
 	.name		= "ext4",
 	.get_sb		= ext4_get_sb,
 	.kill_sb	= kill_block_super,
-	.fs_flags	= FS_REQUIRES_DEV,
+	.fs_flags	= FS_REQUIRES_DEV | FS_INODE_RCU,
 };
 
 static int __init init_ext4_fs(void)
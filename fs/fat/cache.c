@@ -10,14 +10,32 @@
 
 #include <linux/fs.h>
 #include <linux/slab.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
 #include <linux/buffer_head.h>
 #include "fat.h"
 
+/*
+ * Every inode keeps the contiguous runs of its cluster chain seen so far
+ * in an rb-tree indexed by file cluster, so that a seek far into a large
+ * file only walks the FAT from the closest run before it.  An inode may
+ * always cache FAT_MIN_CACHE runs.  Beyond that new runs are allocated
+ * while fewer than fat_cache_max runs are cached in total, and otherwise
+ * the inode's least recently used run is reused.  Under memory pressure
+ * the shrinker frees runs of all inodes, least recently used first.
+ */
+
 /* this must be > 0. */
-#define FAT_MAX_CACHE	8
+#define FAT_MIN_CACHE	8
+
+static unsigned int fat_cache_max = 16384;
+module_param_named(cache_extents, fat_cache_max, uint, 0644);
+MODULE_PARM_DESC(cache_extents, "Cluster runs cached for all files before "
+		 "runs are reused (default 16384)");
 
 struct fat_cache {
 	struct list_head cache_list;
+	struct rb_node rb_node;
 	int nr_contig;	/* number of contiguous clusters */
 	int fcluster;	/* cluster number in the file. */
 	int dcluster;	/* cluster number on disk. */
@@ -30,9 +48,16 @@ struct fat_cache_id {
 	int dcluster;
 };
 
-static inline int fat_max_cache(struct inode *inode)
+static atomic_t fat_cache_count = ATOMIC_INIT(0);
+
+/* Inodes with cached runs, for the shrinker */
+static LIST_HEAD(fat_cache_inodes);
+static DEFINE_SPINLOCK(fat_cache_inodes_lock);
+
+static inline int fat_cache_may_alloc(struct inode *inode)
 {
-	return FAT_MAX_CACHE;
+	return MSDOS_I(inode)->nr_caches < FAT_MIN_CACHE ||
+		atomic_read(&fat_cache_count) < fat_cache_max;
 }
 
 static struct kmem_cache *fat_cache_cachep;
@@ -44,6 +69,14 @@ static void init_once(void *foo)
 	INIT_LIST_HEAD(&cache->cache_list);
 }
 
+static int fat_cache_shrink(struct shrinker *shrink, int nr_to_scan,
+			    gfp_t gfp_mask);
+
+static struct shrinker fat_cache_shrinker = {
+	.shrink = fat_cache_shrink,
+	.seeks = DEFAULT_SEEKS,
+};
+
 int __init fat_cache_init(void)
 {
 	fat_cache_cachep = kmem_cache_create("fat_cache",
@@ -52,23 +85,31 @@ int __init fat_cache_init(void)
 				init_once);
 	if (fat_cache_cachep == NULL)
 		return -ENOMEM;
+	register_shrinker(&fat_cache_shrinker);
 	return 0;
 }
 
 void fat_cache_destroy(void)
 {
+	unregister_shrinker(&fat_cache_shrinker);
 	kmem_cache_destroy(fat_cache_cachep);
 }
 
 static inline struct fat_cache *fat_cache_alloc(struct inode *inode)
 {
-	return kmem_cache_alloc(fat_cache_cachep, GFP_NOFS);
+	struct fat_cache *cache;
+
+	cache = kmem_cache_alloc(fat_cache_cachep, GFP_NOFS);
+	if (cache)
+		atomic_inc(&fat_cache_count);
+	return cache;
 }
 
 static inline void fat_cache_free(struct fat_cache *cache)
 {
 	BUG_ON(!list_empty(&cache->cache_list));
 	kmem_cache_free(fat_cache_cachep, cache);
+	atomic_dec(&fat_cache_count);
 }
 
 static inline void fat_cache_update_lru(struct inode *inode,
@@ -78,29 +119,59 @@ static inline void fat_cache_update_lru(struct inode *inode,
 		list_move(&cache->cache_list, &MSDOS_I(inode)->cache_lru);
 }
 
+/* The cached run starting at @fclus, or else the closest one before it */
+static struct fat_cache *fat_cache_find(struct inode *inode, int fclus)
+{
+	struct rb_node *n = MSDOS_I(inode)->cache_tree.rb_node;
+	struct fat_cache *p, *hit = NULL;
+
+	while (n) {
+		p = rb_entry(n, struct fat_cache, rb_node);
+		if (fclus < p->fcluster) {
+			n = n->rb_left;
+		} else {
+			hit = p;
+			if (fclus == p->fcluster)
+				break;
+			n = n->rb_right;
+		}
+	}
+	return hit;
+}
+
+static void fat_cache_insert(struct inode *inode, struct fat_cache *cache)
+{
+	struct rb_node **p = &MSDOS_I(inode)->cache_tree.rb_node;
+	struct rb_node *parent = NULL;
+	struct fat_cache *c;
+
+	while (*p) {
+		parent = *p;
+		c = rb_entry(parent, struct fat_cache, rb_node);
+		if (cache->fcluster < c->fcluster)
+			p = &parent->rb_left;
+		else
+			p = &parent->rb_right;
+	}
+	rb_link_node(&cache->rb_node, parent, p);
+	rb_insert_color(&cache->rb_node, &MSDOS_I(inode)->cache_tree);
+}
+
 static int fat_cache_lookup(struct inode *inode, int fclus,
 			    struct fat_cache_id *cid,
 			    int *cached_fclus, int *cached_dclus)
 {
-	static struct fat_cache nohit = { .fcluster = 0, };
-
-	struct fat_cache *hit = &nohit, *p;
+	struct fat_cache *hit;
 	int offset = -1;
 
 	spin_lock(&MSDOS_I(inode)->cache_lru_lock);
-	list_for_each_entry(p, &MSDOS_I(inode)->cache_lru, cache_list) {
-		/* Find the cache of "fclus" or nearest cache. */
-		if (p->fcluster <= fclus && hit->fcluster < p->fcluster) {
-			hit = p;
-			if ((hit->fcluster + hit->nr_contig) < fclus) {
-				offset = hit->nr_contig;
-			} else {
-				offset = fclus - hit->fcluster;
-				break;
-			}
-		}
-	}
-	if (hit != &nohit) {
+	/* Find the cache of "fclus" or nearest cache. */
+	hit = fat_cache_find(inode, fclus);
+	if (hit) {
+		if ((hit->fcluster + hit->nr_contig) < fclus)
+			offset = hit->nr_contig;
+		else
+			offset = fclus - hit->fcluster;
 		fat_cache_update_lru(inode, hit);
 
 		cid->id = MSDOS_I(inode)->cache_valid_id;
@@ -120,57 +191,68 @@ static struct fat_cache *fat_cache_merge(struct inode *inode,
 {
 	struct fat_cache *p;
 
-	list_for_each_entry(p, &MSDOS_I(inode)->cache_lru, cache_list) {
-		/* Find the same part as "new" in cluster-chain. */
-		if (p->fcluster == new->fcluster) {
-			BUG_ON(p->dcluster != new->dcluster);
-			if (new->nr_contig > p->nr_contig)
-				p->nr_contig = new->nr_contig;
-			return p;
-		}
+	/* Find the same part as "new" in cluster-chain. */
+	p = fat_cache_find(inode, new->fcluster);
+	if (p && p->fcluster == new->fcluster) {
+		BUG_ON(p->dcluster != new->dcluster);
+		if (new->nr_contig > p->nr_contig)
+			p->nr_contig = new->nr_contig;
+		return p;
 	}
 	return NULL;
 }
 
 static void fat_cache_add(struct inode *inode, struct fat_cache_id *new)
 {
+	struct msdos_inode_info *i = MSDOS_I(inode);
 	struct fat_cache *cache, *tmp;
 
 	if (new->fcluster == -1) /* dummy cache */
 		return;
 
-	spin_lock(&MSDOS_I(inode)->cache_lru_lock);
+	spin_lock(&i->cache_lru_lock);
 	if (new->id != FAT_CACHE_VALID &&
-	    new->id != MSDOS_I(inode)->cache_valid_id)
+	    new->id != i->cache_valid_id)
 		goto out;	/* this cache was invalidated */
 
 	cache = fat_cache_merge(inode, new);
 	if (cache == NULL) {
-		if (MSDOS_I(inode)->nr_caches < fat_max_cache(inode)) {
-			MSDOS_I(inode)->nr_caches++;
-			spin_unlock(&MSDOS_I(inode)->cache_lru_lock);
+		if (fat_cache_may_alloc(inode) || list_empty(&i->cache_lru)) {
+			i->nr_caches++;
+			spin_unlock(&i->cache_lru_lock);
 
 			tmp = fat_cache_alloc(inode);
-			spin_lock(&MSDOS_I(inode)->cache_lru_lock);
+			spin_lock(&i->cache_lru_lock);
+			if (tmp == NULL) {
+				i->nr_caches--;
+				goto out;
+			}
 			cache = fat_cache_merge(inode, new);
 			if (cache != NULL) {
-				MSDOS_I(inode)->nr_caches--;
+				i->nr_caches--;
 				fat_cache_free(tmp);
 				goto out_update_lru;
 			}
 			cache = tmp;
+			if (list_empty(&i->cache_inode)) {
+				spin_lock(&fat_cache_inodes_lock);
+				list_add_tail(&i->cache_inode, &fat_cache_inodes);
+				spin_unlock(&fat_cache_inodes_lock);
+			}
 		} else {
-			struct list_head *p = MSDOS_I(inode)->cache_lru.prev;
+			struct list_head *p = i->cache_lru.prev;
 			cache = list_entry(p, struct fat_cache, cache_list);
+			rb_erase(&cache->rb_node, &i->cache_tree);
 		}
 		cache->fcluster = new->fcluster;
 		cache->dcluster = new->dcluster;
 		cache->nr_contig = new->nr_contig;
+		fat_cache_insert(inode, cache);
 	}
 out_update_lru:
 	fat_cache_update_lru(inode, cache);
 out:
-	spin_unlock(&MSDOS_I(inode)->cache_lru_lock);
+	spin_unlock(&i->cache_lru_lock);
 }
 
 /*
@@ -188,6 +270,12 @@ static void __fat_cache_inval_inode(struct inode *inode)
 		i->nr_caches--;
 		fat_cache_free(cache);
 	}
+	i->cache_tree = RB_ROOT;
+	if (!list_empty(&i->cache_inode)) {
+		spin_lock(&fat_cache_inodes_lock);
+		list_del_init(&i->cache_inode);
+		spin_unlock(&fat_cache_inodes_lock);
+	}
 	/* Update. The copy of caches before this id is discarded. */
 	i->cache_valid_id++;
 	if (i->cache_valid_id == FAT_CACHE_VALID)
@@ -201,6 +289,48 @@ void fat_cache_inval_inode(struct inode *inode)
 	spin_unlock(&MSDOS_I(inode)->cache_lru_lock);
 }
 
+/*
+ * Free up to @nr_to_scan cached runs, the least recently used ones of the
+ * inode that has had runs the longest first.  Inodes whose lock is held
+ * are skipped.  The runs are still valid, so the ids are left alone.
+ */
+static int fat_cache_shrink(struct shrinker *shrink, int nr_to_scan,
+			    gfp_t gfp_mask)
+{
+	struct msdos_inode_info *i;
+	struct fat_cache *cache;
+	LIST_HEAD(scanned);
+
+	spin_lock(&fat_cache_inodes_lock);
+	while (nr_to_scan > 0 && !list_empty(&fat_cache_inodes)) {
+		i = list_first_entry(&fat_cache_inodes, struct msdos_inode_info,
+				     cache_inode);
+		if (!spin_trylock(&i->cache_lru_lock)) {
+			list_move_tail(&i->cache_inode, &scanned);
+			continue;
+		}
+		while (nr_to_scan > 0 && !list_empty(&i->cache_lru)) {
+			cache = list_entry(i->cache_lru.prev, struct fat_cache,
+					   cache_list);
+			list_del_init(&cache->cache_list);
+			rb_erase(&cache->rb_node, &i->cache_tree);
+			i->nr_caches--;
+			fat_cache_free(cache);
+			nr_to_scan--;
+		}
+		if (list_empty(&i->cache_lru))
+			list_del_init(&i->cache_inode);
+		else
+			list_move_tail(&i->cache_inode, &scanned);
+		spin_unlock(&i->cache_lru_lock);
+	}
+	list_splice_tail(&scanned, &fat_cache_inodes);
+	spin_unlock(&fat_cache_inodes_lock);
+
+	return (atomic_read(&fat_cache_count) / 100) *
+		sysctl_vfs_cache_pressure;
+}
+
 static inline int cache_contiguous(struct fat_cache_id *cid, int dclus)
 {
 	cid->nr_contig++;
@@ -265,8 +395,12 @@ int fat_get_cluster(struct inode *inode, int cluster, int *fclus, int *dclus)
 		}
 		(*fclus)++;
 		*dclus = nr;
-		if (!cache_contiguous(&cid, *dclus))
+		if (!cache_contiguous(&cid, *dclus)) {
+			/* keep every run walked past, not only the last one */
+			cid.nr_contig--;
+			fat_cache_add(inode, &cid);
 			cache_init(&cid, *fclus, *dclus);
+		}
 	}
 	nr = 0;
 	fat_cache_add(inode, &cid);
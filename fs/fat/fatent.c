@@ -7,6 +7,9 @@
 #include <linux/fs.h>
 #include <linux/msdos_fs.h>
 #include <linux/blkdev.h>
+#include <linux/vmalloc.h>
+#include <linux/workqueue.h>
+#include <linux/completion.h>
 #include "fat.h"
 
 struct fatent_operations {
@@ -21,6 +24,26 @@ struct fatent_operations {
 
 static DEFINE_SPINLOCK(fat12_entry_lock);
 
+/*
+ * Bitmap of the free clusters, built by a scan of the whole FAT that is
+ * started at mount time on fat_scan_wq.  Allocation and freeing keep the
+ * bits up to date under fat_lock even while the scan runs, and the scan
+ * reads each FAT block under fat_lock too, so that the bitmap is exact
+ * once "ready" is set.  Allocation then skips the FAT blocks without any
+ * free entry, and statfs gets the count of free clusters from the scan
+ * instead of scanning the FAT a second time.
+ */
+struct fat_free_map {
+	struct super_block *sb;
+	struct work_struct work;
+	struct completion done;		/* the scan has ended */
+	int ready;			/* bits are valid, under fat_lock */
+	int stop;			/* unmounting, stop the scan */
+	unsigned long bits[0];
+};
+
+static struct workqueue_struct *fat_scan_wq;
+
 static void fat12_ent_blocknr(struct super_block *sb, int entry,
 			      int *offset, sector_t *blocknr)
 {
@@ -286,6 +309,41 @@ static inline void unlock_fat(struct msdos_sb_info *sbi)
 	mutex_unlock(&sbi->fat_lock);
 }
 
+static inline int fat_free_map_ready(struct msdos_sb_info *sbi)
+{
+	return sbi->free_map && sbi->free_map->ready;
+}
+
+static inline void fat_free_map_set(struct msdos_sb_info *sbi, int entry)
+{
+	if (sbi->free_map)
+		__set_bit(entry, sbi->free_map->bits);
+}
+
+static inline void fat_free_map_clear(struct msdos_sb_info *sbi, int entry)
+{
+	if (sbi->free_map)
+		__clear_bit(entry, sbi->free_map->bits);
+}
+
+/*
+ * Number of entries from @entry on, wrapping around the end of the FAT,
+ * up to the next free cluster.  -1 if there is none.
+ */
+static int fat_free_map_skip(struct msdos_sb_info *sbi, int entry)
+{
+	unsigned long *bits = sbi->free_map->bits;
+	unsigned long next;
+
+	next = find_next_bit(bits, sbi->max_cluster, entry);
+	if (next < sbi->max_cluster)
+		return next - entry;
+	next = find_next_bit(bits, entry, FAT_START_ENT);
+	if (next < entry)
+		return sbi->max_cluster - entry + next - FAT_START_ENT;
+	return -1;
+}
+
 void fat_ent_access_init(struct super_block *sb)
 {
 	struct msdos_sb_info *sbi = MSDOS_SB(sb);
@@ -459,7 +517,7 @@ int fat_alloc_clusters(struct inode *inode, int *cluster, int nr_cluster)
 	struct fatent_operations *ops = sbi->fatent_ops;
 	struct fat_entry fatent, prev_ent;
 	struct buffer_head *bhs[MAX_BUF_PER_PAGE];
-	int i, count, err, nr_bhs, idx_clus;
+	int i, count, err, nr_bhs, idx_clus, skip;
 
 	BUG_ON(nr_cluster > (MAX_BUF_PER_PAGE / 2));	/* fixed limit */
 
@@ -478,6 +536,18 @@ int fat_alloc_clusters(struct inode *inode, int *cluster, int nr_cluster)
 	while (count < sbi->max_cluster) {
 		if (fatent.entry >= sbi->max_cluster)
 			fatent.entry = FAT_START_ENT;
+		if (fat_free_map_ready(sbi)) {
+			/* don't read the FAT blocks without free entries */
+			skip = fat_free_map_skip(sbi, fatent.entry);
+			if (skip < 0)
+				break;
+			count += skip;
+			if (count >= sbi->max_cluster)
+				break;
+			fatent.entry += skip;
+			if (fatent.entry >= sbi->max_cluster)
+				fatent.entry -= sbi->max_cluster - FAT_START_ENT;
+		}
 		fatent_set_entry(&fatent, fatent.entry);
 		err = fat_ent_read_block(sb, &fatent);
 		if (err)
@@ -494,6 +564,7 @@ int fat_alloc_clusters(struct inode *inode, int *cluster, int nr_cluster)
 					ops->ent_put(&prev_ent, entry);
 
 				fat_collect_bhs(bhs, &nr_bhs, &fatent);
+				fat_free_map_clear(sbi, entry);
 
 				sbi->prev_free = entry;
 				if (sbi->free_clusters != -1)
@@ -584,6 +655,7 @@ int fat_free_clusters(struct inode *inode, int cluster)
 		}
 
 		ops->ent_put(&fatent, FAT_ENT_FREE);
+		fat_free_map_set(sbi, fatent.entry);
 		if (sbi->free_clusters != -1) {
 			sbi->free_clusters++;
 			sb->s_dirt = 1;
@@ -646,6 +718,10 @@ int fat_count_free_clusters(struct super_block *sb)
 	unsigned long reada_blocks, reada_mask, cur_block;
 	int err = 0, free;
 
+	/* the mount time scan counts them, unless it failed */
+	if (sbi->free_map)
+		wait_for_completion(&sbi->free_map->done);
+
 	lock_fat(sbi);
 	if (sbi->free_clusters != -1 && sbi->free_clus_valid)
 		goto out;
@@ -682,3 +758,101 @@ out:
 	unlock_fat(sbi);
 	return err;
 }
+
+/* The scan reads further ahead than fat_count_free_clusters() */
+#define FAT_SCAN_READA_SIZE	(1024 * 1024)
+
+static void fat_free_map_scan(struct work_struct *work)
+{
+	struct fat_free_map *map = container_of(work, struct fat_free_map,
+						work);
+	struct super_block *sb = map->sb;
+	struct msdos_sb_info *sbi = MSDOS_SB(sb);
+	struct fatent_operations *ops = sbi->fatent_ops;
+	struct fat_entry fatent;
+	unsigned long reada_blocks, reada_mask, cur_block;
+	int err = 0;
+
+	reada_blocks = FAT_SCAN_READA_SIZE >> sb->s_blocksize_bits;
+	reada_mask = reada_blocks - 1;
+	cur_block = 0;
+
+	fatent_init(&fatent);
+	fatent_set_entry(&fatent, FAT_START_ENT);
+	while (fatent.entry < sbi->max_cluster && !map->stop) {
+		/* readahead of fat blocks */
+		if ((cur_block & reada_mask) == 0) {
+			unsigned long rest = sbi->fat_length - cur_block;
+			fat_ent_reada(sb, &fatent, min(reada_blocks, rest));
+		}
+		cur_block++;
+
+		/* a block at a time, allocations go on in between */
+		lock_fat(sbi);
+		err = fat_ent_read_block(sb, &fatent);
+		if (err) {
+			unlock_fat(sbi);
+			break;
+		}
+		do {
+			if (ops->ent_get(&fatent) == FAT_ENT_FREE)
+				__set_bit(fatent.entry, map->bits);
+		} while (fat_ent_next(sbi, &fatent));
+		unlock_fat(sbi);
+	}
+	fatent_brelse(&fatent);
+
+	if (!err && !map->stop) {
+		lock_fat(sbi);
+		sbi->free_clusters = bitmap_weight(map->bits, sbi->max_cluster);
+		sbi->free_clus_valid = 1;
+		sb->s_dirt = 1;
+		map->ready = 1;
+		unlock_fat(sbi);
+	}
+	complete_all(&map->done);
+}
+
+void fat_free_map_init(struct super_block *sb)
+{
+	struct msdos_sb_info *sbi = MSDOS_SB(sb);
+	struct fat_free_map *map;
+	size_t size;
+
+	size = sizeof(*map) + BITS_TO_LONGS(sbi->max_cluster) * sizeof(long);
+	map = vmalloc(size);
+	if (!map)
+		return;		/* scan the FAT as before */
+	memset(map, 0, size);
+	map->sb = sb;
+	INIT_WORK(&map->work, fat_free_map_scan);
+	init_completion(&map->done);
+	sbi->free_map = map;
+	queue_work(fat_scan_wq, &map->work);
+}
+
+void fat_free_map_release(struct super_block *sb)
+{
+	struct msdos_sb_info *sbi = MSDOS_SB(sb);
+	struct fat_free_map *map = sbi->free_map;
+
+	if (!map)
+		return;
+	map->stop = 1;
+	cancel_work_sync(&map->work);
+	sbi->free_map = NULL;
+	vfree(map);
+}
+
+int __init fatent_wq_init(void)
+{
+	fat_scan_wq = create_singlethread_workqueue("fat_scan");
+	if (!fat_scan_wq)
+		return -ENOMEM;
+	return 0;
+}
+
+void fatent_wq_destroy(void)
+{
+	destroy_workqueue(fat_scan_wq);
+}
@@ -492,6 +492,8 @@ static void fat_put_super(struct super_block *sb)
 
 	lock_kernel();
 
+	fat_free_map_release(sb);
+
 	if (sb->s_dirt)
 		fat_write_super(sb);
 
@@ -533,6 +535,8 @@ static void init_once(void *foo)
 	ei->nr_caches = 0;
 	ei->cache_valid_id = FAT_CACHE_VALID + 1;
 	INIT_LIST_HEAD(&ei->cache_lru);
+	ei->cache_tree = RB_ROOT;
+	INIT_LIST_HEAD(&ei->cache_inode);
 	INIT_HLIST_NODE(&ei->i_fat_hash);
 	inode_init_once(&ei->vfs_inode);
 }
@@ -1518,6 +1522,8 @@ int fat_fill_super(struct super_block *sb, void *data, int silent,
 		goto out_fail;
 	}
 
+	fat_free_map_init(sb);
+
 	return 0;
 
 out_invalid:
@@ -1600,12 +1606,18 @@ static int __init init_fat_fs(void)
 	if (err)
 		return err;
 
-	err = fat_init_inodecache();
+	err = fatent_wq_init();
 	if (err)
 		goto failed;
 
+	err = fat_init_inodecache();
+	if (err)
+		goto failed_inodecache;
+
 	return 0;
 
+failed_inodecache:
+	fatent_wq_destroy();
 failed:
 	fat_cache_destroy();
 	return err;
@@ -1613,6 +1625,7 @@ failed:
 
 static void __exit exit_fat_fs(void)
 {
+	fatent_wq_destroy();
 	fat_cache_destroy();
 	fat_destroy_inodecache();
 }
@@ -469,6 +469,7 @@ static void cuse_fc_release(struct fuse_conn *fc)
 static int cuse_channel_open(struct inode *inode, struct file *file)
 {
 	struct cuse_conn *cc;
+	struct fuse_dev *fud;
 	int rc;
 
 	/* set up cuse_conn */
@@ -481,14 +482,20 @@ static int cuse_channel_open(struct inode *inode, struct file *file)
 	INIT_LIST_HEAD(&cc->list);
 	cc->fc.release = cuse_fc_release;
 
+	/* from here on the channel's fuse_dev owns the base reference */
+	fud = fuse_dev_alloc(&cc->fc);
+	fuse_conn_put(&cc->fc);
+	if (!fud)
+		return -ENOMEM;
+
 	cc->fc.connected = 1;
 	cc->fc.blocked = 0;
 	rc = cuse_send_init(cc);
 	if (rc) {
-		fuse_conn_put(&cc->fc);
+		fuse_dev_free(fud);
 		return rc;
 	}
-	file->private_data = &cc->fc;	/* channel owns base reference to cc */
+	file->private_data = fud;
 
 	return 0;
 }
@@ -506,7 +513,8 @@ static int cuse_channel_open(struct inode *inode, struct file *file)
  */
 static int cuse_channel_release(struct inode *inode, struct file *file)
 {
-	struct cuse_conn *cc = fc_to_cc(file->private_data);
+	struct fuse_dev *fud = file->private_data;
+	struct cuse_conn *cc = fc_to_cc(fud->fc);
 	int rc;
 
 	/* remove from the conntbl, no more access from this point on */
@@ -25,15 +25,23 @@ MODULE_ALIAS("devname:fuse");
 
 static struct kmem_cache *fuse_req_cachep;
 
-static struct fuse_conn *fuse_get_conn(struct file *file)
+static struct fuse_dev *fuse_get_dev(struct file *file)
 {
 	/*
 	 * Lockless access is OK, because file->private data is set
-	 * once during mount and is valid until the file is released.
+	 * once during mount or FUSE_DEV_IOC_CLONE and is valid until the
+	 * file is released.
 	 */
 	return file->private_data;
 }
 
+static struct fuse_conn *fuse_get_conn(struct file *file)
+{
+	struct fuse_dev *fud = fuse_get_dev(file);
+
+	return fud ? fud->fc : NULL;
+}
+
 static void fuse_request_init(struct fuse_req *req)
 {
 	memset(req, 0, sizeof(*req));
@@ -237,19 +245,50 @@ static u64 fuse_get_unique(struct fuse_conn *fc)
 	return fc->reqctr;
 }
 
+/*
+ * Wake up a reader of @q.  If all of them are busy, wake up an idle
+ * reader of another queue instead, it will take the request from @q.
+ */
+static void wake_up_reader(struct fuse_conn *fc, struct fuse_queue *q)
+{
+	unsigned i;
+
+	if (!waitqueue_active(&q->waitq)) {
+		for (i = 0; i < fc->nr_queues; i++) {
+			if (waitqueue_active(&fc->queues[i].waitq)) {
+				q = &fc->queues[i];
+				break;
+			}
+		}
+	}
+	wake_up(&q->waitq);
+	kill_fasync(&fc->fasync, SIGIO, POLL_IN);
+}
+
+void fuse_wake_up_readers(struct fuse_conn *fc)
+{
+	unsigned i;
+
+	for (i = 0; i < FUSE_MAX_QUEUES; i++)
+		wake_up_all(&fc->queues[i].waitq);
+}
+
 static void queue_request(struct fuse_conn *fc, struct fuse_req *req)
 {
+	struct fuse_queue *q;
+
 	req->in.h.unique = fuse_get_unique(fc);
 	req->in.h.len = sizeof(struct fuse_in_header) +
 		len_args(req->in.numargs, (struct fuse_arg *) req->in.args);
-	list_add_tail(&req->list, &fc->pending);
+	/* spread the requests over the queues of the device files */
+	q = &fc->queues[fc->next_queue++ % fc->nr_queues];
+	list_add_tail(&req->list, &q->pending);
 	req->state = FUSE_REQ_PENDING;
 	if (!req->waiting) {
 		req->waiting = 1;
 		atomic_inc(&fc->num_waiting);
 	}
-	wake_up(&fc->waitq);
-	kill_fasync(&fc->fasync, SIGIO, POLL_IN);
+	wake_up_reader(fc, q);
 }
 
 static void flush_bg_queue(struct fuse_conn *fc)
@@ -320,8 +359,7 @@ __acquires(&fc->lock)
 static void queue_interrupt(struct fuse_conn *fc, struct fuse_req *req)
 {
 	list_add_tail(&req->intr_entry, &fc->interrupts);
-	wake_up(&fc->waitq);
-	kill_fasync(&fc->fasync, SIGIO, POLL_IN);
+	wake_up_reader(fc, &fc->queues[0]);
 }
 
 static void request_wait_answer(struct fuse_conn *fc, struct fuse_req *req)
@@ -880,19 +918,46 @@ static int fuse_copy_args(struct fuse_copy_state *cs, unsigned numargs,
 	return err;
 }
 
+/*
+ * The next request for @fud to read, from its own queue if that has any,
+ * otherwise from the queue of another device file whose readers are busy
+ */
+static struct fuse_req *next_request(struct fuse_dev *fud)
+{
+	struct fuse_conn *fc = fud->fc;
+	struct list_head *pending = &fud->queue->pending;
+	unsigned i;
+
+	for (i = 0; list_empty(pending); i++) {
+		if (i == fc->nr_queues)
+			return NULL;
+		pending = &fc->queues[i].pending;
+	}
+	return list_entry(pending->next, struct fuse_req, list);
+}
+
 static int request_pending(struct fuse_conn *fc)
 {
-	return !list_empty(&fc->pending) || !list_empty(&fc->interrupts);
+	unsigned i;
+
+	if (!list_empty(&fc->interrupts))
+		return 1;
+	for (i = 0; i < fc->nr_queues; i++) {
+		if (!list_empty(&fc->queues[i].pending))
+			return 1;
+	}
+	return 0;
 }
 
-/* Wait until a request is available on the pending list */
-static void request_wait(struct fuse_conn *fc)
-__releases(&fc->lock)
-__acquires(&fc->lock)
+/* Wait until a request is available on one of the pending lists */
+static void request_wait(struct fuse_dev *fud)
+__releases(&fud->fc->lock)
+__acquires(&fud->fc->lock)
 {
+	struct fuse_conn *fc = fud->fc;
 	DECLARE_WAITQUEUE(wait, current);
 
-	add_wait_queue_exclusive(&fc->waitq, &wait);
+	add_wait_queue_exclusive(&fud->queue->waitq, &wait);
 	while (fc->connected && !request_pending(fc)) {
 		set_current_state(TASK_INTERRUPTIBLE);
 		if (signal_pending(current))
@@ -903,7 +968,7 @@ __acquires(&fc->lock)
 		spin_lock(&fc->lock);
 	}
 	set_current_state(TASK_RUNNING);
-	remove_wait_queue(&fc->waitq, &wait);
+	remove_wait_queue(&fud->queue->waitq, &wait);
 }
 
 /*
@@ -944,6 +1009,17 @@ __releases(&fc->lock)
 	return err ? err : reqsize;
 }
 
+/*
+ * Continue copying to the userspace buffer right after the previous
+ * request, at the part of the current page that is still unused
+ */
+static void fuse_copy_continue(struct fuse_copy_state *cs)
+{
+	cs->addr -= cs->len;
+	cs->seglen += cs->len;
+	cs->len = 0;
+}
+
 /*
  * Read a single request into the userspace filesystem's buffer.  This
  * function waits until a request is available, then removes it from
@@ -952,14 +1028,21 @@ __releases(&fc->lock)
  * was an error during the copying then it's finished by calling
  * request_end().  Otherwise add it to the processing list, and set
  * the 'sent' flag.
+ *
+ * If batching was enabled on the device file, further pending requests
+ * are read into the rest of the buffer, up to fud->batch of them in
+ * total.  Each one starts with its fuse_in_header.
  */
-static ssize_t fuse_dev_do_read(struct fuse_conn *fc, struct file *file,
+static ssize_t fuse_dev_do_read(struct fuse_dev *fud, struct file *file,
 				struct fuse_copy_state *cs, size_t nbytes)
 {
+	struct fuse_conn *fc = fud->fc;
 	int err;
 	struct fuse_req *req;
 	struct fuse_in *in;
 	unsigned reqsize;
+	unsigned nr_read = 0;
+	size_t done = 0;
 
  restart:
 	spin_lock(&fc->lock);
@@ -968,7 +1051,7 @@ static ssize_t fuse_dev_do_read(struct fuse_conn *fc, struct file *file,
 	    !request_pending(fc))
 		goto err_unlock;
 
-	request_wait(fc);
+	request_wait(fud);
 	err = -ENODEV;
 	if (!fc->connected)
 		goto err_unlock;
@@ -982,7 +1065,8 @@ static ssize_t fuse_dev_do_read(struct fuse_conn *fc, struct file *file,
 		return fuse_read_interrupt(fc, cs, nbytes, req);
 	}
 
-	req = list_entry(fc->pending.next, struct fuse_req, list);
+	req = next_request(fud);
+ next:
 	req->state = FUSE_REQ_READING;
 	list_move(&req->list, &fc->io);
 
@@ -1008,12 +1092,12 @@ static ssize_t fuse_dev_do_read(struct fuse_conn *fc, struct file *file,
 	req->locked = 0;
 	if (req->aborted) {
 		request_end(fc, req);
-		return -ENODEV;
+		return done ? done : -ENODEV;
 	}
 	if (err) {
 		req->out.h.error = -EIO;
 		request_end(fc, req);
-		return err;
+		return done ? done : err;
 	}
 	if (!req->isreply)
 		request_end(fc, req);
@@ -1024,7 +1108,21 @@ static ssize_t fuse_dev_do_read(struct fuse_conn *fc, struct file *file,
 			queue_interrupt(fc, req);
 		spin_unlock(&fc->lock);
 	}
-	return reqsize;
+	done += reqsize;
+	nbytes -= reqsize;
+
+	/* Batch whatever fits, interrupts go first in a read of their own */
+	if (++nr_read < fud->batch && !cs->pipebufs) {
+		spin_lock(&fc->lock);
+		req = next_request(fud);
+		if (fc->connected && list_empty(&fc->interrupts) && req &&
+		    req->in.h.len <= nbytes) {
+			fuse_copy_continue(cs);
+			goto next;
+		}
+		spin_unlock(&fc->lock);
+	}
+	return done;
 
  err_unlock:
 	spin_unlock(&fc->lock);
@@ -1036,13 +1134,13 @@ static ssize_t fuse_dev_read(struct kiocb *iocb, const struct iovec *iov,
 {
 	struct fuse_copy_state cs;
 	struct file *file = iocb->ki_filp;
-	struct fuse_conn *fc = fuse_get_conn(file);
-	if (!fc)
+	struct fuse_dev *fud = fuse_get_dev(file);
+	if (!fud)
 		return -EPERM;
 
-	fuse_copy_init(&cs, fc, 1, iov, nr_segs);
+	fuse_copy_init(&cs, fud->fc, 1, iov, nr_segs);
 
-	return fuse_dev_do_read(fc, file, &cs, iov_length(iov, nr_segs));
+	return fuse_dev_do_read(fud, file, &cs, iov_length(iov, nr_segs));
 }
 
 static int fuse_dev_pipe_buf_steal(struct pipe_inode_info *pipe,
@@ -1070,18 +1168,18 @@ static ssize_t fuse_dev_splice_read(struct file *in, loff_t *ppos,
 	int do_wakeup = 0;
 	struct pipe_buffer *bufs;
 	struct fuse_copy_state cs;
-	struct fuse_conn *fc = fuse_get_conn(in);
-	if (!fc)
+	struct fuse_dev *fud = fuse_get_dev(in);
+	if (!fud)
 		return -EPERM;
 
 	bufs = kmalloc(pipe->buffers * sizeof (struct pipe_buffer), GFP_KERNEL);
 	if (!bufs)
 		return -ENOMEM;
 
-	fuse_copy_init(&cs, fc, 1, NULL, 0);
+	fuse_copy_init(&cs, fud->fc, 1, NULL, 0);
 	cs.pipebufs = bufs;
 	cs.pipe = pipe;
-	ret = fuse_dev_do_read(fc, in, &cs, len);
+	ret = fuse_dev_do_read(fud, in, &cs, len);
 	if (ret < 0)
 		goto out;
 
@@ -1368,6 +1466,9 @@ static ssize_t fuse_dev_do_write(struct fuse_conn *fc,
 
 	err = copy_out_args(cs, &req->out, nbytes);
 	fuse_copy_finish(cs);
+	/* still locked, the opener can't have gone away */
+	if (!err)
+		fuse_passthrough_setup(fc, req);
 
 	spin_lock(&fc->lock);
 	req->locked = 0;
@@ -1481,11 +1582,13 @@ out:
 static unsigned fuse_dev_poll(struct file *file, poll_table *wait)
 {
 	unsigned mask = POLLOUT | POLLWRNORM;
-	struct fuse_conn *fc = fuse_get_conn(file);
-	if (!fc)
+	struct fuse_dev *fud = fuse_get_dev(file);
+	struct fuse_conn *fc;
+	if (!fud)
 		return POLLERR;
 
-	poll_wait(file, &fc->waitq, wait);
+	fc = fud->fc;
+	poll_wait(file, &fud->queue->waitq, wait);
 
 	spin_lock(&fc->lock);
 	if (!fc->connected)
@@ -1554,9 +1657,12 @@ __acquires(&fc->lock)
 
 static void end_queued_requests(struct fuse_conn *fc)
 {
+	unsigned i;
+
 	fc->max_background = UINT_MAX;
 	flush_bg_queue(fc);
-	end_requests(fc, &fc->pending);
+	for (i = 0; i < fc->nr_queues; i++)
+		end_requests(fc, &fc->queues[i].pending);
 	end_requests(fc, &fc->processing);
 }
 
@@ -1587,7 +1693,7 @@ void fuse_abort_conn(struct fuse_conn *fc)
 		fc->blocked = 0;
 		end_io_requests(fc);
 		end_queued_requests(fc);
-		wake_up_all(&fc->waitq);
+		fuse_wake_up_readers(fc);
 		wake_up_all(&fc->blocked_waitq);
 		kill_fasync(&fc->fasync, SIGIO, POLL_IN);
 	}
@@ -1595,23 +1701,120 @@ void fuse_abort_conn(struct fuse_conn *fc)
 }
 EXPORT_SYMBOL_GPL(fuse_abort_conn);
 
+struct fuse_dev *fuse_dev_alloc(struct fuse_conn *fc)
+{
+	struct fuse_dev *fud;
+
+	fud = kzalloc(sizeof(struct fuse_dev), GFP_KERNEL);
+	if (!fud)
+		return NULL;
+
+	fud->fc = fuse_conn_get(fc);
+	fud->batch = 1;
+	spin_lock(&fc->lock);
+	fud->queue = &fc->queues[fc->dev_attached++ % FUSE_MAX_QUEUES];
+	if (fc->nr_queues < fc->dev_attached &&
+	    fc->nr_queues < FUSE_MAX_QUEUES)
+		fc->nr_queues++;
+	fc->dev_count++;
+	spin_unlock(&fc->lock);
+
+	return fud;
+}
+EXPORT_SYMBOL_GPL(fuse_dev_alloc);
+
+void fuse_dev_free(struct fuse_dev *fud)
+{
+	fuse_conn_put(fud->fc);
+	kfree(fud);
+}
+EXPORT_SYMBOL_GPL(fuse_dev_free);
+
+/*
+ * The connection goes away with its last device file.  Requests on the
+ * queue of an earlier one are read through the others.
+ */
 int fuse_dev_release(struct inode *inode, struct file *file)
 {
-	struct fuse_conn *fc = fuse_get_conn(file);
-	if (fc) {
+	struct fuse_dev *fud = fuse_get_dev(file);
+	if (fud) {
+		struct fuse_conn *fc = fud->fc;
+
 		spin_lock(&fc->lock);
-		fc->connected = 0;
-		fc->blocked = 0;
-		end_queued_requests(fc);
-		wake_up_all(&fc->blocked_waitq);
+		if (!--fc->dev_count) {
+			fc->connected = 0;
+			fc->blocked = 0;
+			end_queued_requests(fc);
+			wake_up_all(&fc->blocked_waitq);
+		}
 		spin_unlock(&fc->lock);
-		fuse_conn_put(fc);
+		fuse_dev_free(fud);
 	}
 
 	return 0;
 }
 EXPORT_SYMBOL_GPL(fuse_dev_release);
 
+/*
+ * Attach @file, a fresh open of the device, to the connection of the
+ * device file @oldfd
+ */
+static long fuse_dev_clone(struct file *file, __u32 __user *argp)
+{
+	struct fuse_dev *fud;
+	struct file *old;
+	__u32 oldfd;
+	int err;
+
+	if (get_user(oldfd, argp))
+		return -EFAULT;
+
+	old = fget(oldfd);
+	if (!old)
+		return -EINVAL;
+
+	mutex_lock(&fuse_mutex);
+	err = -EINVAL;
+	if (old->f_op != file->f_op || !fuse_get_dev(old) ||
+	    fuse_get_dev(file))
+		goto out;
+
+	err = -ENOMEM;
+	fud = fuse_dev_alloc(fuse_get_conn(old));
+	if (!fud)
+		goto out;
+	file->private_data = fud;
+	err = 0;
+ out:
+	mutex_unlock(&fuse_mutex);
+	fput(old);
+	return err;
+}
+
+static long fuse_dev_ioctl(struct file *file, unsigned int cmd,
+			   unsigned long arg)
+{
+	struct fuse_dev *fud;
+	__u32 batch;
+
+	switch (cmd) {
+	case FUSE_DEV_IOC_CLONE:
+		return fuse_dev_clone(file, (__u32 __user *)arg);
+
+	case FUSE_DEV_IOC_BATCH:
+		fud = fuse_get_dev(file);
+		if (!fud)
+			return -EPERM;
+		if (get_user(batch, (__u32 __user *)arg))
+			return -EFAULT;
+		fud->batch = max_t(__u32, batch, 1);
+		return 0;
+
+	default:
+		return -ENOTTY;
+	}
+}
+
 static int fuse_dev_fasync(int fd, struct file *file, int on)
 {
 	struct fuse_conn *fc = fuse_get_conn(file);
@@ -1634,6 +1837,8 @@ const struct file_operations fuse_dev_operations = {
 	.poll		= fuse_dev_poll,
 	.release	= fuse_dev_release,
 	.fasync		= fuse_dev_fasync,
+	.unlocked_ioctl	= fuse_dev_ioctl,
+	.compat_ioctl	= fuse_dev_ioctl,
 };
 EXPORT_SYMBOL_GPL(fuse_dev_operations);
 
@@ -429,6 +429,7 @@ static int fuse_create_open(struct inode *dir, struct dentry *entry, int mode,
 	req->out.args[1].value = &outopen;
 	fuse_request_send(fc, req);
 	err = req->out.h.error;
+	ff->passthrough_filp = req->passthrough_filp;
 	if (err) {
 		if (err == -ENOSYS)
 			fc->no_create = 1;
@@ -31,6 +31,9 @@
 /** It could be as large as PATH_MAX, but would that have any uses? */
 #define FUSE_NAME_MAX 1024
 
+/** Magic number of FUSE superblocks */
+#define FUSE_SUPER_MAGIC 0x65735546
+
 /** Number of dentries for each connection in the control filesystem */
 #define FUSE_CTL_NUM_DENTRIES 5
 
@@ -128,6 +131,9 @@ struct fuse_file {
 
 	/** Wait queue head for poll */
 	wait_queue_head_t poll_wait;
+
+	/** Lower file data I/O is passed through to, or NULL */
+	struct file *passthrough_filp;
 };
 
 /** One input argument of a request */
@@ -298,6 +304,41 @@ struct fuse_req {
 
 	/** Request is stolen from fuse_file->reserved_req */
 	struct file *stolen_file;
+
+	/** Lower file of a FOPEN_PASSTHROUGH reply to OPEN or CREATE */
+	struct file *passthrough_filp;
+};
+
+/** Maximum number of pending queues of a connection */
+#define FUSE_MAX_QUEUES 16
+
+/**
+ * A queue of requests waiting to be read by userspace.  Every device
+ * file of a connection reads from one queue first, and from the others
+ * when its own is empty.
+ */
+struct fuse_queue {
+	/** The list of pending requests */
+	struct list_head pending;
+
+	/** Readers of the queue are waiting on this */
+	wait_queue_head_t waitq;
+};
+
+/**
+ * An open device file of a connection.  Further device files can be
+ * attached to the connection with FUSE_DEV_IOC_CLONE, e.g. one for each
+ * thread of a multithreaded filesystem daemon.
+ */
+struct fuse_dev {
+	/** The connection */
+	struct fuse_conn *fc;
+
+	/** The queue read from first */
+	struct fuse_queue *queue;
+
+	/** Most requests returned by one read, set by FUSE_DEV_IOC_BATCH */
+	unsigned batch;
 };
 
 /**
@@ -332,11 +373,20 @@ struct fuse_conn {
 	/** Maximum write size */
 	unsigned max_write;
 
-	/** Readers of the connection are waiting on this */
-	wait_queue_head_t waitq;
+	/** Queues of pending requests, the first nr_queues are in use */
+	struct fuse_queue queues[FUSE_MAX_QUEUES];
 
-	/** The list of pending requests */
-	struct list_head pending;
+	/** Number of queues in use */
+	unsigned nr_queues;
+
+	/** Queue of the next request */
+	unsigned next_queue;
+
+	/** Number of open device files */
+	unsigned dev_count;
+
+	/** Number of device files ever attached, picks their queue */
+	unsigned dev_attached;
 
 	/** The list of requests being processed */
 	struct list_head processing;
@@ -456,6 +506,9 @@ struct fuse_conn {
 	/** Don't apply umask to creation modes */
 	unsigned dont_mask:1;
 
+	/** May data I/O be passed through to a lower file? */
+	unsigned passthrough:1;
+
 	/** The number of requests waiting for completion */
 	atomic_t num_waiting;
 
@@ -670,6 +723,19 @@ void fuse_request_send_background_locked(struct fuse_conn *fc,
 /* Abort all requests */
 void fuse_abort_conn(struct fuse_conn *fc);
 
+/* Wake up all readers of the connection */
+void fuse_wake_up_readers(struct fuse_conn *fc);
+
+/**
+ * Attach a device file to the connection, taking a reference to it
+ */
+struct fuse_dev *fuse_dev_alloc(struct fuse_conn *fc);
+
+/**
+ * Release the device file and its reference to the connection
+ */
+void fuse_dev_free(struct fuse_dev *fud);
+
 /**
  * Invalidate inode attributes
  */
@@ -747,5 +813,17 @@ long fuse_do_ioctl(struct file *file, unsigned int cmd, unsigned long arg,
 		   unsigned int flags);
 unsigned fuse_file_poll(struct file *file, poll_table *wait);
 int fuse_dev_release(struct inode *inode, struct file *file);
+void fuse_write_update_size(struct inode *inode, loff_t pos);
+
+/**
+ * Passthrough of data I/O to a lower file
+ */
+void fuse_passthrough_setup(struct fuse_conn *fc, struct fuse_req *req);
+void fuse_passthrough_release(struct fuse_file *ff);
+ssize_t fuse_passthrough_read(struct kiocb *iocb, const struct iovec *iov,
+			      unsigned long nr_segs, loff_t pos);
+ssize_t fuse_passthrough_write(struct kiocb *iocb, const struct iovec *iov,
+			       unsigned long nr_segs, loff_t pos);
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma);
 
 #endif /* _FS_FUSE_I_H */
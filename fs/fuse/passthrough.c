@@ -0,0 +1,195 @@
+/*
+  FUSE: Filesystem in Userspace
+
+  This program can be distributed under the terms of the GNU GPL.
+  See the file COPYING.
+*/
+
+/*
+ * Passthrough of data I/O to a lower file.
+ *
+ * A filesystem daemon that stores a file's data in a file of another
+ * filesystem may reply to OPEN or CREATE with FOPEN_PASSTHROUGH and the
+ * descriptor of that file opened by itself.  Reads, writes and mmaps of
+ * the FUSE file then go to the lower file directly, without a round trip
+ * through the daemon and without copying the data through /dev/fuse.
+ * Everything else, attributes included, still goes to the daemon.
+ */
+
+#include "fuse_i.h"
+
+#include <linux/file.h>
+#include <linux/fs.h>
+#include <linux/fsnotify.h>
+#include <linux/mm.h>
+#include <linux/pagemap.h>
+#include <linux/security.h>
+#include <linux/uio.h>
+
+/*
+ * Called from fuse_dev_do_write() with the reply to an OPEN or CREATE
+ * request copied in but the request still locked.  That is in the
+ * context of the daemon writing the reply, so passthrough_fd is looked
+ * up in the daemon's file table.  If the lower file can't be used,
+ * FOPEN_PASSTHROUGH is cleared and the file is opened as usual.
+ *
+ * fc->passthrough is only set for a daemon with CAP_SYS_ADMIN, see
+ * process_init_reply(): the lower file is accessed with the daemon's
+ * open file, on behalf of whoever opened the FUSE file.
+ */
+void fuse_passthrough_setup(struct fuse_conn *fc, struct fuse_req *req)
+{
+	struct fuse_open_out *outarg;
+	struct fuse_open_in *inarg;
+	struct file *lower;
+	struct inode *inode;
+	unsigned acc;
+
+	if (req->in.h.opcode == FUSE_OPEN)
+		outarg = req->out.args[0].value;
+	else if (req->in.h.opcode == FUSE_CREATE)
+		outarg = req->out.args[1].value;
+	else
+		return;
+	if (req->out.h.error || !(outarg->open_flags & FOPEN_PASSTHROUGH))
+		return;
+
+	outarg->open_flags &= ~FOPEN_PASSTHROUGH;
+	if (!fc->passthrough)
+		return;
+
+	lower = fget(outarg->passthrough_fd);
+	if (!lower)
+		return;
+
+	/* fuse_create_in starts with the open flags too */
+	inarg = (struct fuse_open_in *) req->in.args[0].value;
+	acc = inarg->flags & O_ACCMODE;
+	inode = lower->f_path.dentry->d_inode;
+	if (!S_ISREG(inode->i_mode) ||
+	    inode->i_sb->s_magic == FUSE_SUPER_MAGIC ||
+	    !lower->f_op || !lower->f_op->aio_read ||
+	    !lower->f_op->aio_write ||
+	    (acc != O_WRONLY && !(lower->f_mode & FMODE_READ)) ||
+	    (acc != O_RDONLY && !(lower->f_mode & FMODE_WRITE))) {
+		fput(lower);
+		return;
+	}
+
+	outarg->open_flags |= FOPEN_PASSTHROUGH;
+	req->passthrough_filp = lower;
+}
+
+void fuse_passthrough_release(struct fuse_file *ff)
+{
+	if (ff->passthrough_filp) {
+		fput(ff->passthrough_filp);
+		ff->passthrough_filp = NULL;
+	}
+}
+
+/*
+ * Do what vfs_readv()/vfs_writev() would do on the lower file: the
+ * mandatory locks and the LSM get to check the access, and watchers of
+ * the lower file are notified.  The FUSE file itself was checked and is
+ * notified by the VFS call that got us here.
+ */
+static ssize_t fuse_passthrough_rw(struct file *lower,
+				   const struct iovec *iov,
+				   unsigned long nr_segs, loff_t *ppos,
+				   int write)
+{
+	struct kiocb kiocb;
+	size_t count = iov_length(iov, nr_segs);
+	ssize_t ret;
+
+	ret = rw_verify_area(write ? WRITE : READ, lower, ppos, count);
+	if (ret < 0)
+		return ret;
+
+	init_sync_kiocb(&kiocb, lower);
+	kiocb.ki_pos = *ppos;
+	kiocb.ki_left = count;
+	kiocb.ki_nbytes = count;
+
+	if (write)
+		ret = lower->f_op->aio_write(&kiocb, iov, nr_segs, *ppos);
+	else
+		ret = lower->f_op->aio_read(&kiocb, iov, nr_segs, *ppos);
+	if (ret == -EIOCBQUEUED)
+		ret = wait_on_sync_kiocb(&kiocb);
+	*ppos = kiocb.ki_pos;
+
+	if (ret > 0) {
+		if (write)
+			fsnotify_modify(lower->f_path.dentry);
+		else
+			fsnotify_access(lower->f_path.dentry);
+	}
+	return ret;
+}
+
+ssize_t fuse_passthrough_read(struct kiocb *iocb, const struct iovec *iov,
+			      unsigned long nr_segs, loff_t pos)
+{
+	struct fuse_file *ff = iocb->ki_filp->private_data;
+	ssize_t ret;
+
+	ret = fuse_passthrough_rw(ff->passthrough_filp, iov, nr_segs, &pos, 0);
+	iocb->ki_pos = pos;
+	return ret;
+}
+
+ssize_t fuse_passthrough_write(struct kiocb *iocb, const struct iovec *iov,
+			       unsigned long nr_segs, loff_t pos)
+{
+	struct file *file = iocb->ki_filp;
+	struct inode *inode = file->f_mapping->host;
+	struct fuse_file *ff = file->private_data;
+	struct file *lower = ff->passthrough_filp;
+	loff_t start;
+	ssize_t ret;
+
+	mutex_lock(&inode->i_mutex);
+	if (file->f_flags & O_APPEND)
+		pos = i_size_read(lower->f_mapping->host);
+	start = pos;
+	ret = fuse_passthrough_rw(lower, iov, nr_segs, &pos, 1);
+	if (ret > 0) {
+		fuse_write_update_size(inode, pos);
+		/* drop what another, non-passthrough open has cached */
+		if (inode->i_mapping->nrpages)
+			invalidate_inode_pages2_range(inode->i_mapping,
+					start >> PAGE_CACHE_SHIFT,
+					(pos - 1) >> PAGE_CACHE_SHIFT);
+	}
+	fuse_invalidate_attr(inode);
+	mutex_unlock(&inode->i_mutex);
+
+	iocb->ki_pos = pos;
+	return ret;
+}
+
+/*
+ * Map the lower file in place of the FUSE file, so that faults are
+ * served from the lower file's page cache.  Once the lower ->mmap()
+ * succeeded the vma holds a reference to the lower file instead.
+ */
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct fuse_file *ff = file->private_data;
+	struct file *lower = ff->passthrough_filp;
+	int err;
+
+	if (!lower->f_op->mmap)
+		return -ENODEV;
+
+	err = lower->f_op->mmap(lower, vma);
+	if (err)
+		return err;
+
+	get_file(lower);
+	vma->vm_file = lower;
+	fput(file);
+	return 0;
+}
@@ -169,6 +169,9 @@ int inode_init_always(struct super_block *sb, struct inode *inode)
 	mapping->flags = 0;
 	mapping_set_gfp_mask(mapping, GFP_HIGHUSER_MOVABLE);
 	mapping->assoc_mapping = NULL;
+#ifdef CONFIG_READAHEAD_PROFILE
+	mapping->ra_profile = NULL;
+#endif
 	mapping->backing_dev_info = &default_backing_dev_info;
 	mapping->writeback_index = 0;
 
@@ -227,6 +230,7 @@ void __destroy_inode(struct inode *inode)
 	BUG_ON(inode_has_buffers(inode));
 	security_inode_free(inode);
 	fsnotify_inode_delete(inode);
+	ra_profile_free(&inode->i_data);
 #ifdef CONFIG_FS_POSIX_ACL
 	if (inode->i_acl && inode->i_acl != ACL_NOT_CACHED)
 		posix_acl_release(inode->i_acl);
@@ -530,6 +534,7 @@ static int shrink_icache_memory(struct shrinker *shrink, int nr, gfp_t gfp_mask)
 static struct shrinker icache_shrinker = {
 	.shrink = shrink_icache_memory,
 	.seeks = DEFAULT_SEEKS,
+	.name = "icache",
 };
 
 static void __wait_on_freeing_inode(struct inode *inode);
@@ -1565,7 +1570,7 @@ void __init inode_init(void)
 					 sizeof(struct inode),
 					 0,
 					 (SLAB_RECLAIM_ACCOUNT|SLAB_PANIC|
-					 SLAB_MEM_SPREAD),
+					 SLAB_MEM_SPREAD|SLAB_DESTROY_BY_RCU),
 					 init_once);
 	register_shrinker(&icache_shrinker);
 
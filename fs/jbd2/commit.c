@@ -720,16 +720,18 @@ start_journal_io:
 		blkdev_issue_flush(journal->j_fs_dev, GFP_KERNEL, NULL,
 			BLKDEV_IFL_WAIT);
 
-	/* Done it all: now write the commit record asynchronously. */
+	/*
+	 * Done it all: now write the commit record asynchronously.  Its
+	 * checksum covers the blocks written above, so it doesn't have to
+	 * wait for them: if it reaches the disk without all of them,
+	 * recovery sees the checksum mismatch and drops the transaction.
+	 */
 	if (JBD2_HAS_INCOMPAT_FEATURE(journal,
 				      JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT)) {
 		err = journal_submit_commit_record(journal, commit_transaction,
 						 &cbh, crc32_sum);
 		if (err)
 			__jbd2_journal_abort_hard(journal);
-		if (journal->j_flags & JBD2_BARRIER)
-			blkdev_issue_flush(journal->j_dev, GFP_KERNEL, NULL,
-				BLKDEV_IFL_WAIT);
 	}
 
 	err = journal_finish_inode_data_buffers(journal, commit_transaction);
@@ -854,6 +856,19 @@ wait_for_iobuf:
 	if (!err && !is_journal_aborted(journal))
 		err = journal_wait_on_commit_record(journal, cbh);
 
+	/*
+	 * With an async commit the whole transaction, commit record
+	 * included, is written without ordering, so a single cache flush
+	 * once all of it has completed makes it durable.  Flushing before
+	 * that wouldn't cover the writes still in flight.
+	 */
+	if (!err && !is_journal_aborted(journal) &&
+	    JBD2_HAS_INCOMPAT_FEATURE(journal,
+				      JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT) &&
+	    (journal->j_flags & JBD2_BARRIER))
+		blkdev_issue_flush(journal->j_dev, GFP_KERNEL, NULL,
+				   BLKDEV_IFL_WAIT);
+
 	if (err)
 		jbd2_journal_abort(journal, err);
 
@@ -40,6 +40,7 @@
 #include <linux/math64.h>
 #include <linux/hash.h>
 #include <linux/log2.h>
+#include <linux/hrtimer.h>
 #include <linux/vmalloc.h>
 
 #define CREATE_TRACE_POINTS
@@ -82,6 +83,7 @@ EXPORT_SYMBOL(jbd2_journal_clear_err);
 EXPORT_SYMBOL(jbd2_log_wait_commit);
 EXPORT_SYMBOL(jbd2_log_start_commit);
 EXPORT_SYMBOL(jbd2_journal_start_commit);
+EXPORT_SYMBOL(jbd2_log_batch_commit);
 EXPORT_SYMBOL(jbd2_journal_force_commit_nested);
 EXPORT_SYMBOL(jbd2_journal_wipe);
 EXPORT_SYMBOL(jbd2_journal_blocks_per_page);
@@ -558,6 +560,68 @@ int jbd2_journal_start_commit(journal_t *journal, tid_t *ptid)
 	return ret;
 }
 
+/*
+ * Make sure transaction @tid gets committed, for fsync().  Returns 1 if
+ * the caller has to wait for the commit with jbd2_log_wait_commit(), 0
+ * if @tid has committed already.
+ *
+ * When @tid is still running and the journal is idle, the first fsync
+ * sleeps for about as long as a commit takes, bounded by
+ * j_min_batch_time and j_max_batch_time, before it starts the commit.
+ * Fsyncs on other files in the same transaction arriving meanwhile just
+ * wait for that commit instead of forcing one each.  While another
+ * commit is running nobody sleeps: the commit can't start before that
+ * one is done anyway, and everyone arriving until then joins it.  A
+ * task that started the previous batch too doesn't sleep either, it is
+ * most likely a single stream of fsyncs with nobody to batch with.
+ */
+int jbd2_log_batch_commit(journal_t *journal, tid_t tid)
+{
+	transaction_t *transaction;
+	u64 commit_time;
+	ktime_t expires;
+
+	spin_lock(&journal->j_state_lock);
+	if (!tid_gt(tid, journal->j_commit_sequence)) {
+		spin_unlock(&journal->j_state_lock);
+		return 0;
+	}
+
+	transaction = journal->j_running_transaction;
+	if (!transaction || transaction->t_tid != tid ||
+	    tid_geq(journal->j_commit_request, tid)) {
+		/* committing, or about to be */
+		spin_unlock(&journal->j_state_lock);
+		return 1;
+	}
+	if (transaction->t_fsync_batch) {
+		journal->j_fsync_joined++;
+		spin_unlock(&journal->j_state_lock);
+		return 1;
+	}
+	if (journal->j_committing_transaction || !journal->j_max_batch_time ||
+	    journal->j_last_sync_writer == current->pid) {
+		__jbd2_log_start_commit(journal, tid);
+		spin_unlock(&journal->j_state_lock);
+		return 1;
+	}
+
+	transaction->t_fsync_batch = 1;
+	journal->j_fsync_batches++;
+	journal->j_last_sync_writer = current->pid;
+	commit_time = max_t(u64, journal->j_average_commit_time,
+			    1000 * journal->j_min_batch_time);
+	commit_time = min_t(u64, commit_time, 1000 * journal->j_max_batch_time);
+	spin_unlock(&journal->j_state_lock);
+
+	expires = ktime_add_ns(ktime_get(), commit_time);
+	set_current_state(TASK_UNINTERRUPTIBLE);
+	schedule_hrtimeout(&expires, HRTIMER_MODE_ABS);
+
+	jbd2_log_start_commit(journal, tid);
+	return 1;
+}
+
 /*
  * Wait for a specified commit to complete.
  * The caller may not hold the journal lock.
@@ -702,6 +766,8 @@ static int jbd2_seq_info_show(struct seq_file *seq, void *v)
 	seq_printf(seq, "%lu transaction, each up to %u blocks\n",
 			s->stats->ts_tid,
 			s->journal->j_max_transaction_buffers);
+	seq_printf(seq, "%lu fsync batches, %lu fsyncs joined a batch\n",
+		   s->journal->j_fsync_batches, s->journal->j_fsync_joined);
 	if (s->stats->ts_tid == 0)
 		return 0;
 	seq_printf(seq, "average: \n  %ums waiting for transaction\n",
@@ -482,6 +482,22 @@ ok:
 	return security_inode_permission(inode, MAY_EXEC);
 }
 
+/*
+ * exec_permission() for the lock-free path walk.  Anything but a grant by the
+ * mode bits - a ->permission() method, ACLs, capabilities, a security module
+ * which checks inodes - returns -ECHILD, and the ordinary walk redoes it.
+ */
+static int exec_permission_rcu(struct inode *inode)
+{
+	if (inode->i_op->permission)
+		return -ECHILD;
+	if (IS_POSIXACL(inode) && inode->i_op->check_acl)
+		return -ECHILD;
+	if (acl_permission_check(inode, MAY_EXEC, NULL))
+		return -ECHILD;
+	return security_inode_permission_rcu(inode, MAY_EXEC);
+}
+
 static __always_inline void set_root(struct nameidata *nd)
 {
 	if (!nd->root.mnt) {
@@ -793,6 +809,136 @@ fail:
 	return PTR_ERR(dentry);
 }
 
+/* hash the path component at @name into @this, returns where it ends */
+static inline const char *hash_component(const char *name, struct qstr *this)
+{
+	unsigned long hash;
+	unsigned int c;
+
+	this->name = name;
+	c = *(const unsigned char *)name;
+
+	hash = init_name_hash();
+	do {
+		name++;
+		hash = partial_name_hash(c, hash);
+		c = *(const unsigned char *)name;
+	} while (c && (c != '/'));
+	this->len = name - (const char *) this->name;
+	this->hash = end_name_hash(hash);
+	return name;
+}
+
+/*
+ * Lock-free path walk.
+ *
+ * Before taking dcache_lock, d_lock and a reference for every component, walk
+ * as far as we can under rcu_read_lock() alone.  The d_seq of a dentry tells
+ * whether it was renamed, unhashed or made negative while we looked at it,
+ * and the inodes of FS_INODE_RCU filesystems stay inodes until a grace period
+ * has passed.  Only cached positive dentries are walked this way: "..",
+ * mount points, dentries to revalidate, parents with their own d_hash or
+ * d_compare, symlinks to follow and permission checks needing more than the
+ * mode bits all end it, as does the last component of LOOKUP_PARENT and
+ * intent lookups.
+ *
+ * On return nd->path holds the last dentry reached and *name points to the
+ * first component left to the ordinary walk.  Returns 0 if the whole name was
+ * resolved and -ECHILD otherwise.
+ */
+static int rcu_path_walk(const char **name, struct nameidata *nd)
+{
+	struct dentry *start = nd->path.dentry;
+	struct dentry *parent = start, *dentry;
+	const char *p = *name, *next;
+	unsigned int lookup_flags = nd->flags;
+	struct inode *inode;
+	unsigned seq, dseq;
+	int err = -ECHILD;
+
+	if (!(start->d_sb->s_type->fs_flags & FS_INODE_RCU))
+		return -ECHILD;
+
+	rcu_read_lock();
+	seq = read_seqcount_begin(&parent->d_seq);
+	inode = parent->d_inode;
+	for (;;) {
+		struct qstr this;
+		int last;
+
+		if (!inode || exec_permission_rcu(inode))
+			break;
+
+		next = hash_component(p, &this);
+		last = !*next;
+		if (!last) {
+			while (*++next == '/');
+			/* trailing slashes need LOOKUP_DIRECTORY */
+			if (!*next)
+				break;
+		} else if (lookup_flags & (LOOKUP_PARENT | LOOKUP_OPEN |
+					   LOOKUP_CREATE))
+			break;
+
+		if (this.name[0] == '.') {
+			if (this.len == 1 && !last) {
+				p = next;
+				continue;
+			}
+			if (this.len == 1 ||
+			    (this.len == 2 && this.name[1] == '.'))
+				break;
+		}
+
+		if (parent->d_op &&
+		    (parent->d_op->d_hash || parent->d_op->d_compare))
+			break;
+		dentry = __d_lookup_rcu(parent, &this, &dseq);
+		if (!dentry)
+			break;
+		/* the parent must not have changed while we searched it */
+		if (read_seqcount_retry(&parent->d_seq, seq))
+			break;
+		if (dentry->d_op && dentry->d_op->d_revalidate)
+			break;
+		if (d_mountpoint(dentry))
+			break;
+
+		inode = dentry->d_inode;
+		if (!inode)
+			break;
+		if (inode->i_op->follow_link) {
+			if (!last || (lookup_flags & LOOKUP_FOLLOW))
+				break;
+		} else if (!inode->i_op->lookup) {
+			if (!last || (lookup_flags & LOOKUP_DIRECTORY))
+				break;
+		}
+
+		parent = dentry;
+		seq = dseq;
+		p = next;
+		if (last) {
+			err = 0;
+			break;
+		}
+	}
+
+	/* keep what was walked only if the dentry reached is still valid */
+	if (parent != start && !__dget_seq(parent, seq)) {
+		parent = start;
+		err = -ECHILD;
+	}
+	rcu_read_unlock();
+
+	if (parent != start) {
+		dput(start);
+		nd->path.dentry = parent;
+		*name = p;
+	}
+	return err;
+}
+
 /*
  * This is a temporary kludge to deal with "automount" symlinks; proper
  * solution is to trigger them on follow_mount(), so that do_lookup()
@@ -824,13 +970,16 @@ static int link_path_walk(const char *name, struct nameidata *nd)
 	if (!*name)
 		goto return_reval;
 
+	if (!nd->depth && !(nd->flags & LOOKUP_REVAL) &&
+	    !rcu_path_walk(&name, nd))
+		return 0;
+
 	inode = nd->path.dentry->d_inode;
 	if (nd->depth)
 		lookup_flags = LOOKUP_FOLLOW | (nd->flags & LOOKUP_CONTINUE);
 
 	/* At this point we know we have a real path component. */
 	for(;;) {
-		unsigned long hash;
 		struct qstr this;
 		unsigned int c;
 
@@ -839,18 +988,9 @@ static int link_path_walk(const char *name, struct nameidata *nd)
  		if (err)
 			break;
 
-		this.name = name;
+		name = hash_component(name, &this);
 		c = *(const unsigned char *)name;
 
-		hash = init_name_hash();
-		do {
-			name++;
-			hash = partial_name_hash(c, hash);
-			c = *(const unsigned char *)name;
-		} while (c && (c != '/'));
-		this.len = name - (const char *) this.name;
-		this.hash = end_name_hash(hash);
-
 		/* remove trailing slashes? */
 		if (!c)
 			goto last_component;
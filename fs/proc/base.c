@@ -2585,6 +2585,88 @@ static int proc_tgid_io_accounting(struct task_struct *task, char *buffer)
 }
 #endif /* CONFIG_TASK_IO_ACCOUNTING */
 
+#ifdef CONFIG_RECLAIM_STALL_STATS
+static const char * const stall_type_name[NR_STALL_TYPES] = {
+	"reclaim", "compact"
+};
+
+static const char * const stall_bucket_name[NR_STALL_BUCKETS] = {
+	"lt_1ms", "lt_4ms", "lt_16ms", "lt_64ms", "lt_256ms", "slow"
+};
+
+static void reclaim_stall_add(struct reclaim_stall_stats *dst,
+			      struct reclaim_stall_stats *src)
+{
+	int type, i;
+
+	for (type = 0; type < NR_STALL_TYPES; type++) {
+		for (i = 0; i < NR_STALL_BUCKETS; i++)
+			dst->count[type][i] += src->count[type][i];
+		dst->delay_ns[type] += src->delay_ns[type];
+	}
+	dst->scanned += src->scanned;
+	dst->reclaimed += src->reclaimed;
+	dst->writeback_ns += src->writeback_ns;
+	if (src->max_ns > dst->max_ns) {
+		dst->max_ns = src->max_ns;
+		dst->max_shrinker_ns = src->max_shrinker_ns;
+		memcpy(dst->max_shrinker, src->max_shrinker,
+		       sizeof(dst->max_shrinker));
+	}
+}
+
+static int do_reclaim_stall(struct task_struct *task, char *buffer, int whole)
+{
+	struct reclaim_stall_stats acct = task->reclaim_stall_stats;
+	unsigned long flags;
+	int type, i, len = 0;
+
+	/* exited threads are not accounted */
+	if (whole && lock_task_sighand(task, &flags)) {
+		struct task_struct *t = task;
+
+		while_each_thread(task, t)
+			reclaim_stall_add(&acct, &t->reclaim_stall_stats);
+
+		unlock_task_sighand(task, &flags);
+	}
+	acct.max_shrinker[sizeof(acct.max_shrinker) - 1] = '\0';
+
+	for (type = 0; type < NR_STALL_TYPES; type++) {
+		for (i = 0; i < NR_STALL_BUCKETS; i++)
+			len += sprintf(buffer + len, "%s_stall_%s: %lu\n",
+				       stall_type_name[type],
+				       stall_bucket_name[i],
+				       acct.count[type][i]);
+		len += sprintf(buffer + len, "%s_stall_us: %llu\n",
+			       stall_type_name[type],
+			       div_u64(acct.delay_ns[type], NSEC_PER_USEC));
+	}
+	len += sprintf(buffer + len,
+			"reclaim_stall_scanned: %lu\n"
+			"reclaim_stall_reclaimed: %lu\n"
+			"reclaim_stall_writeback_us: %llu\n"
+			"reclaim_stall_max_us: %llu\n"
+			"reclaim_stall_max_shrinker: %s %llu\n",
+			acct.scanned, acct.reclaimed,
+			div_u64(acct.writeback_ns, NSEC_PER_USEC),
+			div_u64(acct.max_ns, NSEC_PER_USEC),
+			acct.max_shrinker[0] ? acct.max_shrinker : "none",
+			div_u64(acct.max_shrinker_ns, NSEC_PER_USEC));
+	return len;
+}
+
+static int proc_tid_reclaim_stall(struct task_struct *task, char *buffer)
+{
+	return do_reclaim_stall(task, buffer, 0);
+}
+
+static int proc_tgid_reclaim_stall(struct task_struct *task, char *buffer)
+{
+	return do_reclaim_stall(task, buffer, 1);
+}
+#endif /* CONFIG_RECLAIM_STALL_STATS */
+
 static int proc_pid_personality(struct seq_file *m, struct pid_namespace *ns,
 				struct pid *pid, struct task_struct *task)
 {
@@ -2636,6 +2718,9 @@ static const struct pid_entry tgid_base_stuff[] = {
 	REG("smaps",      S_IRUGO, proc_smaps_operations),
 	REG("pagemap",    S_IRUSR, proc_pagemap_operations),
 #endif
+#ifdef CONFIG_PROCESS_RECLAIM
+	REG("reclaim",    S_IRUSR|S_IWUSR, proc_reclaim_operations),
+#endif
 #ifdef CONFIG_SECURITY
 	DIR("attr",       S_IRUGO|S_IXUGO, proc_attr_dir_inode_operations, proc_attr_dir_operations),
 #endif
@@ -2672,6 +2757,9 @@ static const struct pid_entry tgid_base_stuff[] = {
 #ifdef CONFIG_TASK_IO_ACCOUNTING
 	INF("io",	S_IRUGO, proc_tgid_io_accounting),
 #endif
+#ifdef CONFIG_RECLAIM_STALL_STATS
+	INF("reclaim_stall", S_IRUGO, proc_tgid_reclaim_stall),
+#endif
 };
 
 static int proc_tgid_base_readdir(struct file * filp,
@@ -3003,6 +3091,9 @@ static const struct pid_entry tid_base_stuff[] = {
 #ifdef CONFIG_TASK_IO_ACCOUNTING
 	INF("io",	S_IRUGO, proc_tid_io_accounting),
 #endif
+#ifdef CONFIG_RECLAIM_STALL_STATS
+	INF("reclaim_stall", S_IRUGO, proc_tid_reclaim_stall),
+#endif
 };
 
 static int proc_tid_base_readdir(struct file * filp,
@@ -9,6 +9,7 @@
 #include <linux/mempolicy.h>
 #include <linux/swap.h>
 #include <linux/swapops.h>
+#include <linux/mm_inline.h>
 
 #include <asm/elf.h>
 #include <asm/uaccess.h>
@@ -540,6 +541,150 @@ const struct file_operations proc_clear_refs_operations = {
 	.write		= clear_refs_write,
 };
 
+#ifdef CONFIG_PROCESS_RECLAIM
+enum reclaim_type {
+	RECLAIM_FILE,
+	RECLAIM_ANON,
+	RECLAIM_ALL,
+};
+
+struct reclaim_walk {
+	struct vm_area_struct *vma;
+	enum reclaim_type type;
+	unsigned long nr_reclaimed;
+};
+
+static int reclaim_pte_range(pmd_t *pmd, unsigned long addr,
+			     unsigned long end, struct mm_walk *walk)
+{
+	struct reclaim_walk *rw = walk->private;
+	struct vm_area_struct *vma = rw->vma;
+	pte_t *pte, ptent;
+	spinlock_t *ptl;
+	struct page *page;
+	LIST_HEAD(page_list);
+	int isolated = 0;
+
+	pte = pte_offset_map_lock(vma->vm_mm, pmd, addr, &ptl);
+	for (; addr != end; pte++, addr += PAGE_SIZE) {
+		ptent = *pte;
+		if (!pte_present(ptent))
+			continue;
+
+		page = vm_normal_page(vma, addr, ptent);
+		if (!page)
+			continue;
+
+		if (rw->type == RECLAIM_ANON && !PageAnon(page))
+			continue;
+		if (rw->type == RECLAIM_FILE && PageAnon(page))
+			continue;
+		/* leave pages that other processes are using alone */
+		if (page_mapcount(page) != 1)
+			continue;
+
+		if (isolate_lru_page(page))
+			continue;
+		list_add(&page->lru, &page_list);
+		inc_zone_page_state(page, NR_ISOLATED_ANON +
+				    page_is_file_cache(page));
+		isolated++;
+	}
+	pte_unmap_unlock(pte - 1, ptl);
+
+	if (isolated)
+		rw->nr_reclaimed += reclaim_pages_from_list(&page_list);
+	cond_resched();
+	return 0;
+}
+
+/*
+ * Writing "file", "anon" or "all" to /proc/<pid>/reclaim pushes the
+ * task's private pages of that kind out of memory right away, anon pages
+ * to swap.  Pages shared with other processes, mlocked and hugetlb pages
+ * are skipped.  Reading the file back through the same descriptor gives
+ * the number of pages the last write reclaimed.
+ */
+static ssize_t reclaim_write(struct file *file, const char __user *buf,
+			     size_t count, loff_t *ppos)
+{
+	struct task_struct *task;
+	char buffer[16];
+	struct mm_struct *mm;
+	struct vm_area_struct *vma;
+	struct reclaim_walk rw = { };
+	char *type;
+
+	memset(buffer, 0, sizeof(buffer));
+	if (count > sizeof(buffer) - 1)
+		count = sizeof(buffer) - 1;
+	if (copy_from_user(buffer, buf, count))
+		return -EFAULT;
+
+	type = strstrip(buffer);
+	if (!strcmp(type, "file"))
+		rw.type = RECLAIM_FILE;
+	else if (!strcmp(type, "anon"))
+		rw.type = RECLAIM_ANON;
+	else if (!strcmp(type, "all"))
+		rw.type = RECLAIM_ALL;
+	else
+		return -EINVAL;
+
+	task = get_proc_task(file->f_path.dentry->d_inode);
+	if (!task)
+		return -ESRCH;
+	mm = get_task_mm(task);
+	if (mm) {
+		struct mm_walk reclaim_walk = {
+			.pmd_entry = reclaim_pte_range,
+			.mm = mm,
+			.private = &rw,
+		};
+		down_read(&mm->mmap_sem);
+		for (vma = mm->mmap; vma; vma = vma->vm_next) {
+			if (is_vm_hugetlb_page(vma))
+				continue;
+			if (vma->vm_flags & (VM_LOCKED | VM_PFNMAP))
+				continue;
+			if (rw.type == RECLAIM_ANON && !vma->anon_vma)
+				continue;
+			if (rw.type == RECLAIM_FILE && !vma->vm_file)
+				continue;
+			rw.vma = vma;
+			walk_page_range(vma->vm_start, vma->vm_end,
+					&reclaim_walk);
+			if (fatal_signal_pending(current))
+				break;
+		}
+		flush_tlb_mm(mm);
+		up_read(&mm->mmap_sem);
+		mmput(mm);
+	}
+	put_task_struct(task);
+
+	file->private_data = (void *)rw.nr_reclaimed;
+	return count;
+}
+
+static ssize_t reclaim_read(struct file *file, char __user *buf,
+			    size_t count, loff_t *ppos)
+{
+	char buffer[32];
+	size_t len;
+
+	len = snprintf(buffer, sizeof(buffer), "%lu\n",
+		       (unsigned long)file->private_data);
+	return simple_read_from_buffer(buf, count, ppos, buffer, len);
+}
+
+const struct file_operations proc_reclaim_operations = {
+	.write		= reclaim_write,
+	.read		= reclaim_read,
+	.llseek		= generic_file_llseek,
+};
+#endif /* CONFIG_PROCESS_RECLAIM */
+
 struct pagemapread {
 	int pos, len;
 	u64 *buffer;
@@ -277,11 +277,13 @@ static struct file_system_type ramfs_fs_type = {
 	.name		= "ramfs",
 	.get_sb		= ramfs_get_sb,
 	.kill_sb	= ramfs_kill_sb,
+	.fs_flags	= FS_INODE_RCU,
 };
 static struct file_system_type rootfs_fs_type = {
 	.name		= "rootfs",
 	.get_sb		= rootfs_get_sb,
 	.kill_sb	= kill_litter_super,
+	.fs_flags	= FS_INODE_RCU,
 };
 
 static int __init init_ramfs_fs(void)
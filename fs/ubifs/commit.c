@@ -41,6 +41,13 @@
  * latency blips. Note that in any case, the commit does not prevent lookups
  * (as permitted by the TNC mutex), or access to VFS data structures e.g. page
  * cache.
+ *
+ * To keep commit start short, the journal write-buffers are synchronized once
+ * before the commit semaphore is taken, so that only what was written in the
+ * meantime has to be synchronized with the journal locked. And journal writers
+ * that found the journal full do not wait for the whole commit end: they may
+ * go on as soon as the master node is written and the log has given back the
+ * committed buds, while the LEBs freed by GC and the LPT are still returned.
  */
 
 #include <linux/freezer.h>
@@ -48,6 +55,25 @@
 #include <linux/slab.h>
 #include "ubifs.h"
 
+/**
+ * sync_jheads - synchronize all journal head write-buffers.
+ * @c: UBIFS file-system description object
+ *
+ * Returns zero in case of success and a negative error code in case of
+ * failure.
+ */
+static int sync_jheads(struct ubifs_info *c)
+{
+	int i, err;
+
+	for (i = 0; i < c->jhead_cnt; i++) {
+		err = ubifs_wbuf_sync(&c->jheads[i].wbuf);
+		if (err)
+			return err;
+	}
+	return 0;
+}
+
 /**
  * do_commit - commit the journal.
  * @c: UBIFS file-system description object
@@ -58,7 +84,7 @@
  */
 static int do_commit(struct ubifs_info *c)
 {
-	int err, new_ltail_lnum, old_ltail_lnum, i;
+	int err, new_ltail_lnum, old_ltail_lnum;
 	struct ubifs_zbranch zroot;
 	struct ubifs_lp_stats lst;
 
@@ -68,12 +94,14 @@ static int do_commit(struct ubifs_info *c)
 		goto out_up;
 	}
 
+	spin_lock(&c->cs_lock);
+	c->cmt_log_done = 0;
+	spin_unlock(&c->cs_lock);
+
 	/* Sync all write buffers (necessary for recovery) */
-	for (i = 0; i < c->jhead_cnt; i++) {
-		err = ubifs_wbuf_sync(&c->jheads[i].wbuf);
-		if (err)
-			goto out_up;
-	}
+	err = sync_jheads(c);
+	if (err)
+		goto out_up;
 
 	c->cmt_no += 1;
 	err = ubifs_gc_start_commit(c);
@@ -153,6 +181,12 @@ static int do_commit(struct ubifs_info *c)
 	err = ubifs_log_post_commit(c, old_ltail_lnum);
 	if (err)
 		goto out;
+
+	/* The log is done, let writers waiting for journal space go on */
+	spin_lock(&c->cs_lock);
+	c->cmt_log_done = 1;
+	wake_up(&c->cmt_wq);
+	spin_unlock(&c->cs_lock);
 	err = ubifs_gc_end_commit(c);
 	if (err)
 		goto out;
@@ -199,6 +233,9 @@ static int run_bg_commit(struct ubifs_info *c)
 		goto out;
 	spin_unlock(&c->cs_lock);
 
+	/* Errors are reported by the synchronization in 'do_commit()' */
+	sync_jheads(c);
+
 	down_write(&c->commit_sem);
 	spin_lock(&c->cs_lock);
 	if (c->cmt_state == COMMIT_REQUIRED)
@@ -379,6 +416,9 @@ int ubifs_run_commit(struct ubifs_info *c)
 
 	/* Ok, the commit is indeed needed */
 
+	/* Errors are reported by the synchronization in 'do_commit()' */
+	sync_jheads(c);
+
 	down_write(&c->commit_sem);
 	spin_lock(&c->cs_lock);
 	/*
@@ -411,6 +451,43 @@ out:
 	return err;
 }
 
+/**
+ * ubifs_run_commit_for_log - run commit or wait for it to free journal space.
+ * @c: UBIFS file-system description object
+ *
+ * This function is used by journal writers which found the journal full. If a
+ * commit is running and has not yet given back the space of the committed
+ * buds, it waits only for that rather than for the whole commit to end.
+ * Otherwise it is the same as 'ubifs_run_commit()'. Returns zero in case of
+ * success and a negative error code in case of failure.
+ */
+int ubifs_run_commit_for_log(struct ubifs_info *c)
+{
+	int err;
+
+	spin_lock(&c->cs_lock);
+	if ((c->cmt_state == COMMIT_RUNNING_BACKGROUND ||
+	     c->cmt_state == COMMIT_RUNNING_REQUIRED) && !c->cmt_log_done) {
+		c->cmt_state = COMMIT_RUNNING_REQUIRED;
+		spin_unlock(&c->cs_lock);
+		dbg_cmt("pid %d waits for journal space", current->pid);
+		wait_event(c->cmt_wq, c->cmt_log_done ||
+				      (c->cmt_state != COMMIT_RUNNING_BACKGROUND &&
+				       c->cmt_state != COMMIT_RUNNING_REQUIRED));
+		/*
+		 * The commit may have failed instead, in which case no space
+		 * was freed and the file-system went read-only.
+		 */
+		spin_lock(&c->cs_lock);
+		err = c->cmt_state == COMMIT_BROKEN ? -EROFS : 0;
+		spin_unlock(&c->cs_lock);
+		return err;
+	}
+	spin_unlock(&c->cs_lock);
+
+	return ubifs_run_commit(c);
+}
+
 /**
  * ubifs_gc_should_commit - determine if it is time for GC to run commit.
  * @c: UBIFS file-system description object
@@ -24,10 +24,15 @@
 
 /*
  * This file provides a single place to access to compression and
- * decompression.
+ * decompression. It also keeps statistics of how much data every compressor
+ * was given and how long it took, which are exported in
+ * /proc/fs/ubifs/compressors.
  */
 
 #include <linux/crypto.h>
+#include <linux/ktime.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
 #include "ubifs.h"
 
 /* Fake description object for the "none" compressor */
@@ -74,6 +79,25 @@ static struct ubifs_compressor zlib_compr = {
 /* All UBIFS compressors */
 struct ubifs_compressor *ubifs_compressors[UBIFS_COMPR_TYPES_CNT];
 
+/**
+ * account_comp - account data given to a compressor.
+ * @compr: compressor description object
+ * @in_len: length of the data
+ * @out_len: length the data is stored in
+ * @ns: time spent compressing it
+ */
+static void account_comp(struct ubifs_compressor *compr, int in_len,
+			 int out_len, s64 ns)
+{
+	spin_lock(&compr->stats_lock);
+	compr->comp_bytes += in_len;
+	compr->comp_out_bytes += out_len;
+	compr->comp_ns += ns;
+	if (compr->compr_type != UBIFS_COMPR_NONE && out_len == in_len)
+		compr->comp_rejected += 1;
+	spin_unlock(&compr->stats_lock);
+}
+
 /**
  * ubifs_compress - compress data.
  * @in_buf: data to compress
@@ -97,6 +121,8 @@ void ubifs_compress(const void *in_buf, int in_len, void *out_buf, int *out_len,
 {
 	int err;
 	struct ubifs_compressor *compr = ubifs_compressors[*compr_type];
+	ktime_t start;
+	s64 ns;
 
 	if (*compr_type == UBIFS_COMPR_NONE)
 		goto no_compr;
@@ -105,32 +131,39 @@ void ubifs_compress(const void *in_buf, int in_len, void *out_buf, int *out_len,
 	if (in_len < UBIFS_MIN_COMPR_LEN)
 		goto no_compr;
 
+	start = ktime_get();
 	if (compr->comp_mutex)
 		mutex_lock(compr->comp_mutex);
 	err = crypto_comp_compress(compr->cc, in_buf, in_len, out_buf,
 				   (unsigned int *)out_len);
 	if (compr->comp_mutex)
 		mutex_unlock(compr->comp_mutex);
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
 	if (unlikely(err)) {
 		ubifs_warn("cannot compress %d bytes, compressor %s, "
 			   "error %d, leave data uncompressed",
 			   in_len, compr->name, err);
-		 goto no_compr;
+		account_comp(compr, in_len, in_len, ns);
+		goto no_compr;
 	}
 
 	/*
 	 * If the data compressed only slightly, it is better to leave it
 	 * uncompressed to improve read speed.
 	 */
-	if (in_len - *out_len < UBIFS_MIN_COMPRESS_DIFF)
+	if (in_len - *out_len < UBIFS_MIN_COMPRESS_DIFF) {
+		account_comp(compr, in_len, in_len, ns);
 		goto no_compr;
+	}
 
+	account_comp(compr, in_len, *out_len, ns);
 	return;
 
 no_compr:
 	memcpy(out_buf, in_buf, in_len);
 	*out_len = in_len;
 	*compr_type = UBIFS_COMPR_NONE;
+	account_comp(&none_compr, in_len, in_len, 0);
 }
 
 /**
@@ -150,6 +183,8 @@ int ubifs_decompress(const void *in_buf, int in_len, void *out_buf,
 {
 	int err;
 	struct ubifs_compressor *compr;
+	ktime_t start;
+	s64 ns;
 
 	if (unlikely(compr_type < 0 || compr_type >= UBIFS_COMPR_TYPES_CNT)) {
 		ubifs_err("invalid compression type %d", compr_type);
@@ -166,22 +201,117 @@ int ubifs_decompress(const void *in_buf, int in_len, void *out_buf,
 	if (compr_type == UBIFS_COMPR_NONE) {
 		memcpy(out_buf, in_buf, in_len);
 		*out_len = in_len;
+		spin_lock(&compr->stats_lock);
+		compr->decomp_bytes += in_len;
+		compr->decomp_out_bytes += in_len;
+		spin_unlock(&compr->stats_lock);
 		return 0;
 	}
 
+	start = ktime_get();
 	if (compr->decomp_mutex)
 		mutex_lock(compr->decomp_mutex);
 	err = crypto_comp_decompress(compr->cc, in_buf, in_len, out_buf,
 				     (unsigned int *)out_len);
 	if (compr->decomp_mutex)
 		mutex_unlock(compr->decomp_mutex);
-	if (err)
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	if (err) {
 		ubifs_err("cannot decompress %d bytes, compressor %s, "
 			  "error %d", in_len, compr->name, err);
+		return err;
+	}
 
-	return err;
+	spin_lock(&compr->stats_lock);
+	compr->decomp_bytes += in_len;
+	compr->decomp_out_bytes += *out_len;
+	compr->decomp_ns += ns;
+	spin_unlock(&compr->stats_lock);
+	return 0;
+}
+
+/**
+ * ubifs_compr_dropped - account an inode which stopped using a compressor.
+ * @compr_type: compressor which was stopped being used
+ *
+ * This function is called when adaptive compression finds out that the data
+ * of an inode does not compress well enough with @compr_type.
+ */
+void ubifs_compr_dropped(int compr_type)
+{
+	struct ubifs_compressor *compr = ubifs_compressors[compr_type];
+
+	spin_lock(&compr->stats_lock);
+	compr->dropped += 1;
+	spin_unlock(&compr->stats_lock);
+}
+
+#ifdef CONFIG_PROC_FS
+static struct proc_dir_entry *proc_ubifs;
+
+static int compressors_show(struct seq_file *m, void *v)
+{
+	int i;
+
+	seq_printf(m, "%-5s %12s %12s %10s %9s %8s %12s %12s %10s\n",
+		   "name", "comp_in", "comp_out", "comp_us", "rejected",
+		   "dropped", "decomp_in", "decomp_out", "decomp_us");
+	for (i = 0; i < UBIFS_COMPR_TYPES_CNT; i++) {
+		struct ubifs_compressor *compr = ubifs_compressors[i];
+
+		/*
+		 * Skip the compressors not compiled in.  The "none" row is
+		 * always there: it counts the data stored uncompressed,
+		 * whatever compressor was asked for.
+		 */
+		if (!compr || (i != UBIFS_COMPR_NONE && !compr->capi_name))
+			continue;
+		spin_lock(&compr->stats_lock);
+		seq_printf(m, "%-5s %12llu %12llu %10llu %9lu %8lu "
+			   "%12llu %12llu %10llu\n", compr->name,
+			   compr->comp_bytes, compr->comp_out_bytes,
+			   div_u64(compr->comp_ns, NSEC_PER_USEC),
+			   compr->comp_rejected, compr->dropped,
+			   compr->decomp_bytes, compr->decomp_out_bytes,
+			   div_u64(compr->decomp_ns, NSEC_PER_USEC));
+		spin_unlock(&compr->stats_lock);
+	}
+	return 0;
 }
 
+static int compressors_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, compressors_show, NULL);
+}
+
+static const struct file_operations compressors_fops = {
+	.owner   = THIS_MODULE,
+	.open    = compressors_open,
+	.read    = seq_read,
+	.llseek  = seq_lseek,
+	.release = single_release,
+};
+
+static void __init compr_proc_init(void)
+{
+	proc_ubifs = proc_mkdir("fs/ubifs", NULL);
+	if (proc_ubifs)
+		proc_create("compressors", S_IRUGO, proc_ubifs,
+			    &compressors_fops);
+}
+
+static void compr_proc_exit(void)
+{
+	if (proc_ubifs) {
+		remove_proc_entry("compressors", proc_ubifs);
+		remove_proc_entry("fs/ubifs", NULL);
+	}
+}
+#else
+static inline void compr_proc_init(void) {}
+static inline void compr_proc_exit(void) {}
+#endif
+
 /**
  * compr_init - initialize a compressor.
  * @compr: compressor description object
@@ -191,6 +321,7 @@ int ubifs_decompress(const void *in_buf, int in_len, void *out_buf,
  */
 static int __init compr_init(struct ubifs_compressor *compr)
 {
+	spin_lock_init(&compr->stats_lock);
 	if (compr->capi_name) {
 		compr->cc = crypto_alloc_comp(compr->capi_name, 0, 0);
 		if (IS_ERR(compr->cc)) {
@@ -233,7 +364,9 @@ int __init ubifs_compressors_init(void)
 	if (err)
 		goto out_lzo;
 
+	spin_lock_init(&none_compr.stats_lock);
 	ubifs_compressors[UBIFS_COMPR_NONE] = &none_compr;
+	compr_proc_init();
 	return 0;
 
 out_lzo:
@@ -246,6 +379,7 @@ out_lzo:
  */
 void ubifs_compressors_exit(void)
 {
+	compr_proc_exit();
 	compr_exit(&lzo_compr);
 	compr_exit(&zlib_compr);
 }
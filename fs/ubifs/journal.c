@@ -368,7 +368,14 @@ again:
 		cmt_retries);
 	cmt_retries += 1;
 
-	err = ubifs_run_commit(c);
+	/*
+	 * If the journal is full, the space of the committed buds is enough
+	 * to go on, but GC needs the whole commit to make dirty space.
+	 */
+	if (nospc_retries)
+		err = ubifs_run_commit(c);
+	else
+		err = ubifs_run_commit_for_log(c);
 	if (err)
 		return err;
 	goto again;
@@ -673,6 +680,55 @@ out_ro:
 	return err;
 }
 
+/**
+ * adapt_compr - sample how well the data of an inode compresses.
+ * @c: UBIFS file-system description object
+ * @ui: UBIFS inode the data node belongs to
+ * @len: uncompressed length of the data node
+ * @out_len: length the data node is stored in
+ *
+ * This is a helper function for 'ubifs_jnl_write_data()' which implements
+ * adaptive compression. Once 'UBIFS_COMPR_SAMPLES' data nodes of the inode
+ * were sampled, the compressor of the inode is switched to a cheaper one or
+ * compression is switched off, if the data does not compress well enough.
+ * The decision goes to the media with the next write of the inode.
+ */
+static void adapt_compr(struct ubifs_info *c, struct ubifs_inode *ui, int len,
+			int out_len)
+{
+	int dropped = -1, saved = 0, in = 0;
+
+	spin_lock(&ui->ui_lock);
+	if (ui->compr_samples >= UBIFS_COMPR_SAMPLES ||
+	    ui->compr_type == UBIFS_COMPR_NONE)
+		goto out;
+	ui->compr_in += len;
+	ui->compr_out += out_len;
+	if (++ui->compr_samples < UBIFS_COMPR_SAMPLES)
+		goto out;
+
+	in = ui->compr_in;
+	saved = in - ui->compr_out;
+	if (saved < in / UBIFS_COMPR_POOR) {
+		dropped = ui->compr_type;
+		ui->compr_type = UBIFS_COMPR_NONE;
+	} else if (ui->compr_type == UBIFS_COMPR_ZLIB &&
+		   saved < in / UBIFS_COMPR_FAIR &&
+		   ubifs_compr_present(UBIFS_COMPR_LZO)) {
+		dropped = ui->compr_type;
+		ui->compr_type = UBIFS_COMPR_LZO;
+	}
+out:
+	spin_unlock(&ui->ui_lock);
+
+	if (dropped != -1) {
+		dbg_jnl("ino %lu: %d of %d bytes saved, stop using %s",
+			ui->vfs_inode.i_ino, saved, in,
+			ubifs_compr_name(dropped));
+		ubifs_compr_dropped(dropped);
+	}
+}
+
 /**
  * ubifs_jnl_write_data - write a data node to the journal.
  * @c: UBIFS file-system description object
@@ -688,7 +744,7 @@ int ubifs_jnl_write_data(struct ubifs_info *c, const struct inode *inode,
 			 const union ubifs_key *key, const void *buf, int len)
 {
 	struct ubifs_data_node *data;
-	int err, lnum, offs, compr_type, out_len;
+	int err, lnum, offs, compr_type, out_len, sample;
 	int dlen = UBIFS_DATA_NODE_SZ + UBIFS_BLOCK_SIZE * WORST_COMPR_FACTOR;
 	struct ubifs_inode *ui = ubifs_inode(inode);
 
@@ -712,9 +768,13 @@ int ubifs_jnl_write_data(struct ubifs_info *c, const struct inode *inode,
 	else
 		compr_type = ui->compr_type;
 
+	sample = c->adaptive_compr && compr_type != UBIFS_COMPR_NONE &&
+		 len >= UBIFS_MIN_COMPR_LEN;
 	out_len = dlen - UBIFS_DATA_NODE_SZ;
 	ubifs_compress(buf, len, &data->data, &out_len, &compr_type);
 	ubifs_assert(out_len <= UBIFS_BLOCK_SIZE);
+	if (sample)
+		adapt_compr(c, ui, len, out_len);
 
 	dlen = UBIFS_DATA_NODE_SZ + out_len;
 	data->compr_type = cpu_to_le16(compr_type);
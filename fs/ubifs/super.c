@@ -432,6 +432,11 @@ static int ubifs_show_options(struct seq_file *s, struct vfsmount *mnt)
 			   ubifs_compr_name(c->mount_opts.compr_type));
 	}
 
+	if (c->mount_opts.adaptive_compr == 2)
+		seq_printf(s, ",adaptive_compr");
+	else if (c->mount_opts.adaptive_compr == 1)
+		seq_printf(s, ",no_adaptive_compr");
+
 	return 0;
 }
 
@@ -904,6 +909,8 @@ static int check_volume_empty(struct ubifs_info *c)
  * Opt_chk_data_crc: check CRCs when reading data nodes
  * Opt_no_chk_data_crc: do not check CRCs when reading data nodes
  * Opt_override_compr: override default compressor
+ * Opt_adaptive_compr: stop compressing files which do not compress
+ * Opt_no_adaptive_compr: compress all data with the inode's compressor
  * Opt_err: just end of array marker
  */
 enum {
@@ -914,6 +921,8 @@ enum {
 	Opt_chk_data_crc,
 	Opt_no_chk_data_crc,
 	Opt_override_compr,
+	Opt_adaptive_compr,
+	Opt_no_adaptive_compr,
 	Opt_err,
 };
 
@@ -925,6 +934,8 @@ static const match_table_t tokens = {
 	{Opt_chk_data_crc, "chk_data_crc"},
 	{Opt_no_chk_data_crc, "no_chk_data_crc"},
 	{Opt_override_compr, "compr=%s"},
+	{Opt_adaptive_compr, "adaptive_compr"},
+	{Opt_no_adaptive_compr, "no_adaptive_compr"},
 	{Opt_err, NULL},
 };
 
@@ -1024,6 +1035,14 @@ static int ubifs_parse_options(struct ubifs_info *c, char *options,
 			c->default_compr = c->mount_opts.compr_type;
 			break;
 		}
+		case Opt_adaptive_compr:
+			c->mount_opts.adaptive_compr = 2;
+			c->adaptive_compr = 1;
+			break;
+		case Opt_no_adaptive_compr:
+			c->mount_opts.adaptive_compr = 1;
+			c->adaptive_compr = 0;
+			break;
 		default:
 		{
 			unsigned long flag;
@@ -2096,6 +2115,7 @@ static struct file_system_type ubifs_fs_type = {
 	.owner   = THIS_MODULE,
 	.get_sb  = ubifs_get_sb,
 	.kill_sb = kill_anon_super,
+	.fs_flags = FS_INODE_RCU,
 };
 
 /*
@@ -2153,8 +2173,8 @@ static int __init ubifs_init(void)
 	/*
 	 * We use 2 bit wide bit-fields to store compression type, which should
 	 * be amended if more compressors are added. The bit-fields are:
-	 * @compr_type in 'struct ubifs_inode', @default_compr in
-	 * 'struct ubifs_info' and @compr_type in 'struct ubifs_mount_opts'.
+	 * @default_compr in 'struct ubifs_info' and @compr_type in
+	 * 'struct ubifs_mount_opts'.
 	 */
 	BUILD_BUG_ON(UBIFS_COMPR_TYPES_CNT > 4);
 
@@ -2178,8 +2198,8 @@ static int __init ubifs_init(void)
 	err = -ENOMEM;
 	ubifs_inode_slab = kmem_cache_create("ubifs_inode_slab",
 				sizeof(struct ubifs_inode), 0,
-				SLAB_MEM_SPREAD | SLAB_RECLAIM_ACCOUNT,
-				&inode_slab_ctor);
+				SLAB_MEM_SPREAD | SLAB_RECLAIM_ACCOUNT |
+				SLAB_DESTROY_BY_RCU, &inode_slab_ctor);
 	if (!ubifs_inode_slab)
 		goto out_reg;
 
@@ -1505,9 +1505,10 @@ out:
  * @c: UBIFS file-system description object
  * @bu: bulk-read parameters and results
  *
- * Lookup consecutive data node keys for the same inode that reside
- * consecutively in the same LEB. This function returns zero in case of success
- * and a negative error code in case of failure.
+ * Lookup consecutive data node keys for the same inode that reside at
+ * ascending positions in the same LEB, close enough to be read together. The
+ * indexing nodes which follow are prefetched as well. This function returns
+ * zero in case of success and a negative error code in case of failure.
  *
  * Note, if the bulk-read buffer length (@bu->buf_len) is known, this function
  * makes sure bulk-read nodes fit the buffer. Otherwise, this function prepares
@@ -1516,7 +1517,7 @@ out:
 int ubifs_tnc_get_bu_keys(struct ubifs_info *c, struct bu_info *bu)
 {
 	int n, err = 0, lnum = -1, uninitialized_var(offs);
-	int uninitialized_var(len);
+	int uninitialized_var(len), uninitialized_var(start), gap = 0;
 	unsigned int block = key_block(c, &bu->key);
 	struct ubifs_znode *znode;
 
@@ -1529,6 +1530,9 @@ int ubifs_tnc_get_bu_keys(struct ubifs_info *c, struct bu_info *bu)
 	err = ubifs_lookup_level0(c, &bu->key, &znode, &n);
 	if (err < 0)
 		goto out;
+	/* The next znodes are likely to be needed too, read them in one go */
+	if (znode->parent)
+		ubifs_prefetch_znodes(c, znode->parent, znode->iip + 1);
 	if (err) {
 		/* Key found */
 		len = znode->zbranch[n].len;
@@ -1541,7 +1545,8 @@ int ubifs_tnc_get_bu_keys(struct ubifs_info *c, struct bu_info *bu)
 		bu->zbranch[bu->cnt++] = znode->zbranch[n];
 		bu->blk_cnt += 1;
 		lnum = znode->zbranch[n].lnum;
-		offs = ALIGN(znode->zbranch[n].offs + len, 8);
+		start = znode->zbranch[n].offs;
+		offs = ALIGN(start + len, 8);
 	}
 	while (1) {
 		struct ubifs_zbranch *zbr;
@@ -1563,6 +1568,7 @@ int ubifs_tnc_get_bu_keys(struct ubifs_info *c, struct bu_info *bu)
 		if (lnum < 0) {
 			/* First key found */
 			lnum = zbr->lnum;
+			start = zbr->offs;
 			offs = ALIGN(zbr->offs + zbr->len, 8);
 			len = zbr->len;
 			if (len > bu->buf_len) {
@@ -1571,13 +1577,18 @@ int ubifs_tnc_get_bu_keys(struct ubifs_info *c, struct bu_info *bu)
 			}
 		} else {
 			/*
-			 * The data nodes must be in consecutive positions in
-			 * the same LEB.
+			 * The data nodes must be in ascending positions in the
+			 * same LEB. Whatever lies in between, nodes of other
+			 * inodes or obsolete ones, is read too, but not more
+			 * of it than of the data nodes themselves.
 			 */
-			if (zbr->lnum != lnum || zbr->offs != offs)
+			if (zbr->lnum != lnum || zbr->offs < offs)
+				goto out;
+			gap += zbr->offs - offs;
+			offs = ALIGN(zbr->offs + zbr->len, 8);
+			len = zbr->offs + zbr->len - start;
+			if (gap > len - gap)
 				goto out;
-			offs += ALIGN(zbr->len, 8);
-			len = ALIGN(len, 8) + zbr->len;
 			/* Must not exceed buffer length */
 			if (len > bu->buf_len)
 				goto out;
@@ -1776,13 +1787,12 @@ int ubifs_tnc_bulk_read(struct ubifs_info *c, struct bu_info *bu)
 		return err;
 	}
 
-	/* Validate the nodes read */
-	buf = bu->buf;
+	/* Validate the nodes read, there may be gaps between them */
 	for (i = 0; i < bu->cnt; i++) {
+		buf = bu->buf + bu->zbranch[i].offs - offs;
 		err = validate_data_node(c, buf, &bu->zbranch[i]);
 		if (err)
 			return err;
-		buf = buf + ALIGN(bu->zbranch[i].len, 8);
 	}
 
 	return 0;
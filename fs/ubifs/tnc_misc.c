@@ -257,34 +257,21 @@ long ubifs_destroy_tnc_subtree(struct ubifs_znode *znode)
 }
 
 /**
- * read_znode - read an indexing node from flash and fill znode.
+ * parse_znode - fill znode from an indexing node.
  * @c: UBIFS file-system description object
- * @lnum: LEB of the indexing node to read
+ * @idx: the indexing node, already read and checked
+ * @lnum: LEB of the indexing node
  * @offs: node offset
- * @len: node length
- * @znode: znode to read to
+ * @znode: znode to fill
  *
- * This function reads an indexing node from the flash media and fills znode
- * with the read data. Returns zero in case of success and a negative error
- * code in case of failure. The read indexing node is validated and if anything
- * is wrong with it, this function prints complaint messages and returns
- * %-EINVAL.
+ * This function validates the indexing node and fills znode with its
+ * branches. If anything is wrong with it, this function prints complaint
+ * messages and returns %-EINVAL, otherwise zero.
  */
-static int read_znode(struct ubifs_info *c, int lnum, int offs, int len,
-		      struct ubifs_znode *znode)
+static int parse_znode(struct ubifs_info *c, struct ubifs_idx_node *idx,
+		       int lnum, int offs, struct ubifs_znode *znode)
 {
 	int i, err, type, cmp;
-	struct ubifs_idx_node *idx;
-
-	idx = kmalloc(c->max_idx_node_sz, GFP_NOFS);
-	if (!idx)
-		return -ENOMEM;
-
-	err = ubifs_read_node(c, idx, UBIFS_IDX_NODE, len, lnum, offs);
-	if (err < 0) {
-		kfree(idx);
-		return err;
-	}
 
 	znode->child_cnt = le16_to_cpu(idx->child_cnt);
 	znode->level = le16_to_cpu(idx->level);
@@ -382,16 +369,73 @@ static int read_znode(struct ubifs_info *c, int lnum, int offs, int len,
 		}
 	}
 
-	kfree(idx);
 	return 0;
 
 out_dump:
 	ubifs_err("bad indexing node at LEB %d:%d, error %d", lnum, offs, err);
 	dbg_dump_node(c, idx);
-	kfree(idx);
 	return -EINVAL;
 }
 
+/**
+ * read_znode - read an indexing node from flash and fill znode.
+ * @c: UBIFS file-system description object
+ * @lnum: LEB of the indexing node to read
+ * @offs: node offset
+ * @len: node length
+ * @znode: znode to read to
+ *
+ * This function reads an indexing node from the flash media and fills znode
+ * with the read data. Returns zero in case of success and a negative error
+ * code in case of failure. The read indexing node is validated and if anything
+ * is wrong with it, this function prints complaint messages and returns
+ * %-EINVAL.
+ */
+static int read_znode(struct ubifs_info *c, int lnum, int offs, int len,
+		      struct ubifs_znode *znode)
+{
+	int err;
+	struct ubifs_idx_node *idx;
+
+	idx = kmalloc(c->max_idx_node_sz, GFP_NOFS);
+	if (!idx)
+		return -ENOMEM;
+
+	err = ubifs_read_node(c, idx, UBIFS_IDX_NODE, len, lnum, offs);
+	if (!err)
+		err = parse_znode(c, idx, lnum, offs, znode);
+	kfree(idx);
+	return err;
+}
+
+/**
+ * link_znode - add a znode read from flash to the TNC.
+ * @c: UBIFS file-system description object
+ * @zbr: the branch of @parent pointing to the znode
+ * @znode: the znode
+ * @parent: znode's parent
+ * @iip: index of @zbr in @parent
+ */
+static void link_znode(struct ubifs_info *c, struct ubifs_zbranch *zbr,
+		       struct ubifs_znode *znode, struct ubifs_znode *parent,
+		       int iip)
+{
+	atomic_long_inc(&c->clean_zn_cnt);
+
+	/*
+	 * Increment the global clean znode counter as well. It is OK that
+	 * global and per-FS clean znode counters may be inconsistent for some
+	 * short time (because we might be preempted at this point), the global
+	 * one is only used in shrinker.
+	 */
+	atomic_long_inc(&ubifs_clean_zn_cnt);
+
+	zbr->znode = znode;
+	znode->parent = parent;
+	znode->time = get_seconds();
+	znode->iip = iip;
+}
+
 /**
  * ubifs_load_znode - load znode to TNC cache.
  * @c: UBIFS file-system description object
@@ -423,21 +467,7 @@ struct ubifs_znode *ubifs_load_znode(struct ubifs_info *c,
 	if (err)
 		goto out;
 
-	atomic_long_inc(&c->clean_zn_cnt);
-
-	/*
-	 * Increment the global clean znode counter as well. It is OK that
-	 * global and per-FS clean znode counters may be inconsistent for some
-	 * short time (because we might be preempted at this point), the global
-	 * one is only used in shrinker.
-	 */
-	atomic_long_inc(&ubifs_clean_zn_cnt);
-
-	zbr->znode = znode;
-	znode->parent = parent;
-	znode->time = get_seconds();
-	znode->iip = iip;
-
+	link_znode(c, zbr, znode, parent, iip);
 	return znode;
 
 out:
@@ -445,6 +475,84 @@ out:
 	return ERR_PTR(err);
 }
 
+/**
+ * ubifs_prefetch_znodes - load the following siblings of a znode.
+ * @c: UBIFS file-system description object
+ * @parent: parent znode
+ * @iip: index in @parent of the first sibling to load
+ *
+ * Sequential reads walk through the children of a znode one after the other,
+ * and each of them which is not in the TNC cache costs a separate flash read.
+ * The commit usually writes the indexing nodes of siblings next to each other,
+ * so this function reads those from @iip on which are not cached and sit at
+ * ascending positions in the same LEB with a single read, and adds them to
+ * the TNC cache. This is only an optimization: it stops at the first indexing
+ * node it cannot use and leaves it to 'ubifs_load_znode()' to complain. Has to
+ * be called with @c->tnc_mutex locked. Returns the number of znodes loaded.
+ */
+int ubifs_prefetch_znodes(struct ubifs_info *c, struct ubifs_znode *parent,
+			  int iip)
+{
+	int i, n, err, lnum, offs, end, len = 0, loaded = 0;
+	int max_len = c->fanout * c->max_idx_node_sz;
+	struct ubifs_zbranch *zbr;
+	void *buf;
+
+	if (iip >= parent->child_cnt)
+		return 0;
+	lnum = parent->zbranch[iip].lnum;
+	offs = end = parent->zbranch[iip].offs;
+
+	/* Find out how many siblings a single read covers */
+	for (n = iip; n < parent->child_cnt; n++) {
+		zbr = &parent->zbranch[n];
+		if (zbr->znode || zbr->lnum != lnum || zbr->offs < end ||
+		    zbr->offs + zbr->len - offs > max_len)
+			break;
+		len = zbr->offs + zbr->len - offs;
+		end = ALIGN(zbr->offs + zbr->len, 8);
+	}
+	if (n - iip < 2)
+		return 0;
+
+	buf = kmalloc(len, GFP_NOFS | __GFP_NOWARN);
+	if (!buf)
+		return 0;
+
+	dbg_tnc("LEB %d:%d, %d indexing nodes, length %d", lnum, offs,
+		n - iip, len);
+	err = ubi_read(c->ubi, lnum, buf, offs, len);
+	if (err && err != -EBADMSG)
+		goto out;
+
+	for (i = iip; i < n; i++) {
+		struct ubifs_ch *ch;
+		struct ubifs_znode *znode;
+
+		zbr = &parent->zbranch[i];
+		ch = buf + zbr->offs - offs;
+		if (ch->node_type != UBIFS_IDX_NODE ||
+		    le32_to_cpu(ch->len) != zbr->len ||
+		    ubifs_check_node(c, ch, lnum, zbr->offs, 1, 0))
+			break;
+
+		znode = kzalloc(c->max_znode_sz, GFP_NOFS);
+		if (!znode)
+			break;
+		if (parse_znode(c, (struct ubifs_idx_node *)ch, lnum,
+				zbr->offs, znode)) {
+			kfree(znode);
+			break;
+		}
+		link_znode(c, zbr, znode, parent, i);
+		loaded += 1;
+	}
+
+out:
+	kfree(buf);
+	return loaded;
+}
+
 /**
  * ubifs_tnc_read_node - read a leaf node from the flash media.
  * @c: UBIFS file-system description object
@@ -147,6 +147,16 @@
  */
 #define WORST_COMPR_FACTOR 2
 
+/*
+ * With adaptive compression, the first 'UBIFS_COMPR_SAMPLES' data nodes of an
+ * inode decide how the rest of it is compressed. If they shrank by less than
+ * 1/'UBIFS_COMPR_POOR', the inode is not compressed any more. If they shrank
+ * by less than 1/'UBIFS_COMPR_FAIR' with zlib, the cheaper LZO is used instead.
+ */
+#define UBIFS_COMPR_SAMPLES 8
+#define UBIFS_COMPR_POOR 8
+#define UBIFS_COMPR_FAIR 4
+
 /* Maximum expected tree height for use by bottom_up_buf */
 #define BOTTOM_UP_HEIGHT 64
 
@@ -343,13 +353,17 @@ struct ubifs_gced_idx_leb {
  * @ui_mutex: serializes inode write-back with the rest of VFS operations,
  *            serializes "clean <-> dirty" state changes, serializes bulk-read,
  *            protects @dirty, @bulk_read, @ui_size, and @xattr_size
- * @ui_lock: protects @synced_i_size
+ * @ui_lock: protects @synced_i_size, @compr_samples, @compr_in and
+ *           @compr_out
  * @synced_i_size: synchronized size of inode, i.e. the value of inode size
  *                 currently stored on the flash; used only for regular file
  *                 inodes
  * @ui_size: inode size used by UBIFS when writing to flash
  * @flags: inode flags (@UBIFS_COMPR_FL, etc)
  * @compr_type: default compression type used for this inode
+ * @compr_samples: number of data nodes sampled by adaptive compression
+ * @compr_in: bytes of the sampled data nodes
+ * @compr_out: bytes the sampled data nodes were stored in
  * @last_page_read: page number of last page read (for bulk read)
  * @read_in_a_row: number of consecutive pages read in a row (for bulk read)
  * @data_len: length of the data attached to the inode
@@ -394,12 +408,15 @@ struct ubifs_inode {
 	unsigned int dirty:1;
 	unsigned int xattr:1;
 	unsigned int bulk_read:1;
-	unsigned int compr_type:2;
 	struct mutex ui_mutex;
 	spinlock_t ui_lock;
 	loff_t synced_i_size;
 	loff_t ui_size;
 	int flags;
+	int compr_type;
+	int compr_samples;
+	int compr_in;
+	int compr_out;
 	pgoff_t last_page_read;
 	pgoff_t read_in_a_row;
 	int data_len;
@@ -813,6 +830,15 @@ struct ubifs_node_range {
  * @decomp_mutex: mutex used during decompression
  * @name: compressor name
  * @capi_name: cryptoapi compressor name
+ * @stats_lock: protects the statistics below
+ * @comp_bytes: bytes given to the compressor (stored as they are for "none")
+ * @comp_out_bytes: bytes they were stored in
+ * @comp_ns: time spent compressing, in nanoseconds
+ * @comp_rejected: data nodes which did not compress well enough
+ * @decomp_bytes: bytes given to the decompressor
+ * @decomp_out_bytes: bytes they decompressed to
+ * @decomp_ns: time spent decompressing, in nanoseconds
+ * @dropped: inodes adaptive compression stopped using this compressor for
  */
 struct ubifs_compressor {
 	int compr_type;
@@ -821,6 +847,15 @@ struct ubifs_compressor {
 	struct mutex *decomp_mutex;
 	const char *name;
 	const char *capi_name;
+	spinlock_t stats_lock;
+	unsigned long long comp_bytes;
+	unsigned long long comp_out_bytes;
+	unsigned long long comp_ns;
+	unsigned long comp_rejected;
+	unsigned long long decomp_bytes;
+	unsigned long long decomp_out_bytes;
+	unsigned long long decomp_ns;
+	unsigned long dropped;
 };
 
 /**
@@ -916,6 +951,8 @@ struct ubifs_orphan {
  *                  specified in @compr_type)
  * @compr_type: compressor type to override the superblock compressor with
  *              (%UBIFS_COMPR_NONE, etc)
+ * @adaptive_compr: enable/disable adaptive compression (%0 default, %1 disable,
+ *                  %2 enable)
  */
 struct ubifs_mount_opts {
 	unsigned int unmount_mode:2;
@@ -923,6 +960,7 @@ struct ubifs_mount_opts {
 	unsigned int chk_data_crc:2;
 	unsigned int override_compr:1;
 	unsigned int compr_type:2;
+	unsigned int adaptive_compr:2;
 };
 
 struct ubifs_debug_info;
@@ -964,6 +1002,9 @@ struct ubifs_debug_info;
  *
  * @commit_sem: synchronizes committer with other processes
  * @cmt_state: commit state
+ * @cmt_log_done: the running commit has given back the space of the committed
+ *                buds, so that journal writers may go on (protected by
+ *                @cs_lock)
  * @cs_lock: commit state lock
  * @cmt_wq: wait queue to sleep on if the log is full and a commit is running
  *
@@ -971,6 +1012,7 @@ struct ubifs_debug_info;
  * @no_chk_data_crc: do not check CRCs when reading data nodes (except during
  *                   recovery)
  * @bulk_read: enable bulk-reads
+ * @adaptive_compr: stop compressing files which do not compress
  * @default_compr: default compression algorithm (%UBIFS_COMPR_LZO, etc)
  * @rw_incompat: the media is not R/W compatible
  *
@@ -1208,12 +1250,14 @@ struct ubifs_info {
 
 	struct rw_semaphore commit_sem;
 	int cmt_state;
+	int cmt_log_done;
 	spinlock_t cs_lock;
 	wait_queue_head_t cmt_wq;
 
 	unsigned int big_lpt:1;
 	unsigned int no_chk_data_crc:1;
 	unsigned int bulk_read:1;
+	unsigned int adaptive_compr:1;
 	unsigned int default_compr:2;
 	unsigned int rw_incompat:1;
 
@@ -1567,6 +1611,8 @@ long ubifs_destroy_tnc_subtree(struct ubifs_znode *zr);
 struct ubifs_znode *ubifs_load_znode(struct ubifs_info *c,
 				     struct ubifs_zbranch *zbr,
 				     struct ubifs_znode *parent, int iip);
+int ubifs_prefetch_znodes(struct ubifs_info *c, struct ubifs_znode *parent,
+			  int iip);
 int ubifs_tnc_read_node(struct ubifs_info *c, struct ubifs_zbranch *zbr,
 			void *node);
 
@@ -1582,6 +1628,7 @@ int ubifs_bg_thread(void *info);
 void ubifs_commit_required(struct ubifs_info *c);
 void ubifs_request_bg_commit(struct ubifs_info *c);
 int ubifs_run_commit(struct ubifs_info *c);
+int ubifs_run_commit_for_log(struct ubifs_info *c);
 void ubifs_recovery_commit(struct ubifs_info *c);
 int ubifs_gc_should_commit(struct ubifs_info *c);
 void ubifs_wait_for_commit(struct ubifs_info *c);
@@ -1727,6 +1774,7 @@ void ubifs_compress(const void *in_buf, int in_len, void *out_buf, int *out_len,
 		    int *compr_type);
 int ubifs_decompress(const void *buf, int len, void *out, int *out_len,
 		     int compr_type);
+void ubifs_compr_dropped(int compr_type);
 
 #include "debug.h"
 #include "misc.h"
@@ -35,6 +35,13 @@
 #define PMEM_GET_TOTAL_SIZE	_IOW(PMEM_IOCTL_MAGIC, 7, unsigned int)
 #define PMEM_CACHE_FLUSH	_IOW(PMEM_IOCTL_MAGIC, 8, unsigned int)
 
+enum pmem_allocator_type {
+	/* power of two sized allocations from a buddy bitmap */
+	PMEM_ALLOCATORTYPE_BUDDY,
+	/* page granular best fit allocations from an rb-tree of extents */
+	PMEM_ALLOCATORTYPE_BESTFIT,
+};
+
 struct android_pmem_platform_data
 {
 	const char* name;
@@ -44,12 +51,17 @@ struct android_pmem_platform_data
 	unsigned long size;
 	/* set to indicate the region should not be managed with an allocator */
 	unsigned no_allocator;
+	/* the allocator managing the region if no_allocator is not set */
+	enum pmem_allocator_type allocator_type;
 	/* set to indicate maps of this region should be cached, if a mix of
 	 * cached and uncached is desired, set this and open the device with
 	 * O_SYNC to get an uncached region */
 	unsigned cached;
 	/* The MSM7k has bits to enable a write buffer in the bus controller*/
 	unsigned buffered;
+	/* set to indicate the region is a CMA region, lent to movable pages
+	 * while it is not allocated, see mm/cma.c */
+	unsigned movable;
 };
 
 struct pmem_region {
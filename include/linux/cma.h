@@ -0,0 +1,25 @@
+#ifndef _LINUX_CMA_H
+#define _LINUX_CMA_H
+
+#include <linux/types.h>
+#include <linux/pageblock-flags.h>
+
+/* Regions must start and end on a pageblock boundary */
+#define CMA_REGION_ALIGN	(PAGE_SIZE << pageblock_order)
+
+#ifdef CONFIG_CMA
+extern int cma_declare_region(phys_addr_t base, unsigned long size);
+extern bool cma_region_contains(phys_addr_t base, unsigned long size);
+#else
+static inline int cma_declare_region(phys_addr_t base, unsigned long size)
+{
+	return -ENOSYS;
+}
+
+static inline bool cma_region_contains(phys_addr_t base, unsigned long size)
+{
+	return false;
+}
+#endif /* CONFIG_CMA */
+
+#endif /* _LINUX_CMA_H */
@@ -11,6 +11,12 @@
 extern u32  crc32_le(u32 crc, unsigned char const *p, size_t len);
 extern u32  crc32_be(u32 crc, unsigned char const *p, size_t len);
 
+/*
+ * Castagnoli CRC32c (as used by iSCSI, SCTP, ext4 and jbd2).  Like
+ * crc32_le() it does not invert the seed or the result.
+ */
+extern u32  __crc32c_le(u32 crc, unsigned char const *p, size_t len);
+
 #define crc32(seed, data, length)  crc32_le(seed, (unsigned char const *)data, length)
 
 /*
@@ -17,6 +17,7 @@
 /* For O_CLOEXEC */
 #include <linux/fcntl.h>
 #include <linux/types.h>
+#include <linux/ioctl.h>
 
 /* Flags for epoll_create1.  */
 #define EPOLL_CLOEXEC O_CLOEXEC
@@ -49,6 +50,32 @@ struct epoll_event {
 	__u64 data;
 } EPOLL_PACKED;
 
+/*
+ * One eventpoll file to collect events from, for EPIOC_WAIT_MULTI. The
+ * pointers are carried as __u64 so that the layout is the same for 32 and
+ * 64 bit callers.
+ */
+struct epoll_wait_desc {
+	__s32 epfd;
+	__s32 maxevents;
+	__u64 events;		/* struct epoll_event * */
+	/* Set to the number of events stored in "events" */
+	__s32 nr_events;
+	__u32 __pad;
+};
+
+struct epoll_wait_multi {
+	__u64 descs;		/* struct epoll_wait_desc * */
+	__u32 ndescs;
+	__s32 timeout;
+};
+
+/*
+ * Waits for events on several eventpoll files at once. It can be issued
+ * on any eventpoll file descriptor and returns the total number of events.
+ */
+#define EPIOC_WAIT_MULTI _IOW(0x8A, 0x00, struct epoll_wait_multi)
+
 #ifdef __KERNEL__
 
 /* Forward declarations to avoid compiler errors */
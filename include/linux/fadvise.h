@@ -18,4 +18,13 @@
 #define POSIX_FADV_NOREUSE	5 /* Data will be accessed once.  */
 #endif
 
+/*
+ * Linux extensions: record the pages that have to be read into the page
+ * cache of a file from now on, stop recording, and read the recorded
+ * pages back in one go.  offset and len are ignored.
+ */
+#define POSIX_FADV_RA_RECORD	8 /* Start recording a readahead profile. */
+#define POSIX_FADV_RA_STOP	9 /* Stop recording. */
+#define POSIX_FADV_RA_REPLAY	10 /* Read in what was recorded. */
+
 #endif	/* FADVISE_H_INCLUDED */
@@ -180,6 +180,10 @@ struct inodes_stat_t {
 #define FS_RENAME_DOES_D_MOVE	32768	/* FS will handle d_move()
 					 * during rename() internally.
 					 */
+#define FS_INODE_RCU	65536	/* Inode memory stays an inode until an
+				 * RCU grace period has passed, so that
+				 * path walk may read it lock-free.
+				 */
 
 /*
  * These are the fs-independent mount-flags: up to 32 flags are supported
@@ -639,6 +643,9 @@ struct address_space {
 	spinlock_t		private_lock;	/* for use by the address_space */
 	struct list_head	private_list;	/* ditto */
 	struct address_space	*assoc_mapping;	/* ditto */
+#ifdef CONFIG_READAHEAD_PROFILE
+	struct ra_profile	*ra_profile;	/* recorded page cache misses */
+#endif
 } __attribute__((aligned(sizeof(long))));
 	/*
 	 * On most architectures that alignment is already the case; but
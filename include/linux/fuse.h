@@ -43,6 +43,7 @@
 #define _LINUX_FUSE_H
 
 #include <linux/types.h>
+#include <linux/ioctl.h>
 
 /*
  * Version negotiation:
@@ -135,16 +136,20 @@ struct fuse_file_lock {
  * FOPEN_DIRECT_IO: bypass page cache for this open file
  * FOPEN_KEEP_CACHE: don't invalidate the data cache on open
  * FOPEN_NONSEEKABLE: the file is not seekable
+ * FOPEN_PASSTHROUGH: read and write the file passthrough_fd of the
+ *		      filesystem daemon instead of sending READ and WRITE
  */
 #define FOPEN_DIRECT_IO		(1 << 0)
 #define FOPEN_KEEP_CACHE	(1 << 1)
 #define FOPEN_NONSEEKABLE	(1 << 2)
+#define FOPEN_PASSTHROUGH	(1 << 3)
 
 /**
  * INIT request/reply flags
  *
  * FUSE_EXPORT_SUPPORT: filesystem handles lookups of "." and ".."
  * FUSE_DONT_MASK: don't apply umask to file mode on create operations
+ * FUSE_PASSTHROUGH: FOPEN_PASSTHROUGH may be returned by open and create
  */
 #define FUSE_ASYNC_READ		(1 << 0)
 #define FUSE_POSIX_LOCKS	(1 << 1)
@@ -153,6 +158,7 @@ struct fuse_file_lock {
 #define FUSE_EXPORT_SUPPORT	(1 << 4)
 #define FUSE_BIG_WRITES		(1 << 5)
 #define FUSE_DONT_MASK		(1 << 6)
+#define FUSE_PASSTHROUGH	(1 << 7)
 
 /**
  * CUSE INIT request/reply flags
@@ -354,7 +360,7 @@ struct fuse_create_in {
 struct fuse_open_out {
 	__u64	fh;
 	__u32	open_flags;
-	__u32	padding;
+	__u32	passthrough_fd;	/* Lower file for FOPEN_PASSTHROUGH */
 };
 
 struct fuse_release_in {
@@ -568,4 +574,20 @@ struct fuse_notify_inval_entry_out {
 	__u32	padding;
 };
 
+/**
+ * /dev/fuse ioctls
+ *
+ * FUSE_DEV_IOC_CLONE: attach a fresh open of /dev/fuse to the connection
+ * of the device fd passed in.  Each attached fd gets a request queue of
+ * its own, so that a daemon can serve the connection with one fd per
+ * worker thread.
+ *
+ * FUSE_DEV_IOC_BATCH: let one read() on this fd return up to that many
+ * requests, back to back, each starting with its struct fuse_in_header.
+ * Requests are only batched if the buffer has room for all of them.
+ */
+#define FUSE_DEV_IOC_MAGIC	229
+#define FUSE_DEV_IOC_CLONE	_IOR(FUSE_DEV_IOC_MAGIC, 0, __u32)
+#define FUSE_DEV_IOC_BATCH	_IOR(FUSE_DEV_IOC_MAGIC, 1, __u32)
+
 #endif /* _LINUX_FUSE_H */
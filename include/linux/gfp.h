@@ -329,6 +329,27 @@ extern void __free_pages(struct page *page, unsigned int order);
 extern void free_pages(unsigned long addr, unsigned int order);
 extern void free_hot_cold_page(struct page *page, int cold);
 
+/*
+ * The most pages taken from or given back to the buddy lists under one
+ * hold of zone->lock by the bulk functions, to bound the time spent with
+ * interrupts disabled.
+ */
+#define PAGES_BULK_BATCH	256
+
+extern unsigned long alloc_pages_bulk(gfp_t gfp_mask, unsigned long nr_pages,
+				      struct list_head *list);
+extern unsigned long alloc_pages_bulk_array(gfp_t gfp_mask,
+				unsigned long nr_pages, struct page **pages);
+extern void free_pages_bulk(struct list_head *list);
+extern void free_pages_bulk_array(struct page **pages, unsigned long nr_pages);
+
+#ifdef CONFIG_CMA
+/* The range must be in MIGRATE_CMA pageblocks of a single zone */
+extern int alloc_contig_range(unsigned long start, unsigned long end);
+extern void free_contig_range(unsigned long pfn, unsigned long nr_pages);
+extern void init_cma_reserved_pageblock(struct page *page);
+#endif
+
 #define __free_page(page) __free_pages((page), 0)
 #define free_page(addr) free_pages((addr), 0)
 
@@ -638,6 +638,12 @@ struct transaction_s
 	unsigned int t_synchronous_commit:1;
 	unsigned int t_flushed_data_blocks:1;
 
+	/*
+	 * An fsync is waiting for others to join before it starts the
+	 * commit, see jbd2_log_batch_commit() [j_state_lock]
+	 */
+	unsigned int t_fsync_batch:1;
+
 	/*
 	 * For use by the filesystem to store fs-specific data
 	 * structures associated with the transaction
@@ -958,6 +964,13 @@ struct journal_s
 	u32			j_min_batch_time;
 	u32			j_max_batch_time;
 
+	/*
+	 * Number of fsync batches and of fsyncs that joined one instead
+	 * of starting a commit of their own [j_state_lock]
+	 */
+	unsigned long		j_fsync_batches;
+	unsigned long		j_fsync_joined;
+
 	/* This function is called when a transaction is closed */
 	void			(*j_commit_callback)(journal_t *,
 						     transaction_t *);
@@ -1185,6 +1198,7 @@ int __jbd2_log_space_left(journal_t *); /* Called with journal locked */
 int jbd2_log_start_commit(journal_t *journal, tid_t tid);
 int __jbd2_log_start_commit(journal_t *journal, tid_t tid);
 int jbd2_journal_start_commit(journal_t *journal, tid_t *tid);
+int jbd2_log_batch_commit(journal_t *journal, tid_t tid);
 int jbd2_journal_force_commit_nested(journal_t *journal);
 int jbd2_log_wait_commit(journal_t *journal, tid_t tid);
 int jbd2_log_do_checkpoint(journal_t *journal);
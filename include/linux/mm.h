@@ -722,6 +722,7 @@ static inline int page_mapped(struct page *page)
 
 #define VM_FAULT_NOPAGE	0x0100	/* ->fault installed the pte, not return page */
 #define VM_FAULT_LOCKED	0x0200	/* ->fault locked the returned page */
+#define VM_FAULT_RETRY	0x0400	/* speculative fault gave up, take mmap_sem */
 
 #define VM_FAULT_ERROR	(VM_FAULT_OOM | VM_FAULT_SIGBUS | VM_FAULT_HWPOISON)
 
@@ -842,6 +843,42 @@ static inline int handle_mm_fault(struct mm_struct *mm,
 }
 #endif
 
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+extern int handle_speculative_fault(struct mm_struct *mm,
+			unsigned long address, unsigned int flags,
+			unsigned long vm_flags);
+
+/*
+ * Everything that changes the vmas of an mm, the vm_flags and protection
+ * of one, or moves page tables from one to another, does so between
+ * vma_seq_begin() and vma_seq_end(), with mmap_sem held for writing.
+ */
+static inline void vma_seq_begin(struct mm_struct *mm)
+{
+	write_seqcount_begin(&mm->vma_seq);
+}
+
+static inline void vma_seq_end(struct mm_struct *mm)
+{
+	write_seqcount_end(&mm->vma_seq);
+}
+#else
+static inline int handle_speculative_fault(struct mm_struct *mm,
+			unsigned long address, unsigned int flags,
+			unsigned long vm_flags)
+{
+	return VM_FAULT_RETRY;
+}
+
+static inline void vma_seq_begin(struct mm_struct *mm)
+{
+}
+
+static inline void vma_seq_end(struct mm_struct *mm)
+{
+}
+#endif
+
 extern int make_pages_present(unsigned long addr, unsigned long end);
 extern int access_process_vm(struct task_struct *tsk, unsigned long addr, void *buf, int len, int write);
 
@@ -1006,6 +1043,7 @@ static inline void sync_mm_rss(struct task_struct *task, struct mm_struct *mm)
 struct shrinker {
 	int (*shrink)(struct shrinker *, int nr_to_scan, gfp_t gfp_mask);
 	int seeks;	/* seeks to recreate an obj */
+	const char *name;	/* for statistics, optional */
 
 	/* These are for internal use */
 	struct list_head list;
@@ -1332,6 +1370,29 @@ unsigned long ra_submit(struct file_ra_state *ra,
 			struct address_space *mapping,
 			struct file *filp);
 
+#ifdef CONFIG_READAHEAD_PROFILE
+void ra_profile_record(struct address_space *mapping, pgoff_t offset,
+		       unsigned long nr);
+int ra_profile_advise(struct address_space *mapping, struct file *filp,
+		      int advice);
+void ra_profile_free(struct address_space *mapping);
+#else
+static inline void ra_profile_record(struct address_space *mapping,
+				     pgoff_t offset, unsigned long nr)
+{
+}
+
+static inline int ra_profile_advise(struct address_space *mapping,
+				    struct file *filp, int advice)
+{
+	return -EINVAL;
+}
+
+static inline void ra_profile_free(struct address_space *mapping)
+{
+}
+#endif
+
 /* Do stack extension */
 extern int expand_stack(struct vm_area_struct *vma, unsigned long address);
 #if VM_GROWSUP
@@ -34,6 +34,7 @@ struct mmc_csd {
 	unsigned int		read_blkbits;
 	unsigned int		write_blkbits;
 	unsigned int		capacity;
+	unsigned int		erase_size;		/* In sectors */
 	unsigned int		read_partial:1,
 				read_misalign:1,
 				write_partial:1,
@@ -45,6 +46,7 @@ struct mmc_ext_csd {
 	unsigned int		sa_timeout;		/* Units: 100ns */
 	unsigned int		hs_max_dtr;
 	unsigned int		sectors;
+	unsigned int		hc_erase_size;		/* In sectors */
 };
 
 struct sd_scr {
@@ -41,7 +41,18 @@
 #define MIGRATE_PCPTYPES      3 /* the number of types on the pcp lists */
 #define MIGRATE_RESERVE       3
 #define MIGRATE_ISOLATE       4 /* can't allocate from here */
+#ifdef CONFIG_CMA
+#define MIGRATE_CMA           5 /* movable allocations only, see mm/cma.c */
+#define MIGRATE_TYPES         6
+#else
 #define MIGRATE_TYPES         5
+#endif
+
+#ifdef CONFIG_CMA
+#  define is_migrate_cma(migratetype) unlikely((migratetype) == MIGRATE_CMA)
+#else
+#  define is_migrate_cma(migratetype) false
+#endif
 
 #define for_each_migratetype_order(order, type) \
 	for (order = 0; order < MAX_ORDER; order++) \
@@ -173,6 +184,11 @@ struct per_cpu_pages {
 
 	/* Lists of pages, one per migrate type stored on the pcp-lists */
 	struct list_head lists[MIGRATE_PCPTYPES];
+#ifdef CONFIG_ZEROED_PAGE_CACHE
+	/* Pages cleared in idle time for __GFP_ZERO, not in count */
+	int zeroed_count;
+	struct list_head zeroed;
+#endif
 };
 
 struct per_cpu_pageset {
@@ -336,6 +352,10 @@ struct zone {
 	 */
 	unsigned int		compact_considered;
 	unsigned int		compact_defer_shift;
+
+	/* Likewise for kcompactd, counted in its wakeups */
+	unsigned int		compact_daemon_skip;
+	unsigned int		compact_daemon_shift;
 #endif
 
 	ZONE_PADDING(_pad1_)
@@ -705,6 +705,7 @@ extern struct user_struct root_user;
 
 struct backing_dev_info;
 struct reclaim_state;
+struct reclaim_stall;
 
 #if defined(CONFIG_SCHEDSTATS) || defined(CONFIG_TASK_DELAY_ACCT)
 struct sched_info {
@@ -756,6 +757,31 @@ struct task_delay_info {
 };
 #endif	/* CONFIG_TASK_DELAY_ACCT */
 
+#ifdef CONFIG_RECLAIM_STALL_STATS
+/*
+ * Time spent stuck in direct reclaim and compaction.  Only ever updated
+ * by the task itself, readers of other tasks get a racy snapshot.
+ */
+#define NR_STALL_BUCKETS	6	/* <1, <4, <16, <64, <256ms and slower */
+
+enum {
+	STALL_RECLAIM,
+	STALL_COMPACT,
+	NR_STALL_TYPES
+};
+
+struct reclaim_stall_stats {
+	unsigned long count[NR_STALL_TYPES][NR_STALL_BUCKETS];
+	u64 delay_ns[NR_STALL_TYPES];
+	unsigned long scanned;		/* by direct reclaim */
+	unsigned long reclaimed;
+	u64 writeback_ns;		/* waiting for writeback in reclaim */
+	u64 max_ns;			/* the longest reclaim stall */
+	u64 max_shrinker_ns;		/* its slowest shrinker */
+	char max_shrinker[16];
+};
+#endif /* CONFIG_RECLAIM_STALL_STATS */
+
 static inline int sched_info_on(void)
 {
 #ifdef CONFIG_SCHEDSTATS
@@ -1217,6 +1243,10 @@ struct task_struct {
 #if defined(CONFIG_SCHEDSTATS) || defined(CONFIG_TASK_DELAY_ACCT)
 	struct sched_info sched_info;
 #endif
+#ifdef CONFIG_SCHED_LAT_HIST
+	u64 sched_lat_stamp;	/* when woken up or preempted, or 0 */
+	int sched_lat_wait;	/* the stamp is from a preemption */
+#endif
 
 	struct list_head tasks;
 	struct plist_node pushable_tasks;
@@ -1402,6 +1432,10 @@ struct task_struct {
 
 /* VM state */
 	struct reclaim_state *reclaim_state;
+#ifdef CONFIG_RECLAIM_STALL_STATS
+	struct reclaim_stall *reclaim_stall;	/* the stall in progress */
+	struct reclaim_stall_stats reclaim_stall_stats;
+#endif
 
 	struct backing_dev_info *backing_dev_info;
 
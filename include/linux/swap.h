@@ -111,6 +111,20 @@ struct reclaim_state {
 	unsigned long reclaimed_slab;
 };
 
+/*
+ * current->reclaim_stall points to one of these while a task is stuck in
+ * direct reclaim, collecting what the stall was spent on.
+ */
+struct reclaim_stall {
+	ktime_t start;
+	unsigned long scanned;
+	unsigned long reclaimed;
+	u64 writeback_ns;
+	u64 shrinkers_ns;		/* all shrinker calls */
+	u64 shrinker_ns;		/* the slowest shrinker call */
+	char shrinker[16];		/* and its name */
+};
+
 #ifdef __KERNEL__
 
 struct address_space;
@@ -248,6 +262,9 @@ extern unsigned long mem_cgroup_shrink_node_zone(struct mem_cgroup *mem,
 						struct zone *zone,
 						int nid);
 extern int __isolate_lru_page(struct page *page, int mode, int file);
+extern int isolate_lru_page(struct page *page);
+extern void putback_lru_page(struct page *page);
+extern unsigned long reclaim_pages_from_list(struct list_head *page_list);
 extern unsigned long shrink_all_memory(unsigned long nr_pages);
 extern int vm_swappiness;
 extern int remove_mapping(struct address_space *mapping, struct page *page);
@@ -0,0 +1,38 @@
+#ifndef _LINUX_UNALIGNED_WORD32_H
+#define _LINUX_UNALIGNED_WORD32_H
+
+#include <linux/types.h>
+#include <asm/unaligned.h>
+
+/*
+ * Native-endian 32-bit loads and stores at possibly unaligned addresses,
+ * for the word-at-a-time copy loops of the decompressors.
+ *
+ * HAVE_FAST_UNALIGNED_WORD32 is defined when each is a single memory
+ * access.  Otherwise they are get_unaligned()/put_unaligned(), which on
+ * ARM before v7 expand to byte loads and shifts, and callers should keep
+ * their byte copies.
+ *
+ * ARMv7 handles unaligned LDR/STR in hardware once SCTLR.A is clear, which
+ * both the boot decompressor (cache_on) and alignment_init() ensure.  Plain
+ * u32 dereferences could be merged into LDRD/LDM, which still fault on
+ * unaligned addresses, hence the inline assembly.
+ */
+#if defined(CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS)
+#define HAVE_FAST_UNALIGNED_WORD32
+#define get_unaligned_word32(p)		get_unaligned((const u32 *)(p))
+#define put_unaligned_word32(p, v)	put_unaligned((u32)(v), (u32 *)(p))
+#elif defined(CONFIG_ARM) && __LINUX_ARM_ARCH__ >= 7
+#define HAVE_FAST_UNALIGNED_WORD32
+#define get_unaligned_word32(p) ({					\
+	u32 __v;							\
+	asm("ldr %0, %1" : "=r" (__v) : "m" (*(const u32 *)(p)));	\
+	__v; })
+#define put_unaligned_word32(p, v)					\
+	asm("str %1, %0" : "=m" (*(u32 *)(p)) : "r" ((u32)(v)))
+#else
+#define get_unaligned_word32(p)		get_unaligned((const u32 *)(p))
+#define put_unaligned_word32(p, v)	put_unaligned((u32)(v), (u32 *)(p))
+#endif
+
+#endif /* _LINUX_UNALIGNED_WORD32_H */
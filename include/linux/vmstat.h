@@ -32,6 +32,9 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 		FOR_ALL_ZONES(PGALLOC),
 		PGFREE, PGACTIVATE, PGDEACTIVATE,
 		PGFAULT, PGMAJFAULT,
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+		SPECULATIVE_FAULT, SPECULATIVE_FAULT_RETRY,
+#endif
 		FOR_ALL_ZONES(PGREFILL),
 		FOR_ALL_ZONES(PGSTEAL),
 		FOR_ALL_ZONES(PGSCAN_KSWAPD),
@@ -46,6 +49,20 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 #ifdef CONFIG_COMPACTION
 		COMPACTBLOCKS, COMPACTPAGES, COMPACTPAGEFAILED,
 		COMPACTSTALL, COMPACTFAIL, COMPACTSUCCESS,
+		COMPACTDAEMONWAKE, COMPACTDAEMONRUN,
+		COMPACTDAEMONSUCCESS, COMPACTDAEMONFAIL,
+#endif
+#ifdef CONFIG_RECLAIM_STALL_STATS
+		/* in the order of the NR_STALL_BUCKETS histogram buckets */
+		RECLAIMSTALL_1MS, RECLAIMSTALL_4MS, RECLAIMSTALL_16MS,
+		RECLAIMSTALL_64MS, RECLAIMSTALL_256MS, RECLAIMSTALL_SLOW,
+		RECLAIMSTALL_US, RECLAIMSTALL_SCANNED, RECLAIMSTALL_RECLAIMED,
+		RECLAIMSTALL_WRITEBACK_US, RECLAIMSTALL_SHRINKER_US,
+#ifdef CONFIG_COMPACTION
+		COMPACTSTALL_1MS, COMPACTSTALL_4MS, COMPACTSTALL_16MS,
+		COMPACTSTALL_64MS, COMPACTSTALL_256MS, COMPACTSTALL_SLOW,
+		COMPACTSTALL_US,
+#endif
 #endif
 #ifdef CONFIG_HUGETLB_PAGE
 		HTLB_BUDDY_PGALLOC, HTLB_BUDDY_PGALLOC_FAIL,
@@ -16,6 +16,7 @@
 #include <linux/zlib.h>
 #include <linux/string.h>
 #include <linux/kernel.h>
+#include <asm/byteorder.h>
 
 typedef unsigned char  uch;
 typedef unsigned short ush;
@@ -60,6 +61,45 @@ typedef uLong (*check_func) (uLong check, const Byte *buf,
 #define DO8(buf,i)  DO4(buf,i); DO4(buf,i+4);
 #define DO16(buf)   DO8(buf,0); DO8(buf,8);
 
+/*
+ * Sum a 64 byte, word aligned block a word at a time.  Each of the four
+ * byte lanes of a word is treated as a separate Adler stream, held in
+ * 16-bit halves of two accumulator pairs; 16 words is as far as the
+ * lane s2 sums can go without carrying into the next lane.  Byte lane
+ * l of word j then has weight 4 * (16 - j) - l in the block's s2.
+ * This needs a quarter of the loads of DO16, which matters on cores
+ * with a single load/store pipe.
+ */
+#define ADLER_BLOCK 64
+
+static inline void adler32_block(unsigned long *s1p, unsigned long *s2p,
+				 const Byte *buf)
+{
+    const u32 *w = (const u32 *)buf;
+    u32 e1 = 0, o1 = 0, e2 = 0, o2 = 0;
+    unsigned long l0, l1, l2, l3;
+    int i;
+
+    for (i = 0; i < ADLER_BLOCK / 4; i++) {
+        u32 v = le32_to_cpu(w[i]);
+
+        e1 += v & 0x00ff00ff;           /* lanes 0 and 2 */
+        o1 += (v >> 8) & 0x00ff00ff;    /* lanes 1 and 3 */
+        e2 += e1;
+        o2 += o1;
+    }
+
+    l0 = e1 & 0xffff;
+    l1 = o1 & 0xffff;
+    l2 = e1 >> 16;
+    l3 = o1 >> 16;
+    /* never exceeds the sum DO16 would have produced, see NMAX */
+    *s2p += (*s1p << 6) +
+            (4 * ((e2 & 0xffff) + (e2 >> 16) + (o2 & 0xffff) + (o2 >> 16)) -
+             (l1 + 2 * l2 + 3 * l3));
+    *s1p += l0 + l1 + l2 + l3;
+}
+
 /* ========================================================================= */
 /*
      Update a running Adler-32 checksum with the bytes buf[0..len-1] and
@@ -88,6 +128,16 @@ static inline uLong zlib_adler32(uLong adler,
     while (len > 0) {
         k = len < NMAX ? len : NMAX;
         len -= k;
+        while (k >= ADLER_BLOCK && ((unsigned long)buf & 3)) {
+            s1 += *buf++;
+            s2 += s1;
+            k--;
+        }
+        while (k >= ADLER_BLOCK) {
+            adler32_block(&s1, &s2, buf);
+            buf += ADLER_BLOCK;
+            k -= ADLER_BLOCK;
+        }
         while (k >= 16) {
             DO16(buf);
 	    buf += 16;
@@ -347,6 +347,19 @@ DEFINE_EVENT(sched_stat_template, sched_stat_iowait,
 	     TP_PROTO(struct task_struct *tsk, u64 delay),
 	     TP_ARGS(tsk, delay));
 
+/*
+ * Tracepoints for the wakeup latency and runqueue wait histograms (time
+ * from wakeup, or from preemption, until the task runs again).  Unlike
+ * the sched_stat ones above these cover all scheduling classes.
+ */
+DEFINE_EVENT(sched_stat_template, sched_wakeup_latency,
+	     TP_PROTO(struct task_struct *tsk, u64 delay),
+	     TP_ARGS(tsk, delay));
+
+DEFINE_EVENT(sched_stat_template, sched_wait_latency,
+	     TP_PROTO(struct task_struct *tsk, u64 delay),
+	     TP_ARGS(tsk, delay));
+
 /*
  * Tracepoint for accounting runtime (time the task is executing
  * on a CPU).
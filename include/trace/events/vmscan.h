@@ -0,0 +1,136 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM vmscan
+
+#if !defined(_TRACE_VMSCAN_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_VMSCAN_H
+
+#include <linux/types.h>
+#include <linux/tracepoint.h>
+#include <linux/mm.h>
+#include <linux/swap.h>
+
+#ifdef CONFIG_RECLAIM_STALL_STATS
+/*
+ * Tracepoint for a task entering direct reclaim:
+ */
+TRACE_EVENT(mm_vmscan_direct_reclaim_begin,
+
+	TP_PROTO(int order, int may_writepage, gfp_t gfp_flags),
+
+	TP_ARGS(order, may_writepage, gfp_flags),
+
+	TP_STRUCT__entry(
+		__field(	int,	order		)
+		__field(	int,	may_writepage	)
+		__field(	gfp_t,	gfp_flags	)
+	),
+
+	TP_fast_assign(
+		__entry->order		= order;
+		__entry->may_writepage	= may_writepage;
+		__entry->gfp_flags	= gfp_flags;
+	),
+
+	TP_printk("order=%d may_writepage=%d gfp_flags=0x%x",
+		__entry->order,
+		__entry->may_writepage,
+		(unsigned int)__entry->gfp_flags)
+);
+
+/*
+ * Tracepoint for a task leaving direct reclaim, with what the stall was
+ * spent on:
+ */
+TRACE_EVENT(mm_vmscan_direct_reclaim_end,
+
+	TP_PROTO(struct reclaim_stall *stall, u64 delay),
+
+	TP_ARGS(stall, delay),
+
+	TP_STRUCT__entry(
+		__field(	u64,		delay		)
+		__field(	unsigned long,	scanned		)
+		__field(	unsigned long,	reclaimed	)
+		__field(	u64,		writeback	)
+		__array(	char,		shrinker,	16	)
+		__field(	u64,		shrinker_delay	)
+	),
+
+	TP_fast_assign(
+		__entry->delay		= delay;
+		__entry->scanned	= stall->scanned;
+		__entry->reclaimed	= stall->reclaimed;
+		__entry->writeback	= stall->writeback_ns;
+		memcpy(__entry->shrinker, stall->shrinker, 16);
+		__entry->shrinker_delay	= stall->shrinker_ns;
+	),
+
+	TP_printk("delay=%Lu [ns] scanned=%lu reclaimed=%lu writeback=%Lu [ns] "
+		  "shrinker=%s shrinker_delay=%Lu [ns]",
+		(unsigned long long)__entry->delay,
+		__entry->scanned, __entry->reclaimed,
+		(unsigned long long)__entry->writeback,
+		__entry->shrinker[0] ? __entry->shrinker : "none",
+		(unsigned long long)__entry->shrinker_delay)
+);
+
+/*
+ * Tracepoint for one shrinker having been called during direct reclaim:
+ */
+TRACE_EVENT(mm_shrink_slab_end,
+
+	TP_PROTO(struct shrinker *shrinker, unsigned long freed, u64 delay),
+
+	TP_ARGS(shrinker, freed, delay),
+
+	TP_STRUCT__entry(
+		__array(	char,		name,	16	)
+		__field(	unsigned long,	freed		)
+		__field(	u64,		delay		)
+	),
+
+	TP_fast_assign(
+		if (shrinker->name)
+			strlcpy(__entry->name, shrinker->name, 16);
+		else
+			snprintf(__entry->name, 16, "%pf", shrinker->shrink);
+		__entry->freed	= freed;
+		__entry->delay	= delay;
+	),
+
+	TP_printk("shrinker=%s freed=%lu delay=%Lu [ns]",
+		__entry->name, __entry->freed,
+		(unsigned long long)__entry->delay)
+);
+
+/*
+ * Tracepoint for a task leaving direct compaction:
+ */
+TRACE_EVENT(mm_vmscan_compact_stall,
+
+	TP_PROTO(int order, unsigned long status, u64 delay),
+
+	TP_ARGS(order, status, delay),
+
+	TP_STRUCT__entry(
+		__field(	int,		order	)
+		__field(	unsigned long,	status	)
+		__field(	u64,		delay	)
+	),
+
+	TP_fast_assign(
+		__entry->order	= order;
+		__entry->status	= status;
+		__entry->delay	= delay;
+	),
+
+	TP_printk("order=%d status=%lu delay=%Lu [ns]",
+		__entry->order, __entry->status,
+		(unsigned long long)__entry->delay)
+);
+#endif /* CONFIG_RECLAIM_STALL_STATS */
+
+#endif /* _TRACE_VMSCAN_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -493,6 +493,9 @@ static struct mm_struct * mm_init(struct mm_struct * mm, struct task_struct *p)
 	atomic_set(&mm->mm_users, 1);
 	atomic_set(&mm->mm_count, 1);
 	init_rwsem(&mm->mmap_sem);
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+	seqcount_init(&mm->vma_seq);
+#endif
 	INIT_LIST_HEAD(&mm->mmlist);
 	mm->flags = (current->mm) ?
 		(current->mm->flags & MMF_INIT_MASK) : default_dump_filter;
@@ -1085,6 +1088,9 @@ static struct task_struct *copy_process(unsigned long clone_flags,
 	p->default_timer_slack_ns = current->timer_slack_ns;
 
 	task_io_accounting_init(&p->ioac);
+#ifdef CONFIG_RECLAIM_STALL_STATS
+	memset(&p->reclaim_stall_stats, 0, sizeof(p->reclaim_stall_stats));
+#endif
 	acct_clear_integrals(p);
 
 	posix_cpu_timers_init(p);
@@ -262,6 +262,11 @@ struct task_group {
 	struct rt_bandwidth rt_bandwidth;
 #endif
 
+#ifdef CONFIG_SCHED_LAT_HIST
+	/* wakeup latency and runqueue wait, see sched_lat.h */
+	struct sched_lat_hist __percpu *lat_hist;
+#endif
+
 	struct rcu_head rcu;
 	struct list_head list;
 
@@ -1818,6 +1823,103 @@ static const struct sched_class rt_sched_class;
    for (class = sched_class_highest; class; class = class->next)
 
 #include "sched_stats.h"
+#include "sched_lat.h"
+
+#ifdef CONFIG_SCHED_LAT_HIST
+/* Filling in the histograms, see sched_lat.h */
+#ifdef CONFIG_CGROUP_SCHED
+static inline struct sched_lat_hist __percpu *
+tg_sched_lat_hist(struct task_group *tg)
+{
+	/* the root group is the whole system */
+	return tg->parent ? tg->lat_hist : &root_sched_lat_hist;
+}
+
+static int alloc_sched_lat_hist(struct task_group *tg)
+{
+	tg->lat_hist = alloc_percpu(struct sched_lat_hist);
+	return tg->lat_hist != NULL;
+}
+
+static void free_sched_lat_hist(struct task_group *tg)
+{
+	free_percpu(tg->lat_hist);
+}
+#endif /* CONFIG_CGROUP_SCHED */
+
+static void sched_lat_account(struct task_struct *p, int kind, u64 delta)
+{
+	int bucket = sched_lat_bucket(delta);
+#ifdef CONFIG_CGROUP_SCHED
+	struct task_group *tg;
+
+	for (tg = task_group(p); tg->parent; tg = tg->parent) {
+		__this_cpu_inc(tg->lat_hist->count[kind][bucket]);
+		__this_cpu_add(tg->lat_hist->sum[kind], delta);
+	}
+#endif
+	__this_cpu_inc(root_sched_lat_hist.count[kind][bucket]);
+	__this_cpu_add(root_sched_lat_hist.sum[kind], delta);
+}
+
+/*
+ * Called with the runqueue lock held after @p has been woken up or
+ * created and put on @rq.
+ */
+static inline void sched_lat_wakeup(struct rq *rq, struct task_struct *p)
+{
+	p->sched_lat_stamp = rq->clock;
+	p->sched_lat_wait = 0;
+}
+
+/*
+ * Called from schedule() when @next is about to replace @prev on the
+ * cpu.  A @prev that is still queued was preempted and starts waiting.
+ */
+static inline void
+sched_lat_switch(struct rq *rq, struct task_struct *prev,
+		 struct task_struct *next)
+{
+	u64 delta;
+
+	if (prev->se.on_rq && prev != rq->idle) {
+		prev->sched_lat_stamp = rq->clock;
+		prev->sched_lat_wait = 1;
+	}
+
+	if (!next->sched_lat_stamp || next == rq->idle)
+		return;
+
+	/* a migrated task was stamped with another cpu's clock */
+	delta = rq->clock - next->sched_lat_stamp;
+	if ((s64)delta < 0)
+		delta = 0;
+	next->sched_lat_stamp = 0;
+
+	if (next->sched_lat_wait) {
+		sched_lat_account(next, SCHED_LAT_WAIT, delta);
+		trace_sched_wait_latency(next, delta);
+	} else {
+		sched_lat_account(next, SCHED_LAT_WAKEUP, delta);
+		trace_sched_wakeup_latency(next, delta);
+	}
+}
+
+#else /* CONFIG_SCHED_LAT_HIST */
+
+static inline int alloc_sched_lat_hist(struct task_group *tg)
+{
+	return 1;
+}
+
+static inline void free_sched_lat_hist(struct task_group *tg)
+{
+}
+
+#define sched_lat_wakeup(rq, p)			do { } while (0)
+#define sched_lat_switch(rq, prev, next)	do { } while (0)
+
+#endif /* CONFIG_SCHED_LAT_HIST */
 
 static void inc_nr_running(struct rq *rq)
 {
@@ -2360,6 +2462,7 @@ out_activate:
 	else
 		schedstat_inc(p, se.statistics.nr_wakeups_remote);
 	activate_task(rq, p, en_flags);
+	sched_lat_wakeup(rq, p);
 	success = 1;
 
 out_running:
@@ -2546,6 +2649,7 @@ void wake_up_new_task(struct task_struct *p, unsigned long clone_flags)
 
 	rq = task_rq_lock(p, &flags);
 	activate_task(rq, p, 0);
+	sched_lat_wakeup(rq, p);
 	trace_sched_wakeup_new(p, 1);
 	check_preempt_curr(rq, p, WF_FORK);
 #ifdef CONFIG_SMP
@@ -3620,6 +3724,7 @@ need_resched_nonpreemptible:
 
 	if (likely(prev != next)) {
 		sched_info_switch(prev, next);
+		sched_lat_switch(rq, prev, next);
 		perf_event_task_sched_out(prev, next);
 
 		rq->nr_switches++;
@@ -8010,6 +8115,7 @@ static void free_sched_group(struct task_group *tg)
 {
 	free_fair_sched_group(tg);
 	free_rt_sched_group(tg);
+	free_sched_lat_hist(tg);
 	kfree(tg);
 }
 
@@ -8030,6 +8136,9 @@ struct task_group *sched_create_group(struct task_group *parent)
 	if (!alloc_rt_sched_group(tg, parent))
 		goto err;
 
+	if (!alloc_sched_lat_hist(tg))
+		goto err;
+
 	spin_lock_irqsave(&task_group_lock, flags);
 	for_each_possible_cpu(i) {
 		register_fair_sched_group(tg, i);
@@ -8617,6 +8726,21 @@ static u64 cpu_rt_period_read_uint(struct cgroup *cgrp, struct cftype *cft)
 }
 #endif /* CONFIG_RT_GROUP_SCHED */
 
+#ifdef CONFIG_SCHED_LAT_HIST
+static int cpu_latency_hist_read(struct cgroup *cgrp, struct cftype *cft,
+				 struct seq_file *m)
+{
+	sched_lat_show(m, tg_sched_lat_hist(cgroup_tg(cgrp)));
+	return 0;
+}
+
+static int cpu_latency_hist_reset(struct cgroup *cgrp, unsigned int event)
+{
+	sched_lat_reset(tg_sched_lat_hist(cgroup_tg(cgrp)));
+	return 0;
+}
+#endif /* CONFIG_SCHED_LAT_HIST */
+
 static struct cftype cpu_files[] = {
 #ifdef CONFIG_FAIR_GROUP_SCHED
 	{
@@ -8637,6 +8761,13 @@ static struct cftype cpu_files[] = {
 		.write_u64 = cpu_rt_period_write_uint,
 	},
 #endif
+#ifdef CONFIG_SCHED_LAT_HIST
+	{
+		.name = "latency_hist",
+		.read_seq_string = cpu_latency_hist_read,
+		.trigger = cpu_latency_hist_reset,
+	},
+#endif
 };
 
 static int cpu_cgroup_populate(struct cgroup_subsys *ss, struct cgroup *cont)
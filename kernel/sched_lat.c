@@ -0,0 +1,96 @@
+/*
+ * kernel/sched_lat.c
+ *
+ * Wakeup latency and runqueue wait histograms: the system wide ones and
+ * their /proc/schedlat file, and the formatting shared with the
+ * cpu.latency_hist file of the cpu cgroups.  The histograms are filled
+ * in by schedule(), see kernel/sched.c.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/fs.h>
+#include <linux/percpu.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/string.h>
+#include <linux/time.h>
+
+#include "sched_lat.h"
+
+DEFINE_PER_CPU(struct sched_lat_hist, root_sched_lat_hist);
+
+/*
+ * One line per bucket, "<lower bound in us> <wakeups> <waits>", then
+ * the total latency of each in ns.
+ */
+void sched_lat_show(struct seq_file *m, struct sched_lat_hist __percpu *hist)
+{
+	u64 count[SCHED_LAT_NR][SCHED_LAT_BUCKETS] = { };
+	u64 sum[SCHED_LAT_NR] = { };
+	int cpu, kind, i;
+
+	for_each_possible_cpu(cpu) {
+		struct sched_lat_hist *h = per_cpu_ptr(hist, cpu);
+
+		for (kind = 0; kind < SCHED_LAT_NR; kind++) {
+			for (i = 0; i < SCHED_LAT_BUCKETS; i++)
+				count[kind][i] += h->count[kind][i];
+			sum[kind] += h->sum[kind];
+		}
+	}
+
+	seq_printf(m, "# usecs wakeup wait\n");
+	for (i = 0; i < SCHED_LAT_BUCKETS; i++)
+		seq_printf(m, "%lu %llu %llu\n",
+			   i == SCHED_LAT_BUCKETS - 1 ? USEC_PER_SEC :
+			   i ? 1UL << (i - 1) : 0,
+			   (unsigned long long)count[SCHED_LAT_WAKEUP][i],
+			   (unsigned long long)count[SCHED_LAT_WAIT][i]);
+	seq_printf(m, "sum_ns %llu %llu\n",
+		   (unsigned long long)sum[SCHED_LAT_WAKEUP],
+		   (unsigned long long)sum[SCHED_LAT_WAIT]);
+}
+
+void sched_lat_reset(struct sched_lat_hist __percpu *hist)
+{
+	int cpu;
+
+	/* racy against concurrent updates, which is fine for statistics */
+	for_each_possible_cpu(cpu)
+		memset(per_cpu_ptr(hist, cpu), 0, sizeof(struct sched_lat_hist));
+}
+
+static int schedlat_show(struct seq_file *m, void *v)
+{
+	sched_lat_show(m, &root_sched_lat_hist);
+	return 0;
+}
+
+static int schedlat_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, schedlat_show, NULL);
+}
+
+static ssize_t schedlat_write(struct file *file, const char __user *buf,
+			      size_t count, loff_t *ppos)
+{
+	sched_lat_reset(&root_sched_lat_hist);
+	return count;
+}
+
+static const struct file_operations proc_schedlat_operations = {
+	.open    = schedlat_open,
+	.read    = seq_read,
+	.write   = schedlat_write,
+	.llseek  = seq_lseek,
+	.release = single_release,
+};
+
+static int __init proc_schedlat_init(void)
+{
+	proc_create("schedlat", S_IWUSR | S_IRUGO, NULL,
+		    &proc_schedlat_operations);
+	return 0;
+}
+module_init(proc_schedlat_init);
@@ -0,0 +1,47 @@
+#ifndef _KERNEL_SCHED_LAT_H
+#define _KERNEL_SCHED_LAT_H
+
+/*
+ * Wakeup latency and runqueue wait histograms.
+ *
+ * A task is stamped with the runqueue clock when it is woken up, and
+ * again when it is preempted while still runnable.  When it next gets
+ * the cpu the time since the stamp goes into a log2 histogram of
+ * microseconds, for its task group, every parent group and the whole
+ * system.  The counters are per cpu and only touched under the
+ * runqueue lock of the cpu doing the switch, so there is no shared
+ * cacheline on the context switch path.
+ */
+#define SCHED_LAT_BUCKETS	22	/* the last one is 1s and above */
+
+enum {
+	SCHED_LAT_WAKEUP,	/* woken up to running */
+	SCHED_LAT_WAIT,		/* preempted to running again */
+	SCHED_LAT_NR
+};
+
+struct sched_lat_hist {
+	u64 count[SCHED_LAT_NR][SCHED_LAT_BUCKETS];
+	u64 sum[SCHED_LAT_NR];			/* in ns */
+};
+
+/* the whole system, also the root task group */
+DECLARE_PER_CPU(struct sched_lat_hist, root_sched_lat_hist);
+
+static inline int sched_lat_bucket(u64 delta)
+{
+	unsigned long usecs;
+
+	if (delta >= (u64)NSEC_PER_SEC)
+		return SCHED_LAT_BUCKETS - 1;
+	usecs = (unsigned long)delta / NSEC_PER_USEC;
+	return min(fls(usecs), SCHED_LAT_BUCKETS - 1);
+}
+
+struct seq_file;
+
+extern void sched_lat_show(struct seq_file *m,
+			   struct sched_lat_hist __percpu *hist);
+extern void sched_lat_reset(struct sched_lat_hist __percpu *hist);
+
+#endif /* _KERNEL_SCHED_LAT_H */
@@ -267,6 +267,7 @@ static int max_sched_shares_ratelimit = NSEC_PER_SEC; /* 1 second */
 #ifdef CONFIG_COMPACTION
 static int min_extfrag_threshold;
 static int max_extfrag_threshold = 1000;
+static int max_compact_daemon_order = MAX_ORDER - 1;
 #endif
 
 static struct ctl_table kern_table[] = {
@@ -1145,6 +1146,23 @@ static struct ctl_table vm_table[] = {
 		.extra1		= &min_extfrag_threshold,
 		.extra2		= &max_extfrag_threshold,
 	},
+	{
+		.procname	= "compact_daemon_order",
+		.data		= &sysctl_compact_daemon_order,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &one,
+		.extra2		= &max_compact_daemon_order,
+	},
+	{
+		.procname	= "compact_daemon_blocks",
+		.data		= &sysctl_compact_daemon_blocks,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &zero,
+	},
 
 #endif /* CONFIG_COMPACTION */
 	{
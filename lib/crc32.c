@@ -16,6 +16,12 @@
  *   fs/jffs2 uses seed 0, doesn't xor with ~0.
  *   fs/partitions/efi.c uses seed ~0, xor's with ~0.
  *
+ * The table-driven code processes eight bytes per iteration using eight
+ * 256-entry tables ("slice-by-8", see Kounavis and Berry, "A Systematic
+ * Approach to Building High Performance, Software-based, CRC Generators").
+ * The same body also computes the Castagnoli CRC32c used by ext4, jbd2
+ * and iSCSI, so crypto/crc32c.c no longer carries its own table.
+ *
  * This source code is licensed under the GNU General Public License,
  * Version 2.  See the file COPYING for more details.
  */
@@ -28,13 +34,13 @@
 #include <linux/init.h>
 #include <asm/atomic.h>
 #include "crc32defs.h"
-#if CRC_LE_BITS == 8
+#if CRC_LE_BITS >= 8
 # define tole(x) __constant_cpu_to_le32(x)
 #else
 # define tole(x) (x)
 #endif
 
-#if CRC_BE_BITS == 8
+#if CRC_BE_BITS >= 8
 # define tobe(x) __constant_cpu_to_be32(x)
 #else
 # define tobe(x) (x)
@@ -42,29 +48,45 @@
 #include "crc32table.h"
 
 MODULE_AUTHOR("Matt Domsch <Matt_Domsch@dell.com>");
-MODULE_DESCRIPTION("Ethernet CRC32 calculations");
+MODULE_DESCRIPTION("Various CRC32 calculations");
 MODULE_LICENSE("GPL");
 
-#if CRC_LE_BITS == 8 || CRC_BE_BITS == 8
+#if CRC_LE_BITS > 4 || CRC_BE_BITS > 4
 
+/*
+ * @rows is the number of tables in @tab: 4 for slice-by-4, 8 for
+ * slice-by-8.  It is always a compile-time constant, so the unused
+ * branch disappears once this is inlined.
+ */
 static inline u32
-crc32_body(u32 crc, unsigned char const *buf, size_t len, const u32 (*tab)[256])
+crc32_body(u32 crc, unsigned char const *buf, size_t len,
+	   const u32 (*tab)[256], const int rows)
 {
 # ifdef __LITTLE_ENDIAN
-#  define DO_CRC(x) crc = tab[0][(crc ^ (x)) & 255] ^ (crc >> 8)
-#  define DO_CRC4 crc = tab[3][(crc) & 255] ^ \
-		tab[2][(crc >> 8) & 255] ^ \
-		tab[1][(crc >> 16) & 255] ^ \
-		tab[0][(crc >> 24) & 255]
+#  define DO_CRC(x) crc = t0[(crc ^ (x)) & 255] ^ (crc >> 8)
+#  define DO_CRC4 (t3[(q) & 255] ^ t2[(q >> 8) & 255] ^ \
+		   t1[(q >> 16) & 255] ^ t0[(q >> 24) & 255])
+#  define DO_CRC8 (t7[(q) & 255] ^ t6[(q >> 8) & 255] ^ \
+		   t5[(q >> 16) & 255] ^ t4[(q >> 24) & 255])
 # else
-#  define DO_CRC(x) crc = tab[0][((crc >> 24) ^ (x)) & 255] ^ (crc << 8)
-#  define DO_CRC4 crc = tab[0][(crc) & 255] ^ \
-		tab[1][(crc >> 8) & 255] ^ \
-		tab[2][(crc >> 16) & 255] ^ \
-		tab[3][(crc >> 24) & 255]
+#  define DO_CRC(x) crc = t0[((crc >> 24) ^ (x)) & 255] ^ (crc << 8)
+#  define DO_CRC4 (t0[(q) & 255] ^ t1[(q >> 8) & 255] ^ \
+		   t2[(q >> 16) & 255] ^ t3[(q >> 24) & 255])
+#  define DO_CRC8 (t4[(q) & 255] ^ t5[(q >> 8) & 255] ^ \
+		   t6[(q >> 16) & 255] ^ t7[(q >> 24) & 255])
 # endif
+	const u32 *t0 = tab[0], *t1 = tab[1], *t2 = tab[2], *t3 = tab[3];
+	const u32 *t4 = NULL, *t5 = NULL, *t6 = NULL, *t7 = NULL;
 	const u32 *b;
 	size_t    rem_len;
+	u32 q;
+
+	if (rows == 8) {
+		t4 = tab[4];
+		t5 = tab[5];
+		t6 = tab[6];
+		t7 = tab[7];
+	}
 
 	/* Align it */
 	if (unlikely((long)buf & 3 && len)) {
@@ -72,13 +94,25 @@ crc32_body(u32 crc, unsigned char const *buf, size_t len, const u32 (*tab)[256])
 			DO_CRC(*buf++);
 		} while ((--len) && ((long)buf)&3);
 	}
-	rem_len = len & 3;
+
+	if (rows == 8) {
+		rem_len = len & 7;
+		len = len >> 3;
+	} else {
+		rem_len = len & 3;
+		len = len >> 2;
+	}
 	/* load data 32 bits wide, xor data 32 bits wide. */
-	len = len >> 2;
 	b = (const u32 *)buf;
 	for (--b; len; --len) {
-		crc ^= *++b; /* use pre increment for speed */
-		DO_CRC4;
+		q = crc ^ *++b; /* use pre increment for speed */
+		if (rows == 8) {
+			crc = DO_CRC8;
+			q = *++b;
+			crc ^= DO_CRC4;
+		} else {
+			crc = DO_CRC4;
+		}
 	}
 	len = rem_len;
 	/* And the last few bytes */
@@ -91,80 +125,101 @@ crc32_body(u32 crc, unsigned char const *buf, size_t len, const u32 (*tab)[256])
 	return crc;
 #undef DO_CRC
 #undef DO_CRC4
+#undef DO_CRC8
 }
 #endif
+
 /**
- * crc32_le() - Calculate bitwise little-endian Ethernet AUTODIN II CRC32
- * @crc: seed value for computation.  ~0 for Ethernet, sometimes 0 for
- *	other uses, or the previous crc32 value if computing incrementally.
+ * crc32_le_generic() - Calculate bitwise little-endian CRC32
+ * @crc: seed value for computation
  * @p: pointer to buffer over which CRC is run
  * @len: length of buffer @p
+ * @tab: little-endian table set for @polynomial, unused if CRC_LE_BITS == 1
+ * @polynomial: bit-reversed CRC polynomial
  */
-u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len);
-
-#if CRC_LE_BITS == 1
-/*
- * In fact, the table-based code will work in this case, but it can be
- * simplified by inlining the table in ?: form.
- */
-
-u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len)
+static inline u32 __pure
+crc32_le_generic(u32 crc, unsigned char const *p, size_t len,
+		 const u32 (*tab)[256], u32 polynomial)
 {
+#if CRC_LE_BITS == 1
 	int i;
 	while (len--) {
 		crc ^= *p++;
 		for (i = 0; i < 8; i++)
-			crc = (crc >> 1) ^ ((crc & 1) ? CRCPOLY_LE : 0);
+			crc = (crc >> 1) ^ ((crc & 1) ? polynomial : 0);
 	}
-	return crc;
-}
-#else				/* Table-based approach */
-
-u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len)
-{
-# if CRC_LE_BITS == 8
-	const u32      (*tab)[] = crc32table_le;
-
-	crc = __cpu_to_le32(crc);
-	crc = crc32_body(crc, p, len, tab);
-	return __le32_to_cpu(crc);
-# elif CRC_LE_BITS == 4
+#elif CRC_LE_BITS == 2
 	while (len--) {
 		crc ^= *p++;
-		crc = (crc >> 4) ^ crc32table_le[crc & 15];
-		crc = (crc >> 4) ^ crc32table_le[crc & 15];
+		crc = (crc >> 2) ^ tab[0][crc & 3];
+		crc = (crc >> 2) ^ tab[0][crc & 3];
+		crc = (crc >> 2) ^ tab[0][crc & 3];
+		crc = (crc >> 2) ^ tab[0][crc & 3];
 	}
-	return crc;
-# elif CRC_LE_BITS == 2
+#elif CRC_LE_BITS == 4
 	while (len--) {
 		crc ^= *p++;
-		crc = (crc >> 2) ^ crc32table_le[crc & 3];
-		crc = (crc >> 2) ^ crc32table_le[crc & 3];
-		crc = (crc >> 2) ^ crc32table_le[crc & 3];
-		crc = (crc >> 2) ^ crc32table_le[crc & 3];
+		crc = (crc >> 4) ^ tab[0][crc & 15];
+		crc = (crc >> 4) ^ tab[0][crc & 15];
 	}
+#else
+	crc = __cpu_to_le32(crc);
+	crc = crc32_body(crc, p, len, tab, CRC_LE_ROWS);
+	crc = __le32_to_cpu(crc);
+#endif
 	return crc;
-# endif
 }
-#endif
 
 /**
- * crc32_be() - Calculate bitwise big-endian Ethernet AUTODIN II CRC32
+ * crc32_le() - Calculate bitwise little-endian Ethernet AUTODIN II CRC32
  * @crc: seed value for computation.  ~0 for Ethernet, sometimes 0 for
  *	other uses, or the previous crc32 value if computing incrementally.
  * @p: pointer to buffer over which CRC is run
  * @len: length of buffer @p
  */
-u32 __pure crc32_be(u32 crc, unsigned char const *p, size_t len);
+#if CRC_LE_BITS == 1
+u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len)
+{
+	return crc32_le_generic(crc, p, len, NULL, CRCPOLY_LE);
+}
 
-#if CRC_BE_BITS == 1
-/*
- * In fact, the table-based code will work in this case, but it can be
- * simplified by inlining the table in ?: form.
+/**
+ * __crc32c_le() - Calculate bitwise little-endian Castagnoli CRC32c
+ * @crc: seed value for computation, or the previous crc32c value if
+ *	computing incrementally.  Callers do their own pre/post inversion.
+ * @p: pointer to buffer over which CRC is run
+ * @len: length of buffer @p
  */
+u32 __pure __crc32c_le(u32 crc, unsigned char const *p, size_t len)
+{
+	return crc32_le_generic(crc, p, len, NULL, CRC32C_POLY_LE);
+}
+#else
+u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len)
+{
+	return crc32_le_generic(crc, p, len,
+			(const u32 (*)[256])crc32table_le, CRCPOLY_LE);
+}
 
+u32 __pure __crc32c_le(u32 crc, unsigned char const *p, size_t len)
+{
+	return crc32_le_generic(crc, p, len,
+			(const u32 (*)[256])crc32ctable_le, CRC32C_POLY_LE);
+}
+#endif
+EXPORT_SYMBOL(crc32_le);
+EXPORT_SYMBOL(__crc32c_le);
+
+/**
+ * crc32_be() - Calculate bitwise big-endian Ethernet AUTODIN II CRC32
+ * @crc: seed value for computation.  ~0 for Ethernet, sometimes 0 for
+ *	other uses, or the previous crc32 value if computing incrementally.
+ * @p: pointer to buffer over which CRC is run
+ * @len: length of buffer @p
+ */
 u32 __pure crc32_be(u32 crc, unsigned char const *p, size_t len)
 {
+#if CRC_BE_BITS == 1
 	int i;
 	while (len--) {
 		crc ^= *p++ << 24;
@@ -173,39 +228,28 @@ u32 __pure crc32_be(u32 crc, unsigned char const *p, size_t len)
 			    (crc << 1) ^ ((crc & 0x80000000) ? CRCPOLY_BE :
 					  0);
 	}
-	return crc;
-}
-
-#else				/* Table-based approach */
-u32 __pure crc32_be(u32 crc, unsigned char const *p, size_t len)
-{
-# if CRC_BE_BITS == 8
-	const u32      (*tab)[] = crc32table_be;
-
-	crc = __cpu_to_be32(crc);
-	crc = crc32_body(crc, p, len, tab);
-	return __be32_to_cpu(crc);
-# elif CRC_BE_BITS == 4
+#elif CRC_BE_BITS == 2
 	while (len--) {
 		crc ^= *p++ << 24;
-		crc = (crc << 4) ^ crc32table_be[crc >> 28];
-		crc = (crc << 4) ^ crc32table_be[crc >> 28];
+		crc = (crc << 2) ^ crc32table_be[0][crc >> 30];
+		crc = (crc << 2) ^ crc32table_be[0][crc >> 30];
+		crc = (crc << 2) ^ crc32table_be[0][crc >> 30];
+		crc = (crc << 2) ^ crc32table_be[0][crc >> 30];
 	}
-	return crc;
-# elif CRC_BE_BITS == 2
+#elif CRC_BE_BITS == 4
 	while (len--) {
 		crc ^= *p++ << 24;
-		crc = (crc << 2) ^ crc32table_be[crc >> 30];
-		crc = (crc << 2) ^ crc32table_be[crc >> 30];
-		crc = (crc << 2) ^ crc32table_be[crc >> 30];
-		crc = (crc << 2) ^ crc32table_be[crc >> 30];
+		crc = (crc << 4) ^ crc32table_be[0][crc >> 28];
+		crc = (crc << 4) ^ crc32table_be[0][crc >> 28];
 	}
+#else
+	crc = __cpu_to_be32(crc);
+	crc = crc32_body(crc, p, len,
+			 (const u32 (*)[256])crc32table_be, CRC_BE_ROWS);
+	crc = __be32_to_cpu(crc);
+#endif
 	return crc;
-# endif
 }
-#endif
-
-EXPORT_SYMBOL(crc32_le);
 EXPORT_SYMBOL(crc32_be);
 
 /*
@@ -469,3 +513,153 @@ int main(void)
 }
 
 #endif				/* UNITTEST */
+
+#ifdef CONFIG_CRC32_SELFTEST
+
+#include <linux/slab.h>
+#include <linux/hrtimer.h>
+
+#define CRC32_TEST_LEN		4096
+#define CRC32_TEST_LOOPS	256
+
+/*
+ * Known answers for the ASCII string "123456789", with the usual ~0
+ * seed and final inversion.
+ */
+static const unsigned char crc32_check_str[] = "123456789";
+#define CRC32_CHECK_LE		0xcbf43926
+#define CRC32_CHECK_BE		0xfc891918
+#define CRC32C_CHECK_LE		0xe3069283
+
+static u32 crc32_test_sink __initdata;
+
+static u32 __init crc32_le_bitwise(u32 crc, unsigned char const *p,
+				   size_t len, u32 polynomial)
+{
+	int i;
+
+	while (len--) {
+		crc ^= *p++;
+		for (i = 0; i < 8; i++)
+			crc = (crc >> 1) ^ ((crc & 1) ? polynomial : 0);
+	}
+	return crc;
+}
+
+static u32 __init crc32_be_bitwise(u32 crc, unsigned char const *p,
+				   size_t len)
+{
+	int i;
+
+	while (len--) {
+		crc ^= *p++ << 24;
+		for (i = 0; i < 8; i++)
+			crc = (crc << 1) ^
+			      ((crc & 0x80000000) ? CRCPOLY_BE : 0);
+	}
+	return crc;
+}
+
+static int __init crc32_check_known(void)
+{
+	size_t len = sizeof(crc32_check_str) - 1;
+	int errors = 0;
+
+	if ((crc32_le(~0, crc32_check_str, len) ^ ~0) != CRC32_CHECK_LE)
+		errors++;
+	if ((crc32_be(~0, crc32_check_str, len) ^ ~0) != CRC32_CHECK_BE)
+		errors++;
+	if ((__crc32c_le(~0, crc32_check_str, len) ^ ~0) != CRC32C_CHECK_LE)
+		errors++;
+	return errors;
+}
+
+/*
+ * Compare the table-driven code against the bitwise definition for
+ * every alignment and a spread of lengths, including the splits that
+ * exercise the head/body/tail handling of crc32_body().
+ */
+static int __init crc32_check_random(const u8 *buf)
+{
+	size_t off, len;
+	int errors = 0;
+	u32 seed;
+
+	for (off = 0; off < 8; off++) {
+		for (len = 0; len < 512; len += (len < 64) ? 1 : 37) {
+			seed = len * 0x9e3779b9 + off;
+			if (crc32_le(seed, buf + off, len) !=
+			    crc32_le_bitwise(seed, buf + off, len, CRCPOLY_LE))
+				errors++;
+			if (__crc32c_le(seed, buf + off, len) !=
+			    crc32_le_bitwise(seed, buf + off, len,
+					     CRC32C_POLY_LE))
+				errors++;
+			if (crc32_be(seed, buf + off, len) !=
+			    crc32_be_bitwise(seed, buf + off, len))
+				errors++;
+		}
+	}
+	return errors;
+}
+
+static u64 __init crc32_time(u32 (*fn)(u32, unsigned char const *, size_t),
+			     const u8 *buf)
+{
+	ktime_t start;
+	u32 crc = 0;
+	int i;
+
+	start = ktime_get();
+	for (i = 0; i < CRC32_TEST_LOOPS; i++)
+		crc = fn(crc, buf, CRC32_TEST_LEN);
+	/* keep the loop from being optimised away */
+	crc32_test_sink = crc;
+	return ktime_to_ns(ktime_sub(ktime_get(), start));
+}
+
+static void __init crc32_report(const char *name, u64 nsec)
+{
+	u64 bytes = (u64)CRC32_TEST_LEN * CRC32_TEST_LOOPS * 1000;
+
+	/* bytes per microsecond is MB/s */
+	if (!nsec)
+		nsec = 1;
+	do_div(bytes, nsec);
+	pr_info("crc32: %s: %llu bytes in %llu nsec (%llu MB/s)\n", name,
+		(unsigned long long)CRC32_TEST_LEN * CRC32_TEST_LOOPS,
+		(unsigned long long)nsec, (unsigned long long)bytes);
+}
+
+static int __init crc32test_init(void)
+{
+	u32 state = 0x2545f491;
+	int errors;
+	u8 *buf;
+	int i;
+
+	buf = kmalloc(CRC32_TEST_LEN + 8, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+	for (i = 0; i < CRC32_TEST_LEN + 8; i++) {
+		state = state * 1103515245 + 12345;
+		buf[i] = state >> 16;
+	}
+
+	errors = crc32_check_known() + crc32_check_random(buf);
+	if (errors)
+		pr_warning("crc32: self tests failed (%d errors)\n", errors);
+	else
+		pr_info("crc32: self tests passed, CRC_LE_BITS=%d "
+			"CRC_BE_BITS=%d\n", CRC_LE_BITS, CRC_BE_BITS);
+
+	crc32_report("crc32_le", crc32_time(crc32_le, buf));
+	crc32_report("crc32_be", crc32_time(crc32_be, buf));
+	crc32_report("crc32c_le", crc32_time(__crc32c_le, buf));
+
+	kfree(buf);
+	return 0;
+}
+
+module_init(crc32test_init);
+#endif				/* CONFIG_CRC32_SELFTEST */
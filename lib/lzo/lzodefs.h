@@ -41,3 +41,23 @@
 #define DX2(p, s1, s2)	(((((size_t)((p)[2]) << (s2)) ^ (p)[1]) \
 							<< (s1)) ^ (p)[0])
 #define DX3(p, s1, s2, s3)	((DX2((p)+1, s2, s3) << (s1)) ^ (p)[0])
+
+/*
+ * Word-at-a-time copies in the decompressor, see <linux/unaligned/word32.h>.
+ * When those are cheap the decompressor copies literal runs and matches in
+ * 8-byte steps and may write up to 7 bytes past the end of a run, but never
+ * past the end of the output buffer, so input and output must not overlap.
+ */
+#include <linux/unaligned/word32.h>
+
+#ifdef HAVE_FAST_UNALIGNED_WORD32
+#define LZO_FAST_COPY
+#endif
+
+#define COPY4(dst, src)							\
+	put_unaligned_word32(dst, get_unaligned_word32(src))
+#define COPY8(dst, src)							\
+	do {								\
+		COPY4(dst, src);					\
+		COPY4((dst) + 4, (src) + 4);				\
+	} while (0)
@@ -0,0 +1,193 @@
+/*
+ * Roundtrip, fuzz and speed tests for the LZO1X compressor/decompressor
+ *
+ * Every buffer is compressed with lzo1x_1_compress() and decompressed
+ * again.  The compressed stream is then corrupted and truncated at
+ * random and fed back to lzo1x_decompress_safe(), which must fail
+ * cleanly and must not write outside the output buffer it was given.
+ * Finally the decompression throughput of each corpus is reported.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/lzo.h>
+#include <linux/random.h>
+#include <linux/sched.h>
+#include <linux/vmalloc.h>
+#include <linux/hrtimer.h>
+
+#define LZO_TEST_MAX		(64 * 1024)
+#define LZO_TEST_GUARD		64
+#define LZO_TEST_ROUNDS		2000
+#define LZO_TEST_BENCH_LOOPS	64
+
+static unsigned int rounds = LZO_TEST_ROUNDS;
+module_param(rounds, uint, 0);
+MODULE_PARM_DESC(rounds, "Number of roundtrip/fuzz iterations");
+
+enum {
+	CORPUS_RANDOM,
+	CORPUS_ZERO,
+	CORPUS_TEXT,
+	CORPUS_MATCHES,
+	CORPUS_RUNS,
+	NR_CORPUS
+};
+
+static const char * const corpus_name[NR_CORPUS] = {
+	"random", "zero", "text", "matches", "runs",
+};
+
+static void __init lzo_test_fill(u8 *buf, size_t len, int kind)
+{
+	static const char words[] = "the quick brown fox jumps over ";
+	size_t i, back;
+
+	for (i = 0; i < len; i++) {
+		switch (kind) {
+		case CORPUS_RANDOM:
+			buf[i] = random32();
+			break;
+		case CORPUS_ZERO:
+			buf[i] = 0;
+			break;
+		case CORPUS_TEXT:
+			buf[i] = words[random32() % (sizeof(words) - 1)];
+			break;
+		case CORPUS_MATCHES:
+			/* short and long distance back-references */
+			back = 1 + random32() % min_t(size_t, i ? i : 1, 49151);
+			buf[i] = (i && random32() % 4) ? buf[i - back] :
+				 random32();
+			break;
+		case CORPUS_RUNS:
+			buf[i] = (i / (1 + random32() % 3)) & 7;
+			break;
+		}
+	}
+}
+
+static int __init lzo_test_one(u8 *src, size_t len, u8 *cbuf, u8 *dbuf,
+			       void *wrkmem)
+{
+	size_t clen, dlen, olen, ilen, i;
+	int ret, flips;
+
+	ret = lzo1x_1_compress(src, len, cbuf, &clen, wrkmem);
+	if (ret != LZO_E_OK) {
+		pr_err("lzo_test: compress failed (%d) len %zu\n", ret, len);
+		return 1;
+	}
+
+	dlen = len;
+	ret = lzo1x_decompress_safe(cbuf, clen, dbuf, &dlen);
+	if (ret != LZO_E_OK || dlen != len || memcmp(src, dbuf, len)) {
+		pr_err("lzo_test: roundtrip failed (%d) len %zu/%zu\n",
+		       ret, dlen, len);
+		return 1;
+	}
+
+	/* corrupt, truncate, shrink the output and look for overruns */
+	for (flips = 1 + random32() % 4; flips && clen; flips--)
+		cbuf[random32() % clen] ^= 1 << (random32() % 8);
+	ilen = (random32() % 4) ? clen : random32() % (clen + 1);
+	olen = (random32() % 2) ? len : random32() % (len + 1);
+
+	memset(dbuf, 0xa5, olen + LZO_TEST_GUARD);
+	dlen = olen;
+	lzo1x_decompress_safe(cbuf, ilen, dbuf, &dlen);
+	if (dlen > olen) {
+		pr_err("lzo_test: reported %zu bytes for a %zu byte buffer\n",
+		       dlen, olen);
+		return 1;
+	}
+	for (i = olen; i < olen + LZO_TEST_GUARD; i++) {
+		if (dbuf[i] != 0xa5) {
+			pr_err("lzo_test: output overrun at %zu/%zu\n",
+			       i, olen);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static void __init lzo_test_bench(u8 *src, u8 *cbuf, u8 *dbuf, void *wrkmem)
+{
+	size_t clen, dlen;
+	ktime_t start;
+	u64 nsec, bytes;
+	int kind, i;
+
+	for (kind = 0; kind < NR_CORPUS; kind++) {
+		lzo_test_fill(src, LZO_TEST_MAX, kind);
+		lzo1x_1_compress(src, LZO_TEST_MAX, cbuf, &clen, wrkmem);
+
+		start = ktime_get();
+		for (i = 0; i < LZO_TEST_BENCH_LOOPS; i++) {
+			dlen = LZO_TEST_MAX;
+			lzo1x_decompress_safe(cbuf, clen, dbuf, &dlen);
+		}
+		nsec = ktime_to_ns(ktime_sub(ktime_get(), start)) ?: 1;
+
+		bytes = (u64)LZO_TEST_MAX * LZO_TEST_BENCH_LOOPS * 1000;
+		do_div(bytes, nsec);
+		pr_info("lzo_test: %-8s %6zu -> %6u bytes, decompress %llu MB/s\n",
+			corpus_name[kind], clen, LZO_TEST_MAX,
+			(unsigned long long)bytes);
+	}
+}
+
+static int __init lzo_test_init(void)
+{
+	u8 *src, *cbuf, *dbuf;
+	void *wrkmem;
+	unsigned int i;
+	int errors = 0;
+
+	src = vmalloc(LZO_TEST_MAX);
+	cbuf = vmalloc(lzo1x_worst_compress(LZO_TEST_MAX));
+	dbuf = vmalloc(LZO_TEST_MAX + LZO_TEST_GUARD);
+	wrkmem = vmalloc(LZO1X_MEM_COMPRESS);
+	if (!src || !cbuf || !dbuf || !wrkmem) {
+		errors = -ENOMEM;
+		goto out;
+	}
+
+	for (i = 0; i < rounds; i++) {
+		/* many tiny buffers first, they hit all the edge cases */
+		size_t len = i < 512 ? i : random32() % LZO_TEST_MAX;
+
+		lzo_test_fill(src, len, i % NR_CORPUS);
+		errors += lzo_test_one(src, len, cbuf, dbuf, wrkmem);
+		if (errors > 10)
+			break;
+		cond_resched();
+	}
+
+	if (errors)
+		pr_err("lzo_test: %d failures in %u rounds\n", errors, i);
+	else
+		pr_info("lzo_test: %u roundtrip/fuzz rounds passed\n", rounds);
+
+	lzo_test_bench(src, cbuf, dbuf, wrkmem);
+out:
+	vfree(wrkmem);
+	vfree(dbuf);
+	vfree(cbuf);
+	vfree(src);
+	return errors < 0 ? errors : 0;
+}
+
+static void __exit lzo_test_exit(void)
+{
+}
+
+module_init(lzo_test_init);
+module_exit(lzo_test_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("LZO1X roundtrip, fuzz and speed tests");
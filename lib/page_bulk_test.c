@@ -0,0 +1,428 @@
+/*
+ * Tests and speed test of alloc_pages_bulk() and free_pages_bulk()
+ *
+ * alloc_pages_bulk() takes the pages off the buddy lists PAGES_BULK_BATCH
+ * at a time, after the cleared pages of the per-cpu zeroed cache for a
+ * __GFP_ZERO request, and gets the rest from alloc_page().  Requests of
+ * sizes around the batch are made with lowmem, highmem, movable and
+ * __GFP_ZERO flags.  Every page handed out must be distinct, in a zone the
+ * flags allow, look like a freshly allocated page (one reference, no
+ * mapping, no buddy or LRU flag, no private data) and be cleared if asked
+ * for.  The pages are dirtied before they are freed, so that a cleared
+ * page the allocator did not really clear shows up in a later round.
+ *
+ * free_pages_bulk() must drop exactly one reference, leaving pages that
+ * still have another user alone.  With CONFIG_ZEROED_PAGE_CACHE, pages of
+ * the zeroed cache come from unmovable pageblocks and must only be handed
+ * to MIGRATE_UNMOVABLE requests.
+ *
+ * Once the checks pass, 1 to max_mb MB worth of order-0 pages are
+ * allocated and freed, first one at a time with alloc_page() and
+ * __free_page() the way buffer pools do, then in bulk, for each of the
+ * same flags, and the cost per page of each is reported.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/gfp.h>
+#include <linux/mm.h>
+#include <linux/mmzone.h>
+#include <linux/highmem.h>
+#include <linux/sched.h>
+#include <linux/sort.h>
+#include <linux/vmalloc.h>
+#include <linux/hrtimer.h>
+
+#define PAGE_BULK_TEST_MAX_MB	16
+#define PAGE_BULK_TEST_LOOPS	8
+
+static unsigned int max_mb = PAGE_BULK_TEST_MAX_MB;
+module_param(max_mb, uint, 0);
+MODULE_PARM_DESC(max_mb, "Largest allocation to time, in MB, 0 to skip");
+
+static unsigned int loops = PAGE_BULK_TEST_LOOPS;
+module_param(loops, uint, 0);
+MODULE_PARM_DESC(loops, "Allocate and free cycles per size");
+
+static const unsigned long page_bulk_sizes[] __initconst = {
+	0, 1, 2, 31, PAGES_BULK_BATCH - 1, PAGES_BULK_BATCH,
+	PAGES_BULK_BATCH + 1, 3 * PAGES_BULK_BATCH + 7,
+};
+
+static const struct {
+	const char *name;
+	gfp_t gfp;
+} page_bulk_kinds[] __initconst = {
+	{ "kernel",		GFP_KERNEL },
+	{ "kernel zero",	GFP_KERNEL | __GFP_ZERO },
+	{ "highuser",		GFP_HIGHUSER },
+	{ "movable zero",	GFP_HIGHUSER_MOVABLE | __GFP_ZERO },
+};
+
+#define PAGE_BULK_MAX		(3 * PAGES_BULK_BATCH + 7)
+
+static int __init page_bulk_cleared(struct page *page)
+{
+	unsigned long *p = kmap(page);
+	int i, ret = 1;
+
+	for (i = 0; i < PAGE_SIZE / sizeof(*p); i++) {
+		if (p[i]) {
+			ret = 0;
+			break;
+		}
+	}
+	kunmap(page);
+	return ret;
+}
+
+static void __init page_bulk_dirty(struct page *page)
+{
+	memset(kmap(page), 0x5a, PAGE_SIZE);
+	kunmap(page);
+}
+
+static int __init page_bulk_cmp_pfn(const void *a, const void *b)
+{
+	unsigned long x = *(const unsigned long *)a;
+	unsigned long y = *(const unsigned long *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* Returns the problem with a page just allocated with @gfp, if any */
+static const char * __init page_bulk_bad(struct page *page, gfp_t gfp)
+{
+	if (page_count(page) != 1)
+		return "reference count not 1";
+	if (page_mapcount(page) || page->mapping)
+		return "mapped";
+	if (PageBuddy(page) || PageLRU(page) || PageCompound(page))
+		return "bad flags";
+	if (page_private(page))
+		return "private data left";
+	if (PageHighMem(page) && !(gfp & __GFP_HIGHMEM))
+		return "highmem page for a lowmem request";
+	if ((gfp & __GFP_ZERO) && !page_bulk_cleared(page))
+		return "not cleared";
+	return NULL;
+}
+
+static int __init page_bulk_test_alloc(const char *kind, gfp_t gfp,
+				       unsigned long nr, unsigned long *pfns)
+{
+	struct page *page;
+	unsigned long got, i = 0;
+	const char *bad;
+	int errors = 0;
+	LIST_HEAD(list);
+
+	got = alloc_pages_bulk(gfp, nr, &list);
+	if (got != nr) {
+		pr_err("page_bulk_test: %s: got %lu of %lu pages\n", kind,
+		       got, nr);
+		errors++;
+	}
+
+	list_for_each_entry(page, &list, lru) {
+		if (i == got) {
+			pr_err("page_bulk_test: %s: more than %lu pages on "
+			       "the list\n", kind, got);
+			errors++;
+			break;
+		}
+		bad = page_bulk_bad(page, gfp);
+		if (bad) {
+			pr_err("page_bulk_test: %s: page %lu of %lu: %s\n",
+			       kind, i, nr, bad);
+			errors++;
+		}
+		pfns[i++] = page_to_pfn(page);
+		page_bulk_dirty(page);
+	}
+	if (i < got) {
+		pr_err("page_bulk_test: %s: %lu of %lu pages on the list\n",
+		       kind, i, got);
+		errors++;
+	}
+
+	sort(pfns, i, sizeof(*pfns), page_bulk_cmp_pfn, NULL);
+	while (i-- > 1) {
+		if (pfns[i] == pfns[i - 1]) {
+			pr_err("page_bulk_test: %s: pfn %lu handed out twice\n",
+			       kind, pfns[i]);
+			errors++;
+			break;
+		}
+	}
+
+	free_pages_bulk(&list);
+	if (!list_empty(&list)) {
+		pr_err("page_bulk_test: %s: list not empty after free\n",
+		       kind);
+		errors++;
+	}
+	return errors;
+}
+
+/* free_pages_bulk_array() must only drop the caller's reference */
+static int __init page_bulk_test_refs(void)
+{
+	struct page *pages[8];
+	unsigned long got, i;
+	int errors = 0;
+
+	got = alloc_pages_bulk_array(GFP_KERNEL, ARRAY_SIZE(pages), pages);
+	if (got != ARRAY_SIZE(pages)) {
+		pr_err("page_bulk_test: refs: got %lu of %zu pages\n", got,
+		       ARRAY_SIZE(pages));
+		free_pages_bulk_array(pages, got);
+		return 1;
+	}
+
+	for (i = 0; i < got; i += 2)
+		get_page(pages[i]);
+	free_pages_bulk_array(pages, got);
+
+	for (i = 0; i < got; i += 2) {
+		if (page_count(pages[i]) != 1) {
+			pr_err("page_bulk_test: refs: page %lu has count %d "
+			       "after free\n", i, page_count(pages[i]));
+			errors++;
+		}
+		__free_page(pages[i]);
+	}
+	return errors;
+}
+
+#ifdef CONFIG_ZEROED_PAGE_CACHE
+/*
+ * A movable __GFP_ZERO page must not come out of the zeroed cache, an
+ * unmovable one must while the cache has pages.  Interrupts are kept off
+ * so that nothing else uses the cache of this cpu in between.
+ */
+static int __init page_bulk_test_zeroed(void)
+{
+	struct zonelist *zonelist = node_zonelist(numa_node_id(), GFP_KERNEL);
+	struct per_cpu_pages *pcp;
+	struct page *movable, *unmovable;
+	struct zone *zone;
+	unsigned long flags;
+	int before, after_movable, after, errors = 0;
+
+	first_zones_zonelist(zonelist, gfp_zone(GFP_KERNEL), NULL, &zone);
+	if (!zone)
+		return 0;
+
+	local_irq_save(flags);
+	pcp = &this_cpu_ptr(zone->pageset)->pcp;
+	before = pcp->zeroed_count;
+	movable = alloc_page(GFP_ATOMIC | __GFP_MOVABLE | __GFP_ZERO);
+	after_movable = pcp->zeroed_count;
+	unmovable = alloc_page(GFP_ATOMIC | __GFP_ZERO);
+	after = pcp->zeroed_count;
+	local_irq_restore(flags);
+
+	if (!movable || !unmovable) {
+		pr_err("page_bulk_test: zeroed: allocation failed\n");
+		errors++;
+		goto out;
+	}
+	if (after_movable != before) {
+		pr_err("page_bulk_test: zeroed: movable request served from "
+		       "the zeroed cache\n");
+		errors++;
+	}
+	if (before && after != before - 1) {
+		pr_err("page_bulk_test: zeroed: unmovable request not served "
+		       "from the zeroed cache\n");
+		errors++;
+	}
+	if (before && get_pageblock_migratetype(unmovable) !=
+		      MIGRATE_UNMOVABLE) {
+		pr_err("page_bulk_test: zeroed: cached page in a pageblock "
+		       "of type %d\n", get_pageblock_migratetype(unmovable));
+		errors++;
+	}
+	if (!page_bulk_cleared(movable) || !page_bulk_cleared(unmovable)) {
+		pr_err("page_bulk_test: zeroed: page not cleared\n");
+		errors++;
+	}
+	if (!before)
+		pr_info("page_bulk_test: zeroed cache empty, unmovable "
+			"path not checked\n");
+out:
+	if (movable)
+		__free_page(movable);
+	if (unmovable)
+		__free_page(unmovable);
+	return errors;
+}
+#else
+static inline int page_bulk_test_zeroed(void)
+{
+	return 0;
+}
+#endif
+
+struct page_bulk_time {
+	u64 alloc_ns;
+	u64 free_ns;
+};
+
+static inline u64 __init page_bulk_since(ktime_t start)
+{
+	return ktime_to_ns(ktime_sub(ktime_get(), start));
+}
+
+static int __init page_bulk_time_single(gfp_t gfp, struct page **pages,
+					unsigned long nr,
+					struct page_bulk_time *t)
+{
+	unsigned long i, got;
+	ktime_t start;
+
+	start = ktime_get();
+	for (got = 0; got < nr; got++) {
+		pages[got] = alloc_page(gfp);
+		if (!pages[got])
+			break;
+	}
+	t->alloc_ns += page_bulk_since(start);
+
+	start = ktime_get();
+	for (i = 0; i < got; i++)
+		__free_page(pages[i]);
+	t->free_ns += page_bulk_since(start);
+
+	return got == nr ? 0 : -ENOMEM;
+}
+
+static int __init page_bulk_time_bulk(gfp_t gfp, struct page **pages,
+				      unsigned long nr,
+				      struct page_bulk_time *t)
+{
+	unsigned long got;
+	ktime_t start;
+
+	start = ktime_get();
+	got = alloc_pages_bulk_array(gfp, nr, pages);
+	t->alloc_ns += page_bulk_since(start);
+
+	start = ktime_get();
+	free_pages_bulk_array(pages, got);
+	t->free_ns += page_bulk_since(start);
+
+	return got == nr ? 0 : -ENOMEM;
+}
+
+static void __init page_bulk_report(const char *kind, const char *how,
+				    unsigned int mb, unsigned long nr,
+				    struct page_bulk_time *t)
+{
+	u64 alloc = t->alloc_ns, free = t->free_ns;
+
+	do_div(alloc, nr * loops);
+	do_div(free, nr * loops);
+	pr_info("page_bulk_test: %2uMB %-12s %-6s alloc %5llu ns/page, "
+		"free %5llu ns/page\n", mb, kind, how,
+		(unsigned long long)alloc, (unsigned long long)free);
+}
+
+/* Times 1 to max_mb MB of pages of each kind, singly and in bulk */
+static int __init page_bulk_time(void)
+{
+	struct page_bulk_time single, bulk;
+	struct page **pages;
+	unsigned long nr;
+	unsigned int mb, i;
+	int k, ret = 0;
+
+	if (!max_mb || !loops)
+		return 0;
+
+	pages = vmalloc((max_mb << (20 - PAGE_SHIFT)) * sizeof(*pages));
+	if (!pages)
+		return -ENOMEM;
+
+	for (k = 0; k < ARRAY_SIZE(page_bulk_kinds) && !ret; k++) {
+		for (mb = 1; mb <= max_mb && !ret; mb *= 2) {
+			nr = mb << (20 - PAGE_SHIFT);
+			memset(&single, 0, sizeof(single));
+			memset(&bulk, 0, sizeof(bulk));
+
+			for (i = 0; i < loops && !ret; i++) {
+				ret = page_bulk_time_single(
+						page_bulk_kinds[k].gfp, pages,
+						nr, &single);
+				if (!ret)
+					ret = page_bulk_time_bulk(
+						page_bulk_kinds[k].gfp, pages,
+						nr, &bulk);
+				cond_resched();
+			}
+			if (ret) {
+				pr_err("page_bulk_test: %uMB %s allocation "
+				       "failed\n", mb, page_bulk_kinds[k].name);
+				break;
+			}
+
+			page_bulk_report(page_bulk_kinds[k].name, "single",
+					 mb, nr, &single);
+			page_bulk_report(page_bulk_kinds[k].name, "bulk",
+					 mb, nr, &bulk);
+		}
+	}
+
+	vfree(pages);
+	return ret;
+}
+
+static int __init page_bulk_test_init(void)
+{
+	unsigned long *pfns;
+	int s, k, errors = 0;
+
+	pfns = vmalloc(PAGE_BULK_MAX * sizeof(*pfns));
+	if (!pfns)
+		return -ENOMEM;
+
+	/* twice, so that the second round gets the pages dirtied by the first */
+	for (k = 0; k < 2 * ARRAY_SIZE(page_bulk_kinds); k++) {
+		int kind = k % ARRAY_SIZE(page_bulk_kinds);
+
+		for (s = 0; s < ARRAY_SIZE(page_bulk_sizes); s++) {
+			errors += page_bulk_test_alloc(
+					page_bulk_kinds[kind].name,
+					page_bulk_kinds[kind].gfp,
+					page_bulk_sizes[s], pfns);
+			cond_resched();
+		}
+	}
+	errors += page_bulk_test_refs();
+	errors += page_bulk_test_zeroed();
+
+	vfree(pfns);
+
+	if (errors) {
+		pr_err("page_bulk_test: %d failures\n", errors);
+		return 0;
+	}
+	pr_info("page_bulk_test: passed\n");
+
+	return page_bulk_time();
+}
+
+static void __exit page_bulk_test_exit(void)
+{
+}
+
+module_init(page_bulk_test_init);
+module_exit(page_bulk_test_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Bulk page allocator tests and speed test");
@@ -4,6 +4,7 @@
  */
 
 #include <linux/zutil.h>
+#include <linux/unaligned/word32.h>
 #include "inftrees.h"
 #include "inflate.h"
 #include "inffast.h"
@@ -38,6 +39,18 @@ get_unaligned16(const unsigned short *p)
 	return mm.us;
 }
 
+/* Match copies in 8-byte steps, see <linux/unaligned/word32.h> */
+#ifdef HAVE_FAST_UNALIGNED_WORD32
+#  define INFLATE_WORD_COPY
+#endif
+
+#ifdef INFLATE_WORD_COPY
+#  define COPY8(d, s) do { \
+	put_unaligned_word32(d, get_unaligned_word32(s)); \
+	put_unaligned_word32((d) + 4, get_unaligned_word32((s) + 4)); \
+    } while (0)
+#endif
+
 #ifdef POSTINC
 #  define OFF 0
 #  define PUP(a) *(a)++
@@ -210,9 +223,8 @@ void inflate_fast(z_streamp strm, unsigned start)
                         from += wsize - op;
                         if (op < len) {         /* some from window */
                             len -= op;
-                            do {
-                                PUP(out) = PUP(from);
-                            } while (--op);
+                            memcpy(out + OFF, from + OFF, op);
+                            out += op;
                             from = out - dist;  /* rest from output */
                         }
                     }
@@ -221,16 +233,14 @@ void inflate_fast(z_streamp strm, unsigned start)
                         op -= write;
                         if (op < len) {         /* some from end of window */
                             len -= op;
-                            do {
-                                PUP(out) = PUP(from);
-                            } while (--op);
+                            memcpy(out + OFF, from + OFF, op);
+                            out += op;
                             from = window - OFF;
                             if (write < len) {  /* some from start of window */
                                 op = write;
                                 len -= op;
-                                do {
-                                    PUP(out) = PUP(from);
-                                } while (--op);
+                                memcpy(out + OFF, from + OFF, op);
+                                out += op;
                                 from = out - dist;      /* rest from output */
                             }
                         }
@@ -239,9 +249,8 @@ void inflate_fast(z_streamp strm, unsigned start)
                         from += write - op;
                         if (op < len) {         /* some from window */
                             len -= op;
-                            do {
-                                PUP(out) = PUP(from);
-                            } while (--op);
+                            memcpy(out + OFF, from + OFF, op);
+                            out += op;
                             from = out - dist;  /* rest from output */
                         }
                     }
@@ -262,6 +271,33 @@ void inflate_fast(z_streamp strm, unsigned start)
 		    unsigned long loops;
 
                     from = out - dist;          /* copy direct from output */
+#ifdef INFLATE_WORD_COPY
+		    /*
+		     * Chunks never overlap their own source when dist >= 8.
+		     * Nothing is written past the end of the match, callers
+		     * may still have input or data of their own there.
+		     */
+		    if (dist >= 8) {
+			unsigned char *o = out + OFF;
+			const unsigned char *f = from + OFF;
+
+			while (len >= 8) {
+			    COPY8(o, f);
+			    o += 8;
+			    f += 8;
+			    len -= 8;
+			}
+			while (len--)
+			    *o++ = *f++;
+			out = o - OFF;
+			continue;
+		    }
+#endif
+		    if (dist == 1) {            /* run of one byte */
+			memset(out + OFF, from[OFF], len);
+			out += len;
+			continue;
+		    }
 		    /* minimum length is three */
 		    /* Align out addr */
 		    if (!((long)(out - 1 + OFF) & 1)) {
@@ -0,0 +1,338 @@
+/*
+ * Tests for the inflate_fast() match copies and for zlib_adler32()
+ *
+ * inflate_fast() copies a match in one of four ways: with memcpy() out of
+ * the sliding window, in up to two pieces when the match wraps around the
+ * end of the window, with memset() for distance 1, and in 8-byte steps
+ * for distances of 8 or more.  Deflate streams are built here holding
+ * matches of chosen distances and lengths and inflated in pieces sized so
+ * that the matches straddle the pieces, and thus come out of the window
+ * at every write position, and in one go into output buffers at every
+ * alignment.  The bytes right after the output space must stay untouched.
+ *
+ * zlib_adler32() sums word aligned 64-byte blocks a word at a time and
+ * the bytes around them one at a time; it is compared with a byte at a
+ * time sum for every start alignment and for lengths around the block
+ * size and NMAX, with all-ones data, which gives the largest sums.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/zlib.h>
+#include <linux/zutil.h>
+#include <linux/random.h>
+#include <linux/sched.h>
+#include <linux/vmalloc.h>
+#include <linux/hrtimer.h>
+
+/* more than the 32 KB window, so that the window write position wraps */
+#define ZLIB_TEST_LEN		(48 * 1024)
+#define ZLIB_TEST_GUARD		16
+
+/*
+ * zlib.compress(zlib_test_known_data(), 9) from userspace zlib 1.2, so
+ * that the fast path is also checked against streams not made by the
+ * in-kernel deflate.
+ */
+static const u8 known_stream[] __initconst = {
+	0x78, 0xda, 0x4b, 0x4c, 0x1c, 0x05, 0x44, 0x83, 0xa4, 0x51, 0x48, 0x3c,
+	0x4c, 0x4e, 0x49, 0x4d, 0x4b, 0xcf, 0xc8, 0xcc, 0xca, 0x1e, 0x65, 0x8e,
+	0x32, 0x07, 0x05, 0xb3, 0xa2, 0xb2, 0xca, 0xc0, 0xd0, 0xc8, 0x78, 0x94,
+	0x42, 0xa3, 0x46, 0x0b, 0x76, 0x52, 0xea, 0x00, 0x02, 0x89, 0x0c, 0x00,
+	0x11, 0x26, 0xc1, 0x7f,
+};
+#define KNOWN_LEN	1873
+#define KNOWN_ADLER	0x1126c17fUL
+
+/* around the 8-byte steps, the pattern copies and the window size */
+static const unsigned int match_dist[] __initconst = {
+	1, 2, 3, 7, 8, 9, 15, 16, 17, 258, 4095, 32768,
+};
+static const unsigned int match_len[] __initconst = {
+	3, 7, 8, 9, 16, 17, 258,
+};
+
+/*
+ * Output space per zlib_inflate() call.  inflate_fast() only runs with
+ * 258 bytes of space or more; the odd sizes move every match across the
+ * piece boundaries, and so the window write position, from piece to piece.
+ */
+static const size_t piece_size[] __initconst = {
+	258, 263, 1021, 4099, 32771,
+};
+
+static size_t __init zlib_test_known_data(u8 *buf)
+{
+	static const struct {
+		const char *s;
+		int times;
+	} parts[] __initconst = {
+		{ "a", 300 }, { "ab", 150 }, { "abcdefghijk", 60 },
+		{ "xyz0123", 40 }, { "a", 300 }, { "abcdefghijk", 3 },
+	};
+	size_t len = 0;
+	int i, j;
+
+	for (i = 0; i < ARRAY_SIZE(parts); i++) {
+		for (j = 0; j < parts[i].times; j++) {
+			memcpy(buf + len, parts[i].s, strlen(parts[i].s));
+			len += strlen(parts[i].s);
+		}
+	}
+	return len;
+}
+
+/*
+ * Random literals with a match of @len bytes at distance @dist every few
+ * bytes.  Random data gives deflate no shorter match to pick instead.
+ */
+static void __init zlib_test_matches(u8 *buf, size_t size, unsigned int dist,
+				     unsigned int len)
+{
+	size_t i = 0, n;
+
+	while (i < size) {
+		for (n = (i < dist ? dist : 1 + random32() % 16);
+		     n && i < size; n--)
+			buf[i++] = random32();
+		for (n = len; n && i < size; n--, i++)
+			buf[i] = buf[i - dist];
+	}
+}
+
+static size_t __init zlib_test_deflate(z_stream *strm, const u8 *src,
+				       size_t len, u8 *cbuf, size_t csize)
+{
+	size_t clen = 0;
+
+	if (zlib_deflateInit(strm, 9) != Z_OK)
+		return 0;
+	strm->next_in = src;
+	strm->avail_in = len;
+	strm->next_out = cbuf;
+	strm->avail_out = csize;
+	if (zlib_deflate(strm, Z_FINISH) == Z_STREAM_END)
+		clen = strm->total_out;
+	zlib_deflateEnd(strm);
+	return clen;
+}
+
+/* inflate @cbuf into @len bytes at @dbuf, @piece bytes per call at most */
+static int __init zlib_test_run(z_stream *strm, const u8 *cbuf, size_t clen,
+				u8 *dbuf, size_t len, size_t piece)
+{
+	size_t n;
+	int ret;
+
+	if (zlib_inflateInit(strm) != Z_OK)
+		return Z_STREAM_ERROR;
+
+	strm->next_in = cbuf;
+	strm->avail_in = clen;
+	do {
+		n = min(piece, len - (size_t)strm->total_out);
+		strm->next_out = dbuf + strm->total_out;
+		strm->avail_out = n;
+		ret = zlib_inflate(strm, Z_NO_FLUSH);
+	} while (ret == Z_OK && n);
+	zlib_inflateEnd(strm);
+	return ret;
+}
+
+/*
+ * Check that @cbuf inflates to the @len bytes of @src, and that nothing
+ * is written past them.  Returns the number of failures.
+ */
+static int __init zlib_test_inflate(z_stream *strm, const u8 *cbuf,
+				    size_t clen, const u8 *src, u8 *dbuf,
+				    size_t len, size_t piece)
+{
+	int ret, i;
+
+	memset(dbuf, 0xa5, len + ZLIB_TEST_GUARD);
+	ret = zlib_test_run(strm, cbuf, clen, dbuf, len, piece);
+	if (ret != Z_STREAM_END || strm->total_out != len ||
+	    memcmp(src, dbuf, len)) {
+		pr_err("zlib_test: inflate failed (%d), %lu of %zu bytes, "
+		       "%zu per call\n", ret, strm->total_out, len, piece);
+		return 1;
+	}
+	for (i = 0; i < ZLIB_TEST_GUARD; i++) {
+		if (dbuf[len + i] != 0xa5) {
+			pr_err("zlib_test: byte %zu written past the output, "
+			       "%zu per call\n", len + i, piece);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static int __init zlib_test_known(z_stream *strm, u8 *src, u8 *dbuf)
+{
+	size_t len = zlib_test_known_data(src);
+	int i, errors = 0;
+
+	if (zlib_adler32(1, src, len) != KNOWN_ADLER) {
+		pr_err("zlib_test: known adler32 %08lx, expected %08lx\n",
+		       zlib_adler32(1, src, len), KNOWN_ADLER);
+		errors++;
+	}
+	for (i = 0; i < ARRAY_SIZE(piece_size); i++)
+		errors += zlib_test_inflate(strm, known_stream,
+					    sizeof(known_stream), src, dbuf,
+					    len, piece_size[i]);
+	return errors;
+}
+
+static int __init zlib_test_copies(z_stream *strm, u8 *src, u8 *cbuf,
+				   size_t csize, u8 *dbuf)
+{
+	int d, l, i, errors = 0;
+	size_t clen;
+
+	for (d = 0; d < ARRAY_SIZE(match_dist); d++) {
+		for (l = 0; l < ARRAY_SIZE(match_len); l++) {
+			zlib_test_matches(src, ZLIB_TEST_LEN, match_dist[d],
+					  match_len[l]);
+			clen = zlib_test_deflate(strm, src, ZLIB_TEST_LEN,
+						 cbuf, csize);
+			if (!clen) {
+				pr_err("zlib_test: deflate failed\n");
+				return errors + 1;
+			}
+
+			/* pieces: matches out of the window */
+			for (i = 0; i < ARRAY_SIZE(piece_size); i++)
+				errors += zlib_test_inflate(strm, cbuf, clen,
+						src, dbuf, ZLIB_TEST_LEN,
+						piece_size[i]);
+			/* one go: matches out of the output, every alignment */
+			for (i = 0; i < 8; i++)
+				errors += zlib_test_inflate(strm, cbuf, clen,
+						src, dbuf + i, ZLIB_TEST_LEN,
+						ZLIB_TEST_LEN);
+			if (errors) {
+				pr_err("zlib_test: matches of %u at distance "
+				       "%u\n", match_len[l], match_dist[d]);
+				return errors;
+			}
+			cond_resched();
+		}
+	}
+	return 0;
+}
+
+static unsigned long __init adler32_ref(unsigned long adler, const u8 *buf,
+					size_t len)
+{
+	unsigned long s1 = adler & 0xffff, s2 = adler >> 16;
+
+	while (len--) {
+		s1 = (s1 + *buf++) % BASE;
+		s2 = (s2 + s1) % BASE;
+	}
+	return (s2 << 16) | s1;
+}
+
+static int __init zlib_test_adler(u8 *buf)
+{
+	static const size_t lens[] __initconst = {
+		0, 1, 3, 4, 63, 64, 65, 67, 127, 128, 131,
+		NMAX - 1, NMAX, NMAX + 1, NMAX + 64, 3 * NMAX + 67,
+	};
+	/* start from large sums, as in the middle of a stream */
+	unsigned long adler = 0xfff0fff0UL % BASE, ref, got;
+	int off, i, errors = 0;
+
+	memset(buf, 0xff, 3 * NMAX + 67 + 8);
+	for (off = 0; off < 8; off++) {
+		for (i = 0; i < ARRAY_SIZE(lens); i++) {
+			ref = adler32_ref(adler, buf + off, lens[i]);
+			got = zlib_adler32(adler, buf + off, lens[i]);
+			if (ref == got)
+				continue;
+			pr_err("zlib_test: adler32 %08lx, expected %08lx "
+			       "(offset %d, length %zu)\n", got, ref, off,
+			       lens[i]);
+			errors++;
+		}
+	}
+	return errors;
+}
+
+static void __init zlib_test_speed(z_stream *strm, u8 *src, u8 *cbuf,
+				   size_t csize, u8 *dbuf)
+{
+	size_t clen;
+	ktime_t start;
+	u64 bytes;
+	int i;
+
+	/* typical of a filesystem image: matches of 8 to 64 bytes */
+	zlib_test_matches(src, ZLIB_TEST_LEN, 1024, 24);
+	clen = zlib_test_deflate(strm, src, ZLIB_TEST_LEN, cbuf, csize);
+
+	start = ktime_get();
+	for (i = 0; i < 16; i++)
+		zlib_test_run(strm, cbuf, clen, dbuf, ZLIB_TEST_LEN,
+			      ZLIB_TEST_LEN);
+	bytes = (u64)ZLIB_TEST_LEN * 16 * 1000;
+	do_div(bytes, ktime_to_ns(ktime_sub(ktime_get(), start)) ?: 1);
+	pr_info("zlib_test: inflate %llu MB/s\n", (unsigned long long)bytes);
+
+	start = ktime_get();
+	for (i = 0; i < 16; i++)
+		zlib_adler32(1, src, ZLIB_TEST_LEN);
+	bytes = (u64)ZLIB_TEST_LEN * 16 * 1000;
+	do_div(bytes, ktime_to_ns(ktime_sub(ktime_get(), start)) ?: 1);
+	pr_info("zlib_test: adler32 %llu MB/s\n", (unsigned long long)bytes);
+}
+
+static int __init zlib_test_init(void)
+{
+	z_stream strm = { };
+	u8 *src, *cbuf, *dbuf;
+	size_t csize;
+	int errors = 0;
+
+	csize = ZLIB_TEST_LEN + ZLIB_TEST_LEN / 8 + 64;
+	src = vmalloc(ZLIB_TEST_LEN);
+	cbuf = vmalloc(csize);
+	dbuf = vmalloc(ZLIB_TEST_LEN + 8 + ZLIB_TEST_GUARD);
+	strm.workspace = vmalloc(max(zlib_deflate_workspacesize(),
+				     zlib_inflate_workspacesize()));
+	if (!src || !cbuf || !dbuf || !strm.workspace) {
+		errors = -ENOMEM;
+		goto out;
+	}
+
+	errors += zlib_test_known(&strm, src, dbuf);
+	errors += zlib_test_copies(&strm, src, cbuf, csize, dbuf);
+	errors += zlib_test_adler(src);
+	if (errors)
+		pr_err("zlib_test: %d failures\n", errors);
+	else
+		pr_info("zlib_test: passed\n");
+
+	zlib_test_speed(&strm, src, cbuf, csize, dbuf);
+out:
+	vfree(strm.workspace);
+	vfree(dbuf);
+	vfree(cbuf);
+	vfree(src);
+	return errors < 0 ? errors : 0;
+}
+
+static void __exit zlib_test_exit(void)
+{
+}
+
+module_init(zlib_test_init);
+module_exit(zlib_test_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Tests for the zlib inflate match copies and adler32");
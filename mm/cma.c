@@ -0,0 +1,117 @@
+/*
+ * linux/mm/cma.c
+ *
+ * Contiguous memory allocator regions.  Memory set aside at boot for
+ * devices that need large physically contiguous buffers is otherwise lost
+ * to the rest of the system whenever those devices are idle.  A region
+ * declared here is given to the page allocator as MIGRATE_CMA pageblocks
+ * instead, which only movable allocations may borrow, and the driver that
+ * owns the region takes ranges of it back with alloc_contig_range(),
+ * migrating whatever the pages hold at that moment.
+ */
+#include <linux/mm.h>
+#include <linux/mmzone.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/pfn.h>
+#include <linux/cma.h>
+
+#define MAX_CMA_REGIONS	8
+
+struct cma_region {
+	unsigned long base_pfn;
+	unsigned long count;
+};
+
+static struct cma_region cma_regions[MAX_CMA_REGIONS];
+static int cma_region_count;
+
+/**
+ * cma_declare_region() -- hand reserved memory over to CMA
+ * @base:	physical start of the region
+ * @size:	size of the region in bytes
+ *
+ * The memory must have been reserved with bootmem by the caller and be
+ * aligned to CMA_REGION_ALIGN.  It is released to the page allocator at
+ * core_initcall time, so this has to be called during machine setup.
+ */
+int cma_declare_region(phys_addr_t base, unsigned long size)
+{
+	struct cma_region *cma;
+
+	if (!size || (base | size) & (CMA_REGION_ALIGN - 1)) {
+		printk(KERN_ERR "cma: region %08llx+%lx is not aligned to "
+		       "%lx\n", (unsigned long long)base, size,
+		       (unsigned long)CMA_REGION_ALIGN);
+		return -EINVAL;
+	}
+	if (cma_region_count == MAX_CMA_REGIONS)
+		return -ENOSPC;
+
+	cma = &cma_regions[cma_region_count++];
+	cma->base_pfn = PFN_DOWN(base);
+	cma->count = size >> PAGE_SHIFT;
+	return 0;
+}
+
+/**
+ * cma_region_contains() -- test whether memory lies in a declared region
+ * @base:	physical start of the memory
+ * @size:	size of the memory in bytes
+ */
+bool cma_region_contains(phys_addr_t base, unsigned long size)
+{
+	unsigned long start = PFN_DOWN(base);
+	unsigned long end = PFN_UP(base + size);
+	int i;
+
+	for (i = 0; i < cma_region_count; i++) {
+		struct cma_region *cma = &cma_regions[i];
+
+		if (cma->count && start >= cma->base_pfn &&
+		    end <= cma->base_pfn + cma->count)
+			return true;
+	}
+	return false;
+}
+EXPORT_SYMBOL(cma_region_contains);
+
+static int __init cma_activate_region(struct cma_region *cma)
+{
+	unsigned long pfn = cma->base_pfn, end = pfn + cma->count;
+	struct zone *zone;
+
+	/* alloc_contig_range() works within a single zone */
+	if (!pfn_valid(pfn))
+		return -EINVAL;
+	zone = page_zone(pfn_to_page(pfn));
+	for (; pfn < end; pfn += pageblock_nr_pages) {
+		if (!pfn_valid(pfn) || page_zone(pfn_to_page(pfn)) != zone)
+			return -EINVAL;
+	}
+
+	for (pfn = cma->base_pfn; pfn < end; pfn += pageblock_nr_pages)
+		init_cma_reserved_pageblock(pfn_to_page(pfn));
+	return 0;
+}
+
+static int __init cma_init_reserved_regions(void)
+{
+	struct cma_region *cma;
+	int i;
+
+	for (i = 0; i < cma_region_count; i++) {
+		cma = &cma_regions[i];
+		if (cma_activate_region(cma)) {
+			printk(KERN_ERR "cma: region at pfn %lx is not in one zone, "
+			       "left reserved\n", cma->base_pfn);
+			cma->count = 0;
+			continue;
+		}
+		printk(KERN_INFO "cma: %lu MB at %08llx\n",
+		       cma->count >> (20 - PAGE_SHIFT),
+		       (unsigned long long)PFN_PHYS(cma->base_pfn));
+	}
+	return 0;
+}
+core_initcall(cma_init_reserved_regions);
@@ -14,6 +14,8 @@
 #include <linux/backing-dev.h>
 #include <linux/sysctl.h>
 #include <linux/sysfs.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
 #include "internal.h"
 
 /*
@@ -37,6 +39,7 @@ struct compact_control {
 
 	unsigned int order;		/* order a direct compactor needs */
 	int migratetype;		/* MOVABLE, RECLAIMABLE etc */
+	unsigned long nr_blocks;	/* free blocks of order kcompactd wants */
 	struct zone *zone;
 };
 
@@ -341,6 +344,17 @@ static void update_nr_listpages(struct compact_control *cc)
 	cc->nr_freepages = nr_freepages;
 }
 
+/* The number of free blocks of @order the free pages of @zone make up */
+static unsigned long zone_free_blocks(struct zone *zone, unsigned int order)
+{
+	unsigned long blocks = 0;
+	unsigned int o;
+
+	for (o = order; o < MAX_ORDER; o++)
+		blocks += zone->free_area[o].nr_free << (o - order);
+	return blocks;
+}
+
 static int compact_finished(struct zone *zone,
 						struct compact_control *cc)
 {
@@ -361,6 +375,15 @@ static int compact_finished(struct zone *zone,
 	if (cc->order == -1)
 		return COMPACT_CONTINUE;
 
+	/* kcompactd: Are there enough free blocks of the order? */
+	if (cc->nr_blocks) {
+		if (kthread_should_stop())
+			return COMPACT_PARTIAL;
+		if (zone_free_blocks(zone, cc->order) >= cc->nr_blocks)
+			return COMPACT_PARTIAL;
+		return COMPACT_CONTINUE;
+	}
+
 	/* Direct compactor: Is a suitable page free? */
 	for (order = cc->order; order < MAX_ORDER; order++) {
 		/* Job done if page is free of the right migratetype */
@@ -583,6 +606,158 @@ int sysctl_extfrag_handler(struct ctl_table *table, int write,
 	return 0;
 }
 
+/*
+ * kcompactd keeps compact_daemon_blocks free blocks of compact_daemon_order
+ * in every zone, so that the high-order allocations of camera, video and
+ * framebuffer drivers do not have to wait for direct compaction.  It runs
+ * at SCHED_IDLE and is woken when the allocator falls into its slow path
+ * for a page of at least that order and after kswapd has freed memory.
+ * It leaves a zone alone when the fragmentation index says that an
+ * allocation would fail for lack of memory rather than fragmentation.  A
+ * zone it fails to compact far enough is skipped for an exponentially
+ * growing number of wakeups, which come every KCOMPACTD_INTERVAL for as
+ * long as a zone is short.  compact_daemon_blocks of 0 disables it.
+ */
+#define KCOMPACTD_INTERVAL	HZ
+
+int sysctl_compact_daemon_order = 4;
+int sysctl_compact_daemon_blocks = 16;
+
+static DECLARE_WAIT_QUEUE_HEAD(kcompactd_wait);
+static bool kcompactd_pending;
+
+/*
+ * @order is that of an allocation that entered the slow path; kswapd
+ * passes MAX_ORDER - 1 to always wake kcompactd.
+ */
+void wakeup_kcompactd(int order)
+{
+	if (order < sysctl_compact_daemon_order ||
+	    !sysctl_compact_daemon_blocks)
+		return;
+	if (!waitqueue_active(&kcompactd_wait))
+		return;
+	kcompactd_pending = true;
+	wake_up_interruptible(&kcompactd_wait);
+}
+
+/* Whether compacting @zone is needed and worth it */
+static bool kcompactd_zone_wants(struct zone *zone, int order,
+				 unsigned long blocks)
+{
+	unsigned long watermark;
+	int fragindex;
+
+	if (zone_free_blocks(zone, order) >= blocks)
+		return false;
+
+	/* the same order-0 margin as direct compaction */
+	watermark = low_wmark_pages(zone) + (2UL << order);
+	if (!zone_watermark_ok(zone, 0, watermark, 0, 0))
+		return false;
+
+	/* -1000 means some blocks are free, just not enough of them */
+	fragindex = fragmentation_index(zone, order);
+	return fragindex < 0 || fragindex > sysctl_extfrag_threshold;
+}
+
+static void kcompactd_zone(struct zone *zone, int order, unsigned long blocks)
+{
+	struct compact_control cc = {
+		.nr_freepages = 0,
+		.nr_migratepages = 0,
+		.order = order,
+		.migratetype = MIGRATE_MOVABLE,
+		.nr_blocks = blocks,
+		.zone = zone,
+	};
+	INIT_LIST_HEAD(&cc.freepages);
+	INIT_LIST_HEAD(&cc.migratepages);
+
+	count_vm_event(COMPACTDAEMONRUN);
+	compact_zone(zone, &cc);
+
+	if (zone_free_blocks(zone, order) >= blocks) {
+		count_vm_event(COMPACTDAEMONSUCCESS);
+		zone->compact_daemon_shift = 0;
+	} else {
+		count_vm_event(COMPACTDAEMONFAIL);
+		if (zone->compact_daemon_shift < COMPACT_MAX_DEFER_SHIFT)
+			zone->compact_daemon_shift++;
+		zone->compact_daemon_skip = 1U << zone->compact_daemon_shift;
+	}
+}
+
+/* Returns true if a zone is still short of free blocks */
+static bool kcompactd_do_work(void)
+{
+	int order = sysctl_compact_daemon_order;
+	unsigned long blocks = sysctl_compact_daemon_blocks;
+	bool drained = false, short_blocks = false;
+	struct zone *zone;
+
+	if (!blocks)
+		return false;
+
+	for_each_populated_zone(zone) {
+		if (kthread_should_stop())
+			break;
+		if (zone->compact_daemon_skip) {
+			zone->compact_daemon_skip--;
+			short_blocks = true;
+			continue;
+		}
+		if (!kcompactd_zone_wants(zone, order, blocks))
+			continue;
+
+		if (!drained) {
+			lru_add_drain_all();
+			drained = true;
+		}
+		kcompactd_zone(zone, order, blocks);
+		if (zone->compact_daemon_skip)
+			short_blocks = true;
+	}
+	return short_blocks;
+}
+
+static int kcompactd(void *unused)
+{
+	struct sched_param param = { .sched_priority = 0 };
+	long timeout = MAX_SCHEDULE_TIMEOUT;
+
+	sched_setscheduler(current, SCHED_IDLE, &param);
+	set_freezable();
+
+	while (!kthread_should_stop()) {
+		wait_event_freezable_timeout(kcompactd_wait,
+				kcompactd_pending || kthread_should_stop(),
+				timeout);
+		if (kcompactd_pending)
+			count_vm_event(COMPACTDAEMONWAKE);
+		kcompactd_pending = false;
+
+		if (kcompactd_do_work())
+			timeout = KCOMPACTD_INTERVAL;
+		else
+			timeout = MAX_SCHEDULE_TIMEOUT;
+	}
+	return 0;
+}
+
+static int __init kcompactd_init(void)
+{
+	struct task_struct *tsk;
+
+	tsk = kthread_run(kcompactd, NULL, "kcompactd");
+	if (IS_ERR(tsk)) {
+		printk(KERN_ERR "Failed to start kcompactd\n");
+		return PTR_ERR(tsk);
+	}
+	return 0;
+}
+module_init(kcompactd_init)
+
 #if defined(CONFIG_SYSFS) && defined(CONFIG_NUMA)
 ssize_t sysfs_compact_node(struct sys_device *dev,
 			struct sysdev_attribute *attr,
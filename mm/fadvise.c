@@ -115,6 +115,13 @@ SYSCALL_DEFINE(fadvise64_64)(int fd, loff_t offset, loff_t len, int advice)
 		break;
 	case POSIX_FADV_NOREUSE:
 		break;
+	case POSIX_FADV_RA_RECORD:
+	case POSIX_FADV_RA_STOP:
+	case POSIX_FADV_RA_REPLAY:
+		ret = ra_profile_advise(mapping, file, advice);
+		if (ret > 0)
+			ret = 0;
+		break;
 	case POSIX_FADV_DONTNEED:
 		if (!bdi_write_congested(mapping->backing_dev_info))
 			filemap_flush(mapping);
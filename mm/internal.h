@@ -12,6 +12,7 @@
 #define __MM_INTERNAL_H
 
 #include <linux/mm.h>
+#include <linux/ktime.h>
 
 void free_pgtables(struct mmu_gather *tlb, struct vm_area_struct *start_vma,
 		unsigned long floor, unsigned long ceiling);
@@ -39,12 +40,6 @@ static inline void __put_page(struct page *page)
 
 extern unsigned long highest_memmap_pfn;
 
-/*
- * in mm/vmscan.c:
- */
-extern int isolate_lru_page(struct page *page);
-extern void putback_lru_page(struct page *page);
-
 /*
  * in mm/page_alloc.c
  */
@@ -249,6 +244,25 @@ int __get_user_pages(struct task_struct *tsk, struct mm_struct *mm,
 #define ZONE_RECLAIM_FULL	-1
 #define ZONE_RECLAIM_SOME	0
 #define ZONE_RECLAIM_SUCCESS	1
+
+#ifdef CONFIG_RECLAIM_STALL_STATS
+static inline ktime_t stall_start(void)
+{
+	return ktime_get();
+}
+
+extern void compact_stall_end(ktime_t start, int order, unsigned long status);
+#else
+static inline ktime_t stall_start(void)
+{
+	return ktime_set(0, 0);
+}
+
+static inline void compact_stall_end(ktime_t start, int order,
+				     unsigned long status)
+{
+}
+#endif
 #endif
 
 extern int hwpoison_filter(struct page *p);
@@ -63,6 +63,11 @@ static int really_do_swap_account __initdata = 1; /* for remember boot option*/
 #define do_swap_account		(0)
 #endif
 
+/* Set by the "memcg_lru_only" boot option, see mem_cgroup_counted() */
+static int memcg_lru_only __read_mostly;
+
+#define MEM_CGROUP_RECLAIM_PRIORITY_MAX	100
+
 /*
  * Per memcg event counter is incremented at every pagein/pageout. This counter
  * is used for trigger some periodic events. This is straightforward and better
@@ -226,6 +231,12 @@ struct mem_cgroup {
 	atomic_t	refcnt;
 
 	unsigned int	swappiness;
+	/*
+	 * Cgroups with a higher reclaim priority are reclaimed from first,
+	 * see mem_cgroup_priority_reclaim().  0 leaves them to the global
+	 * LRU scan.
+	 */
+	unsigned int	reclaim_priority;
 	/* OOM-Killer disable */
 	int		oom_kill_disable;
 
@@ -339,6 +350,7 @@ static void mem_cgroup_get(struct mem_cgroup *mem);
 static void mem_cgroup_put(struct mem_cgroup *mem);
 static struct mem_cgroup *parent_mem_cgroup(struct mem_cgroup *mem);
 static void drain_all_stock_async(void);
+static inline u64 mem_cgroup_usage(struct mem_cgroup *mem, bool swap);
 
 static struct mem_cgroup_per_zone *
 mem_cgroup_zoneinfo(struct mem_cgroup *mem, int nid, int zid)
@@ -696,6 +708,21 @@ static inline bool mem_cgroup_is_root(struct mem_cgroup *mem)
 	return (mem == root_mem_cgroup);
 }
 
+/*
+ * Whether charges to @mem are accounted in its res_counters.  The root
+ * cgroup has no limit to enforce, and with "memcg_lru_only" no cgroup
+ * has: charge and uncharge then skip the res_counters and limit reclaim.
+ * Everything else per page stays, the page_cgroup is still committed
+ * and cleared under its lock, with the css reference and the statistics
+ * that keep the page on its cgroup's LRU lists and in memory.stat.  Code
+ * that needs the usage of such a cgroup must use mem_cgroup_usage(), the
+ * res_counters stay at 0.
+ */
+static inline bool mem_cgroup_counted(struct mem_cgroup *mem)
+{
+	return !mem_cgroup_is_root(mem) && !memcg_lru_only;
+}
+
 /*
  * Following LRU functions are allowed to be used without PCG_LOCK.
  * Operations are called by routine of global LRU independently from memcg.
@@ -1620,7 +1647,7 @@ static int __mem_cgroup_try_charge(struct mm_struct *mm,
 		return 0;
 
 	VM_BUG_ON(css_is_removed(&mem->css));
-	if (mem_cgroup_is_root(mem))
+	if (!mem_cgroup_counted(mem))
 		goto done;
 
 	while (1) {
@@ -1744,9 +1771,12 @@ static void __mem_cgroup_cancel_charge(struct mem_cgroup *mem,
 							unsigned long count)
 {
 	if (!mem_cgroup_is_root(mem)) {
-		res_counter_uncharge(&mem->res, PAGE_SIZE * count);
-		if (do_swap_account)
-			res_counter_uncharge(&mem->memsw, PAGE_SIZE * count);
+		if (mem_cgroup_counted(mem)) {
+			res_counter_uncharge(&mem->res, PAGE_SIZE * count);
+			if (do_swap_account)
+				res_counter_uncharge(&mem->memsw,
+						     PAGE_SIZE * count);
+		}
 		VM_BUG_ON(test_bit(CSS_ROOT, &mem->css.flags));
 		WARN_ON_ONCE(count > INT_MAX);
 		__css_put(&mem->css, (int)count);
@@ -2285,7 +2315,7 @@ __mem_cgroup_uncharge_common(struct page *page, enum charge_type ctype)
 		break;
 	}
 
-	if (!mem_cgroup_is_root(mem))
+	if (mem_cgroup_counted(mem))
 		__do_uncharge(mem, ctype);
 	if (ctype == MEM_CGROUP_CHARGE_TYPE_SWAPOUT)
 		mem_cgroup_swap_statistics(mem, true);
@@ -2881,6 +2911,89 @@ unsigned long mem_cgroup_soft_limit_reclaim(struct zone *zone, int order,
 	return nr_reclaimed;
 }
 
+/*
+ * The cgroup with the lowest css id from *@id on, with a css reference
+ * held, or NULL.  *@id is advanced past it.
+ */
+static struct mem_cgroup *mem_cgroup_get_next(int *id)
+{
+	struct cgroup_subsys_state *css;
+	struct mem_cgroup *mem = NULL;
+	int found;
+
+	while (!mem) {
+		rcu_read_lock();
+		css = css_get_next(&mem_cgroup_subsys, *id,
+				   &root_mem_cgroup->css, &found);
+		if (css && css_tryget(css))
+			mem = container_of(css, struct mem_cgroup, css);
+		rcu_read_unlock();
+		if (!css)
+			break;
+		*id = found + 1;
+	}
+	return mem;
+}
+
+static unsigned long mem_cgroup_zone_evictable(struct mem_cgroup *mem,
+					       int nid, int zid)
+{
+	struct mem_cgroup_per_zone *mz = mem_cgroup_zoneinfo(mem, nid, zid);
+	unsigned long nr = 0;
+	enum lru_list l;
+
+	for_each_evictable_lru(l)
+		nr += MEM_CGROUP_ZSTAT(mz, l);
+	return nr;
+}
+
+/*
+ * Reclaim from the cgroups that have a reclaim priority before @zone is
+ * scanned as a whole, highest priority first, so that the cgroups of
+ * background applications give up their pages before the foreground
+ * has to.  Stops once SWAP_CLUSTER_MAX pages were reclaimed, and
+ * returns how many were.
+ */
+unsigned long mem_cgroup_priority_reclaim(struct zone *zone, int order,
+					  gfp_t gfp_mask, int nid, int zid)
+{
+	unsigned int priority = MEM_CGROUP_RECLAIM_PRIORITY_MAX + 1, next;
+	unsigned long nr_reclaimed = 0;
+	struct mem_cgroup *mem;
+	int id;
+
+	if (mem_cgroup_disabled() || order > 0)
+		return 0;
+
+	while (nr_reclaimed < SWAP_CLUSTER_MAX) {
+		/* the next lower priority with pages in this zone */
+		next = 0;
+		id = 1;
+		while ((mem = mem_cgroup_get_next(&id))) {
+			if (mem->reclaim_priority < priority &&
+			    mem->reclaim_priority > next &&
+			    mem_cgroup_zone_evictable(mem, nid, zid))
+				next = mem->reclaim_priority;
+			css_put(&mem->css);
+		}
+		if (!next)
+			break;
+		priority = next;
+
+		id = 1;
+		while ((mem = mem_cgroup_get_next(&id))) {
+			if (mem->reclaim_priority == priority)
+				nr_reclaimed += mem_cgroup_shrink_node_zone(mem,
+						gfp_mask, false,
+						get_swappiness(mem), zone, nid);
+			css_put(&mem->css);
+			if (nr_reclaimed >= SWAP_CLUSTER_MAX)
+				break;
+		}
+	}
+	return nr_reclaimed;
+}
+
 /*
  * This routine traverse page_cgroup in given list and drop them all.
  * *And* this routine doesn't reclaim page itself, just removes page_cgroup.
@@ -2984,7 +3097,7 @@ move_account:
 			goto try_to_free;
 		cond_resched();
 	/* "ret" should also be checked to ensure all lists are empty. */
-	} while (mem->res.usage > 0 || ret);
+	} while (mem_cgroup_usage(mem, false) > 0 || ret);
 out:
 	css_put(&mem->css);
 	return ret;
@@ -2999,7 +3112,7 @@ try_to_free:
 	lru_add_drain_all();
 	/* try to free all pages in this cgroup */
 	shrink = 1;
-	while (nr_retries && mem->res.usage > 0) {
+	while (nr_retries && mem_cgroup_usage(mem, false) > 0) {
 		int progress;
 
 		if (signal_pending(current)) {
@@ -3092,7 +3205,7 @@ static inline u64 mem_cgroup_usage(struct mem_cgroup *mem, bool swap)
 {
 	u64 idx_val, val;
 
-	if (!mem_cgroup_is_root(mem)) {
+	if (mem_cgroup_counted(mem)) {
 		if (!swap)
 			return res_counter_read_u64(&mem->res, RES_USAGE);
 		else
@@ -3156,7 +3269,8 @@ static int mem_cgroup_write(struct cgroup *cont, struct cftype *cft,
 	name = MEMFILE_ATTR(cft->private);
 	switch (name) {
 	case RES_LIMIT:
-		if (mem_cgroup_is_root(memcg)) { /* Can't set limit on root */
+		/* Can't set limit on root, nor without res_counters */
+		if (!mem_cgroup_counted(memcg)) {
 			ret = -EINVAL;
 			break;
 		}
@@ -3170,6 +3284,10 @@ static int mem_cgroup_write(struct cgroup *cont, struct cftype *cft,
 			ret = mem_cgroup_resize_memsw_limit(memcg, val);
 		break;
 	case RES_SOFT_LIMIT:
+		if (memcg_lru_only) {
+			ret = -EINVAL;
+			break;
+		}
 		ret = res_counter_memparse_write_strategy(buffer, &val);
 		if (ret)
 			break;
@@ -3258,6 +3376,9 @@ static int mem_cgroup_move_charge_write(struct cgroup *cgrp,
 
 	if (val >= (1 << NR_MOVE_TYPE))
 		return -EINVAL;
+	/* there are no charges to move without res_counters */
+	if (val && memcg_lru_only)
+		return -EINVAL;
 	/*
 	 * We check this value several times in both in can_attach() and
 	 * attach(), so we need cgroup lock to prevent this value from being
@@ -3461,6 +3582,27 @@ static int mem_cgroup_swappiness_write(struct cgroup *cgrp, struct cftype *cft,
 	return 0;
 }
 
+static u64 mem_cgroup_reclaim_priority_read(struct cgroup *cgrp,
+					    struct cftype *cft)
+{
+	return mem_cgroup_from_cont(cgrp)->reclaim_priority;
+}
+
+static int mem_cgroup_reclaim_priority_write(struct cgroup *cgrp,
+					     struct cftype *cft, u64 val)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_cont(cgrp);
+
+	if (val > MEM_CGROUP_RECLAIM_PRIORITY_MAX)
+		return -EINVAL;
+	/* root's pages are not on per cgroup LRU lists */
+	if (cgrp->parent == NULL)
+		return -EINVAL;
+
+	memcg->reclaim_priority = val;
+	return 0;
+}
+
 static void __mem_cgroup_threshold(struct mem_cgroup *memcg, bool swap)
 {
 	struct mem_cgroup_threshold_ary *t;
@@ -3837,6 +3979,11 @@ static struct cftype mem_cgroup_files[] = {
 		.read_u64 = mem_cgroup_swappiness_read,
 		.write_u64 = mem_cgroup_swappiness_write,
 	},
+	{
+		.name = "reclaim_priority",
+		.read_u64 = mem_cgroup_reclaim_priority_read,
+		.write_u64 = mem_cgroup_reclaim_priority_write,
+	},
 	{
 		.name = "move_charge_at_immigrate",
 		.read_u64 = mem_cgroup_move_charge_read,
@@ -4021,7 +4168,8 @@ static struct mem_cgroup *parent_mem_cgroup(struct mem_cgroup *mem)
 #ifdef CONFIG_CGROUP_MEM_RES_CTLR_SWAP
 static void __init enable_swap_cgroup(void)
 {
-	if (!mem_cgroup_disabled() && really_do_swap_account)
+	if (!mem_cgroup_disabled() && really_do_swap_account &&
+	    !memcg_lru_only)
 		do_swap_account = 1;
 }
 #else
@@ -4108,8 +4256,10 @@ mem_cgroup_create(struct cgroup_subsys *ss, struct cgroup *cont)
 	spin_lock_init(&mem->reclaim_param_lock);
 	INIT_LIST_HEAD(&mem->oom_notify);
 
-	if (parent)
+	if (parent) {
 		mem->swappiness = get_swappiness(parent);
+		mem->reclaim_priority = parent->reclaim_priority;
+	}
 	atomic_set(&mem->refcnt, 1);
 	mem->move_charge_at_immigrate = 0;
 	mutex_init(&mem->thresholds_lock);
@@ -4655,3 +4805,10 @@ static int __init disable_swap_account(char *s)
 }
 __setup("noswapaccount", disable_swap_account);
 #endif
+
+static int __init enable_memcg_lru_only(char *s)
+{
+	memcg_lru_only = 1;
+	return 1;
+}
+__setup("memcg_lru_only", enable_memcg_lru_only);
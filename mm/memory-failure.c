@@ -1137,7 +1137,7 @@ static struct page *new_page(struct page *p, unsigned long private, int **x)
  */
 static int get_any_page(struct page *p, unsigned long pfn, int flags)
 {
-	int ret;
+	int ret, migratetype;
 
 	if (flags & MF_COUNT_INCREASED)
 		return 1;
@@ -1153,6 +1153,7 @@ static int get_any_page(struct page *p, unsigned long pfn, int flags)
 	 * Isolate the page, so that it doesn't get reallocated if it
 	 * was free.
 	 */
+	migratetype = get_pageblock_migratetype(p);
 	set_migratetype_isolate(p);
 	if (!get_page_unless_zero(compound_head(p))) {
 		if (is_free_buddy_page(p)) {
@@ -1169,7 +1170,7 @@ static int get_any_page(struct page *p, unsigned long pfn, int flags)
 		/* Not a free page */
 		ret = 1;
 	}
-	unset_migratetype_isolate(p);
+	unset_migratetype_isolate(p, migratetype);
 	unlock_system_sleep();
 	return ret;
 }
@@ -57,6 +57,7 @@
 #include <linux/swapops.h>
 #include <linux/elf.h>
 #include <linux/gfp.h>
+#include <linux/file.h>
 
 #include <asm/io.h>
 #include <asm/pgalloc.h>
@@ -3227,6 +3228,220 @@ int handle_mm_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 	return handle_pte_fault(mm, vma, address, pte, pmd, flags);
 }
 
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+/*
+ * Left to handle_mm_fault(): stacks need expand_stack() and the guard
+ * page, mlocked vmas the mlock accounting, and the others have no
+ * struct page or no linear mapping to the file.
+ */
+#define VM_NO_SPECULATIVE	(VM_GROWSDOWN | VM_GROWSUP | VM_LOCKED | \
+				 VM_IO | VM_PFNMAP | VM_MIXEDMAP | \
+				 VM_HUGETLB | VM_NONLINEAR)
+
+/*
+ * Whether any vma of @mm changed since @seq was read.  Speculative
+ * faults are only built for uniprocessor kernels, so once the caller has
+ * disabled preemption no vma can change until it enables it again.
+ */
+static inline int vma_seq_changed(struct mm_struct *mm, unsigned int seq)
+{
+	smp_rmb();
+	return mm->vma_seq.sequence != seq;
+}
+
+/*
+ * Handle a fault on a pte that was never populated, in an anonymous or
+ * page cache mapping, without mmap_sem.  The vma is looked up and copied
+ * with preemption disabled, the page is allocated or read in using the
+ * copy, and it is only mapped if no vma of the process changed in the
+ * meantime, again with preemption disabled and now under the pte lock.
+ * @vm_flags are the permissions of which the vma needs at least one for
+ * the access to be valid.
+ *
+ * Returns VM_FAULT_RETRY if the fault has to be handled by
+ * handle_mm_fault() with mmap_sem held instead.
+ */
+int handle_speculative_fault(struct mm_struct *mm, unsigned long address,
+			     unsigned int flags, unsigned long vm_flags)
+{
+	struct vm_area_struct *vma, copy;
+	struct page *page = NULL;
+	struct vm_fault vmf;
+	unsigned int seq;
+	pgd_t *pgd;
+	pud_t *pud;
+	pmd_t *pmd, orig_pmd;
+	pte_t *pte, entry;
+	spinlock_t *ptl;
+	int file, anon = 0, charged = 0, ret = 0;
+
+	address &= PAGE_MASK;
+	vmf.page = NULL;
+
+	preempt_disable();
+	seq = mm->vma_seq.sequence;
+	smp_rmb();
+	if (seq & 1)
+		goto out_preempt;
+
+	vma = find_vma(mm, address);
+	if (!vma || vma->vm_start > address || !(vma->vm_flags & vm_flags) ||
+	    (vma->vm_flags & VM_NO_SPECULATIVE))
+		goto out_preempt;
+	/*
+	 * As in handle_pte_fault(), a vma without vm_ops is anonymous even if
+	 * it has a vm_file, like a private mapping of /dev/zero.
+	 */
+	file = vma->vm_ops != NULL;
+	if (file) {
+		/* page cache read faults and private write faults only */
+		if (vma->vm_ops->fault != filemap_fault)
+			goto out_preempt;
+		if ((flags & FAULT_FLAG_WRITE) && (vma->vm_flags & VM_SHARED))
+			goto out_preempt;
+	}
+	if ((flags & FAULT_FLAG_WRITE) && !vma->anon_vma)
+		goto out_preempt;
+
+	/* only page tables that are already there are used */
+	pgd = pgd_offset(mm, address);
+	if (pgd_none(*pgd) || unlikely(pgd_bad(*pgd)))
+		goto out_preempt;
+	pud = pud_offset(pgd, address);
+	if (pud_none(*pud) || unlikely(pud_bad(*pud)))
+		goto out_preempt;
+	pmd = pmd_offset(pud, address);
+	orig_pmd = *pmd;
+	if (pmd_none(orig_pmd) || unlikely(pmd_bad(orig_pmd)))
+		goto out_preempt;
+	pte = pte_offset_map(pmd, address);
+	entry = *pte;
+	pte_unmap(pte);
+	if (!pte_none(entry))
+		goto out_preempt;
+
+	copy = *vma;
+	if (copy.vm_file)
+		get_file(copy.vm_file);
+	preempt_enable();
+
+	__set_current_state(TASK_RUNNING);
+	check_sync_rss_stat(current);
+
+	if (!file) {
+		if (!(flags & FAULT_FLAG_WRITE)) {
+			/* use the zero-page for reads */
+			entry = pte_mkspecial(pfn_pte(my_zero_pfn(address),
+						      copy.vm_page_prot));
+			goto commit;
+		}
+		page = alloc_zeroed_user_highpage_movable(&copy, address);
+		if (!page)
+			goto out;
+		__SetPageUptodate(page);
+		anon = 1;
+	} else {
+		vmf.virtual_address = (void __user *)address;
+		vmf.pgoff = ((address - copy.vm_start) >> PAGE_SHIFT) +
+			    copy.vm_pgoff;
+		vmf.flags = flags;
+		ret = filemap_fault(&copy, &vmf);
+		if (unlikely(ret & (VM_FAULT_ERROR | VM_FAULT_NOPAGE))) {
+			vmf.page = NULL;
+			goto out;
+		}
+		if (unlikely(PageHWPoison(vmf.page)))
+			goto out;
+		page = vmf.page;
+
+		/* early C-O-W break, as in __do_fault() */
+		if (flags & FAULT_FLAG_WRITE) {
+			page = alloc_page_vma(GFP_HIGHUSER_MOVABLE, &copy,
+					      address);
+			if (!page)
+				goto out;
+			anon = 1;
+			copy_user_highpage(page, vmf.page, address, &copy);
+			__SetPageUptodate(page);
+		}
+	}
+	if (anon) {
+		if (mem_cgroup_newpage_charge(page, mm, GFP_KERNEL))
+			goto out;
+		charged = 1;
+	}
+
+	entry = mk_pte(page, copy.vm_page_prot);
+	if (flags & FAULT_FLAG_WRITE)
+		entry = maybe_mkwrite(pte_mkdirty(entry), &copy);
+
+commit:
+	preempt_disable();
+	if (vma_seq_changed(mm, seq) || pmd_val(*pmd) != pmd_val(orig_pmd)) {
+		preempt_enable();
+		goto out;
+	}
+	pte = pte_offset_map_lock(mm, pmd, address, &ptl);
+	preempt_enable();
+
+	if (unlikely(!pte_none(*pte))) {
+		/* another fault on the same page got there first */
+		pte_unmap_unlock(pte, ptl);
+		ret = 0;
+		goto out_release;
+	}
+	if (anon) {
+		inc_mm_counter_fast(mm, MM_ANONPAGES);
+		page_add_new_anon_rmap(page, vma, address);
+	} else if (page) {
+		flush_icache_page(vma, page);
+		inc_mm_counter_fast(mm, MM_FILEPAGES);
+		page_add_file_rmap(page);
+	}
+	set_pte_at(mm, address, pte, entry);
+
+	/* no need to invalidate: a not-present page won't be cached */
+	update_mmu_cache(vma, address, pte);
+	pte_unmap_unlock(pte, ptl);
+
+	if (vmf.page) {
+		unlock_page(vmf.page);
+		if (anon)
+			page_cache_release(vmf.page);
+	}
+	if (copy.vm_file)
+		fput(copy.vm_file);
+	count_vm_event(PGFAULT);
+	count_vm_event(SPECULATIVE_FAULT);
+	return ret & VM_FAULT_MAJOR;
+
+out_preempt:
+	preempt_enable();
+	count_vm_event(SPECULATIVE_FAULT_RETRY);
+	return VM_FAULT_RETRY;
+
+out:
+	ret = VM_FAULT_RETRY;
+out_release:
+	if (anon) {
+		if (charged)
+			mem_cgroup_uncharge_page(page);
+		page_cache_release(page);
+	}
+	if (vmf.page) {
+		unlock_page(vmf.page);
+		page_cache_release(vmf.page);
+	}
+	if (copy.vm_file)
+		fput(copy.vm_file);
+	if (ret & VM_FAULT_RETRY)
+		count_vm_event(SPECULATIVE_FAULT_RETRY);
+	else
+		count_vm_event(PGFAULT);
+	return ret;
+}
+#endif
+
 #ifndef __PAGETABLE_PUD_FOLDED
 /*
  * Allocate page upper directory.
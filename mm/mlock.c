@@ -426,7 +426,9 @@ success:
 	 */
 
 	if (lock) {
+		vma_seq_begin(mm);
 		vma->vm_flags = newflags;
+		vma_seq_end(mm);
 		ret = __mlock_vma_pages_range(vma, start, end);
 		if (ret < 0)
 			ret = __mlock_posix_error_return(ret);
@@ -459,10 +459,12 @@ static void vma_link(struct mm_struct *mm, struct vm_area_struct *vma,
 		vma->vm_truncate_count = mapping->truncate_count;
 	}
 	anon_vma_lock(vma);
+	vma_seq_begin(mm);
 
 	__vma_link(mm, vma, prev, rb_link, rb_parent);
 	__vma_link_file(vma);
 
+	vma_seq_end(mm);
 	anon_vma_unlock(vma);
 	if (mapping)
 		spin_unlock(&mapping->i_mmap_lock);
@@ -563,6 +565,7 @@ again:			remove_next = 1 + (end > next->vm_end);
 		}
 	}
 
+	vma_seq_begin(mm);
 	if (file) {
 		mapping = file->f_mapping;
 		if (!(vma->vm_flags & VM_NONLINEAR))
@@ -629,6 +632,7 @@ again:			remove_next = 1 + (end > next->vm_end);
 
 	if (mapping)
 		spin_unlock(&mapping->i_mmap_lock);
+	vma_seq_end(mm);
 
 	if (remove_next) {
 		if (file) {
@@ -1906,6 +1910,7 @@ detach_vmas_to_be_unmapped(struct mm_struct *mm, struct vm_area_struct *vma,
 	struct vm_area_struct *tail_vma = NULL;
 	unsigned long addr;
 
+	vma_seq_begin(mm);
 	insertion_point = (prev ? &prev->vm_next : &mm->mmap);
 	vma->vm_prev = NULL;
 	do {
@@ -1924,6 +1929,7 @@ detach_vmas_to_be_unmapped(struct mm_struct *mm, struct vm_area_struct *vma,
 		addr = vma ?  vma->vm_start : mm->mmap_base;
 	mm->unmap_area(mm, addr);
 	mm->mmap_cache = NULL;		/* Kill the cache. */
+	vma_seq_end(mm);
 }
 
 /*
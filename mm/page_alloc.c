@@ -34,6 +34,7 @@
 #include <linux/topology.h>
 #include <linux/sysctl.h>
 #include <linux/cpu.h>
+#include <linux/kthread.h>
 #include <linux/cpuset.h>
 #include <linux/memory_hotplug.h>
 #include <linux/nodemask.h>
@@ -45,6 +46,8 @@
 #include <linux/backing-dev.h>
 #include <linux/fault-inject.h>
 #include <linux/page-isolation.h>
+#include <linux/migrate.h>
+#include <linux/mm_inline.h>
 #include <linux/page_cgroup.h>
 #include <linux/debugobjects.h>
 #include <linux/kmemleak.h>
@@ -626,6 +629,34 @@ static void free_pcppages_bulk(struct zone *zone, int count,
 	spin_unlock(&zone->lock);
 }
 
+#ifdef CONFIG_ZEROED_PAGE_CACHE
+/*
+ * Give the pre-zeroed pages of a pcp back to the buddy allocator.  Called
+ * with interrupts disabled.
+ */
+static void free_zeroed_pages(struct zone *zone, struct per_cpu_pages *pcp)
+{
+	struct page *page, *next;
+
+	if (!pcp->zeroed_count)
+		return;
+
+	spin_lock(&zone->lock);
+	list_for_each_entry_safe(page, next, &pcp->zeroed, lru) {
+		list_del(&page->lru);
+		__free_one_page(page, zone, 0, page_private(page));
+	}
+	__mod_zone_page_state(zone, NR_FREE_PAGES, pcp->zeroed_count);
+	pcp->zeroed_count = 0;
+	spin_unlock(&zone->lock);
+}
+#else
+static inline void free_zeroed_pages(struct zone *zone,
+				     struct per_cpu_pages *pcp)
+{
+}
+#endif
+
 static void free_one_page(struct zone *zone, struct page *page, int order,
 				int migratetype)
 {
@@ -819,11 +850,17 @@ struct page *__rmqueue_smallest(struct zone *zone, unsigned int order,
  * This array describes the order lists are fallen back to when
  * the free lists for the desirable migrate type are depleted
  */
-static int fallbacks[MIGRATE_TYPES][MIGRATE_TYPES-1] = {
-	[MIGRATE_UNMOVABLE]   = { MIGRATE_RECLAIMABLE, MIGRATE_MOVABLE,   MIGRATE_RESERVE },
-	[MIGRATE_RECLAIMABLE] = { MIGRATE_UNMOVABLE,   MIGRATE_MOVABLE,   MIGRATE_RESERVE },
-	[MIGRATE_MOVABLE]     = { MIGRATE_RECLAIMABLE, MIGRATE_UNMOVABLE, MIGRATE_RESERVE },
-	[MIGRATE_RESERVE]     = { MIGRATE_RESERVE,     MIGRATE_RESERVE,   MIGRATE_RESERVE }, /* Never used */
+static int fallbacks[MIGRATE_TYPES][4] = {
+	[MIGRATE_UNMOVABLE]   = { MIGRATE_RECLAIMABLE, MIGRATE_MOVABLE,     MIGRATE_RESERVE },
+	[MIGRATE_RECLAIMABLE] = { MIGRATE_UNMOVABLE,   MIGRATE_MOVABLE,     MIGRATE_RESERVE },
+#ifdef CONFIG_CMA
+	/* CMA pageblocks only ever lend pages to movable allocations */
+	[MIGRATE_MOVABLE]     = { MIGRATE_CMA,         MIGRATE_RECLAIMABLE, MIGRATE_UNMOVABLE, MIGRATE_RESERVE },
+	[MIGRATE_CMA]         = { MIGRATE_RESERVE }, /* Never used */
+#else
+	[MIGRATE_MOVABLE]     = { MIGRATE_RECLAIMABLE, MIGRATE_UNMOVABLE,   MIGRATE_RESERVE },
+#endif
+	[MIGRATE_RESERVE]     = { MIGRATE_RESERVE }, /* Never used */
 };
 
 /*
@@ -919,12 +956,12 @@ __rmqueue_fallback(struct zone *zone, int order, int start_migratetype)
 	/* Find the largest possible block of pages in the other list */
 	for (current_order = MAX_ORDER-1; current_order >= order;
 						--current_order) {
-		for (i = 0; i < MIGRATE_TYPES - 1; i++) {
+		for (i = 0;; i++) {
 			migratetype = fallbacks[start_migratetype][i];
 
 			/* MIGRATE_RESERVE handled later if necessary */
 			if (migratetype == MIGRATE_RESERVE)
-				continue;
+				break;
 
 			area = &(zone->free_area[current_order]);
 			if (list_empty(&area->free_list[migratetype]))
@@ -938,11 +975,14 @@ __rmqueue_fallback(struct zone *zone, int order, int start_migratetype)
 			 * If breaking a large block of pages, move all free
 			 * pages to the preferred allocation list. If falling
 			 * back for a reclaimable kernel allocation, be more
-			 * agressive about taking ownership of free pages
+			 * agressive about taking ownership of free pages.
+			 * CMA pageblocks are only borrowed from, never taken
+			 * over.
 			 */
-			if (unlikely(current_order >= (pageblock_order >> 1)) ||
+			if (!is_migrate_cma(migratetype) &&
+			    (unlikely(current_order >= (pageblock_order >> 1)) ||
 					start_migratetype == MIGRATE_RECLAIMABLE ||
-					page_group_by_mobility_disabled) {
+					page_group_by_mobility_disabled)) {
 				unsigned long pages;
 				pages = move_freepages_block(zone, page,
 								start_migratetype);
@@ -961,7 +1001,8 @@ __rmqueue_fallback(struct zone *zone, int order, int start_migratetype)
 			rmv_page_order(page);
 
 			/* Take ownership for orders >= pageblock_order */
-			if (current_order >= pageblock_order)
+			if (current_order >= pageblock_order &&
+			    !is_migrate_cma(migratetype))
 				change_pageblock_range(page, current_order,
 							start_migratetype);
 
@@ -1038,6 +1079,11 @@ static int rmqueue_bulk(struct zone *zone, unsigned int order,
 		else
 			list_add_tail(&page->lru, list);
 		set_page_private(page, migratetype);
+#ifdef CONFIG_CMA
+		/* pages borrowed from CMA must go back to the CMA lists */
+		if (is_migrate_cma(get_pageblock_migratetype(page)))
+			set_page_private(page, MIGRATE_CMA);
+#endif
 		list = &page->lru;
 	}
 	__mod_zone_page_state(zone, NR_FREE_PAGES, -(i << order));
@@ -1092,6 +1138,7 @@ static void drain_pages(unsigned int cpu)
 		pcp = &pset->pcp;
 		free_pcppages_bulk(zone, pcp->count, pcp);
 		pcp->count = 0;
+		free_zeroed_pages(zone, pcp);
 		local_irq_restore(flags);
 	}
 }
@@ -1273,6 +1320,166 @@ int split_free_page(struct page *page)
 	return 1 << order;
 }
 
+#ifdef CONFIG_ZEROED_PAGE_CACHE
+/*
+ * Every cpu keeps up to pcp->batch pages of each lowmem zone cleared in
+ * advance, for the order-0 __GFP_ZERO allocations of page tables, binder
+ * buffers and get_zeroed_page().  The clearing is done by a SCHED_IDLE
+ * thread per cpu, so it only uses time nobody else wants.  The pages are
+ * taken from the buddy allocator only while the zone is above its high
+ * watermark and are given back by drain_pages().
+ *
+ * The pages all come from MIGRATE_UNMOVABLE pageblocks, like the
+ * allocations they are meant for, and only serve MIGRATE_UNMOVABLE
+ * requests: a movable or reclaimable allocation getting one would pin an
+ * unmovable pageblock and defeat anti-fragmentation.
+ */
+static DEFINE_PER_CPU(struct task_struct *, kzerod_task);
+
+/*
+ * Take a cleared page for an allocation of @migratetype off @pcp.  Called
+ * with interrupts disabled; sets *@refill when the kzerod of this cpu
+ * should be woken up.
+ */
+static inline struct page *rmqueue_zeroed(struct per_cpu_pages *pcp,
+					  int migratetype, bool *refill)
+{
+	struct page *page;
+
+	if (migratetype != MIGRATE_UNMOVABLE || !pcp->zeroed_count)
+		return NULL;
+
+	page = list_first_entry(&pcp->zeroed, struct page, lru);
+	list_del(&page->lru);
+	if (--pcp->zeroed_count < pcp->batch / 2)
+		*refill = true;
+	return page;
+}
+
+static void wake_up_kzerod(int cpu)
+{
+	struct task_struct *tsk = per_cpu(kzerod_task, cpu);
+
+	if (tsk)
+		wake_up_process(tsk);
+}
+
+static void refill_zeroed_pages(struct zone *zone, int cpu)
+{
+	struct per_cpu_pages *pcp = &per_cpu_ptr(zone->pageset, cpu)->pcp;
+	struct page *page;
+	unsigned long flags;
+	LIST_HEAD(list);
+	int nr;
+
+	nr = pcp->batch - pcp->zeroed_count;
+	if (nr <= 0 || !zone_watermark_ok(zone, 0, high_wmark_pages(zone), 0, 0))
+		return;
+
+	local_irq_save(flags);
+	nr = rmqueue_bulk(zone, 0, nr, &list, MIGRATE_UNMOVABLE, 0);
+	local_irq_restore(flags);
+
+	list_for_each_entry(page, &list, lru) {
+		clear_page(page_address(page));
+		cond_resched();
+	}
+
+	local_irq_save(flags);
+	list_splice(&list, &pcp->zeroed);
+	pcp->zeroed_count += nr;
+	local_irq_restore(flags);
+}
+
+static int kzerod(void *data)
+{
+	struct sched_param param = { .sched_priority = 0 };
+	int cpu = (long)data;
+	struct zone *zone;
+
+	sched_setscheduler(current, SCHED_IDLE, &param);
+
+	set_current_state(TASK_INTERRUPTIBLE);
+	while (!kthread_should_stop()) {
+		schedule();
+		__set_current_state(TASK_RUNNING);
+
+		for_each_populated_zone(zone) {
+			if (kthread_should_stop())
+				break;
+			if (!is_highmem(zone))
+				refill_zeroed_pages(zone, cpu);
+		}
+		set_current_state(TASK_INTERRUPTIBLE);
+	}
+	__set_current_state(TASK_RUNNING);
+	return 0;
+}
+
+static int __cpuinit kzerod_cpu_notify(struct notifier_block *nfb,
+				       unsigned long action, void *hcpu)
+{
+	int cpu = (long)hcpu;
+	struct task_struct *p;
+
+	switch (action & ~CPU_TASKS_FROZEN) {
+	case CPU_UP_PREPARE:
+		p = kthread_create(kzerod, hcpu, "kzerod/%d", cpu);
+		if (IS_ERR(p)) {
+			printk(KERN_ERR "kzerod for cpu %d failed\n", cpu);
+			return notifier_from_errno(PTR_ERR(p));
+		}
+		kthread_bind(p, cpu);
+		per_cpu(kzerod_task, cpu) = p;
+		break;
+	case CPU_ONLINE:
+		wake_up_kzerod(cpu);
+		break;
+#ifdef CONFIG_HOTPLUG_CPU
+	case CPU_UP_CANCELED:
+	case CPU_DEAD:
+		p = per_cpu(kzerod_task, cpu);
+		if (!p)
+			break;
+		/* Unbind so it can run */
+		kthread_bind(p, cpumask_any(cpu_online_mask));
+		per_cpu(kzerod_task, cpu) = NULL;
+		kthread_stop(p);
+		break;
+#endif /* CONFIG_HOTPLUG_CPU */
+	}
+	return NOTIFY_OK;
+}
+
+/* Called before page_alloc_cpu_notify() drains the pages of a dead cpu */
+static struct notifier_block __cpuinitdata kzerod_cpu_nfb = {
+	.notifier_call = kzerod_cpu_notify,
+	.priority = 1,
+};
+
+static __init int kzerod_init(void)
+{
+	void *cpu = (void *)(long)smp_processor_id();
+	int err = kzerod_cpu_notify(&kzerod_cpu_nfb, CPU_UP_PREPARE, cpu);
+
+	BUG_ON(err != NOTIFY_OK);
+	kzerod_cpu_notify(&kzerod_cpu_nfb, CPU_ONLINE, cpu);
+	register_cpu_notifier(&kzerod_cpu_nfb);
+	return 0;
+}
+early_initcall(kzerod_init);
+#else
+static inline struct page *rmqueue_zeroed(struct per_cpu_pages *pcp,
+					  int migratetype, bool *refill)
+{
+	return NULL;
+}
+
+static inline void wake_up_kzerod(int cpu)
+{
+}
+#endif /* CONFIG_ZEROED_PAGE_CACHE */
+
 /*
  * Really, prep_compound_page() should be called from __rmqueue_bulk().  But
  * we cheat by calling it from here, in the order > 0 path.  Saves a branch
@@ -1286,14 +1493,27 @@ struct page *buffered_rmqueue(struct zone *preferred_zone,
 	unsigned long flags;
 	struct page *page;
 	int cold = !!(gfp_flags & __GFP_COLD);
+	gfp_t prep_flags;
+	bool refill;
+	int cpu;
 
 again:
+	prep_flags = gfp_flags;
+	refill = false;
 	if (likely(order == 0)) {
 		struct per_cpu_pages *pcp;
 		struct list_head *list;
 
 		local_irq_save(flags);
+		cpu = smp_processor_id();
 		pcp = &this_cpu_ptr(zone->pageset)->pcp;
+		if (gfp_flags & __GFP_ZERO) {
+			page = rmqueue_zeroed(pcp, migratetype, &refill);
+			if (page) {
+				prep_flags &= ~__GFP_ZERO;
+				goto got_page;
+			}
+		}
 		list = &pcp->lists[migratetype];
 		if (list_empty(list)) {
 			pcp->count += rmqueue_bulk(zone, 0,
@@ -1311,6 +1531,7 @@ again:
 		list_del(&page->lru);
 		pcp->count--;
 	} else {
+		cpu = -1;
 		if (unlikely(gfp_flags & __GFP_NOFAIL)) {
 			/*
 			 * __GFP_NOFAIL is not to be used in new code.
@@ -1332,12 +1553,16 @@ again:
 		__mod_zone_page_state(zone, NR_FREE_PAGES, -(1 << order));
 	}
 
+got_page:
 	__count_zone_vm_events(PGALLOC, zone, 1 << order);
 	zone_statistics(preferred_zone, zone);
 	local_irq_restore(flags);
 
+	if (refill)
+		wake_up_kzerod(cpu);
+
 	VM_BUG_ON(bad_range(zone, page));
-	if (prep_new_page(page, order, gfp_flags))
+	if (prep_new_page(page, order, prep_flags))
 		goto again;
 	return page;
 
@@ -1788,13 +2013,16 @@ __alloc_pages_direct_compact(gfp_t gfp_mask, unsigned int order,
 	int migratetype, unsigned long *did_some_progress)
 {
 	struct page *page;
+	ktime_t start;
 
 	if (!order || compaction_deferred(preferred_zone))
 		return NULL;
 
+	start = stall_start();
 	*did_some_progress = try_to_compact_pages(zonelist, order, gfp_mask,
 								nodemask);
 	if (*did_some_progress != COMPACT_SKIPPED) {
+		compact_stall_end(start, order, *did_some_progress);
 
 		/* Page migration frees to the PCP lists but we want merging */
 		drain_pages(get_cpu());
@@ -1996,6 +2224,7 @@ __alloc_pages_slowpath(gfp_t gfp_mask, unsigned int order,
 
 restart:
 	wake_all_kswapd(order, zonelist, high_zoneidx);
+	wakeup_kcompactd(order);
 
 	/*
 	 * OK, we're below the kswapd watermark and have kicked background
@@ -2214,6 +2443,247 @@ void free_pages(unsigned long addr, unsigned int order)
 
 EXPORT_SYMBOL(free_pages);
 
+#ifdef CONFIG_ZEROED_PAGE_CACHE
+/* Take up to @nr of this cpu's cleared pages of @zone onto @list */
+static unsigned long rmqueue_zeroed_bulk(struct zone *zone, int migratetype,
+				unsigned long nr, struct list_head *list)
+{
+	struct per_cpu_pages *pcp;
+	struct page *page;
+	unsigned long flags, got = 0;
+	bool refill = false;
+	int cpu;
+
+	local_irq_save(flags);
+	cpu = smp_processor_id();
+	pcp = &this_cpu_ptr(zone->pageset)->pcp;
+	while (got < nr) {
+		page = rmqueue_zeroed(pcp, migratetype, &refill);
+		if (!page)
+			break;
+		list_add_tail(&page->lru, list);
+		got++;
+	}
+	__count_zone_vm_events(PGALLOC, zone, got);
+	local_irq_restore(flags);
+
+	if (refill)
+		wake_up_kzerod(cpu);
+	return got;
+}
+#else
+static inline unsigned long rmqueue_zeroed_bulk(struct zone *zone,
+				int migratetype, unsigned long nr,
+				struct list_head *list)
+{
+	return 0;
+}
+#endif
+
+/**
+ * alloc_pages_bulk - allocate a number of order-0 pages
+ * @gfp_mask: GFP flags for the allocation
+ * @nr_pages: the number of pages wanted
+ * @list: the pages are added to the tail of this list, linked by page->lru
+ *
+ * While the zones are above their low watermark the pages are taken from
+ * the buddy lists directly, PAGES_BULK_BATCH at a time under one hold of
+ * zone->lock, instead of through the per-cpu lists a pcp->batch at a time.
+ * The rest, if any, comes from alloc_page() and may enter reclaim.
+ *
+ * Returns the number of pages added to @list, which is less than
+ * @nr_pages only if alloc_page() failed too.
+ */
+unsigned long alloc_pages_bulk(gfp_t gfp_mask, unsigned long nr_pages,
+			       struct list_head *list)
+{
+	enum zone_type high_zoneidx = gfp_zone(gfp_mask);
+	int migratetype = allocflags_to_migratetype(gfp_mask);
+	struct zonelist *zonelist = node_zonelist(numa_node_id(), gfp_mask);
+	struct zone *preferred_zone, *zone;
+	struct page *page, *next;
+	struct zoneref *z;
+	unsigned long nr = 0, flags;
+	LIST_HEAD(pages);
+	LIST_HEAD(zeroed);
+
+	gfp_mask &= gfp_allowed_mask;
+	might_sleep_if(gfp_mask & __GFP_WAIT);
+
+	get_mems_allowed();
+	first_zones_zonelist(zonelist, high_zoneidx, NULL, &preferred_zone);
+	if (!preferred_zone)
+		goto slow;
+
+	for_each_zone_zonelist(zone, z, zonelist, high_zoneidx) {
+		if (!cpuset_zone_allowed_softwall(zone, gfp_mask))
+			continue;
+
+		if (gfp_mask & __GFP_ZERO)
+			nr += rmqueue_zeroed_bulk(zone, migratetype,
+						  nr_pages - nr, &zeroed);
+
+		while (nr < nr_pages) {
+			unsigned long batch = min(nr_pages - nr,
+						  (unsigned long)PAGES_BULK_BATCH);
+			int i, got;
+
+			if (!zone_watermark_ok(zone, 0,
+					low_wmark_pages(zone) + batch,
+					zone_idx(preferred_zone), 0))
+				break;
+
+			local_irq_save(flags);
+			got = rmqueue_bulk(zone, 0, batch, &pages, migratetype, 0);
+			__count_zone_vm_events(PGALLOC, zone, got);
+			for (i = 0; i < got; i++)
+				zone_statistics(preferred_zone, zone);
+			local_irq_restore(flags);
+
+			nr += got;
+			if (got < batch)
+				break;
+		}
+		if (nr == nr_pages)
+			break;
+	}
+
+	/* a page failing the checks is leaked, as in buffered_rmqueue() */
+	list_for_each_entry_safe(page, next, &zeroed, lru) {
+		list_del(&page->lru);
+		if (prep_new_page(page, 0, gfp_mask & ~__GFP_ZERO)) {
+			nr--;
+			continue;
+		}
+		list_add_tail(&page->lru, list);
+		trace_mm_page_alloc(page, 0, gfp_mask, migratetype);
+	}
+	list_for_each_entry_safe(page, next, &pages, lru) {
+		list_del(&page->lru);
+		if (prep_new_page(page, 0, gfp_mask)) {
+			nr--;
+			continue;
+		}
+		list_add_tail(&page->lru, list);
+		trace_mm_page_alloc(page, 0, gfp_mask, migratetype);
+	}
+
+slow:
+	put_mems_allowed();
+	while (nr < nr_pages) {
+		page = alloc_page(gfp_mask);
+		if (!page)
+			break;
+		list_add_tail(&page->lru, list);
+		nr++;
+	}
+	return nr;
+}
+EXPORT_SYMBOL(alloc_pages_bulk);
+
+/**
+ * alloc_pages_bulk_array - allocate a number of order-0 pages into an array
+ * @gfp_mask: GFP flags for the allocation
+ * @nr_pages: the number of pages wanted
+ * @pages: the pages are stored here
+ *
+ * Like alloc_pages_bulk(), returns the number of entries of @pages filled.
+ */
+unsigned long alloc_pages_bulk_array(gfp_t gfp_mask, unsigned long nr_pages,
+				     struct page **pages)
+{
+	struct page *page, *next;
+	unsigned long i = 0;
+	LIST_HEAD(list);
+
+	alloc_pages_bulk(gfp_mask, nr_pages, &list);
+	list_for_each_entry_safe(page, next, &list, lru) {
+		list_del(&page->lru);
+		pages[i++] = page;
+	}
+	return i;
+}
+EXPORT_SYMBOL(alloc_pages_bulk_array);
+
+/**
+ * free_pages_bulk - free a list of order-0 pages
+ * @list: the pages, linked by page->lru
+ *
+ * Drops a reference to every page on @list.  The pages that are no longer
+ * used go straight back to the buddy lists, taking each zone->lock once
+ * per PAGES_BULK_BATCH pages.  @list is empty afterwards.
+ */
+void free_pages_bulk(struct list_head *list)
+{
+	struct page *page, *next;
+	struct zone *zone = NULL;
+	unsigned long flags;
+	int count = 0, total = 0;
+	LIST_HEAD(pages);
+
+	list_for_each_entry_safe(page, next, list, lru) {
+		list_del(&page->lru);
+		if (!put_page_testzero(page))
+			continue;
+		/* rare, let the single page path do the accounting */
+		if (unlikely(PageMlocked(page))) {
+			free_hot_cold_page(page, 0);
+			continue;
+		}
+		if (!free_pages_prepare(page, 0))
+			continue;
+		set_page_private(page, get_pageblock_migratetype(page));
+		list_add_tail(&page->lru, &pages);
+	}
+
+	local_irq_save(flags);
+	list_for_each_entry_safe(page, next, &pages, lru) {
+		if (page_zone(page) != zone || count == PAGES_BULK_BATCH) {
+			if (zone) {
+				__mod_zone_page_state(zone, NR_FREE_PAGES,
+						      count);
+				spin_unlock(&zone->lock);
+				local_irq_restore(flags);
+				local_irq_save(flags);
+			}
+			zone = page_zone(page);
+			total += count;
+			count = 0;
+
+			spin_lock(&zone->lock);
+			zone->all_unreclaimable = 0;
+			zone->pages_scanned = 0;
+		}
+		list_del(&page->lru);
+		__free_one_page(page, zone, 0, page_private(page));
+		count++;
+	}
+	if (zone) {
+		__mod_zone_page_state(zone, NR_FREE_PAGES, count);
+		spin_unlock(&zone->lock);
+		total += count;
+	}
+	__count_vm_events(PGFREE, total);
+	local_irq_restore(flags);
+}
+EXPORT_SYMBOL(free_pages_bulk);
+
+/**
+ * free_pages_bulk_array - free an array of order-0 pages
+ * @pages: the pages
+ * @nr_pages: the number of entries in @pages
+ */
+void free_pages_bulk_array(struct page **pages, unsigned long nr_pages)
+{
+	unsigned long i;
+	LIST_HEAD(list);
+
+	for (i = 0; i < nr_pages; i++)
+		list_add_tail(&pages[i]->lru, &list);
+	free_pages_bulk(&list);
+}
+EXPORT_SYMBOL(free_pages_bulk_array);
+
 /**
  * alloc_pages_exact - allocate an exact number physically-contiguous pages.
  * @size: the number of bytes to allocate
@@ -3371,6 +3841,9 @@ static void setup_pageset(struct per_cpu_pageset *p, unsigned long batch)
 	pcp->batch = max(1UL, 1 * batch);
 	for (migratetype = 0; migratetype < MIGRATE_PCPTYPES; migratetype++)
 		INIT_LIST_HEAD(&pcp->lists[migratetype]);
+#ifdef CONFIG_ZEROED_PAGE_CACHE
+	INIT_LIST_HEAD(&pcp->zeroed);
+#endif
 }
 
 /*
@@ -3478,6 +3951,7 @@ static int __zone_pcp_update(void *data)
 
 		local_irq_save(flags);
 		free_pcppages_bulk(zone, pcp->count, pcp);
+		free_zeroed_pages(zone, pcp);
 		setup_pageset(pset, batch);
 		local_irq_restore(flags);
 	}
@@ -5303,6 +5777,7 @@ int set_migratetype_isolate(struct page *page)
 
 	spin_lock_irqsave(&zone->lock, flags);
 	if (get_pageblock_migratetype(page) == MIGRATE_MOVABLE ||
+	    is_migrate_cma(get_pageblock_migratetype(page)) ||
 	    zone_idx == ZONE_MOVABLE) {
 		ret = 0;
 		goto out;
@@ -5355,7 +5830,7 @@ out:
 	return ret;
 }
 
-void unset_migratetype_isolate(struct page *page)
+void unset_migratetype_isolate(struct page *page, unsigned migratetype)
 {
 	struct zone *zone;
 	unsigned long flags;
@@ -5363,12 +5838,240 @@ void unset_migratetype_isolate(struct page *page)
 	spin_lock_irqsave(&zone->lock, flags);
 	if (get_pageblock_migratetype(page) != MIGRATE_ISOLATE)
 		goto out;
-	set_pageblock_migratetype(page, MIGRATE_MOVABLE);
-	move_freepages_block(zone, page, MIGRATE_MOVABLE);
+	set_pageblock_migratetype(page, migratetype);
+	move_freepages_block(zone, page, migratetype);
 out:
 	spin_unlock_irqrestore(&zone->lock, flags);
 }
 
+#ifdef CONFIG_CMA
+/*
+ * Free a pageblock of bootmem reserved memory to the buddy allocator as
+ * MIGRATE_CMA.  Movable allocations may use it until alloc_contig_range()
+ * claims it back.
+ */
+void __init init_cma_reserved_pageblock(struct page *page)
+{
+	unsigned i = pageblock_nr_pages;
+	struct page *p = page;
+
+	do {
+		__ClearPageReserved(p);
+		set_page_count(p, 0);
+	} while (++p, --i);
+
+	set_page_refcounted(page);
+	set_pageblock_migratetype(page, MIGRATE_CMA);
+	__free_pages(page, pageblock_order);
+	totalram_pages += pageblock_nr_pages;
+}
+
+#define CONTIG_MIGRATE_BATCH	256
+#define CONTIG_MIGRATE_PASSES	5
+
+/*
+ * Serialises alloc_contig_range().  Two callers whose ranges share a
+ * pageblock would otherwise undo each other's isolation, or both find the
+ * same free pages and take them off the buddy lists twice.
+ */
+static DEFINE_MUTEX(contig_range_mutex);
+
+static struct page *
+contig_migrate_alloc(struct page *page, unsigned long private, int **result)
+{
+	gfp_t gfp_mask = GFP_USER | __GFP_MOVABLE;
+
+	if (PageHighMem(page))
+		gfp_mask |= __GFP_HIGHMEM;
+	return alloc_page(gfp_mask);
+}
+
+/*
+ * Take up to CONTIG_MIGRATE_BATCH LRU pages from [pfn, end) off the LRU.
+ * Returns the pfn to continue at.
+ */
+static unsigned long
+isolate_contig_lru_pages(unsigned long pfn, unsigned long end,
+			 struct list_head *list)
+{
+	struct page *page;
+	int nr = 0;
+
+	for (; pfn < end && nr < CONTIG_MIGRATE_BATCH; pfn++) {
+		if (!pfn_valid_within(pfn))
+			continue;
+		page = pfn_to_page(pfn);
+		if (!PageLRU(page) || isolate_lru_page(page))
+			continue;
+		list_add_tail(&page->lru, list);
+		inc_zone_page_state(page, NR_ISOLATED_ANON +
+				    page_is_file_cache(page));
+		nr++;
+	}
+	return pfn;
+}
+
+/*
+ * Migrate everything on the LRU in [start, end) out of the range, which
+ * must already be isolated so the new pages come from elsewhere.  Pages
+ * that are locked, under writeback or briefly pinned fail a pass, so the
+ * range is walked again a few times before giving up.
+ */
+static int alloc_contig_migrate_range(unsigned long start, unsigned long end)
+{
+	unsigned long pfn;
+	int pass, ret, failed = 0;
+	LIST_HEAD(source);
+
+	for (pass = 0; pass < CONTIG_MIGRATE_PASSES; pass++) {
+		lru_add_drain_all();
+		failed = 0;
+		pfn = start;
+		while (pfn < end) {
+			if (fatal_signal_pending(current))
+				return -EINTR;
+			pfn = isolate_contig_lru_pages(pfn, end, &source);
+			if (!list_empty(&source)) {
+				/* returns the number of pages not moved */
+				ret = migrate_pages(&source, contig_migrate_alloc,
+						    0, 0);
+				if (ret < 0)
+					return ret;
+				failed += ret;
+			}
+			cond_resched();
+		}
+		if (!failed)
+			break;
+	}
+	return failed ? -EBUSY : 0;
+}
+
+/*
+ * Take the free pages in [start, end) off the isolated free lists and
+ * split them into order-0 pages.  The last one may end past @end, the
+ * pfn it ends at is returned, or 0 if a page in the range is not free.
+ */
+static unsigned long take_isolated_free_range(unsigned long start,
+					      unsigned long end)
+{
+	struct zone *zone = page_zone(pfn_to_page(start));
+	unsigned long pfn = start, i, flags;
+	struct page *page;
+	int order;
+
+	spin_lock_irqsave(&zone->lock, flags);
+	while (pfn < end) {
+		page = pfn_to_page(pfn);
+		if (!PageBuddy(page))
+			break;
+		order = page_order(page);
+		list_del(&page->lru);
+		rmv_page_order(page);
+		zone->free_area[order].nr_free--;
+		__mod_zone_page_state(zone, NR_FREE_PAGES, -(1UL << order));
+		set_page_refcounted(page);
+		split_page(page, order);
+		pfn += 1 << order;
+	}
+	spin_unlock_irqrestore(&zone->lock, flags);
+
+	if (pfn < end) {
+		free_contig_range(start, pfn - start);
+		return 0;
+	}
+	for (i = start; i < pfn; i++)
+		kernel_map_pages(pfn_to_page(i), 1, 1);
+	return pfn;
+}
+
+/**
+ * alloc_contig_range() -- allocate a given range of pages
+ * @start:	first PFN to allocate
+ * @end:	one past the last PFN to allocate
+ *
+ * The range must lie in MIGRATE_CMA pageblocks of a single zone.  Pages
+ * of the range in use by movable allocations are migrated elsewhere
+ * first, so this sleeps and can take a while under memory pressure.
+ *
+ * Returns 0 with every page of the range holding a reference count of
+ * one, to be given back with free_contig_range(), or -EBUSY if some page
+ * could not be moved out of the way.
+ */
+int alloc_contig_range(unsigned long start, unsigned long end)
+{
+	unsigned long block_start = start & ~(pageblock_nr_pages - 1);
+	unsigned long block_end = ALIGN(end, pageblock_nr_pages);
+	unsigned long outer_start, outer_end;
+	int order, ret;
+
+	/*
+	 * Nothing can be allocated from isolated pageblocks and pages freed
+	 * there go straight back to the buddy lists, so once everything in
+	 * use has been migrated the whole range ends up free.
+	 */
+	mutex_lock(&contig_range_mutex);
+	ret = start_isolate_page_range(block_start, block_end, MIGRATE_CMA);
+	if (ret)
+		goto out;
+
+	ret = alloc_contig_migrate_range(start, end);
+	if (ret)
+		goto done;
+
+	lru_add_drain_all();
+	drain_all_pages();
+
+	/*
+	 * @start may be in the middle of a free buddy page, whose head is
+	 * where the free pages have to be taken from.
+	 */
+	order = 0;
+	outer_start = start;
+	while (!PageBuddy(pfn_to_page(outer_start))) {
+		if (++order >= MAX_ORDER) {
+			ret = -EBUSY;
+			goto done;
+		}
+		outer_start &= ~0UL << order;
+	}
+	if (outer_start != start) {
+		order = page_order(pfn_to_page(outer_start));
+		if (outer_start + (1UL << order) <= start)
+			outer_start = start;
+	}
+
+	if (test_pages_isolated(outer_start, end)) {
+		ret = -EBUSY;
+		goto done;
+	}
+
+	outer_end = take_isolated_free_range(outer_start, end);
+	if (!outer_end) {
+		ret = -EBUSY;
+		goto done;
+	}
+
+	/* give back what was taken on either side of the range */
+	if (start != outer_start)
+		free_contig_range(outer_start, start - outer_start);
+	if (end != outer_end)
+		free_contig_range(end, outer_end - end);
+
+done:
+	undo_isolate_page_range(block_start, block_end, MIGRATE_CMA);
+out:
+	mutex_unlock(&contig_range_mutex);
+	return ret;
+}
+
+void free_contig_range(unsigned long pfn, unsigned long nr_pages)
+{
+	for (; nr_pages--; pfn++)
+		__free_page(pfn_to_page(pfn));
+}
+#endif
+
 #ifdef CONFIG_MEMORY_HOTREMOVE
 /*
  * All pages in the range must be isolated before calling this.
@@ -17,6 +17,9 @@
 #include <linux/task_io_accounting_ops.h>
 #include <linux/pagevec.h>
 #include <linux/pagemap.h>
+#include <linux/fadvise.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
 
 /*
  * Initialise a struct file's readahead state.  Assumes that the caller has
@@ -179,6 +182,7 @@ __do_page_cache_readahead(struct address_space *mapping, struct file *filp,
 			break;
 		page->index = page_offset;
 		list_add(&page->lru, &page_pool);
+		ra_profile_record(mapping, page_offset, 1);
 		if (page_idx == nr_to_read - lookahead_size)
 			SetPageReadahead(page);
 		ret++;
@@ -568,3 +572,227 @@ page_cache_async_readahead(struct address_space *mapping,
 #endif
 }
 EXPORT_SYMBOL_GPL(page_cache_async_readahead);
+
+#ifdef CONFIG_READAHEAD_PROFILE
+/*
+ * Readahead profiles.
+ *
+ * Application launch reads scattered pages of the same files in the same
+ * order every time, which the heuristics above cannot predict.  While a
+ * profile is recorded, every page that has to be read into the file's
+ * page cache is logged, as a list of extents in the order they were
+ * missed.  Replaying the profile sorts and merges the extents and reads
+ * all pages that are not cached any more in file order, in as few
+ * ->readpages() calls as possible.  The launcher drives this with
+ * POSIX_FADV_RA_RECORD, POSIX_FADV_RA_STOP and POSIX_FADV_RA_REPLAY;
+ * a profile lives as long as the inode.
+ */
+#define RA_PROFILE_TIMEOUT	(10 * HZ)	/* recording stops by itself */
+
+struct ra_extent {
+	pgoff_t start;
+	unsigned long nr;
+};
+
+struct ra_profile {
+	spinlock_t lock;
+	int recording;
+	unsigned long deadline;		/* in jiffies */
+	unsigned int nr;
+	struct ra_extent ext[0];
+};
+
+/* a profile fills one page */
+#define RA_PROFILE_EXTENTS \
+	((PAGE_SIZE - sizeof(struct ra_profile)) / sizeof(struct ra_extent))
+
+/*
+ * Note that page @offset of @mapping is being read because it was not
+ * in the page cache.  Contiguous misses are merged into one extent.
+ */
+void ra_profile_record(struct address_space *mapping, pgoff_t offset,
+		       unsigned long nr)
+{
+	struct ra_profile *p = ACCESS_ONCE(mapping->ra_profile);
+	struct ra_extent *last;
+
+	if (likely(!p || !p->recording))
+		return;
+
+	spin_lock(&p->lock);
+	if (!p->recording)
+		goto out;
+	if (time_after(jiffies, p->deadline)) {
+		p->recording = 0;
+		goto out;
+	}
+
+	if (p->nr) {
+		last = &p->ext[p->nr - 1];
+		if (offset >= last->start && offset <= last->start + last->nr) {
+			last->nr = max(last->nr, offset + nr - last->start);
+			goto out;
+		}
+	}
+	if (p->nr == RA_PROFILE_EXTENTS) {
+		p->recording = 0;
+		goto out;
+	}
+	p->ext[p->nr].start = offset;
+	p->ext[p->nr].nr = nr;
+	p->nr++;
+out:
+	spin_unlock(&p->lock);
+}
+
+static int ra_extent_cmp(const void *a, const void *b)
+{
+	const struct ra_extent *x = a, *y = b;
+
+	if (x->start == y->start)
+		return 0;
+	return x->start < y->start ? -1 : 1;
+}
+
+/*
+ * Read every page of the profile that is not cached.  Pages are submitted
+ * in file order, in 2 megabyte batches like force_page_cache_readahead()
+ * so that we don't pin too much memory at once.
+ *
+ * Returns the number of pages read.
+ */
+static int ra_profile_replay(struct address_space *mapping, struct file *filp,
+			     struct ra_profile *p)
+{
+	unsigned long batch_max = (2 * 1024 * 1024) / PAGE_CACHE_SIZE;
+	unsigned long budget = 0, end_index;
+	unsigned int nr, n, i;
+	struct ra_extent *ext;
+	LIST_HEAD(page_pool);
+	struct page *page;
+	pgoff_t index, last;
+	loff_t isize = i_size_read(mapping->host);
+	int batch = 0, ret = 0;
+
+	if (isize == 0)
+		return 0;
+	end_index = ((isize - 1) >> PAGE_CACHE_SHIFT);
+
+	ext = kmalloc(RA_PROFILE_EXTENTS * sizeof(*ext), GFP_KERNEL);
+	if (!ext)
+		return -ENOMEM;
+
+	spin_lock(&p->lock);
+	nr = p->nr;
+	memcpy(ext, p->ext, nr * sizeof(*ext));
+	spin_unlock(&p->lock);
+
+	/* sort by offset and merge overlapping or adjacent extents */
+	sort(ext, nr, sizeof(*ext), ra_extent_cmp, NULL);
+	for (i = 0, n = 0; i < nr; i++) {
+		if (n && ext[i].start <= ext[n - 1].start + ext[n - 1].nr) {
+			ext[n - 1].nr = max(ext[n - 1].nr,
+					ext[i].start + ext[i].nr - ext[n - 1].start);
+			continue;
+		}
+		ext[n++] = ext[i];
+	}
+	for (i = 0; i < n; i++)
+		budget += ext[i].nr;
+	budget = max_sane_readahead(budget);
+
+	for (i = 0; i < n && budget; i++) {
+		if (ext[i].start > end_index)
+			break;
+		last = min(ext[i].start + ext[i].nr - 1, end_index);
+
+		for (index = ext[i].start; index <= last && budget; index++) {
+			rcu_read_lock();
+			page = radix_tree_lookup(&mapping->page_tree, index);
+			rcu_read_unlock();
+			if (page)
+				continue;
+
+			page = page_cache_alloc_cold(mapping);
+			if (!page)
+				goto submit;
+			page->index = index;
+			list_add(&page->lru, &page_pool);
+			budget--;
+
+			if (++batch == batch_max) {
+				read_pages(mapping, filp, &page_pool, batch);
+				ret += batch;
+				batch = 0;
+			}
+		}
+	}
+submit:
+	if (batch) {
+		read_pages(mapping, filp, &page_pool, batch);
+		ret += batch;
+	}
+	BUG_ON(!list_empty(&page_pool));
+	kfree(ext);
+
+#ifdef CONFIG_BLOCK
+	/* the launch will want these soon, don't wait for the unplug timer */
+	if (ret)
+		blk_run_backing_dev(mapping->backing_dev_info, NULL);
+#endif
+	return ret;
+}
+
+/*
+ * Handle the POSIX_FADV_RA_* advice for @mapping.
+ */
+int ra_profile_advise(struct address_space *mapping, struct file *filp,
+		      int advice)
+{
+	struct ra_profile *p = mapping->ra_profile;
+
+	if (unlikely(!mapping->a_ops->readpage && !mapping->a_ops->readpages))
+		return -EINVAL;
+
+	switch (advice) {
+	case POSIX_FADV_RA_RECORD:
+		if (!p) {
+			p = kzalloc(PAGE_SIZE, GFP_KERNEL);
+			if (!p)
+				return -ENOMEM;
+			spin_lock_init(&p->lock);
+			if (cmpxchg(&mapping->ra_profile, NULL, p)) {
+				kfree(p);
+				p = mapping->ra_profile;
+			}
+		}
+		spin_lock(&p->lock);
+		p->nr = 0;
+		p->deadline = jiffies + RA_PROFILE_TIMEOUT;
+		p->recording = 1;
+		spin_unlock(&p->lock);
+		return 0;
+
+	case POSIX_FADV_RA_STOP:
+		if (p) {
+			spin_lock(&p->lock);
+			p->recording = 0;
+			spin_unlock(&p->lock);
+		}
+		return 0;
+
+	case POSIX_FADV_RA_REPLAY:
+		return p ? ra_profile_replay(mapping, filp, p) : 0;
+	}
+	return -EINVAL;
+}
+
+/*
+ * Called when the inode owning @mapping is destroyed.
+ */
+void ra_profile_free(struct address_space *mapping)
+{
+	kfree(mapping->ra_profile);
+	mapping->ra_profile = NULL;
+}
+#endif /* CONFIG_READAHEAD_PROFILE */
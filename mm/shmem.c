@@ -2407,7 +2407,7 @@ static int init_inodecache(void)
 {
 	shmem_inode_cachep = kmem_cache_create("shmem_inode_cache",
 				sizeof(struct shmem_inode_info),
-				0, SLAB_PANIC, init_once);
+				0, SLAB_PANIC | SLAB_DESTROY_BY_RCU, init_once);
 	return 0;
 }
 
@@ -2521,6 +2521,7 @@ static struct file_system_type tmpfs_fs_type = {
 	.name		= "tmpfs",
 	.get_sb		= shmem_get_sb,
 	.kill_sb	= kill_litter_super,
+	.fs_flags	= FS_INODE_RCU,
 };
 
 int __init init_tmpfs(void)
@@ -2617,6 +2618,7 @@ static struct file_system_type tmpfs_fs_type = {
 	.name		= "tmpfs",
 	.get_sb		= ramfs_get_sb,
 	.kill_sb	= kill_litter_super,
+	.fs_flags	= FS_INODE_RCU,
 };
 
 int __init init_tmpfs(void)
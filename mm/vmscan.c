@@ -38,6 +38,7 @@
 #include <linux/kthread.h>
 #include <linux/freezer.h>
 #include <linux/memcontrol.h>
+#include <linux/compaction.h>
 #include <linux/delayacct.h>
 #include <linux/sysctl.h>
 
@@ -48,6 +49,9 @@
 
 #include "internal.h"
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/vmscan.h>
+
 struct scan_control {
 	/* Incremented by the number of inactive pages that were scanned */
 	unsigned long nr_scanned;
@@ -81,6 +85,9 @@ struct scan_control {
 	 */
 	bool lumpy_reclaim_mode;
 
+	/* Reclaim referenced pages too, the caller picked them on purpose */
+	bool ignore_references;
+
 	/* Which cgroup do we reclaim from */
 	struct mem_cgroup *mem_cgroup;
 
@@ -178,6 +185,152 @@ void unregister_shrinker(struct shrinker *shrinker)
 }
 EXPORT_SYMBOL(unregister_shrinker);
 
+#ifdef CONFIG_RECLAIM_STALL_STATS
+/*
+ * Direct reclaim and compaction stalls are timed, put in a histogram of
+ * log4 milliseconds in /proc/vmstat and in the stalling task, and
+ * reported through the vmscan tracepoints together with what they were
+ * spent on.
+ */
+static inline u64 stall_since(ktime_t start)
+{
+	return ktime_to_ns(ktime_sub(ktime_get(), start));
+}
+
+static int account_stall(int type, u64 delay)
+{
+	struct reclaim_stall_stats *st = &current->reclaim_stall_stats;
+	unsigned long msecs = (unsigned long)div_u64(delay, NSEC_PER_MSEC);
+	int bucket = min((fls(msecs) + 1) / 2, NR_STALL_BUCKETS - 1);
+
+	st->count[type][bucket]++;
+	st->delay_ns[type] += delay;
+	return bucket;
+}
+
+static void reclaim_stall_begin(struct reclaim_stall *stall,
+				struct scan_control *sc)
+{
+	memset(stall, 0, sizeof(*stall));
+	trace_mm_vmscan_direct_reclaim_begin(sc->order, sc->may_writepage,
+					     sc->gfp_mask);
+	stall->start = ktime_get();
+	current->reclaim_stall = stall;
+}
+
+static void reclaim_stall_end(struct reclaim_stall *stall,
+			      unsigned long scanned, unsigned long reclaimed)
+{
+	struct reclaim_stall_stats *st = &current->reclaim_stall_stats;
+	u64 delay = stall_since(stall->start);
+	int bucket;
+
+	current->reclaim_stall = NULL;
+	stall->scanned = scanned;
+	stall->reclaimed = reclaimed;
+
+	bucket = account_stall(STALL_RECLAIM, delay);
+	st->scanned += scanned;
+	st->reclaimed += reclaimed;
+	st->writeback_ns += stall->writeback_ns;
+	if (delay > st->max_ns) {
+		st->max_ns = delay;
+		st->max_shrinker_ns = stall->shrinker_ns;
+		memcpy(st->max_shrinker, stall->shrinker,
+		       sizeof(st->max_shrinker));
+	}
+
+	count_vm_event(RECLAIMSTALL_1MS + bucket);
+	count_vm_events(RECLAIMSTALL_US, div_u64(delay, NSEC_PER_USEC));
+	count_vm_events(RECLAIMSTALL_SCANNED, scanned);
+	count_vm_events(RECLAIMSTALL_RECLAIMED, reclaimed);
+	count_vm_events(RECLAIMSTALL_WRITEBACK_US,
+			div_u64(stall->writeback_ns, NSEC_PER_USEC));
+	count_vm_events(RECLAIMSTALL_SHRINKER_US,
+			div_u64(stall->shrinkers_ns, NSEC_PER_USEC));
+
+	trace_mm_vmscan_direct_reclaim_end(stall, delay);
+}
+
+/* Charge a wait for writeback that started at @start to the stall */
+static void stall_writeback(ktime_t start)
+{
+	struct reclaim_stall *stall = current->reclaim_stall;
+
+	if (stall)
+		stall->writeback_ns += stall_since(start);
+}
+
+/*
+ * Shrinker calls are only timed in a direct reclaim stall, kswapd and the
+ * other callers of shrink_slab() do not read the clock for them.
+ */
+static inline ktime_t stall_shrinker_start(void)
+{
+	return current->reclaim_stall ? ktime_get() : ktime_set(0, 0);
+}
+
+/* Charge a shrinker call that started at @start to the stall */
+static void stall_shrinker(struct shrinker *shrinker, unsigned long freed,
+			   ktime_t start)
+{
+	struct reclaim_stall *stall = current->reclaim_stall;
+	u64 delay;
+
+	if (!stall)
+		return;
+
+	delay = stall_since(start);
+	stall->shrinkers_ns += delay;
+	if (delay > stall->shrinker_ns) {
+		stall->shrinker_ns = delay;
+		if (shrinker->name)
+			strlcpy(stall->shrinker, shrinker->name,
+				sizeof(stall->shrinker));
+		else
+			snprintf(stall->shrinker, sizeof(stall->shrinker),
+				 "%pf", shrinker->shrink);
+	}
+	trace_mm_shrink_slab_end(shrinker, freed, delay);
+}
+
+#ifdef CONFIG_COMPACTION
+void compact_stall_end(ktime_t start, int order, unsigned long status)
+{
+	u64 delay = stall_since(start);
+	int bucket = account_stall(STALL_COMPACT, delay);
+
+	count_vm_event(COMPACTSTALL_1MS + bucket);
+	count_vm_events(COMPACTSTALL_US, div_u64(delay, NSEC_PER_USEC));
+	trace_mm_vmscan_compact_stall(order, status, delay);
+}
+#endif
+#else
+static inline void reclaim_stall_begin(struct reclaim_stall *stall,
+				       struct scan_control *sc)
+{
+}
+
+static inline void reclaim_stall_end(struct reclaim_stall *stall,
+			unsigned long scanned, unsigned long reclaimed)
+{
+}
+
+static inline void stall_writeback(ktime_t start)
+{
+}
+
+static inline ktime_t stall_shrinker_start(void)
+{
+	return ktime_set(0, 0);
+}
+
+static inline void stall_shrinker(struct shrinker *shrinker,
+				  unsigned long freed, ktime_t start)
+{
+}
+#endif /* CONFIG_RECLAIM_STALL_STATS */
+
 #define SHRINK_BATCH 128
 /*
  * Call the shrink functions to age shrinkable caches
@@ -214,6 +367,8 @@ unsigned long shrink_slab(unsigned long scanned, gfp_t gfp_mask,
 		unsigned long long delta;
 		unsigned long total_scan;
 		unsigned long max_pass;
+		unsigned long freed = ret;
+		ktime_t start = stall_shrinker_start();
 
 		max_pass = (*shrinker->shrink)(shrinker, 0, gfp_mask);
 		delta = (4 * scanned) / shrinker->seeks;
@@ -257,6 +412,7 @@ unsigned long shrink_slab(unsigned long scanned, gfp_t gfp_mask,
 		}
 
 		shrinker->nr += total_scan;
+		stall_shrinker(shrinker, ret - freed, start);
 	}
 	up_read(&shrinker_rwsem);
 	return ret;
@@ -574,8 +730,8 @@ static enum page_references page_check_references(struct page *page,
 	referenced_ptes = page_referenced(page, 1, sc->mem_cgroup, &vm_flags);
 	referenced_page = TestClearPageReferenced(page);
 
-	/* Lumpy reclaim - ignore references */
-	if (sc->lumpy_reclaim_mode)
+	/* Lumpy or per-process reclaim - ignore references */
+	if (sc->lumpy_reclaim_mode || sc->ignore_references)
 		return PAGEREF_RECLAIM;
 
 	/*
@@ -839,6 +995,48 @@ keep:
 	return nr_reclaimed;
 }
 
+#ifdef CONFIG_PROCESS_RECLAIM
+/*
+ * Reclaim the pages on @page_list, which were isolated with
+ * isolate_lru_page() and counted as NR_ISOLATED_*, however recently they
+ * were used.  Pages that cannot be freed go back to the inactive lists.
+ * Returns the number of pages reclaimed.
+ */
+unsigned long reclaim_pages_from_list(struct list_head *page_list)
+{
+	struct scan_control sc = {
+		.gfp_mask = GFP_KERNEL,
+		.may_writepage = !laptop_mode,
+		.may_unmap = 1,
+		.may_swap = 1,
+		.swappiness = vm_swappiness,
+		.nr_to_reclaim = ULONG_MAX,
+		.ignore_references = true,
+	};
+	unsigned long nr_reclaimed;
+	struct page *page;
+
+	/*
+	 * shrink_page_list() does not tell which pages it freed, so drop
+	 * the isolation counts up front.
+	 */
+	list_for_each_entry(page, page_list, lru) {
+		dec_zone_page_state(page, NR_ISOLATED_ANON +
+				    page_is_file_cache(page));
+		ClearPageActive(page);
+	}
+
+	nr_reclaimed = shrink_page_list(page_list, &sc, PAGEOUT_IO_ASYNC);
+
+	while (!list_empty(page_list)) {
+		page = lru_to_page(page_list);
+		list_del(&page->lru);
+		putback_lru_page(page);
+	}
+	return nr_reclaimed;
+}
+#endif /* CONFIG_PROCESS_RECLAIM */
+
 /*
  * Attempt to remove the specified page from its LRU.  Only take this page
  * if it is of the appropriate PageActive status.  Pages which are being
@@ -1209,6 +1407,8 @@ static unsigned long shrink_inactive_list(unsigned long max_scan,
 		 */
 		if (nr_freed < nr_taken && !current_is_kswapd() &&
 		    sc->lumpy_reclaim_mode) {
+			ktime_t start = stall_start();
+
 			congestion_wait(BLK_RW_ASYNC, HZ/10);
 
 			/*
@@ -1220,6 +1420,7 @@ static unsigned long shrink_inactive_list(unsigned long max_scan,
 
 			nr_freed += shrink_page_list(&page_list, sc,
 							PAGEOUT_IO_SYNC);
+			stall_writeback(start);
 		}
 
 		nr_reclaimed += nr_freed;
@@ -1732,6 +1933,7 @@ static void shrink_zones(int priority, struct zonelist *zonelist,
 	enum zone_type high_zoneidx = gfp_zone(sc->gfp_mask);
 	struct zoneref *z;
 	struct zone *zone;
+	unsigned long nr;
 
 	for_each_zone_zonelist_nodemask(zone, z, zonelist, high_zoneidx,
 					sc->nodemask) {
@@ -1748,6 +1950,14 @@ static void shrink_zones(int priority, struct zonelist *zonelist,
 
 			if (zone->all_unreclaimable && priority != DEF_PRIORITY)
 				continue;	/* Let kswapd poll it */
+
+			/* background cgroups give their pages up first */
+			nr = mem_cgroup_priority_reclaim(zone, sc->order,
+					sc->gfp_mask, zone_to_nid(zone),
+					zone_idx(zone));
+			sc->nr_reclaimed += nr;
+			if (nr >= SWAP_CLUSTER_MAX)
+				continue;
 		} else {
 			/*
 			 * Ignore cpuset limitation here. We just want to reduce
@@ -1820,12 +2030,15 @@ static unsigned long do_try_to_free_pages(struct zonelist *zonelist,
 	struct zone *zone;
 	enum zone_type high_zoneidx = gfp_zone(sc->gfp_mask);
 	unsigned long writeback_threshold;
+	struct reclaim_stall stall;
 
 	get_mems_allowed();
 	delayacct_freepages_start();
 
-	if (scanning_global_lru(sc))
+	if (scanning_global_lru(sc)) {
 		count_vm_event(ALLOCSTALL);
+		reclaim_stall_begin(&stall, sc);
+	}
 	/*
 	 * mem_cgroup will not do shrink_slab.
 	 */
@@ -1874,8 +2087,12 @@ static unsigned long do_try_to_free_pages(struct zonelist *zonelist,
 
 		/* Take a nap, wait for some writeback to complete */
 		if (!sc->hibernation_mode && sc->nr_scanned &&
-		    priority < DEF_PRIORITY - 2)
+		    priority < DEF_PRIORITY - 2) {
+			ktime_t start = stall_start();
+
 			congestion_wait(BLK_RW_ASYNC, HZ/10);
+			stall_writeback(start);
+		}
 	}
 
 out:
@@ -1900,6 +2117,8 @@ out:
 	} else
 		mem_cgroup_record_reclaim_priority(sc->mem_cgroup, priority);
 
+	if (scanning_global_lru(sc))
+		reclaim_stall_end(&stall, total_scanned, sc->nr_reclaimed);
 	delayacct_freepages_end();
 	put_mems_allowed();
 
@@ -2132,6 +2351,7 @@ loop_again:
 			struct zone *zone = pgdat->node_zones + i;
 			int nr_slab;
 			int nid, zid;
+			unsigned long nr_prio;
 
 			if (!populated_zone(zone))
 				continue;
@@ -2151,11 +2371,19 @@ loop_again:
 			 */
 			mem_cgroup_soft_limit_reclaim(zone, order, sc.gfp_mask,
 							nid, zid);
+			/*
+			 * Background cgroups give their pages up first, the
+			 * zone is only scanned as a whole if they ran dry.
+			 */
+			nr_prio = mem_cgroup_priority_reclaim(zone, order,
+						sc.gfp_mask, nid, zid);
+			sc.nr_reclaimed += nr_prio;
 			/*
 			 * We put equal pressure on every zone, unless one
 			 * zone has way too many pages free already.
 			 */
-			if (!zone_watermark_ok(zone, order,
+			if (nr_prio < SWAP_CLUSTER_MAX &&
+			    !zone_watermark_ok(zone, order,
 					8*high_wmark_pages(zone), end_zone, 0))
 				shrink_zone(priority, zone, &sc);
 			reclaim_state->reclaimed_slab = 0;
@@ -2348,8 +2576,10 @@ static int kswapd(void *p)
 		 * We can speed up thawing tasks if we don't call balance_pgdat
 		 * after returning from the refrigerator
 		 */
-		if (!ret)
+		if (!ret) {
 			balance_pgdat(pgdat, order);
+			wakeup_kcompactd(MAX_ORDER - 1);
+		}
 	}
 	return 0;
 }
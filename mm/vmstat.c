@@ -482,6 +482,9 @@ static char * const migratetype_names[MIGRATE_TYPES] = {
 	"Movable",
 	"Reserve",
 	"Isolate",
+#ifdef CONFIG_CMA
+	"CMA",
+#endif
 };
 
 static void *frag_start(struct seq_file *m, loff_t *pos)
@@ -768,6 +771,10 @@ static const char * const vmstat_text[] = {
 
 	"pgfault",
 	"pgmajfault",
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+	"speculative_fault",
+	"speculative_fault_retry",
+#endif
 
 	TEXTS_FOR_ZONES("pgrefill")
 	TEXTS_FOR_ZONES("pgsteal")
@@ -796,6 +803,33 @@ static const char * const vmstat_text[] = {
 	"compact_stall",
 	"compact_fail",
 	"compact_success",
+	"compact_daemon_wake",
+	"compact_daemon_run",
+	"compact_daemon_success",
+	"compact_daemon_fail",
+#endif
+
+#ifdef CONFIG_RECLAIM_STALL_STATS
+	"reclaim_stall_lt_1ms",
+	"reclaim_stall_lt_4ms",
+	"reclaim_stall_lt_16ms",
+	"reclaim_stall_lt_64ms",
+	"reclaim_stall_lt_256ms",
+	"reclaim_stall_slow",
+	"reclaim_stall_us",
+	"reclaim_stall_scanned",
+	"reclaim_stall_reclaimed",
+	"reclaim_stall_writeback_us",
+	"reclaim_stall_shrinker_us",
+#ifdef CONFIG_COMPACTION
+	"compact_stall_lt_1ms",
+	"compact_stall_lt_4ms",
+	"compact_stall_lt_16ms",
+	"compact_stall_lt_64ms",
+	"compact_stall_lt_256ms",
+	"compact_stall_slow",
+	"compact_stall_us",
+#endif
 #endif
 
 #ifdef CONFIG_HUGETLB_PAGE
@@ -530,6 +530,21 @@ int security_inode_permission(struct inode *inode, int mask)
 	return security_ops->inode_permission(inode, mask);
 }
 
+/*
+ * Permission check of the lock-free path walk.  The hooks may sleep and
+ * i_security is not freed by RCU, so unless the module does not check inode
+ * permissions at all, -ECHILD sends the walk back to the locked path.
+ */
+int security_inode_permission_rcu(struct inode *inode, int mask)
+{
+	if (unlikely(IS_PRIVATE(inode)))
+		return 0;
+	if (security_ops->inode_permission ==
+	    default_security_ops.inode_permission)
+		return 0;
+	return -ECHILD;
+}
+
 int security_inode_setattr(struct dentry *dentry, struct iattr *attr)
 {
 	if (unlikely(IS_PRIVATE(dentry->d_inode)))
@@ -0,0 +1,244 @@
+/*
+ * frag-stress.c -- fragment memory and watch kcompactd restore high-order
+ * free blocks
+ *
+ * Anonymous memory is faulted in and then every other page of it is
+ * released, which leaves free memory scattered in order-0 holes between
+ * movable pages.  Every second afterwards the number of free blocks of
+ * the target order in each zone (from /proc/buddyinfo) is printed next
+ * to the growth of the compaction counters of /proc/vmstat, so the time
+ * kcompactd takes to bring the blocks back can be read off.  With -r the
+ * fragmenting is repeated every round while watching.
+ *
+ * The order defaults to /proc/sys/vm/compact_daemon_order.  Comparing a
+ * run with compact_daemon_blocks set to 0 shows what direct compaction
+ * alone achieves.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/mman.h>
+
+#define MAX_ZONES	8
+#define MAX_ORDER	16
+
+static const char * const counters[] = {
+	"compact_daemon_wake", "compact_daemon_run", "compact_daemon_success",
+	"compact_stall", "compact_pages_moved",
+};
+#define NR_COUNTERS	(sizeof(counters) / sizeof(counters[0]))
+
+static const char * const counter_title[NR_COUNTERS] = {
+	"wake", "run", "done", "stall", "moved",
+};
+
+struct zone_blocks {
+	char name[32];
+	unsigned long long blocks;
+};
+
+static volatile sig_atomic_t stop;
+
+static void on_signal(int sig)
+{
+	stop = 1;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-m MB] [-o order] [-t secs] [-r rounds]\n", prog);
+	exit(2);
+}
+
+static long read_long(const char *path, long def)
+{
+	FILE *f = fopen(path, "r");
+	long v;
+
+	if (!f)
+		return def;
+	if (fscanf(f, "%ld", &v) != 1)
+		v = def;
+	fclose(f);
+	return v;
+}
+
+static long mem_free_mb(void)
+{
+	char line[256];
+	long kb = 0;
+	FILE *f;
+
+	f = fopen("/proc/meminfo", "r");
+	if (!f)
+		return 0;
+	while (fgets(line, sizeof(line), f))
+		if (sscanf(line, "MemFree: %ld kB", &kb) == 1)
+			break;
+	fclose(f);
+	return kb / 1024;
+}
+
+/* Free blocks of @order or larger, counted in blocks of @order */
+static int read_buddyinfo(int order, struct zone_blocks *z)
+{
+	char line[512], *p;
+	int nr = 0, o, n;
+	unsigned long long count;
+	FILE *f;
+
+	f = fopen("/proc/buddyinfo", "r");
+	if (!f) {
+		perror("/proc/buddyinfo");
+		exit(1);
+	}
+	while (nr < MAX_ZONES && fgets(line, sizeof(line), f)) {
+		p = strstr(line, "zone");
+		if (!p || sscanf(p, "zone %31s%n", z[nr].name, &n) != 1)
+			continue;
+		p += n;
+		z[nr].blocks = 0;
+		for (o = 0; o < MAX_ORDER; o++) {
+			if (sscanf(p, "%llu%n", &count, &n) != 1)
+				break;
+			p += n;
+			if (o >= order)
+				z[nr].blocks += count << (o - order);
+		}
+		nr++;
+	}
+	fclose(f);
+	return nr;
+}
+
+static void read_vmstat(unsigned long long *val)
+{
+	char line[256], name[64];
+	unsigned long long v;
+	size_t i;
+	FILE *f;
+
+	memset(val, 0, NR_COUNTERS * sizeof(*val));
+	f = fopen("/proc/vmstat", "r");
+	if (!f)
+		return;
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "%63s %llu", name, &v) != 2)
+			continue;
+		for (i = 0; i < NR_COUNTERS; i++)
+			if (!strcmp(name, counters[i]))
+				val[i] = v;
+	}
+	fclose(f);
+}
+
+/*
+ * Fault in @size bytes and give every other page back, so that the
+ * remaining pages pin the free ones into order-0 holes.
+ */
+static char *fragment(size_t size, long page_size)
+{
+	char *map;
+	size_t off;
+
+	map = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (map == MAP_FAILED) {
+		perror("mmap");
+		exit(1);
+	}
+	for (off = 0; off < size; off += page_size)
+		map[off] = 1;
+	for (off = page_size; off < size; off += 2 * page_size)
+		madvise(map + off, page_size, MADV_DONTNEED);
+	return map;
+}
+
+int main(int argc, char **argv)
+{
+	struct zone_blocks zones[MAX_ZONES];
+	unsigned long long start[NR_COUNTERS], now[NR_COUNTERS];
+	long page_size = sysconf(_SC_PAGESIZE);
+	long mb = 0, secs = 30, rounds = 1, order, t;
+	size_t size, i;
+	char *map = NULL;
+	int opt, nr, z;
+
+	order = read_long("/proc/sys/vm/compact_daemon_order", 4);
+	while ((opt = getopt(argc, argv, "m:o:t:r:h")) != -1) {
+		switch (opt) {
+		case 'm':
+			mb = atol(optarg);
+			break;
+		case 'o':
+			order = atol(optarg);
+			break;
+		case 't':
+			secs = atol(optarg);
+			break;
+		case 'r':
+			rounds = atol(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind != argc || order < 1 || order >= MAX_ORDER || secs < 1 ||
+	    rounds < 1)
+		usage(argv[0]);
+	if (!mb)
+		mb = mem_free_mb() / 2;
+	if (mb < 1) {
+		fprintf(stderr, "not enough free memory\n");
+		return 1;
+	}
+	size = (size_t)mb << 20;
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+
+	nr = read_buddyinfo(order, zones);
+	printf("order-%ld free blocks before:", order);
+	for (z = 0; z < nr; z++)
+		printf(" %s %llu", zones[z].name, zones[z].blocks);
+	printf("\n%ld MB fragmented, %ld round(s)\n\n", mb, rounds);
+
+	printf("%4s", "sec");
+	for (z = 0; z < nr; z++)
+		printf(" %10s", zones[z].name);
+	for (i = 0; i < NR_COUNTERS; i++)
+		printf(" %7s", counter_title[i]);
+	printf("\n");
+
+	read_vmstat(start);
+	for (t = 0; t < secs * rounds && !stop; t++) {
+		if (t % secs == 0) {
+			if (map)
+				munmap(map, size);
+			map = fragment(size, page_size);
+		}
+
+		nr = read_buddyinfo(order, zones);
+		read_vmstat(now);
+		printf("%4ld", t);
+		for (z = 0; z < nr; z++)
+			printf(" %10llu", zones[z].blocks);
+		for (i = 0; i < NR_COUNTERS; i++)
+			printf(" %7llu", now[i] - start[i]);
+		printf("\n");
+		fflush(stdout);
+		sleep(1);
+	}
+
+	if (map)
+		munmap(map, size);
+	return 0;
+}
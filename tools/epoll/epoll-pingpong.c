@@ -0,0 +1,428 @@
+/*
+ * epoll-pingpong.c -- epoll wake up and event collection cost with many fds
+ *
+ * Sets up -n channels, each a pair of eventfds (or of pipes, with -p)
+ * carrying a token back and forth between -t client threads, which own an
+ * equal share of the channels, and one server thread.  Every client sends
+ * a request on all its channels at once and then, whenever epoll_wait()
+ * reports a reply, times the round trip and sends the next request; the
+ * server echoes every request it collects.  That is the shape of a daemon
+ * serving many clients, with the wake ups of the server's epoll instance
+ * coming from several CPUs at once.
+ *
+ * The server collects the requests in three ways, for -s seconds each:
+ * from a single epoll instance ("single"), from -e instances the channels
+ * are spread over, themselves added to one more instance it sleeps on
+ * ("nested"), and from the same -e instances with the EPIOC_WAIT_MULTI
+ * ioctl ("multi").  For each way the round trips per second, their
+ * average and 99th percentile latency in microseconds and the events the
+ * server got per system call are printed.  Raise the limit of open files
+ * for large -n, e.g. "ulimit -n 8192".
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+
+#ifndef EPIOC_WAIT_MULTI
+/* include/linux/eventpoll.h */
+struct epoll_wait_desc {
+	int32_t epfd;
+	int32_t maxevents;
+	uint64_t events;
+	int32_t nr_events;
+	uint32_t __pad;
+};
+
+struct epoll_wait_multi {
+	uint64_t descs;
+	uint32_t ndescs;
+	int32_t timeout;
+};
+
+#define EPIOC_WAIT_MULTI _IOW(0x8A, 0x00, struct epoll_wait_multi)
+#endif
+
+#define MAX_THREADS	64
+#define MAX_INSTANCES	64
+#define MAX_EVENTS	64
+#define MAX_SAMPLES	65536
+
+enum { SINGLE, NESTED, MULTI, NR_MODES };
+
+static const char *const mode_names[NR_MODES] = { "single", "nested", "multi" };
+
+struct channel {
+	int req[2];	/* client to server, read end first */
+	int rep[2];	/* server to client */
+	double sent;
+};
+
+struct client {
+	pthread_t thread;
+	int epfd;
+	long first, last;
+	unsigned long trips;
+	double *lat;
+};
+
+static long nr_channels = 128, nr_threads = 2, nr_instances = 4, secs = 5;
+static int use_pipes;
+static struct channel *channels;
+static volatile int stop;
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-n channels] [-t client threads] "
+		"[-e epoll instances] [-s secs] [-p]\n", prog);
+	exit(2);
+}
+
+static double now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void send_token(int fd)
+{
+	uint64_t one = 1;
+
+	if (write(fd, &one, use_pipes ? 1 : sizeof(one)) < 0) {
+		perror("write");
+		exit(1);
+	}
+}
+
+static void recv_token(int fd)
+{
+	uint64_t val;
+
+	if (read(fd, &val, use_pipes ? 1 : sizeof(val)) < 0) {
+		perror("read");
+		exit(1);
+	}
+}
+
+static void make_pair(int fds[2])
+{
+	if (use_pipes) {
+		if (pipe(fds)) {
+			perror("pipe");
+			exit(1);
+		}
+		return;
+	}
+	fds[0] = fds[1] = eventfd(0, 0);
+	if (fds[0] < 0) {
+		perror("eventfd");
+		exit(1);
+	}
+}
+
+static void close_pair(int fds[2])
+{
+	close(fds[0]);
+	if (fds[1] != fds[0])
+		close(fds[1]);
+}
+
+static int epoll_new(void)
+{
+	int epfd = epoll_create(1);
+
+	if (epfd < 0) {
+		perror("epoll_create");
+		exit(1);
+	}
+	return epfd;
+}
+
+static void epoll_add(int epfd, int fd, uint32_t data)
+{
+	struct epoll_event ev;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.u32 = data;
+	if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev)) {
+		perror("epoll_ctl");
+		exit(1);
+	}
+}
+
+static void *client_thread(void *arg)
+{
+	struct client *c = arg;
+	struct epoll_event ev[MAX_EVENTS];
+	struct channel *ch;
+	double t;
+	long i;
+	int n;
+
+	for (i = c->first; i < c->last; i++) {
+		channels[i].sent = now_us();
+		send_token(channels[i].req[1]);
+	}
+	while (!stop) {
+		n = epoll_wait(c->epfd, ev, MAX_EVENTS, 100);
+		if (n < 0) {
+			perror("epoll_wait");
+			exit(1);
+		}
+		for (i = 0; i < n; i++) {
+			ch = &channels[ev[i].data.u32];
+			recv_token(ch->rep[0]);
+			t = now_us();
+			c->lat[c->trips++ % MAX_SAMPLES] = t - ch->sent;
+			ch->sent = t;
+			send_token(ch->req[1]);
+		}
+	}
+	return NULL;
+}
+
+/* echo the request of every channel epoll reported */
+static void echo(struct epoll_event *ev, int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++) {
+		struct channel *ch = &channels[ev[i].data.u32];
+
+		recv_token(ch->req[0]);
+		send_token(ch->rep[1]);
+	}
+}
+
+static void run(int mode)
+{
+	static struct epoll_event ev[MAX_INSTANCES][MAX_EVENTS];
+	struct epoll_event oev[MAX_INSTANCES];
+	struct epoll_wait_desc descs[MAX_INSTANCES];
+	struct epoll_wait_multi wm;
+	struct client clients[MAX_THREADS];
+	int inst[MAX_INSTANCES], outer = -1, nr_inst, n, i;
+	unsigned long calls = 0, events = 0, trips = 0;
+	double start, end, elapsed, sum = 0, *lat;
+	long c, j, k = 0, per_thread;
+
+	nr_inst = mode == SINGLE ? 1 : nr_instances;
+	for (i = 0; i < nr_inst; i++)
+		inst[i] = epoll_new();
+	if (mode == NESTED) {
+		outer = epoll_new();
+		for (i = 0; i < nr_inst; i++)
+			epoll_add(outer, inst[i], i);
+	}
+	for (j = 0; j < nr_channels; j++) {
+		make_pair(channels[j].req);
+		make_pair(channels[j].rep);
+		epoll_add(inst[j % nr_inst], channels[j].req[0], j);
+	}
+
+	lat = calloc(nr_threads * MAX_SAMPLES, sizeof(*lat));
+	if (!lat) {
+		perror("calloc");
+		exit(1);
+	}
+	stop = 0;
+	per_thread = (nr_channels + nr_threads - 1) / nr_threads;
+	memset(clients, 0, sizeof(clients));
+	for (c = 0; c < nr_threads; c++) {
+		struct client *cl = &clients[c];
+
+		cl->first = c * per_thread;
+		cl->last = cl->first + per_thread < nr_channels ?
+			   cl->first + per_thread : nr_channels;
+		cl->lat = lat + c * MAX_SAMPLES;
+		cl->epfd = epoll_new();
+		for (j = cl->first; j < cl->last; j++)
+			epoll_add(cl->epfd, channels[j].rep[0], j);
+	}
+
+	start = now_us();
+	end = start + secs * 1e6;
+	for (c = 0; c < nr_threads; c++)
+		if (pthread_create(&clients[c].thread, NULL, client_thread,
+				   &clients[c])) {
+			fprintf(stderr, "pthread_create failed\n");
+			exit(1);
+		}
+
+	while (now_us() < end) {
+		switch (mode) {
+		case SINGLE:
+			n = epoll_wait(inst[0], ev[0], MAX_EVENTS, 100);
+			if (n < 0) {
+				perror("epoll_wait");
+				exit(1);
+			}
+			calls++;
+			echo(ev[0], n);
+			events += n;
+			break;
+		case NESTED:
+			n = epoll_wait(outer, oev, MAX_INSTANCES, 100);
+			if (n < 0) {
+				perror("epoll_wait");
+				exit(1);
+			}
+			calls++;
+			for (i = 0; i < n; i++) {
+				int e = oev[i].data.u32;
+				int m = epoll_wait(inst[e], ev[e], MAX_EVENTS,
+						   0);
+
+				if (m < 0) {
+					perror("epoll_wait");
+					exit(1);
+				}
+				calls++;
+				echo(ev[e], m);
+				events += m;
+			}
+			break;
+		case MULTI:
+			for (i = 0; i < nr_inst; i++) {
+				descs[i].epfd = inst[i];
+				descs[i].maxevents = MAX_EVENTS;
+				descs[i].events = (uintptr_t)ev[i];
+				descs[i].nr_events = 0;
+			}
+			wm.descs = (uintptr_t)descs;
+			wm.ndescs = nr_inst;
+			wm.timeout = 100;
+			n = ioctl(inst[0], EPIOC_WAIT_MULTI, &wm);
+			if (n < 0) {
+				perror("EPIOC_WAIT_MULTI");
+				exit(1);
+			}
+			calls++;
+			for (i = 0; i < nr_inst; i++) {
+				echo(ev[i], descs[i].nr_events);
+				events += descs[i].nr_events;
+			}
+			break;
+		}
+	}
+	stop = 1;
+	for (c = 0; c < nr_threads; c++)
+		pthread_join(clients[c].thread, NULL);
+	elapsed = (now_us() - start) / 1e6;
+
+	for (c = 0; c < nr_threads; c++) {
+		long samples = clients[c].trips < MAX_SAMPLES ?
+			       clients[c].trips : MAX_SAMPLES;
+
+		trips += clients[c].trips;
+		for (j = 0; j < samples; j++) {
+			lat[k] = clients[c].lat[j];
+			sum += lat[k++];
+		}
+		close(clients[c].epfd);
+	}
+	qsort(lat, k, sizeof(*lat), cmp_double);
+
+	printf("%-8s %12.0f %10.1f %10.1f %12.2f\n", mode_names[mode],
+	       trips / elapsed, k ? sum / k : 0, k ? lat[k * 99 / 100] : 0,
+	       calls ? (double)events / calls : 0);
+	fflush(stdout);
+
+	for (j = 0; j < nr_channels; j++) {
+		close_pair(channels[j].req);
+		close_pair(channels[j].rep);
+	}
+	for (i = 0; i < nr_inst; i++)
+		close(inst[i]);
+	if (outer >= 0)
+		close(outer);
+	free(lat);
+}
+
+int main(int argc, char **argv)
+{
+	int opt, mode;
+
+	while ((opt = getopt(argc, argv, "n:t:e:s:ph")) != -1) {
+		switch (opt) {
+		case 'n':
+			nr_channels = atol(optarg);
+			break;
+		case 't':
+			nr_threads = atol(optarg);
+			break;
+		case 'e':
+			nr_instances = atol(optarg);
+			break;
+		case 's':
+			secs = atol(optarg);
+			break;
+		case 'p':
+			use_pipes = 1;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind != argc || nr_threads < 1 || nr_threads > MAX_THREADS ||
+	    nr_channels < nr_threads || nr_instances < 1 ||
+	    nr_instances > MAX_INSTANCES || secs < 1)
+		usage(argv[0]);
+
+	channels = calloc(nr_channels, sizeof(*channels));
+	if (!channels) {
+		perror("calloc");
+		return 1;
+	}
+
+	printf("%ld %s channels, %ld client threads, %ld epoll instances, "
+	       "%ld s\n\n", nr_channels, use_pipes ? "pipe" : "eventfd",
+	       nr_threads, nr_instances, secs);
+	printf("%-8s %12s %10s %10s %12s\n", "server", "trips/s", "avg_us",
+	       "p99_us", "events/call");
+	for (mode = 0; mode < NR_MODES; mode++) {
+		/* an empty instance has no events, anything else fails */
+		if (mode == MULTI) {
+			struct epoll_event e;
+			struct epoll_wait_desc d = {
+				.maxevents = 1, .events = (uintptr_t)&e,
+			};
+			struct epoll_wait_multi wm = {
+				.descs = (uintptr_t)&d, .ndescs = 1,
+			};
+			int ret;
+
+			d.epfd = epoll_new();
+			ret = ioctl(d.epfd, EPIOC_WAIT_MULTI, &wm);
+			close(d.epfd);
+			if (ret) {
+				printf("%-8s not supported by this kernel\n",
+				       mode_names[mode]);
+				continue;
+			}
+		}
+		run(mode);
+	}
+	return 0;
+}
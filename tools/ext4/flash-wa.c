@@ -0,0 +1,290 @@
+/*
+ * flash-wa.c -- write amplification of a file workload on a simulated FTL
+ *
+ * Runs -r rounds of a workload like that of a phone or a set-top box on
+ * the directory: each round creates -n small files of 4 KB to -k KB,
+ * appends -a KB to a log file, fsync()s all of them and deletes half of
+ * the small files of the round before.  Where their data landed on the
+ * device is taken from FIEMAP and fed, in the order it was written, to a
+ * simple model of the block mapped FTL of eMMC and SD cards: -o erase
+ * blocks of -e KB can be open at once and are written in -p KB pages, in
+ * order.  A write behind the last page written to an open erase block, or
+ * to one that isn't open, closes an erase block and costs copying the
+ * pages of it that weren't written, just as the card's read-modify-write.
+ *
+ * The throughput of the workload and the write amplification, pages
+ * written by the FTL per page written by the filesystem, are printed for
+ * every tenth of the rounds.  Metadata and journal writes aren't seen, so
+ * the figures are for file data only.  Run it on a ramdisk or loop device
+ * mounted with and without flash_align, e.g.
+ *
+ *	mkfs.ext4 /dev/ram0 && mount -o flash_align=1024 /dev/ram0 /mnt
+ *	flash-wa -e 4096 /mnt
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#include <linux/fiemap.h>
+
+#define MAX_OPEN	64
+#define MAX_EXTENTS	256
+
+struct open_block {
+	uint64_t eb;
+	unsigned long next_page;
+	unsigned long last_use;
+};
+
+static const char *dir;
+static long rounds = 100, nr_files = 32, max_kb = 64, append_kb = 256;
+static unsigned long erase_kb = 4096, page_kb = 16, nr_open = 4;
+
+static struct open_block open_blocks[MAX_OPEN];
+static unsigned long nr_opened, clock_tick;
+static unsigned long long host_pages, copied_pages, merges;
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-r rounds] [-n files] [-k KB] [-a KB] "
+		"[-e erase KB] [-p page KB] [-o open blocks] dir\n", prog);
+	exit(2);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* closing an erase block copies the pages not written since it opened */
+static void close_block(struct open_block *ob)
+{
+	unsigned long pages = erase_kb / page_kb;
+
+	copied_pages += pages - ob->next_page;
+	merges++;
+}
+
+static struct open_block *open_block(uint64_t eb)
+{
+	struct open_block *ob = NULL;
+	unsigned long i;
+
+	if (nr_opened < nr_open) {
+		ob = &open_blocks[nr_opened++];
+	} else {
+		/* close the least recently used one */
+		for (i = 0; i < nr_opened; i++)
+			if (!ob || open_blocks[i].last_use < ob->last_use)
+				ob = &open_blocks[i];
+		close_block(ob);
+	}
+	ob->eb = eb;
+	ob->next_page = 0;
+	return ob;
+}
+
+static void ftl_write_page(uint64_t page)
+{
+	unsigned long pages = erase_kb / page_kb;
+	uint64_t eb = page / pages;
+	unsigned long off = page % pages;
+	struct open_block *ob = NULL;
+	unsigned long i;
+
+	for (i = 0; i < nr_opened; i++)
+		if (open_blocks[i].eb == eb)
+			ob = &open_blocks[i];
+
+	if (ob && off < ob->next_page) {
+		/* rewrite: merge, then start over in a fresh erase block */
+		close_block(ob);
+		ob->next_page = 0;
+	} else if (!ob) {
+		ob = open_block(eb);
+	}
+
+	/* the pages skipped over are copied from the old erase block */
+	copied_pages += off - ob->next_page;
+	ob->next_page = off + 1;
+	ob->last_use = ++clock_tick;
+	host_pages++;
+}
+
+static void ftl_write(uint64_t start, uint64_t len)
+{
+	uint64_t page_size = page_kb << 10;
+	uint64_t page;
+
+	for (page = start / page_size; page * page_size < start + len; page++)
+		ftl_write_page(page);
+}
+
+/* feed where [start, start + len) of the file landed to the FTL */
+static void map_range(int fd, const char *path, uint64_t start, uint64_t len)
+{
+	struct fiemap *fm;
+	unsigned int i;
+
+	fm = calloc(1, sizeof(*fm) + MAX_EXTENTS * sizeof(fm->fm_extents[0]));
+	if (!fm) {
+		perror("calloc");
+		exit(1);
+	}
+	fm->fm_start = start;
+	fm->fm_length = len;
+	fm->fm_flags = FIEMAP_FLAG_SYNC;
+	fm->fm_extent_count = MAX_EXTENTS;
+	if (ioctl(fd, FS_IOC_FIEMAP, fm)) {
+		perror(path);
+		exit(1);
+	}
+	for (i = 0; i < fm->fm_mapped_extents; i++) {
+		struct fiemap_extent *fe = &fm->fm_extents[i];
+		uint64_t skip = 0, l = fe->fe_length;
+
+		/* only the part that was written now */
+		if (fe->fe_logical < start)
+			skip = start - fe->fe_logical;
+		if (skip >= l)
+			continue;
+		l -= skip;
+		if (fe->fe_logical + skip + l > start + len)
+			l = start + len - fe->fe_logical - skip;
+		ftl_write(fe->fe_physical + skip, l);
+	}
+	free(fm);
+}
+
+static void write_file(const char *path, int flags, const char *buf,
+		       size_t size)
+{
+	off_t start;
+	int fd;
+
+	fd = open(path, O_WRONLY | O_CREAT | flags, 0644);
+	if (fd < 0) {
+		perror(path);
+		exit(1);
+	}
+	start = lseek(fd, 0, SEEK_END);
+	if (write(fd, buf, size) != (ssize_t)size || fsync(fd)) {
+		perror(path);
+		exit(1);
+	}
+	map_range(fd, path, start, size);
+	close(fd);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long long written = 0;
+	double start, elapsed;
+	char path[256], *buf;
+	long r, i;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "r:n:k:a:e:p:o:h")) != -1) {
+		switch (opt) {
+		case 'r':
+			rounds = atol(optarg);
+			break;
+		case 'n':
+			nr_files = atol(optarg);
+			break;
+		case 'k':
+			max_kb = atol(optarg);
+			break;
+		case 'a':
+			append_kb = atol(optarg);
+			break;
+		case 'e':
+			erase_kb = strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+			page_kb = strtoul(optarg, NULL, 0);
+			break;
+		case 'o':
+			nr_open = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind != argc - 1 || rounds < 1 || nr_files < 0 || max_kb < 4 ||
+	    append_kb < 0 || !page_kb || erase_kb < page_kb ||
+	    erase_kb % page_kb || !nr_open || nr_open > MAX_OPEN)
+		usage(argv[0]);
+	dir = argv[optind];
+
+	buf = malloc((max_kb > append_kb ? max_kb : append_kb) << 10);
+	if (!buf) {
+		perror("malloc");
+		return 1;
+	}
+	memset(buf, 0x5a, (max_kb > append_kb ? max_kb : append_kb) << 10);
+	srand(1);
+
+	printf("%s, %ld files of 4-%ld KB and %ld KB of log per round, "
+	       "%lu KB erase blocks, %lu KB pages, %lu open\n\n", dir,
+	       nr_files, max_kb, append_kb, erase_kb, page_kb, nr_open);
+	printf("%6s %10s %10s %10s %10s\n", "round", "MB/s", "host_MB",
+	       "merges", "WA");
+
+	start = now();
+	for (r = 0; r < rounds; r++) {
+		for (i = 0; i < nr_files; i++) {
+			size_t size = (4 + rand() % (max_kb - 3)) << 10;
+
+			snprintf(path, sizeof(path), "%s/flash-wa.%ld.%ld",
+				 dir, r, i);
+			write_file(path, O_TRUNC, buf, size);
+			written += size;
+		}
+		if (append_kb) {
+			snprintf(path, sizeof(path), "%s/flash-wa.log", dir);
+			write_file(path, O_APPEND, buf, append_kb << 10);
+			written += append_kb << 10;
+		}
+		/* age the filesystem: drop half of the last round's files */
+		for (i = 0; r && i < nr_files; i += 2) {
+			snprintf(path, sizeof(path), "%s/flash-wa.%ld.%ld",
+				 dir, r - 1, i);
+			unlink(path);
+		}
+
+		if ((r + 1) % (rounds < 10 ? 1 : rounds / 10) && r + 1 != rounds)
+			continue;
+		elapsed = now() - start;
+		printf("%6ld %10.1f %10.1f %10llu %10.2f\n", r + 1,
+		       written / elapsed / (1 << 20),
+		       (double)written / (1 << 20), merges,
+		       host_pages ? (double)(host_pages + copied_pages) /
+				    host_pages : 0);
+		fflush(stdout);
+	}
+
+	/* clean up */
+	for (r = 0; r < rounds; r++)
+		for (i = 0; i < nr_files; i++) {
+			snprintf(path, sizeof(path), "%s/flash-wa.%ld.%ld",
+				 dir, r, i);
+			unlink(path);
+		}
+	snprintf(path, sizeof(path), "%s/flash-wa.log", dir);
+	unlink(path);
+	return 0;
+}
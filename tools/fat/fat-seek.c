@@ -0,0 +1,169 @@
+/*
+ * fat-seek.c -- random seek latency in a large file
+ *
+ * Reads -b bytes at -n random offsets of a file with O_DIRECT, so that
+ * every read maps its offset to a disk block, and prints the latency
+ * distribution.  The file is read twice: the first pass starts from an
+ * empty cluster cache when -d drops the caches before the file is opened,
+ * and the second pass shows the latency once the cluster runs the first
+ * one walked are cached.
+ *
+ * On vfat the mapping walks the FAT chain from the closest cached run
+ * before the offset, so on a multi-GB file written in fragments the
+ * first pass is dominated by FAT reads.  The number of cached runs is
+ * taken from the fat_cache line of /proc/slabinfo when it is readable.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/stat.h>
+
+static const char *path;
+static size_t block = 4096;
+static long nr_reads = 1000;
+static int drop;
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-b bytes] [-n reads] [-r seed] [-d] file\n",
+		prog);
+	exit(2);
+}
+
+static double now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void drop_caches(void)
+{
+	int fd;
+
+	sync();
+	fd = open("/proc/sys/vm/drop_caches", O_WRONLY);
+	if (fd < 0 || write(fd, "3\n", 2) != 2) {
+		perror("/proc/sys/vm/drop_caches");
+		exit(1);
+	}
+	close(fd);
+}
+
+/* active fat_cache objects, -1 if unknown */
+static long cached_runs(void)
+{
+	char line[256];
+	long active = -1;
+	FILE *f;
+
+	f = fopen("/proc/slabinfo", "r");
+	if (!f)
+		return -1;
+	while (fgets(line, sizeof(line), f))
+		if (sscanf(line, "fat_cache %ld", &active) == 1)
+			break;
+	fclose(f);
+	return active;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void run(const char *name, int fd, off_t size, char *buf,
+		double *lat)
+{
+	off_t blocks = size / block, off;
+	double start, sum = 0;
+	long i;
+
+	for (i = 0; i < nr_reads; i++) {
+		off = (off_t)(((unsigned long long)random() << 31 | random()) %
+			      blocks) * block;
+		start = now_us();
+		if (pread(fd, buf, block, off) != (ssize_t)block) {
+			perror("pread");
+			exit(1);
+		}
+		lat[i] = now_us() - start;
+		sum += lat[i];
+	}
+
+	qsort(lat, nr_reads, sizeof(*lat), cmp_double);
+	printf("%-6s %10.0f %10.0f %10.0f %10.0f %10.0f %8ld\n", name, lat[0],
+	       sum / nr_reads, lat[nr_reads / 2], lat[nr_reads * 99 / 100],
+	       lat[nr_reads - 1], cached_runs());
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int seed = 1;
+	struct stat st;
+	double *lat;
+	void *buf;
+	int opt, fd;
+
+	while ((opt = getopt(argc, argv, "b:n:r:dh")) != -1) {
+		switch (opt) {
+		case 'b':
+			block = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			nr_reads = atol(optarg);
+			break;
+		case 'r':
+			seed = strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			drop = 1;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind != argc - 1 || nr_reads < 1 || !block || block % 512)
+		usage(argv[0]);
+	path = argv[optind];
+
+	if (drop)
+		drop_caches();
+	fd = open(path, O_RDONLY | O_DIRECT);
+	if (fd < 0 || fstat(fd, &st) < 0) {
+		perror(path);
+		return 1;
+	}
+	if (st.st_size < (off_t)block) {
+		fprintf(stderr, "%s: smaller than %zu bytes\n", path, block);
+		return 1;
+	}
+	lat = calloc(nr_reads, sizeof(*lat));
+	if (!lat || posix_memalign(&buf, 4096, block)) {
+		perror("alloc");
+		return 1;
+	}
+	srandom(seed);
+
+	printf("%s: %lld MB, %ld reads of %zu bytes%s\n\n", path,
+	       (long long)st.st_size >> 20, nr_reads, block,
+	       drop ? ", caches dropped" : "");
+	printf("%-6s %10s %10s %10s %10s %10s %8s\n", "pass", "min_us",
+	       "avg_us", "median_us", "p99_us", "max_us", "runs");
+	run("first", fd, st.st_size, buf, lat);
+	run("second", fd, st.st_size, buf, lat);
+	close(fd);
+	return 0;
+}
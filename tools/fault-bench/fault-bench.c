@@ -0,0 +1,257 @@
+/*
+ * fault-bench.c -- page fault throughput of a threaded process
+ *
+ * Each of 1 to -t threads repeatedly faults in its own anonymous buffer
+ * and throws the pages away again with MADV_DONTNEED, which takes
+ * mmap_sem for reading.  Unless -w 0 is given, one more thread keeps
+ * mapping and unmapping a small region, taking mmap_sem for writing the
+ * way a malloc arena growing and shrinking does, so that the faulting
+ * threads contend with a writer.
+ *
+ * With -f the buffers are private read-only mappings of that file
+ * instead, so the faults map page cache pages rather than allocating
+ * anonymous ones.
+ *
+ * The faults per second of every thread count are printed together with
+ * the voluntary and involuntary context switches of the run, and with
+ * how many faults were handled without mmap_sem and how many of those
+ * had to be retried with it (speculative_fault and
+ * speculative_fault_retry in /proc/vmstat).  Comparing them with and
+ * without speculative faults shows how much of the fault path is spent
+ * sleeping on mmap_sem.
+ *
+ * With -g the process first moves itself into that memory cgroup
+ * directory, so that every fault also charges its page to the cgroup.
+ * Running the same test booted with and without "memcg_lru_only", and
+ * without -g, gives the cost of full memcg accounting, of LRU-only
+ * tracking and of none per fault.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+#define MAX_THREADS	64
+
+struct worker {
+	pthread_t thread;
+	unsigned long faults;
+	unsigned int sum;
+};
+
+static volatile int stop;
+static long page_size;
+static size_t buffer_kb = 1024;
+static long max_threads = 4, secs = 5, writer = 1;
+static const char *file, *cgroup;
+static int file_fd = -1;
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-t threads] [-s secs] [-k buffer KB] "
+		"[-w 0|1] [-f file] [-g cgroup dir]\n", prog);
+	exit(2);
+}
+
+/* speculative_fault and speculative_fault_retry, 0 if not there */
+static void read_vmstat(unsigned long long *spf, unsigned long long *retry)
+{
+	char line[256], name[64];
+	unsigned long long v;
+	FILE *f;
+
+	*spf = *retry = 0;
+	f = fopen("/proc/vmstat", "r");
+	if (!f)
+		return;
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "%63s %llu", name, &v) != 2)
+			continue;
+		if (!strcmp(name, "speculative_fault"))
+			*spf = v;
+		else if (!strcmp(name, "speculative_fault_retry"))
+			*retry = v;
+	}
+	fclose(f);
+}
+
+static void join_cgroup(const char *dir)
+{
+	char path[256];
+	FILE *f;
+
+	snprintf(path, sizeof(path), "%s/tasks", dir);
+	f = fopen(path, "w");
+	if (!f || fprintf(f, "%d\n", getpid()) < 0 || fclose(f)) {
+		perror(path);
+		exit(1);
+	}
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *fault_thread(void *arg)
+{
+	struct worker *w = arg;
+	size_t size = buffer_kb << 10, off;
+	volatile char *map;
+	unsigned int sum = 0;
+
+	if (file)
+		map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, file_fd, 0);
+	else
+		map = mmap(NULL, size, PROT_READ | PROT_WRITE,
+			   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (map == MAP_FAILED) {
+		perror("mmap");
+		exit(1);
+	}
+	while (!stop) {
+		for (off = 0; off < size; off += page_size) {
+			if (file)
+				sum += map[off];
+			else
+				map[off] = 1;
+		}
+		w->faults += size / page_size;
+		madvise((void *)map, size, MADV_DONTNEED);
+	}
+	munmap((void *)map, size);
+	w->sum = sum;
+	return NULL;
+}
+
+static void *mmap_thread(void *arg)
+{
+	unsigned long *rounds = arg;
+	char *map;
+
+	while (!stop) {
+		map = mmap(NULL, 16 * page_size, PROT_READ | PROT_WRITE,
+			   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (map == MAP_FAILED) {
+			perror("mmap");
+			exit(1);
+		}
+		munmap(map, 16 * page_size);
+		(*rounds)++;
+	}
+	return NULL;
+}
+
+static void run(long nr_threads)
+{
+	struct worker workers[MAX_THREADS];
+	struct rusage before, after;
+	unsigned long long spf[2], retry[2];
+	unsigned long faults = 0, rounds = 0;
+	pthread_t mapper;
+	double start, elapsed;
+	long i;
+
+	memset(workers, 0, sizeof(workers));
+	stop = 0;
+	read_vmstat(&spf[0], &retry[0]);
+	getrusage(RUSAGE_SELF, &before);
+	start = now();
+	for (i = 0; i < nr_threads; i++)
+		if (pthread_create(&workers[i].thread, NULL, fault_thread,
+				   &workers[i])) {
+			fprintf(stderr, "pthread_create failed\n");
+			exit(1);
+		}
+	if (writer && pthread_create(&mapper, NULL, mmap_thread, &rounds)) {
+		fprintf(stderr, "pthread_create failed\n");
+		exit(1);
+	}
+
+	sleep(secs);
+	stop = 1;
+	for (i = 0; i < nr_threads; i++) {
+		pthread_join(workers[i].thread, NULL);
+		faults += workers[i].faults;
+	}
+	if (writer)
+		pthread_join(mapper, NULL);
+	elapsed = now() - start;
+	getrusage(RUSAGE_SELF, &after);
+	read_vmstat(&spf[1], &retry[1]);
+
+	printf("%7ld %12.0f %12.0f %10.0f %10ld %10ld %12llu %10llu\n",
+	       nr_threads, faults / elapsed, faults / elapsed / nr_threads,
+	       rounds / elapsed, after.ru_nvcsw - before.ru_nvcsw,
+	       after.ru_nivcsw - before.ru_nivcsw, spf[1] - spf[0],
+	       retry[1] - retry[0]);
+	fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+	long nr;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "t:s:k:w:f:g:h")) != -1) {
+		switch (opt) {
+		case 't':
+			max_threads = atol(optarg);
+			break;
+		case 's':
+			secs = atol(optarg);
+			break;
+		case 'k':
+			buffer_kb = strtoul(optarg, NULL, 0);
+			break;
+		case 'w':
+			writer = atol(optarg);
+			break;
+		case 'f':
+			file = optarg;
+			break;
+		case 'g':
+			cgroup = optarg;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind != argc || max_threads < 1 || max_threads > MAX_THREADS ||
+	    secs < 1 || !buffer_kb)
+		usage(argv[0]);
+
+	page_size = sysconf(_SC_PAGESIZE);
+	if (file) {
+		file_fd = open(file, O_RDONLY);
+		if (file_fd < 0) {
+			perror(file);
+			return 1;
+		}
+	}
+	if (cgroup)
+		join_cgroup(cgroup);
+	printf("%zu KB %s per thread, %ld s per run, %s, %s\n\n", buffer_kb,
+	       file ? file : "anonymous", secs,
+	       writer ? "with an mmap/munmap writer" : "no writer",
+	       cgroup ? cgroup : "no cgroup");
+	printf("%7s %12s %12s %10s %10s %10s %12s %10s\n", "threads",
+	       "faults/s", "per thread", "mmaps/s", "vcsw", "ivcsw",
+	       "speculative", "retried");
+	for (nr = 1; nr <= max_threads; nr++)
+		run(nr);
+	return 0;
+}
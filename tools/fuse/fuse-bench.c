@@ -0,0 +1,794 @@
+/*
+ * fuse-bench.c -- small file throughput of a FUSE passthrough filesystem
+ *
+ * Mounts a minimal passthrough filesystem of the backing directory on the
+ * mount point, served by 1 to -w worker threads speaking the FUSE protocol
+ * on /dev/fuse directly.  Every worker reads requests from a device fd of
+ * its own, cloned from the mount's with FUSE_DEV_IOC_CLONE, unless -S
+ * makes them all share the mount's fd the way a single queue daemon does.
+ * With -b every read() of a worker returns up to that many requests
+ * (FUSE_DEV_IOC_BATCH).
+ *
+ * Meanwhile -c client threads each create, write, stat, read back and
+ * unlink small files of -k KB under the mount point for -s seconds.  For
+ * every worker count the files per second of the clients and the FUSE
+ * requests per second served by the workers are printed, together with
+ * the average number of requests a worker read() returned.
+ *
+ * Attribute and entry timeouts are 0 unless -t is given, so that every
+ * stat() and lookup reaches the daemon.
+ *
+ * With -m seqread, seqwrite, randread or randwrite each client instead
+ * reads or writes a file of -f MB of its own, sequentially in 128 KB or
+ * at random 4 KB aligned offsets, and the I/Os and MB per second are
+ * printed.  With -p the daemon replies to every open with
+ * FOPEN_PASSTHROUGH and its own descriptor of the backing file, so that
+ * data I/O never reaches it, otherwise every read and write is a round
+ * trip to a worker.  -D makes the daemon ask for FOPEN_DIRECT_IO instead,
+ * which keeps reads from being served out of the FUSE page cache and is
+ * the fair comparison with -p for files that fit into memory.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/mount.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "../../include/linux/fuse.h"
+
+#define MAX_WORKERS	16
+#define MAX_CLIENTS	64
+#define MAX_WRITE	(128 << 10)
+#define BUF_SIZE	(MAX_WRITE + 4096)
+#define HASH_SIZE	1024
+#define SEQ_SIZE	(128 << 10)
+#define RAND_SIZE	4096
+
+enum { FILES, SEQREAD, SEQWRITE, RANDREAD, RANDWRITE };
+
+static const char *mode_names[] = {
+	"files", "seqread", "seqwrite", "randread", "randwrite",
+};
+
+struct node {
+	struct node *next;
+	unsigned long long nodeid;
+	unsigned long long nlookup;
+	char *path;
+};
+
+struct worker {
+	pthread_t thread;
+	int fd;
+	unsigned long requests;
+	unsigned long reads;
+};
+
+struct client {
+	pthread_t thread;
+	int id;
+	unsigned long ops;
+	unsigned long long bytes;
+};
+
+static const char *backing, *mnt;
+static long max_workers = 4, nr_clients = 4, secs = 5, timeout;
+static size_t size = 4 << 10, file_size = 64 << 20;
+static unsigned int batch = 1;
+static int shared, mode = FILES, passthrough, direct_io;
+static volatile int stop;
+
+static struct node *nodes[HASH_SIZE];
+static pthread_mutex_t nodes_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-w workers] [-c clients] [-s secs] "
+		"[-k KB] [-b batch] [-t timeout] [-S] [-m mode] [-f MB] "
+		"[-p] [-D] backing_dir mountpoint\n", prog);
+	exit(2);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* backing path of @nodeid in @buf, -ENOENT if it was forgotten */
+static int node_path(unsigned long long nodeid, const char *name, char *buf,
+		     size_t len)
+{
+	struct node *n;
+	int err = -ENOENT;
+
+	pthread_mutex_lock(&nodes_lock);
+	for (n = nodes[nodeid % HASH_SIZE]; n; n = n->next) {
+		if (n->nodeid == nodeid) {
+			if (name)
+				snprintf(buf, len, "%s/%s", n->path, name);
+			else
+				snprintf(buf, len, "%s", n->path);
+			err = 0;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&nodes_lock);
+	return err;
+}
+
+/* the backing inode number is the node id, the root's is FUSE_ROOT_ID */
+static void node_get(unsigned long long nodeid, const char *path)
+{
+	struct node **p = &nodes[nodeid % HASH_SIZE], *n;
+
+	pthread_mutex_lock(&nodes_lock);
+	for (n = *p; n; n = n->next)
+		if (n->nodeid == nodeid)
+			break;
+	if (!n) {
+		n = calloc(1, sizeof(*n));
+		if (!n) {
+			perror("calloc");
+			exit(1);
+		}
+		n->nodeid = nodeid;
+		n->next = *p;
+		*p = n;
+	}
+	if (!n->path || strcmp(n->path, path)) {
+		free(n->path);
+		n->path = strdup(path);
+	}
+	n->nlookup++;
+	pthread_mutex_unlock(&nodes_lock);
+}
+
+static void node_forget(unsigned long long nodeid, unsigned long long nlookup)
+{
+	struct node **p, *n;
+
+	pthread_mutex_lock(&nodes_lock);
+	for (p = &nodes[nodeid % HASH_SIZE]; (n = *p); p = &n->next) {
+		if (n->nodeid != nodeid)
+			continue;
+		if (n->nlookup > nlookup) {
+			n->nlookup -= nlookup;
+		} else {
+			*p = n->next;
+			free(n->path);
+			free(n);
+		}
+		break;
+	}
+	pthread_mutex_unlock(&nodes_lock);
+}
+
+static void nodes_clear(void)
+{
+	struct node *n;
+	int i;
+
+	for (i = 0; i < HASH_SIZE; i++) {
+		while ((n = nodes[i])) {
+			nodes[i] = n->next;
+			free(n->path);
+			free(n);
+		}
+	}
+}
+
+static void fill_attr(struct fuse_attr *attr, const struct stat *st,
+		      unsigned long long nodeid)
+{
+	memset(attr, 0, sizeof(*attr));
+	attr->ino = nodeid;
+	attr->size = st->st_size;
+	attr->blocks = st->st_blocks;
+	attr->atime = st->st_atim.tv_sec;
+	attr->mtime = st->st_mtim.tv_sec;
+	attr->ctime = st->st_ctim.tv_sec;
+	attr->atimensec = st->st_atim.tv_nsec;
+	attr->mtimensec = st->st_mtim.tv_nsec;
+	attr->ctimensec = st->st_ctim.tv_nsec;
+	attr->mode = st->st_mode;
+	attr->nlink = st->st_nlink;
+	attr->uid = st->st_uid;
+	attr->gid = st->st_gid;
+	attr->rdev = st->st_rdev;
+	attr->blksize = st->st_blksize;
+}
+
+/* look up and stat @path, filling @e and taking a lookup reference */
+static int do_entry(const char *path, struct fuse_entry_out *e)
+{
+	struct stat st;
+
+	if (lstat(path, &st))
+		return -errno;
+	memset(e, 0, sizeof(*e));
+	e->nodeid = st.st_ino;
+	e->entry_valid = timeout;
+	e->attr_valid = timeout;
+	fill_attr(&e->attr, &st, e->nodeid);
+	node_get(e->nodeid, path);
+	return 0;
+}
+
+static int do_attr(const char *path, unsigned long long nodeid,
+		   struct fuse_attr_out *a)
+{
+	struct stat st;
+
+	if (lstat(path, &st))
+		return -errno;
+	memset(a, 0, sizeof(*a));
+	a->attr_valid = timeout;
+	fill_attr(&a->attr, &st, nodeid);
+	return 0;
+}
+
+static void reply(int fd, const struct fuse_in_header *in, int error,
+		  const void *arg, size_t len, const void *arg2, size_t len2)
+{
+	struct fuse_out_header out;
+	struct iovec iov[3];
+
+	out.len = sizeof(out) + (error ? 0 : len + len2);
+	out.error = error;
+	out.unique = in->unique;
+	iov[0].iov_base = &out;
+	iov[0].iov_len = sizeof(out);
+	iov[1].iov_base = (void *)arg;
+	iov[1].iov_len = error ? 0 : len;
+	iov[2].iov_base = (void *)arg2;
+	iov[2].iov_len = error ? 0 : len2;
+	/* ENOENT: the request was interrupted and is gone */
+	if (writev(fd, iov, 3) < 0 && errno != ENOENT) {
+		perror("writev /dev/fuse");
+		exit(1);
+	}
+}
+
+static void do_init(int fd, const struct fuse_in_header *in, const void *arg)
+{
+	const struct fuse_init_in *init = arg;
+	struct fuse_init_out out;
+
+	if (init->major != FUSE_KERNEL_VERSION) {
+		fprintf(stderr, "FUSE protocol %u.%u not supported\n",
+			init->major, init->minor);
+		exit(1);
+	}
+	memset(&out, 0, sizeof(out));
+	out.major = FUSE_KERNEL_VERSION;
+	out.minor = FUSE_KERNEL_MINOR_VERSION;
+	out.max_readahead = init->max_readahead;
+	if (passthrough && !(init->flags & FUSE_PASSTHROUGH)) {
+		fprintf(stderr, "kernel does not support passthrough\n");
+		exit(1);
+	}
+	out.flags = init->flags & (FUSE_BIG_WRITES | FUSE_PASSTHROUGH);
+	out.max_background = 64;
+	out.congestion_threshold = 48;
+	out.max_write = MAX_WRITE;
+	reply(fd, in, 0, &out, sizeof(out), NULL, 0);
+}
+
+static void do_setattr(int fd, const struct fuse_in_header *in,
+		       const struct fuse_setattr_in *sa, const char *path)
+{
+	struct fuse_attr_out out;
+	int err = 0;
+
+	if ((sa->valid & FATTR_SIZE) && truncate(path, sa->size))
+		err = -errno;
+	if (!err && (sa->valid & FATTR_MODE) && chmod(path, sa->mode & 07777))
+		err = -errno;
+	if (!err)
+		err = do_attr(path, in->nodeid, &out);
+	reply(fd, in, err, &out, sizeof(out), NULL, 0);
+}
+
+static void fill_open(struct fuse_open_out *o, int file)
+{
+	memset(o, 0, sizeof(*o));
+	o->fh = file;
+	if (passthrough) {
+		o->open_flags = FOPEN_PASSTHROUGH;
+		o->passthrough_fd = file;
+	} else if (direct_io) {
+		o->open_flags = FOPEN_DIRECT_IO;
+	}
+}
+
+static void do_create(int fd, const struct fuse_in_header *in,
+		      const struct fuse_create_in *ci, const char *path)
+{
+	struct fuse_entry_out e;
+	struct fuse_open_out o;
+	int file, err;
+
+	file = open(path, ci->flags | O_CREAT, ci->mode & ~ci->umask);
+	if (file < 0) {
+		reply(fd, in, -errno, NULL, 0, NULL, 0);
+		return;
+	}
+	err = do_entry(path, &e);
+	if (err) {
+		close(file);
+		reply(fd, in, err, NULL, 0, NULL, 0);
+		return;
+	}
+	fill_open(&o, file);
+	reply(fd, in, 0, &e, sizeof(e), &o, sizeof(o));
+}
+
+static void do_read(int fd, const struct fuse_in_header *in,
+		    const struct fuse_read_in *ri, char *buf)
+{
+	ssize_t n;
+
+	n = pread(ri->fh, buf, ri->size, ri->offset);
+	if (n < 0)
+		reply(fd, in, -errno, NULL, 0, NULL, 0);
+	else
+		reply(fd, in, 0, buf, n, NULL, 0);
+}
+
+static void do_write(int fd, const struct fuse_in_header *in,
+		     const struct fuse_write_in *wi)
+{
+	struct fuse_write_out out;
+	ssize_t n;
+
+	n = pwrite(wi->fh, wi + 1, wi->size, wi->offset);
+	if (n < 0) {
+		reply(fd, in, -errno, NULL, 0, NULL, 0);
+		return;
+	}
+	memset(&out, 0, sizeof(out));
+	out.size = n;
+	reply(fd, in, 0, &out, sizeof(out), NULL, 0);
+}
+
+static void handle(int fd, const struct fuse_in_header *in, char *data)
+{
+	const void *arg = in + 1;
+	union {
+		struct fuse_entry_out e;
+		struct fuse_attr_out a;
+		struct fuse_open_out o;
+	} out;
+	char path[PATH_MAX];
+	const char *name = NULL;
+	int err, file;
+
+	switch (in->opcode) {
+	case FUSE_INIT:
+		do_init(fd, in, arg);
+		return;
+	case FUSE_FORGET:
+		node_forget(in->nodeid,
+			    ((const struct fuse_forget_in *)arg)->nlookup);
+		return;
+	case FUSE_LOOKUP:
+	case FUSE_UNLINK:
+		name = arg;
+		break;
+	case FUSE_CREATE:
+		name = (const char *)arg + sizeof(struct fuse_create_in);
+		break;
+	}
+	if (in->opcode != FUSE_READ && in->opcode != FUSE_WRITE &&
+	    in->opcode != FUSE_FLUSH && in->opcode != FUSE_RELEASE) {
+		err = node_path(in->nodeid, name, path, sizeof(path));
+		if (err) {
+			reply(fd, in, err, NULL, 0, NULL, 0);
+			return;
+		}
+	}
+
+	switch (in->opcode) {
+	case FUSE_LOOKUP:
+		err = do_entry(path, &out.e);
+		reply(fd, in, err, &out.e, sizeof(out.e), NULL, 0);
+		break;
+	case FUSE_GETATTR:
+		err = do_attr(path, in->nodeid, &out.a);
+		reply(fd, in, err, &out.a, sizeof(out.a), NULL, 0);
+		break;
+	case FUSE_SETATTR:
+		do_setattr(fd, in, arg, path);
+		break;
+	case FUSE_OPEN:
+		file = open(path, ((const struct fuse_open_in *)arg)->flags &
+			    ~(O_CREAT | O_EXCL | O_NOCTTY));
+		fill_open(&out.o, file);
+		reply(fd, in, file < 0 ? -errno : 0, &out.o, sizeof(out.o),
+		      NULL, 0);
+		break;
+	case FUSE_CREATE:
+		do_create(fd, in, arg, path);
+		break;
+	case FUSE_READ:
+		do_read(fd, in, arg, data);
+		break;
+	case FUSE_WRITE:
+		do_write(fd, in, arg);
+		break;
+	case FUSE_FLUSH:
+		reply(fd, in, 0, NULL, 0, NULL, 0);
+		break;
+	case FUSE_RELEASE:
+		close(((const struct fuse_release_in *)arg)->fh);
+		reply(fd, in, 0, NULL, 0, NULL, 0);
+		break;
+	case FUSE_UNLINK:
+		reply(fd, in, unlink(path) ? -errno : 0, NULL, 0, NULL, 0);
+		break;
+	default:
+		reply(fd, in, -ENOSYS, NULL, 0, NULL, 0);
+	}
+}
+
+static void *worker_thread(void *arg)
+{
+	struct worker *w = arg;
+	const struct fuse_in_header *in;
+	char *buf, *data;
+	ssize_t n, off;
+
+	buf = malloc(BUF_SIZE);
+	data = malloc(MAX_WRITE);
+	if (!buf || !data) {
+		perror("malloc");
+		exit(1);
+	}
+	for (;;) {
+		n = read(w->fd, buf, BUF_SIZE);
+		if (n < 0) {
+			/* ENOENT: an interrupted request went away */
+			if (errno == EINTR || errno == EAGAIN ||
+			    errno == ENOENT)
+				continue;
+			if (errno == ENODEV)
+				break;
+			perror("read /dev/fuse");
+			exit(1);
+		}
+		w->reads++;
+		for (off = 0; off < n; off += in->len) {
+			in = (const struct fuse_in_header *)(buf + off);
+			handle(w->fd, in, data);
+			w->requests++;
+		}
+	}
+	free(data);
+	free(buf);
+	return NULL;
+}
+
+static void small_files(struct client *c, char *buf)
+{
+	char path[PATH_MAX];
+	struct stat st;
+	unsigned long i;
+	int fd;
+
+	for (i = 0; !stop; i++) {
+		snprintf(path, sizeof(path), "%s/c%d-%lu", mnt, c->id, i % 64);
+		fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0 || write(fd, buf, size) != (ssize_t)size ||
+		    close(fd)) {
+			perror(path);
+			exit(1);
+		}
+		if (stat(path, &st) || st.st_size != (off_t)size) {
+			fprintf(stderr, "%s: bad size\n", path);
+			exit(1);
+		}
+		fd = open(path, O_RDONLY);
+		if (fd < 0 || read(fd, buf, size) != (ssize_t)size ||
+		    close(fd)) {
+			perror(path);
+			exit(1);
+		}
+		if (unlink(path)) {
+			perror(path);
+			exit(1);
+		}
+		c->ops++;
+		c->bytes += 2 * size;
+	}
+}
+
+static void file_io(struct client *c, char *buf, size_t len)
+{
+	int reading = mode == SEQREAD || mode == RANDREAD;
+	int seq = mode == SEQREAD || mode == SEQWRITE;
+	off_t blocks = file_size / len, off = 0;
+	unsigned int seed = c->id + 1;
+	char path[PATH_MAX];
+	ssize_t n;
+	int fd;
+
+	snprintf(path, sizeof(path), "%s/io%d", mnt, c->id);
+	fd = open(path, reading ? O_RDONLY : O_WRONLY);
+	if (fd < 0) {
+		perror(path);
+		exit(1);
+	}
+	while (!stop) {
+		if (!seq)
+			off = (off_t)(rand_r(&seed) % blocks) * len;
+		if (reading)
+			n = pread(fd, buf, len, off);
+		else
+			n = pwrite(fd, buf, len, off);
+		if (n != (ssize_t)len) {
+			perror(path);
+			exit(1);
+		}
+		off += len;
+		if (off >= blocks * (off_t)len)
+			off = 0;
+		c->ops++;
+		c->bytes += len;
+	}
+	close(fd);
+}
+
+static void *client_thread(void *arg)
+{
+	struct client *c = arg;
+	size_t len;
+	char *buf;
+
+	if (mode == FILES)
+		len = size;
+	else if (mode == SEQREAD || mode == SEQWRITE)
+		len = SEQ_SIZE;
+	else
+		len = RAND_SIZE;
+	buf = malloc(len);
+	if (!buf) {
+		perror("malloc");
+		exit(1);
+	}
+	memset(buf, 0x5a, len);
+	if (mode == FILES)
+		small_files(c, buf);
+	else
+		file_io(c, buf, len);
+	free(buf);
+	return NULL;
+}
+
+/* the files of the I/O modes are written in the backing directory */
+static void io_files(int create)
+{
+	char path[PATH_MAX], *buf;
+	struct stat st;
+	size_t off;
+	long i;
+	int fd;
+
+	buf = calloc(1, SEQ_SIZE);
+	if (!buf) {
+		perror("calloc");
+		exit(1);
+	}
+	for (i = 0; i < nr_clients; i++) {
+		snprintf(path, sizeof(path), "%s/io%ld", backing, i);
+		if (!create) {
+			unlink(path);
+			continue;
+		}
+		if (!stat(path, &st) && st.st_size >= (off_t)file_size)
+			continue;
+		fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0) {
+			perror(path);
+			exit(1);
+		}
+		for (off = 0; off < file_size; off += SEQ_SIZE) {
+			if (write(fd, buf, SEQ_SIZE) != SEQ_SIZE) {
+				perror(path);
+				exit(1);
+			}
+		}
+		close(fd);
+	}
+	free(buf);
+}
+
+static int open_dev(void)
+{
+	int fd;
+
+	fd = open("/dev/fuse", O_RDWR);
+	if (fd < 0) {
+		perror("/dev/fuse");
+		exit(1);
+	}
+	return fd;
+}
+
+static void run(long nr_workers)
+{
+	struct worker workers[MAX_WORKERS];
+	struct client clients[MAX_CLIENTS];
+	unsigned long ops = 0, requests = 0, reads = 0;
+	unsigned long long bytes = 0;
+	double start, elapsed;
+	char opts[128];
+	__u32 oldfd;
+	long i;
+	int fd;
+
+	memset(workers, 0, sizeof(workers));
+	memset(clients, 0, sizeof(clients));
+	fd = open_dev();
+	snprintf(opts, sizeof(opts),
+		 "fd=%d,rootmode=40000,user_id=0,group_id=0,allow_other", fd);
+	if (mount("fuse-bench", mnt, "fuse", MS_NOSUID | MS_NODEV, opts)) {
+		perror("mount");
+		exit(1);
+	}
+	node_get(FUSE_ROOT_ID, backing);
+
+	oldfd = fd;
+	for (i = 0; i < nr_workers; i++) {
+		workers[i].fd = fd;
+		if (i && !shared) {
+			workers[i].fd = open_dev();
+			if (ioctl(workers[i].fd, FUSE_DEV_IOC_CLONE, &oldfd)) {
+				perror("FUSE_DEV_IOC_CLONE");
+				exit(1);
+			}
+		}
+		if (batch > 1 && (!i || !shared) &&
+		    ioctl(workers[i].fd, FUSE_DEV_IOC_BATCH, &batch)) {
+			perror("FUSE_DEV_IOC_BATCH");
+			exit(1);
+		}
+		if (pthread_create(&workers[i].thread, NULL, worker_thread,
+				   &workers[i])) {
+			fprintf(stderr, "pthread_create failed\n");
+			exit(1);
+		}
+	}
+
+	stop = 0;
+	start = now();
+	for (i = 0; i < nr_clients; i++) {
+		clients[i].id = i;
+		if (pthread_create(&clients[i].thread, NULL, client_thread,
+				   &clients[i])) {
+			fprintf(stderr, "pthread_create failed\n");
+			exit(1);
+		}
+	}
+	sleep(secs);
+	stop = 1;
+	for (i = 0; i < nr_clients; i++) {
+		pthread_join(clients[i].thread, NULL);
+		ops += clients[i].ops;
+		bytes += clients[i].bytes;
+	}
+	elapsed = now() - start;
+
+	/* the workers see ENODEV once the connection is gone */
+	if (umount(mnt)) {
+		perror("umount");
+		exit(1);
+	}
+	for (i = 0; i < nr_workers; i++) {
+		pthread_join(workers[i].thread, NULL);
+		requests += workers[i].requests;
+		reads += workers[i].reads;
+		if (workers[i].fd != fd)
+			close(workers[i].fd);
+	}
+	close(fd);
+	nodes_clear();
+
+	printf("%7ld %10.0f %10.1f %12.0f %12.0f %10.2f\n", nr_workers,
+	       ops / elapsed, bytes / elapsed / (1 << 20), requests / elapsed,
+	       requests / elapsed / nr_workers,
+	       reads ? (double)requests / reads : 0);
+	fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+	long nr;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "w:c:s:k:b:t:Sm:f:pDh")) != -1) {
+		switch (opt) {
+		case 'w':
+			max_workers = atol(optarg);
+			break;
+		case 'c':
+			nr_clients = atol(optarg);
+			break;
+		case 's':
+			secs = atol(optarg);
+			break;
+		case 'k':
+			size = strtoul(optarg, NULL, 0) << 10;
+			break;
+		case 'b':
+			batch = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			timeout = atol(optarg);
+			break;
+		case 'S':
+			shared = 1;
+			break;
+		case 'm':
+			for (mode = 0; mode <= RANDWRITE; mode++)
+				if (!strcmp(optarg, mode_names[mode]))
+					break;
+			break;
+		case 'f':
+			file_size = strtoul(optarg, NULL, 0) << 20;
+			break;
+		case 'p':
+			passthrough = 1;
+			break;
+		case 'D':
+			direct_io = 1;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind != argc - 2 || max_workers < 1 ||
+	    max_workers > MAX_WORKERS || nr_clients < 1 ||
+	    nr_clients > MAX_CLIENTS || secs < 1 || !size ||
+	    size > MAX_WRITE || !batch || mode > RANDWRITE ||
+	    file_size < SEQ_SIZE)
+		usage(argv[0]);
+	backing = argv[optind];
+	mnt = argv[optind + 1];
+
+	if (mode == FILES)
+		printf("%s on %s, %ld clients, %zu KB files", backing, mnt,
+		       nr_clients, size >> 10);
+	else
+		printf("%s on %s, %ld clients, %s of %zu MB files", backing,
+		       mnt, nr_clients, mode_names[mode], file_size >> 20);
+	printf(", %s, batch %u%s\n\n", shared ? "shared fd" : "fd per worker",
+	       batch, passthrough ? ", passthrough" :
+	       direct_io ? ", direct I/O" : "");
+	printf("%7s %10s %10s %12s %12s %10s\n", "workers",
+	       mode == FILES ? "files/s" : "IOs/s", "MB/s", "requests/s",
+	       "per worker", "per read");
+	if (mode != FILES)
+		io_files(1);
+	for (nr = 1; nr <= max_workers; nr++)
+		run(nr);
+	if (mode != FILES)
+		io_files(0);
+	return 0;
+}
@@ -0,0 +1,277 @@
+/*
+ * fsync-storm.c -- fsync throughput and journal commits of concurrent writers
+ *
+ * Each of 1 to -t threads appends -k KB to a file of its own in the
+ * directory and fsync()s it, over and over for -s seconds, the way a
+ * SQLite database in WAL mode commits.  A file is truncated again once it
+ * reaches -m MB.  With -o the threads overwrite the start of their file
+ * instead, and with -d they use fdatasync().
+ *
+ * For every thread count the fsyncs per second, their average and 99th
+ * percentile latency and the journal commits per second are printed.  The
+ * commits are counted in the first line of /proc/fs/jbd2/<dev>/info, the
+ * journal of the filesystem holding the directory unless -j names another
+ * info file, which also gives how many fsyncs waited for a batch to fill
+ * and how many joined one.  Compare runs with max_batch_time=0, the
+ * default batching and journal_async_commit.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+
+#define MAX_THREADS	64
+#define MAX_SAMPLES	65536
+
+struct worker {
+	pthread_t thread;
+	int id;
+	unsigned long fsyncs;
+	double *lat;
+};
+
+struct journal_stats {
+	unsigned long commits;
+	unsigned long batches;
+	unsigned long joined;
+};
+
+static const char *dir;
+static char info_path[256];
+static long max_threads = 8, secs = 5;
+static size_t size = 4 << 10, max_size = 64 << 20;
+static int overwrite, datasync;
+static volatile int stop;
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-t threads] [-s secs] [-k KB] [-m MB] "
+		"[-o] [-d] [-j jbd2 info file] dir\n", prog);
+	exit(2);
+}
+
+static double now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* /proc/fs/jbd2/<devname>-8/info of the filesystem holding dir */
+static void find_journal(void)
+{
+	char path[256], line[256], name[64] = "";
+	struct stat st;
+	FILE *f;
+
+	if (stat(dir, &st)) {
+		perror(dir);
+		exit(1);
+	}
+	snprintf(path, sizeof(path), "/sys/dev/block/%u:%u/uevent",
+		 major(st.st_dev), minor(st.st_dev));
+	f = fopen(path, "r");
+	if (!f)
+		return;
+	while (fgets(line, sizeof(line), f))
+		if (sscanf(line, "DEVNAME=%63s", name) == 1)
+			break;
+	fclose(f);
+	if (name[0])
+		snprintf(info_path, sizeof(info_path),
+			 "/proc/fs/jbd2/%s-8/info", name);
+}
+
+static void read_journal(struct journal_stats *js)
+{
+	char line[256];
+	FILE *f;
+
+	memset(js, 0, sizeof(*js));
+	if (!info_path[0])
+		return;
+	f = fopen(info_path, "r");
+	if (!f)
+		return;
+	if (fgets(line, sizeof(line), f))
+		sscanf(line, "%lu transaction", &js->commits);
+	if (fgets(line, sizeof(line), f))
+		sscanf(line, "%lu fsync batches, %lu fsyncs joined",
+		       &js->batches, &js->joined);
+	fclose(f);
+}
+
+static void *storm_thread(void *arg)
+{
+	struct worker *w = arg;
+	char path[256], *buf;
+	off_t off = 0;
+	double start;
+	int fd;
+
+	snprintf(path, sizeof(path), "%s/fsync-storm.%d", dir, w->id);
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	buf = malloc(size);
+	if (fd < 0 || !buf) {
+		perror(path);
+		exit(1);
+	}
+	memset(buf, 0x5a, size);
+	while (!stop) {
+		if (!overwrite && off + size > max_size) {
+			if (ftruncate(fd, 0)) {
+				perror("ftruncate");
+				exit(1);
+			}
+			off = 0;
+		}
+		start = now_us();
+		if (pwrite(fd, buf, size, off) != (ssize_t)size ||
+		    (datasync ? fdatasync(fd) : fsync(fd))) {
+			perror(path);
+			exit(1);
+		}
+		w->lat[w->fsyncs % MAX_SAMPLES] = now_us() - start;
+		w->fsyncs++;
+		if (!overwrite)
+			off += size;
+	}
+	close(fd);
+	unlink(path);
+	free(buf);
+	return NULL;
+}
+
+static void run(long nr_threads)
+{
+	struct worker workers[MAX_THREADS];
+	struct journal_stats before, after;
+	unsigned long fsyncs = 0, commits;
+	double start, elapsed, sum = 0, *lat;
+	long i, j, n = 0;
+
+	memset(workers, 0, sizeof(workers));
+	lat = calloc(nr_threads * MAX_SAMPLES, sizeof(*lat));
+	if (!lat) {
+		perror("calloc");
+		exit(1);
+	}
+	stop = 0;
+	read_journal(&before);
+	start = now_us();
+	for (i = 0; i < nr_threads; i++) {
+		workers[i].id = i;
+		workers[i].lat = lat + i * MAX_SAMPLES;
+		if (pthread_create(&workers[i].thread, NULL, storm_thread,
+				   &workers[i])) {
+			fprintf(stderr, "pthread_create failed\n");
+			exit(1);
+		}
+	}
+	sleep(secs);
+	stop = 1;
+	for (i = 0; i < nr_threads; i++)
+		pthread_join(workers[i].thread, NULL);
+	elapsed = (now_us() - start) / 1e6;
+	read_journal(&after);
+
+	/* pack the samples of all threads together */
+	for (i = 0; i < nr_threads; i++) {
+		long samples = workers[i].fsyncs < MAX_SAMPLES ?
+			       workers[i].fsyncs : MAX_SAMPLES;
+
+		fsyncs += workers[i].fsyncs;
+		for (j = 0; j < samples; j++) {
+			lat[n] = workers[i].lat[j];
+			sum += lat[n++];
+		}
+	}
+	if (!n) {
+		fprintf(stderr, "no fsync completed\n");
+		exit(1);
+	}
+	qsort(lat, n, sizeof(*lat), cmp_double);
+	commits = after.commits - before.commits;
+
+	printf("%7ld %10.0f %10.2f %10.2f %10.0f %10.2f %8lu %8lu\n",
+	       nr_threads, fsyncs / elapsed, sum / n / 1000,
+	       lat[n * 99 / 100] / 1000, commits / elapsed,
+	       commits ? (double)fsyncs / commits : 0,
+	       after.batches - before.batches, after.joined - before.joined);
+	fflush(stdout);
+	free(lat);
+}
+
+int main(int argc, char **argv)
+{
+	const char *info = NULL;
+	long nr;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "t:s:k:m:odj:h")) != -1) {
+		switch (opt) {
+		case 't':
+			max_threads = atol(optarg);
+			break;
+		case 's':
+			secs = atol(optarg);
+			break;
+		case 'k':
+			size = strtoul(optarg, NULL, 0) << 10;
+			break;
+		case 'm':
+			max_size = strtoul(optarg, NULL, 0) << 20;
+			break;
+		case 'o':
+			overwrite = 1;
+			break;
+		case 'd':
+			datasync = 1;
+			break;
+		case 'j':
+			info = optarg;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind != argc - 1 || max_threads < 1 ||
+	    max_threads > MAX_THREADS || secs < 1 || !size ||
+	    max_size < size)
+		usage(argv[0]);
+	dir = argv[optind];
+
+	if (info)
+		snprintf(info_path, sizeof(info_path), "%s", info);
+	else
+		find_journal();
+
+	printf("%s, %zu KB %s%s, %ld s per run, journal %s\n\n", dir,
+	       size >> 10, overwrite ? "overwrites" : "appends",
+	       datasync ? " with fdatasync" : "", secs,
+	       info_path[0] ? info_path : "unknown");
+	printf("%7s %10s %10s %10s %10s %10s %8s %8s\n", "threads",
+	       "fsyncs/s", "avg_ms", "p99_ms", "commits/s", "per commit",
+	       "batches", "joined");
+	for (nr = 1; nr <= max_threads; nr++)
+		run(nr);
+	return 0;
+}
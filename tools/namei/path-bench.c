@@ -0,0 +1,205 @@
+/*
+ * path-bench.c -- cost of stat() and open() by path depth
+ *
+ * Creates a chain of -d nested directories in the directory, with a file at
+ * every depth, and then for every depth times -n calls of stat() on the
+ * file, of stat() on a name missing from the directory holding it and of
+ * open() and close() of the file, from -t threads at once.  Every call
+ * resolves the whole path from the directory given, as the package manager
+ * and the media scanner do for each file they look at.
+ *
+ * For every depth the average time per call in nanoseconds is printed, and
+ * per component in the last column for stat().  With the lock-free walk the
+ * cost per component should stay flat as the threads are added; without it
+ * the dcache_lock and d_lock taken for every component show up.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#define MAX_DEPTH	32
+#define MAX_THREADS	64
+
+enum { STAT, STAT_MISSING, OPEN, NR_OPS };
+
+struct worker {
+	pthread_t thread;
+	int op;
+	const char *path;
+};
+
+static const char *dir;
+static long max_depth = 16, iterations = 100000, nr_threads = 1;
+static pthread_barrier_t barrier;
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-d depth] [-n calls] [-t threads] dir\n",
+		prog);
+	exit(2);
+}
+
+static double now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* dir/p/p/.../p/<name>, with depth p's */
+static void make_path(char *buf, size_t size, long depth, const char *name)
+{
+	size_t n = snprintf(buf, size, "%s", dir);
+	long i;
+
+	for (i = 0; i < depth && n < size; i++)
+		n += snprintf(buf + n, size - n, "/p");
+	if (n < size)
+		snprintf(buf + n, size - n, "/%s", name);
+}
+
+static void *call_thread(void *arg)
+{
+	struct worker *w = arg;
+	struct stat st;
+	long i;
+	int fd;
+
+	pthread_barrier_wait(&barrier);
+	for (i = 0; i < iterations; i++) {
+		switch (w->op) {
+		case STAT:
+			if (stat(w->path, &st)) {
+				perror(w->path);
+				exit(1);
+			}
+			break;
+		case STAT_MISSING:
+			if (!stat(w->path, &st)) {
+				fprintf(stderr, "%s exists\n", w->path);
+				exit(1);
+			}
+			break;
+		case OPEN:
+			fd = open(w->path, O_RDONLY);
+			if (fd < 0) {
+				perror(w->path);
+				exit(1);
+			}
+			close(fd);
+			break;
+		}
+	}
+	pthread_barrier_wait(&barrier);
+	return NULL;
+}
+
+/* average ns per call of op on path, with all threads calling it */
+static double run(int op, const char *path)
+{
+	struct worker workers[MAX_THREADS];
+	double start;
+	long i;
+
+	pthread_barrier_init(&barrier, NULL, nr_threads + 1);
+	for (i = 0; i < nr_threads; i++) {
+		workers[i].op = op;
+		workers[i].path = path;
+		if (pthread_create(&workers[i].thread, NULL, call_thread,
+				   &workers[i])) {
+			fprintf(stderr, "pthread_create failed\n");
+			exit(1);
+		}
+	}
+	pthread_barrier_wait(&barrier);
+	start = now_ns();
+	pthread_barrier_wait(&barrier);
+	start = now_ns() - start;
+	for (i = 0; i < nr_threads; i++)
+		pthread_join(workers[i].thread, NULL);
+	pthread_barrier_destroy(&barrier);
+	return start / iterations;
+}
+
+int main(int argc, char **argv)
+{
+	char path[4096];
+	double ns[NR_OPS];
+	long depth;
+	int opt, op, fd;
+
+	while ((opt = getopt(argc, argv, "d:n:t:h")) != -1) {
+		switch (opt) {
+		case 'd':
+			max_depth = atol(optarg);
+			break;
+		case 'n':
+			iterations = atol(optarg);
+			break;
+		case 't':
+			nr_threads = atol(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind != argc - 1 || max_depth < 0 || max_depth > MAX_DEPTH ||
+	    iterations < 1 || nr_threads < 1 || nr_threads > MAX_THREADS)
+		usage(argv[0]);
+	dir = argv[optind];
+
+	for (depth = 0; depth <= max_depth; depth++) {
+		make_path(path, sizeof(path), depth, "f");
+		fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0) {
+			perror(path);
+			return 1;
+		}
+		close(fd);
+		if (depth < max_depth) {
+			make_path(path, sizeof(path), depth, "p");
+			if (mkdir(path, 0755)) {
+				perror(path);
+				return 1;
+			}
+		}
+	}
+
+	printf("%s, %ld calls from each of %ld threads\n\n", dir, iterations,
+	       nr_threads);
+	printf("%6s %10s %12s %10s %14s\n", "depth", "stat_ns", "enoent_ns",
+	       "open_ns", "stat_ns/comp");
+	for (depth = 0; depth <= max_depth; depth++) {
+		for (op = 0; op < NR_OPS; op++) {
+			make_path(path, sizeof(path), depth,
+				  op == STAT_MISSING ? "missing" : "f");
+			ns[op] = run(op, path);
+		}
+		/* components below dir: the directories and the file */
+		printf("%6ld %10.0f %12.0f %10.0f %14.1f\n", depth, ns[STAT],
+		       ns[STAT_MISSING], ns[OPEN], ns[STAT] / (depth + 1));
+		fflush(stdout);
+	}
+
+	/* clean up, deepest first */
+	for (depth = max_depth; depth >= 0; depth--) {
+		make_path(path, sizeof(path), depth, "f");
+		unlink(path);
+		if (depth) {
+			make_path(path, sizeof(path), depth - 1, "p");
+			rmdir(path);
+		}
+	}
+	return 0;
+}
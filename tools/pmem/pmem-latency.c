@@ -0,0 +1,214 @@
+/*
+ * pmem-latency.c -- time pmem allocations with and without memory pressure
+ *
+ * A pmem buffer is allocated by mmap()ing the device, and given back when
+ * the file is closed.  That is timed a number of times on an otherwise
+ * idle system and then again while a child process keeps dirtying
+ * anonymous memory and, with -f, reading a file through the page cache.
+ *
+ * On a carveout region both cost about the same.  On a region declared to
+ * CMA the movable pages the pressure placed in the region are migrated
+ * out when the buffer is allocated, and the difference between the two
+ * runs is the price paid for lending the region out.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+struct pmem_region {
+	unsigned long offset;
+	unsigned long len;
+};
+
+#define PMEM_IOCTL_MAGIC	'p'
+#define PMEM_GET_TOTAL_SIZE	_IOW(PMEM_IOCTL_MAGIC, 7, unsigned int)
+
+static const char *dev = "/dev/pmem";
+static const char *file;
+static size_t size;
+static long rounds = 20, pressure_mb;
+static long page_size;
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-d device] [-s KB] [-n rounds] "
+		"[-m MB] [-f file]\n", prog);
+	exit(2);
+}
+
+static double now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static long mem_free_mb(void)
+{
+	char line[256];
+	long kb = 0;
+	FILE *f;
+
+	f = fopen("/proc/meminfo", "r");
+	if (!f)
+		return 0;
+	while (fgets(line, sizeof(line), f))
+		if (sscanf(line, "MemFree: %ld kB", &kb) == 1)
+			break;
+	fclose(f);
+	return kb / 1024;
+}
+
+/* keep anonymous and page cache pages churning until killed */
+static void pressure(void)
+{
+	size_t len = (size_t)pressure_mb << 20, off;
+	char buf[65536];
+	char *map;
+	int fd;
+
+	map = mmap(NULL, len, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (map == MAP_FAILED) {
+		perror("mmap");
+		exit(1);
+	}
+	for (;;) {
+		for (off = 0; off < len; off += page_size)
+			map[off]++;
+		if (!file)
+			continue;
+		fd = open(file, O_RDONLY);
+		if (fd < 0) {
+			perror(file);
+			exit(1);
+		}
+		while (read(fd, buf, sizeof(buf)) > 0)
+			;
+		close(fd);
+	}
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void run(const char *name, double *lat)
+{
+	double start, sum = 0;
+	char *map;
+	long i;
+	int fd;
+
+	for (i = 0; i < rounds; i++) {
+		fd = open(dev, O_RDWR);
+		if (fd < 0) {
+			perror(dev);
+			exit(1);
+		}
+		start = now_us();
+		map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+			   fd, 0);
+		if (map == MAP_FAILED) {
+			perror("pmem mmap");
+			exit(1);
+		}
+		map[0] = 1;
+		lat[i] = now_us() - start;
+		sum += lat[i];
+		munmap(map, size);
+		close(fd);
+		usleep(100000);
+	}
+
+	qsort(lat, rounds, sizeof(*lat), cmp_double);
+	printf("%-10s %10.0f %10.0f %10.0f %10.0f\n", name, lat[0],
+	       sum / rounds, lat[rounds / 2], lat[rounds - 1]);
+}
+
+int main(int argc, char **argv)
+{
+	struct pmem_region region;
+	double *lat;
+	pid_t child;
+	int opt, fd;
+
+	while ((opt = getopt(argc, argv, "d:s:n:m:f:h")) != -1) {
+		switch (opt) {
+		case 'd':
+			dev = optarg;
+			break;
+		case 's':
+			size = strtoul(optarg, NULL, 0) << 10;
+			break;
+		case 'n':
+			rounds = atol(optarg);
+			break;
+		case 'm':
+			pressure_mb = atol(optarg);
+			break;
+		case 'f':
+			file = optarg;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind != argc || rounds < 1)
+		usage(argv[0]);
+
+	page_size = sysconf(_SC_PAGESIZE);
+	fd = open(dev, O_RDWR);
+	if (fd < 0 || ioctl(fd, PMEM_GET_TOTAL_SIZE, &region) < 0) {
+		perror(dev);
+		return 1;
+	}
+	close(fd);
+	if (!size || size > region.len)
+		size = region.len;
+	size = (size + page_size - 1) & ~(page_size - 1);
+	if (!pressure_mb)
+		pressure_mb = mem_free_mb() * 3 / 4;
+
+	lat = calloc(rounds, sizeof(*lat));
+	if (!lat) {
+		perror("calloc");
+		return 1;
+	}
+
+	printf("%s: %zu KB of %lu KB, %ld rounds, %ld MB pressure\n\n", dev,
+	       size >> 10, region.len >> 10, rounds, pressure_mb);
+	printf("%-10s %10s %10s %10s %10s\n", "", "min_us", "avg_us",
+	       "median_us", "max_us");
+	run("idle", lat);
+
+	child = fork();
+	if (child < 0) {
+		perror("fork");
+		return 1;
+	}
+	if (!child)
+		pressure();
+	/* let the pressure fill the region first */
+	sleep(2);
+	run("pressure", lat);
+	kill(child, SIGKILL);
+	waitpid(child, NULL, 0);
+	return 0;
+}
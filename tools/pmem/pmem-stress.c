@@ -0,0 +1,237 @@
+/*
+ * pmem-stress.c -- random allocation stress test of a pmem region
+ *
+ * Keeps up to -c pmem buffers of random page granular sizes allocated,
+ * freeing and allocating them in random order.  A buffer is allocated by
+ * mmap()ing a fresh open of the device and freed by closing it.  Every
+ * page of a buffer is tagged when it is allocated and checked before it
+ * is freed, so overlapping allocations show up as corrupted tags.
+ *
+ * At the end the allocation latency, the failures and how full the
+ * region was when allocations started failing are printed, followed by
+ * the allocator statistics pmem keeps in debugfs.  Running it once with
+ * -p (power of two sizes) and once without on the same region compares
+ * a buddy region with a best fit one.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+
+struct pmem_region {
+	unsigned long offset;
+	unsigned long len;
+};
+
+#define PMEM_IOCTL_MAGIC	'p'
+#define PMEM_GET_TOTAL_SIZE	_IOW(PMEM_IOCTL_MAGIC, 7, unsigned int)
+
+struct buffer {
+	int fd;
+	unsigned int *map;
+	size_t size;
+	unsigned int tag;
+};
+
+static const char *dev = "/dev/pmem";
+static const char *debugfs = "/sys/kernel/debug";
+static long iterations = 100000, nr_buffers = 32;
+static size_t max_size;
+static int pow2;
+static long page_size;
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-d device] [-n iterations] [-c buffers] "
+		"[-s max KB] [-p] [-r seed]\n", prog);
+	exit(2);
+}
+
+static double now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static size_t random_size(void)
+{
+	size_t pages = max_size / page_size, size;
+
+	size = (1 + random() % pages) * page_size;
+	if (pow2) {
+		while (size & (size - 1))
+			size &= size - 1;
+	}
+	return size;
+}
+
+static void tag(struct buffer *b)
+{
+	size_t off;
+
+	for (off = 0; off < b->size; off += page_size)
+		b->map[off / sizeof(*b->map)] = b->tag;
+}
+
+static int check(struct buffer *b)
+{
+	size_t off;
+
+	for (off = 0; off < b->size; off += page_size)
+		if (b->map[off / sizeof(*b->map)] != b->tag)
+			return -1;
+	return 0;
+}
+
+static void show_debugfs(void)
+{
+	const char *name = strrchr(dev, '/');
+	char path[256], line[256];
+	FILE *f;
+	int n = 0;
+
+	snprintf(path, sizeof(path), "%s/%s", debugfs, name ? name + 1 : dev);
+	f = fopen(path, "r");
+	if (!f)
+		return;
+	printf("\n%s:\n", path);
+	/* the statistics come before the per process mappings */
+	while (fgets(line, sizeof(line), f) && n++ < 4)
+		fputs(line, stdout);
+	fclose(f);
+}
+
+int main(int argc, char **argv)
+{
+	struct pmem_region region;
+	struct buffer *bufs, *b;
+	unsigned long allocs = 0, failed = 0, corrupt = 0;
+	size_t used = 0, used_at_failure = 0;
+	double start, lat, total_lat = 0, max_lat = 0;
+	unsigned int seed = 1, next_tag = 1;
+	long i;
+	int opt, fd;
+
+	while ((opt = getopt(argc, argv, "d:n:c:s:pr:h")) != -1) {
+		switch (opt) {
+		case 'd':
+			dev = optarg;
+			break;
+		case 'n':
+			iterations = atol(optarg);
+			break;
+		case 'c':
+			nr_buffers = atol(optarg);
+			break;
+		case 's':
+			max_size = strtoul(optarg, NULL, 0) << 10;
+			break;
+		case 'p':
+			pow2 = 1;
+			break;
+		case 'r':
+			seed = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind != argc || iterations < 1 || nr_buffers < 1)
+		usage(argv[0]);
+
+	page_size = sysconf(_SC_PAGESIZE);
+	fd = open(dev, O_RDWR);
+	if (fd < 0 || ioctl(fd, PMEM_GET_TOTAL_SIZE, &region) < 0) {
+		perror(dev);
+		return 1;
+	}
+	close(fd);
+	if (!max_size)
+		max_size = region.len / nr_buffers * 2;
+	if (max_size < (size_t)page_size)
+		max_size = page_size;
+
+	bufs = calloc(nr_buffers, sizeof(*bufs));
+	if (!bufs) {
+		perror("calloc");
+		return 1;
+	}
+	srandom(seed);
+
+	for (i = 0; i < iterations; i++) {
+		b = &bufs[random() % nr_buffers];
+		if (b->map) {
+			if (check(b)) {
+				fprintf(stderr, "buffer of %zu KB corrupted\n",
+					b->size >> 10);
+				corrupt++;
+			}
+			munmap(b->map, b->size);
+			close(b->fd);
+			used -= b->size;
+			b->map = NULL;
+			continue;
+		}
+
+		b->size = random_size();
+		b->fd = open(dev, O_RDWR);
+		if (b->fd < 0) {
+			perror(dev);
+			return 1;
+		}
+		start = now_us();
+		b->map = mmap(NULL, b->size, PROT_READ | PROT_WRITE,
+			      MAP_SHARED, b->fd, 0);
+		lat = now_us() - start;
+		if (b->map == MAP_FAILED) {
+			if (!failed++)
+				used_at_failure = used;
+			b->map = NULL;
+			close(b->fd);
+			continue;
+		}
+		allocs++;
+		total_lat += lat;
+		if (lat > max_lat)
+			max_lat = lat;
+		used += b->size;
+		b->tag = next_tag++;
+		tag(b);
+	}
+
+	for (i = 0; i < nr_buffers; i++) {
+		b = &bufs[i];
+		if (!b->map)
+			continue;
+		if (check(b))
+			corrupt++;
+		munmap(b->map, b->size);
+		close(b->fd);
+	}
+
+	printf("%s: %lu KB, %ld buffers of up to %zu KB%s\n", dev,
+	       region.len >> 10, nr_buffers, max_size >> 10,
+	       pow2 ? ", power of two" : "");
+	printf("allocs %lu failed %lu corrupted %lu\n", allocs, failed,
+	       corrupt);
+	printf("alloc latency: avg %.1f us max %.1f us\n",
+	       allocs ? total_lat / allocs : 0, max_lat);
+	if (failed)
+		printf("first failure with %zu KB (%zu%%) in use\n",
+		       used_at_failure >> 10,
+		       used_at_failure * 100 / region.len);
+	show_debugfs();
+	return corrupt ? 1 : 0;
+}
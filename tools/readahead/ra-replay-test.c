@@ -0,0 +1,295 @@
+/*
+ * ra-replay-test.c -- measure launch-style file access with and without a
+ * replayed readahead profile
+ *
+ * An application launch is simulated by mmap()ing the given files and
+ * touching a fixed, pseudo random sequence of their pages.  The sequence
+ * is first run once while a readahead profile is recorded.  Then it is
+ * run cold a number of times, alternately with and without replaying the
+ * profile first, and the major faults, block I/O wait and elapsed time of
+ * each run are reported.
+ *
+ * The page cache of the files is dropped with POSIX_FADV_DONTNEED before
+ * each run, so they should not be mapped by anyone else.  I/O wait comes
+ * from /proc/self/stat and needs CONFIG_TASK_DELAY_ACCT.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+
+#ifndef POSIX_FADV_RA_RECORD
+#define POSIX_FADV_RA_RECORD	8
+#define POSIX_FADV_RA_STOP	9
+#define POSIX_FADV_RA_REPLAY	10
+#endif
+
+#define MAX_FILES	16
+
+struct mapped {
+	const char *path;
+	int fd;
+	size_t size;
+	unsigned char *map;
+};
+
+struct result {
+	long majflt;
+	unsigned long long blkio_ms;
+	double elapsed_ms;
+	double replay_ms;
+};
+
+static struct mapped files[MAX_FILES];
+static int nr_files;
+static unsigned long *seq_file, *seq_page;
+static unsigned long seq_len = 1024;
+static unsigned int seed = 1;
+static int runs = 5;
+static long page_size;
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-n pages] [-r runs] [-s seed] file...\n", prog);
+	exit(2);
+}
+
+static double now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/* field 42 of /proc/self/stat, in clock ticks */
+static unsigned long long blkio_ms(void)
+{
+	unsigned long long ticks = 0;
+	char buf[1024], *p;
+	FILE *f;
+	int field;
+
+	f = fopen("/proc/self/stat", "r");
+	if (!f)
+		return 0;
+	if (!fgets(buf, sizeof(buf), f)) {
+		fclose(f);
+		return 0;
+	}
+	fclose(f);
+
+	/* skip "pid (comm)", comm may contain spaces */
+	p = strrchr(buf, ')');
+	if (!p)
+		return 0;
+	for (field = 2; field < 42 && p; field++)
+		p = strchr(p + 1, ' ');
+	if (p)
+		ticks = strtoull(p + 1, NULL, 10);
+	return ticks * 1000 / sysconf(_SC_CLK_TCK);
+}
+
+static long majflt(void)
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_majflt;
+}
+
+static void advise_all(int advice, const char *what)
+{
+	int i, err;
+
+	for (i = 0; i < nr_files; i++) {
+		err = posix_fadvise(files[i].fd, 0, 0, advice);
+		if (err) {
+			fprintf(stderr, "%s: %s: %s\n", files[i].path, what,
+				strerror(err));
+			exit(1);
+		}
+	}
+}
+
+static void drop_caches(void)
+{
+	int i;
+
+	for (i = 0; i < nr_files; i++)
+		if (files[i].map != MAP_FAILED)
+			munmap(files[i].map, files[i].size);
+	advise_all(POSIX_FADV_DONTNEED, "dropping cache");
+	for (i = 0; i < nr_files; i++) {
+		files[i].map = mmap(NULL, files[i].size, PROT_READ,
+				    MAP_SHARED, files[i].fd, 0);
+		if (files[i].map == MAP_FAILED) {
+			perror(files[i].path);
+			exit(1);
+		}
+	}
+}
+
+static unsigned int launch(void)
+{
+	unsigned int sum = 0;
+	unsigned long i;
+
+	for (i = 0; i < seq_len; i++) {
+		volatile unsigned char *map = files[seq_file[i]].map;
+
+		sum += map[seq_page[i] * page_size];
+	}
+	return sum;
+}
+
+static void run(int replay, struct result *r)
+{
+	long flt;
+	unsigned long long io;
+	double start;
+
+	drop_caches();
+
+	flt = majflt();
+	io = blkio_ms();
+	start = now_ms();
+	if (replay) {
+		advise_all(POSIX_FADV_RA_REPLAY, "replay");
+		r->replay_ms = now_ms() - start;
+	} else {
+		r->replay_ms = 0;
+	}
+	launch();
+	r->elapsed_ms = now_ms() - start;
+	r->majflt = majflt() - flt;
+	r->blkio_ms = blkio_ms() - io;
+}
+
+/*
+ * Clusters of a few pages at random places, the way code and resources
+ * of a large binary are touched during startup.
+ */
+static void make_sequence(void)
+{
+	unsigned long i = 0, pages, start, len;
+	int f;
+
+	seq_file = malloc(seq_len * sizeof(*seq_file));
+	seq_page = malloc(seq_len * sizeof(*seq_page));
+	if (!seq_file || !seq_page) {
+		perror("malloc");
+		exit(1);
+	}
+
+	srandom(seed);
+	while (i < seq_len) {
+		f = random() % nr_files;
+		pages = (files[f].size + page_size - 1) / page_size;
+		start = random() % pages;
+		for (len = 1 + random() % 4; len && i < seq_len; len--) {
+			seq_file[i] = f;
+			seq_page[i++] = start;
+			if (++start == pages)
+				break;
+		}
+	}
+}
+
+static void print(const char *name, struct result *r, int n)
+{
+	double flt = 0, io = 0, ms = 0, rep = 0;
+	int i;
+
+	for (i = 0; i < n; i++) {
+		flt += r[i].majflt;
+		io += r[i].blkio_ms;
+		ms += r[i].elapsed_ms;
+		rep += r[i].replay_ms;
+	}
+	printf("%-10s %10.1f %10.1f %10.1f %10.1f\n", name, flt / n, io / n,
+	       ms / n, rep / n);
+}
+
+int main(int argc, char **argv)
+{
+	struct result *plain, *replay;
+	struct stat st;
+	int opt, i;
+
+	while ((opt = getopt(argc, argv, "n:r:s:h")) != -1) {
+		switch (opt) {
+		case 'n':
+			seq_len = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			runs = atoi(optarg);
+			break;
+		case 's':
+			seed = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind == argc || argc - optind > MAX_FILES || !seq_len ||
+	    runs < 1)
+		usage(argv[0]);
+
+	page_size = sysconf(_SC_PAGESIZE);
+	for (; optind < argc; optind++) {
+		struct mapped *m = &files[nr_files++];
+
+		m->path = argv[optind];
+		m->fd = open(m->path, O_RDONLY);
+		if (m->fd < 0 || fstat(m->fd, &st)) {
+			perror(m->path);
+			return 1;
+		}
+		if (!st.st_size) {
+			fprintf(stderr, "%s: empty file\n", m->path);
+			return 1;
+		}
+		m->size = st.st_size;
+		m->map = MAP_FAILED;
+	}
+	make_sequence();
+
+	/* the recording launch */
+	drop_caches();
+	advise_all(POSIX_FADV_RA_RECORD, "record");
+	launch();
+	advise_all(POSIX_FADV_RA_STOP, "stop recording");
+
+	plain = calloc(runs, sizeof(*plain));
+	replay = calloc(runs, sizeof(*replay));
+	if (!plain || !replay) {
+		perror("calloc");
+		return 1;
+	}
+	for (i = 0; i < runs; i++) {
+		run(0, &plain[i]);
+		run(1, &replay[i]);
+	}
+
+	printf("%lu page touches in %d file(s), %d cold runs each\n\n",
+	       seq_len, nr_files, runs);
+	printf("%-10s %10s %10s %10s %10s\n", "", "majflt", "iowait_ms",
+	       "total_ms", "replay_ms");
+	print("no replay", plain, runs);
+	print("replay", replay, runs);
+	return 0;
+}
@@ -0,0 +1,354 @@
+/*
+ * schedlat.c -- wakeup latency and runqueue wait percentiles
+ *
+ * Without -t the histogram in /proc/schedlat, or in the cpu.latency_hist
+ * file of a cpu cgroup given on the command line, is turned into
+ * percentiles.  Those are only as exact as the log2 buckets, so the
+ * value is interpolated inside the bucket a percentile falls in.
+ *
+ * With -t SECS the sched_wakeup_latency and sched_wait_latency
+ * tracepoints are enabled for that long and every sample is kept, which
+ * gives exact percentiles and allows filtering by task name (-c) or pid
+ * (-p).  Needs debugfs; the usual mount points are tried.
+ *
+ * -r clears the histogram after reading it.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+
+#define NR_BUCKETS	64
+
+static const double percentiles[] = { 50, 90, 95, 99, 99.9 };
+#define NR_PERCENTILES	(sizeof(percentiles) / sizeof(percentiles[0]))
+
+static const char * const kind_name[] = { "wakeup", "wait" };
+
+static const char * const debugfs_mounts[] = {
+	"/sys/kernel/debug", "/debug", "/d", NULL
+};
+
+struct samples {
+	unsigned long long *v;
+	size_t nr, alloc;
+};
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-r] [histogram file]\n"
+		"       %s -t secs [-c comm] [-p pid]\n", prog, prog);
+	exit(2);
+}
+
+/* ---- histogram mode ---- */
+
+static int show_hist(const char *path, int reset)
+{
+	unsigned long long lower[NR_BUCKETS], count[2][NR_BUCKETS];
+	unsigned long long sum[2] = { 0, 0 }, total[2] = { 0, 0 };
+	char line[256];
+	int nr = 0, kind, i;
+	size_t p;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (!f) {
+		perror(path);
+		return 1;
+	}
+	while (fgets(line, sizeof(line), f)) {
+		if (line[0] == '#')
+			continue;
+		if (!strncmp(line, "sum_ns", 6)) {
+			sscanf(line + 6, "%llu %llu", &sum[0], &sum[1]);
+			continue;
+		}
+		if (nr < NR_BUCKETS &&
+		    sscanf(line, "%llu %llu %llu", &lower[nr], &count[0][nr],
+			   &count[1][nr]) == 3)
+			nr++;
+	}
+	fclose(f);
+	if (!nr) {
+		fprintf(stderr, "%s: no histogram found\n", path);
+		return 1;
+	}
+
+	printf("%-7s %10s %9s", "", "samples", "mean_us");
+	for (p = 0; p < NR_PERCENTILES; p++)
+		printf("   p%-6g", percentiles[p]);
+	printf("\n");
+
+	for (kind = 0; kind < 2; kind++) {
+		for (i = 0; i < nr; i++)
+			total[kind] += count[kind][i];
+		printf("%-7s %10llu %9.1f", kind_name[kind], total[kind],
+		       total[kind] ? sum[kind] / 1000.0 / total[kind] : 0.0);
+
+		for (p = 0; p < NR_PERCENTILES; p++) {
+			double want = percentiles[p] / 100.0 * total[kind];
+			double seen = 0, lo, hi;
+
+			if (!total[kind]) {
+				printf(" %9s", "-");
+				continue;
+			}
+			for (i = 0; i < nr - 1; i++) {
+				if (seen + count[kind][i] >= want)
+					break;
+				seen += count[kind][i];
+			}
+			lo = lower[i];
+			if (i == nr - 1) {
+				/* open ended */
+				printf(" %8.0f+", lo);
+				continue;
+			}
+			hi = lower[i + 1];
+			printf(" %9.1f", lo + (hi - lo) *
+			       (want - seen) / count[kind][i]);
+		}
+		printf("   (us)\n");
+	}
+
+	if (reset) {
+		f = fopen(path, "w");
+		if (!f || fputs("0\n", f) < 0 || fclose(f)) {
+			perror(path);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* ---- trace mode ---- */
+
+static char tracing[256];
+
+static int find_tracing(void)
+{
+	int i;
+
+	for (i = 0; debugfs_mounts[i]; i++) {
+		snprintf(tracing, sizeof(tracing), "%s/tracing",
+			 debugfs_mounts[i]);
+		if (!access(tracing, F_OK))
+			return 0;
+	}
+	fprintf(stderr, "debugfs with tracing support not found\n");
+	return -1;
+}
+
+static int write_tracing(const char *file, const char *val)
+{
+	char path[512];
+	int fd, ret;
+
+	snprintf(path, sizeof(path), "%s/%s", tracing, file);
+	fd = open(path, O_WRONLY | O_TRUNC);
+	if (fd < 0) {
+		perror(path);
+		return -1;
+	}
+	ret = write(fd, val, strlen(val));
+	close(fd);
+	return ret < 0 ? -1 : 0;
+}
+
+static void enable_events(int on)
+{
+	const char *val = on ? "1" : "0";
+
+	write_tracing("events/sched/sched_wakeup_latency/enable", val);
+	write_tracing("events/sched/sched_wait_latency/enable", val);
+}
+
+static void add_sample(struct samples *s, unsigned long long v)
+{
+	if (s->nr == s->alloc) {
+		s->alloc = s->alloc ? 2 * s->alloc : 4096;
+		s->v = realloc(s->v, s->alloc * sizeof(*s->v));
+		if (!s->v) {
+			perror("realloc");
+			enable_events(0);
+			exit(1);
+		}
+	}
+	s->v[s->nr++] = v;
+}
+
+static int cmp_ull(const void *a, const void *b)
+{
+	unsigned long long x = *(const unsigned long long *)a;
+	unsigned long long y = *(const unsigned long long *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/*
+ * Lines look like
+ *   <task>-<pid> [cpu] ts: sched_wakeup_latency: comm=foo pid=12 delay=3 [ns]
+ */
+static void parse_line(char *line, struct samples *s, const char *comm,
+		       int pid)
+{
+	char *ev, *c, *end;
+	unsigned long long delay;
+	int kind, p;
+
+	ev = strstr(line, "sched_wakeup_latency: ");
+	kind = 0;
+	if (!ev) {
+		ev = strstr(line, "sched_wait_latency: ");
+		kind = 1;
+	}
+	if (!ev)
+		return;
+
+	c = strstr(ev, " comm=");
+	if (!c)
+		return;
+	c += 6;
+	end = strstr(c, " pid=");
+	if (!end || sscanf(end, " pid=%d delay=%llu", &p, &delay) != 2)
+		return;
+	if (pid && p != pid)
+		return;
+	*end = '\0';
+	if (comm && strcmp(comm, c))
+		return;
+
+	add_sample(&s[kind], delay);
+}
+
+static volatile sig_atomic_t stop;
+
+static void on_signal(int sig)
+{
+	stop = 1;
+}
+
+static int trace(int secs, const char *comm, int pid)
+{
+	struct samples s[2];
+	char path[512], buf[65536], *line, *nl;
+	size_t have = 0, p;
+	time_t deadline;
+	struct pollfd pfd;
+	int fd, kind;
+	ssize_t n;
+
+	memset(s, 0, sizeof(s));
+	if (find_tracing())
+		return 1;
+
+	snprintf(path, sizeof(path), "%s/trace_pipe", tracing);
+	fd = open(path, O_RDONLY | O_NONBLOCK);
+	if (fd < 0) {
+		perror(path);
+		return 1;
+	}
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+	enable_events(1);
+	deadline = time(NULL) + secs;
+
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	while (!stop && time(NULL) < deadline) {
+		if (poll(&pfd, 1, 200) <= 0)
+			continue;
+		n = read(fd, buf + have, sizeof(buf) - have - 1);
+		if (n <= 0)
+			continue;
+		have += n;
+		buf[have] = '\0';
+
+		for (line = buf; (nl = strchr(line, '\n')); line = nl + 1) {
+			*nl = '\0';
+			parse_line(line, s, comm, pid);
+		}
+		have -= line - buf;
+		memmove(buf, line, have);
+		if (have == sizeof(buf) - 1)
+			have = 0;	/* overlong line, drop it */
+	}
+
+	enable_events(0);
+	close(fd);
+
+	printf("%-7s %10s %9s", "", "samples", "mean_us");
+	for (p = 0; p < NR_PERCENTILES; p++)
+		printf("   p%-6g", percentiles[p]);
+	printf(" %9s\n", "max");
+
+	for (kind = 0; kind < 2; kind++) {
+		unsigned long long sum = 0;
+		size_t i;
+
+		printf("%-7s %10zu", kind_name[kind], s[kind].nr);
+		if (!s[kind].nr) {
+			printf("\n");
+			continue;
+		}
+		qsort(s[kind].v, s[kind].nr, sizeof(*s[kind].v), cmp_ull);
+		for (i = 0; i < s[kind].nr; i++)
+			sum += s[kind].v[i];
+		printf(" %9.1f", sum / 1000.0 / s[kind].nr);
+		for (p = 0; p < NR_PERCENTILES; p++) {
+			i = (size_t)(percentiles[p] / 100.0 * (s[kind].nr - 1));
+			printf(" %9.1f", s[kind].v[i] / 1000.0);
+		}
+		printf(" %9.1f   (us)\n", s[kind].v[s[kind].nr - 1] / 1000.0);
+		free(s[kind].v);
+	}
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	const char *comm = NULL;
+	int secs = 0, pid = 0, reset = 0, opt;
+
+	while ((opt = getopt(argc, argv, "t:c:p:rh")) != -1) {
+		switch (opt) {
+		case 't':
+			secs = atoi(optarg);
+			break;
+		case 'c':
+			comm = optarg;
+			break;
+		case 'p':
+			pid = atoi(optarg);
+			break;
+		case 'r':
+			reset = 1;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (secs > 0) {
+		if (optind != argc)
+			usage(argv[0]);
+		return trace(secs, comm, pid);
+	}
+	if ((comm || pid) || optind + 1 < argc)
+		usage(argv[0]);
+	return show_hist(optind < argc ? argv[optind] : "/proc/schedlat",
+			 reset);
+}
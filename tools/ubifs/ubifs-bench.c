@@ -0,0 +1,289 @@
+/*
+ * ubifs-bench.c -- write latency under commit and bulk-read throughput of
+ * UBIFS
+ *
+ * The write test runs -t threads for -s seconds, each rewriting -k KB at
+ * random offsets of its own -m MB file, like the databases of a /data
+ * partition do, with an fsync() after every -n writes.  Its throughput and
+ * the average, 99th, 99.9th percentile and maximum write latency are
+ * printed; writers blocked by a journal commit show up in the tail.
+ *
+ * The read test then writes two files of -r MB together, 4 KB at a time,
+ * so that their data nodes are interleaved on the flash, plus one of -r MB
+ * on its own, drops the caches and times reading each back sequentially.
+ * Bulk-read only helps reads of data nodes it can read together, so mount
+ * with -o bulk_read, e.g. on a simulated 256 MB NAND with 2 KB pages:
+ *
+ *	modprobe nandsim first_id_byte=0x20 second_id_byte=0xaa \
+ *		third_id_byte=0x00 fourth_id_byte=0x15
+ *	modprobe ubi mtd=0 && ubimkvol /dev/ubi0 -N data -m
+ *	mount -t ubifs -o bulk_read ubi0:data /mnt && ubifs-bench /mnt
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+
+#define MAX_THREADS	64
+#define MAX_SAMPLES	65536
+
+struct writer {
+	pthread_t thread;
+	int id;
+	unsigned long writes;
+	double *lat;
+};
+
+static const char *dir;
+static long nr_threads = 4, secs = 10, sync_every = 4, read_mb = 16;
+static size_t size = 4 << 10, file_size = 4 << 20;
+static volatile int stop;
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-t threads] [-s secs] [-k KB] [-m MB] "
+		"[-n writes per fsync] [-r read MB] dir\n", prog);
+	exit(2);
+}
+
+static double now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void drop_caches(void)
+{
+	int fd;
+
+	sync();
+	fd = open("/proc/sys/vm/drop_caches", O_WRONLY);
+	if (fd < 0 || write(fd, "3\n", 2) != 2) {
+		perror("/proc/sys/vm/drop_caches");
+		exit(1);
+	}
+	close(fd);
+}
+
+static int open_file(const char *path, int flags)
+{
+	int fd = open(path, flags, 0644);
+
+	if (fd < 0) {
+		perror(path);
+		exit(1);
+	}
+	return fd;
+}
+
+static void *write_thread(void *arg)
+{
+	struct writer *w = arg;
+	unsigned int seed = w->id;
+	char path[256], *buf;
+	double start;
+	off_t off;
+	int fd;
+
+	snprintf(path, sizeof(path), "%s/ubifs-bench.w%d", dir, w->id);
+	fd = open_file(path, O_RDWR | O_CREAT | O_TRUNC);
+	buf = malloc(size);
+	if (!buf || ftruncate(fd, file_size)) {
+		perror(path);
+		exit(1);
+	}
+	memset(buf, 0x5a, size);
+	while (!stop) {
+		off = (off_t)(rand_r(&seed) % (file_size / size)) * size;
+		/* make the data compress like real data rather than zeroes */
+		buf[0] = rand_r(&seed);
+		start = now_us();
+		if (pwrite(fd, buf, size, off) != (ssize_t)size ||
+		    ((w->writes + 1) % sync_every == 0 && fsync(fd))) {
+			perror(path);
+			exit(1);
+		}
+		w->lat[w->writes % MAX_SAMPLES] = now_us() - start;
+		w->writes++;
+	}
+	close(fd);
+	unlink(path);
+	free(buf);
+	return NULL;
+}
+
+static void write_test(void)
+{
+	struct writer writers[MAX_THREADS];
+	double start, elapsed, sum = 0, *lat;
+	unsigned long writes = 0;
+	long i, j, n = 0;
+
+	memset(writers, 0, sizeof(writers));
+	lat = calloc(nr_threads * MAX_SAMPLES, sizeof(*lat));
+	if (!lat) {
+		perror("calloc");
+		exit(1);
+	}
+	start = now_us();
+	for (i = 0; i < nr_threads; i++) {
+		writers[i].id = i;
+		writers[i].lat = lat + i * MAX_SAMPLES;
+		if (pthread_create(&writers[i].thread, NULL, write_thread,
+				   &writers[i])) {
+			fprintf(stderr, "pthread_create failed\n");
+			exit(1);
+		}
+	}
+	sleep(secs);
+	stop = 1;
+	for (i = 0; i < nr_threads; i++)
+		pthread_join(writers[i].thread, NULL);
+	elapsed = (now_us() - start) / 1e6;
+
+	for (i = 0; i < nr_threads; i++) {
+		long samples = writers[i].writes < MAX_SAMPLES ?
+			       writers[i].writes : MAX_SAMPLES;
+
+		writes += writers[i].writes;
+		for (j = 0; j < samples; j++) {
+			lat[n] = writers[i].lat[j];
+			sum += lat[n++];
+		}
+	}
+	if (!n) {
+		fprintf(stderr, "no write completed\n");
+		exit(1);
+	}
+	qsort(lat, n, sizeof(*lat), cmp_double);
+
+	printf("%-12s %10s %10s %10s %10s %10s %10s\n", "write", "writes/s",
+	       "MB/s", "avg_ms", "p99_ms", "p99.9_ms", "max_ms");
+	printf("%-12s %10.0f %10.2f %10.3f %10.3f %10.3f %10.3f\n\n", "",
+	       writes / elapsed, writes * size / elapsed / (1 << 20),
+	       sum / n / 1000, lat[n * 99 / 100] / 1000,
+	       lat[n * 999 / 1000] / 1000, lat[n - 1] / 1000);
+	fflush(stdout);
+	free(lat);
+}
+
+static double time_read(const char *path, char *buf)
+{
+	double start;
+	ssize_t ret;
+	int fd;
+
+	drop_caches();
+	start = now_us();
+	fd = open_file(path, O_RDONLY);
+	while ((ret = read(fd, buf, 128 << 10)) > 0)
+		;
+	if (ret < 0) {
+		perror(path);
+		exit(1);
+	}
+	close(fd);
+	return (now_us() - start) / 1e6;
+}
+
+static void read_test(void)
+{
+	char path[3][256], *buf;
+	long i, blocks = read_mb << 8;
+	int fd[3];
+
+	buf = malloc(128 << 10);
+	if (!buf) {
+		perror("malloc");
+		exit(1);
+	}
+	for (i = 0; i < 3; i++) {
+		snprintf(path[i], sizeof(path[i]), "%s/ubifs-bench.r%ld",
+			 dir, i);
+		fd[i] = open_file(path[i], O_WRONLY | O_CREAT | O_TRUNC);
+	}
+
+	/* r0 and r1 interleaved, then r2 on its own */
+	for (i = 0; i < 3 * blocks; i++) {
+		int f = i < 2 * blocks ? i & 1 : 2;
+
+		memset(buf, (int)i, 4096);
+		if (write(fd[f], buf, 4096) != 4096 || fsync(fd[f])) {
+			perror(path[f]);
+			exit(1);
+		}
+	}
+	for (i = 0; i < 3; i++)
+		close(fd[i]);
+
+	printf("%-12s %10s\n", "read", "MB/s");
+	printf("%-12s %10.2f\n", "interleaved",
+	       read_mb / time_read(path[0], buf));
+	printf("%-12s %10.2f\n", "contiguous",
+	       read_mb / time_read(path[2], buf));
+	fflush(stdout);
+
+	for (i = 0; i < 3; i++)
+		unlink(path[i]);
+	free(buf);
+}
+
+int main(int argc, char **argv)
+{
+	int opt;
+
+	while ((opt = getopt(argc, argv, "t:s:k:m:n:r:h")) != -1) {
+		switch (opt) {
+		case 't':
+			nr_threads = atol(optarg);
+			break;
+		case 's':
+			secs = atol(optarg);
+			break;
+		case 'k':
+			size = strtoul(optarg, NULL, 0) << 10;
+			break;
+		case 'm':
+			file_size = strtoul(optarg, NULL, 0) << 20;
+			break;
+		case 'n':
+			sync_every = atol(optarg);
+			break;
+		case 'r':
+			read_mb = atol(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind != argc - 1 || nr_threads < 1 ||
+	    nr_threads > MAX_THREADS || secs < 1 || !size ||
+	    file_size < size || sync_every < 1 || read_mb < 0)
+		usage(argv[0]);
+	dir = argv[optind];
+
+	printf("%s, %ld writers of %zu KB to %zu MB files, fsync every %ld, "
+	       "%ld s\n\n", dir, nr_threads, size >> 10, file_size >> 20,
+	       sync_every, secs);
+	write_test();
+	if (read_mb)
+		read_test();
+	return 0;
+}
@@ -0,0 +1,226 @@
+/*
+ * ubifs-compr-bench.c -- UBIFS write throughput for media, text and mixed
+ * files
+ *
+ * Writes -n files of -m MB to the directory, 4 KB at a time, and fsync()s
+ * each of them, three times over: with random bytes that do not compress,
+ * like the JPEGs, MP3s and videos of a media partition, with text made of
+ * words from a small dictionary that compresses about as well as logs and
+ * XML do, and with every other file of each kind.  The files are removed
+ * between the runs.
+ *
+ * For every run the write throughput is printed, followed by what each
+ * compressor did during it, taken from /proc/fs/ubifs/compressors: the MB
+ * given to it, the ratio they were stored at, the CPU time it spent in
+ * milliseconds and how many files adaptive compression stopped using it
+ * for.  Compare mounts with and without -o adaptive_compr, e.g.
+ *
+ *	mount -t ubifs -o compr=zlib,adaptive_compr ubi0:data /mnt
+ *	ubifs-compr-bench /mnt
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+
+#define STATS_PATH	"/proc/fs/ubifs/compressors"
+#define MAX_COMPR	4
+#define BLOCK		4096
+#define POOL_MB		4
+
+struct compr_stats {
+	char name[8];
+	unsigned long long in, out, us;
+	unsigned long dropped;
+};
+
+static const char *dir;
+static long nr_files = 16, file_mb = 4;
+
+static const char *const words[] = {
+	"the", "of", "and", "to", "in", "is", "that", "for", "it", "as",
+	"was", "with", "be", "by", "on", "not", "he", "this", "are", "or",
+	"his", "from", "at", "which", "but", "have", "an", "had", "they",
+	"you", "were", "their", "one", "all", "we", "can", "her", "has",
+	"there", "been", "if", "more", "when", "will", "would", "who", "so",
+	"no", "<item>", "</item>", "error:", "warning:", "0x1f", "=",
+};
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-n files] [-m MB] dir\n", prog);
+	exit(2);
+}
+
+static double now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int read_stats(struct compr_stats *cs)
+{
+	char line[256];
+	int n = 0;
+	FILE *f;
+
+	memset(cs, 0, MAX_COMPR * sizeof(*cs));
+	f = fopen(STATS_PATH, "r");
+	if (!f)
+		return 0;
+	/* skip the header */
+	if (!fgets(line, sizeof(line), f)) {
+		fclose(f);
+		return 0;
+	}
+	while (n < MAX_COMPR && fgets(line, sizeof(line), f))
+		if (sscanf(line, "%7s %llu %llu %llu %*u %lu", cs[n].name,
+			   &cs[n].in, &cs[n].out, &cs[n].us,
+			   &cs[n].dropped) == 5)
+			n++;
+	fclose(f);
+	return n;
+}
+
+static char *pool[2];
+
+/* POOL_MB of each kind of data, generated before any timing starts */
+static void fill_pools(void)
+{
+	unsigned int seed = 1;
+	size_t n;
+
+	pool[0] = malloc(POOL_MB << 20);
+	pool[1] = malloc(POOL_MB << 20);
+	if (!pool[0] || !pool[1]) {
+		perror("malloc");
+		exit(1);
+	}
+	for (n = 0; n < POOL_MB << 20; n++)
+		pool[0][n] = rand_r(&seed);
+	n = 0;
+	while (n < POOL_MB << 20) {
+		const char *w = words[rand_r(&seed) % (sizeof(words) /
+						       sizeof(words[0]))];
+		size_t len = strlen(w);
+
+		if (n + len + 1 > POOL_MB << 20)
+			len = (POOL_MB << 20) - n - 1;
+		memcpy(pool[1] + n, w, len);
+		n += len;
+		pool[1][n++] = rand_r(&seed) % 12 ? ' ' : '\n';
+	}
+}
+
+static void write_file(const char *path, int text, unsigned int *seed)
+{
+	long i, blocks = (POOL_MB << 20) / BLOCK;
+	int fd;
+
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		perror(path);
+		exit(1);
+	}
+	for (i = 0; i < file_mb << 8; i++) {
+		char *buf = pool[text] + (rand_r(seed) % blocks) * BLOCK;
+
+		if (write(fd, buf, BLOCK) != BLOCK) {
+			perror(path);
+			exit(1);
+		}
+	}
+	if (fsync(fd)) {
+		perror(path);
+		exit(1);
+	}
+	close(fd);
+}
+
+/* kind: 0 media, 1 text, 2 every other file of each */
+static void run(const char *label, int kind)
+{
+	struct compr_stats before[MAX_COMPR], after[MAX_COMPR];
+	unsigned int seed = 1;
+	double start, elapsed;
+	char path[256];
+	int i, n;
+
+	sync();
+	n = read_stats(before);
+	start = now_us();
+	for (i = 0; i < nr_files; i++) {
+		snprintf(path, sizeof(path), "%s/ubifs-compr-bench.%d",
+			 dir, i);
+		write_file(path, kind == 2 ? i & 1 : kind, &seed);
+	}
+	elapsed = (now_us() - start) / 1e6;
+	read_stats(after);
+
+	printf("%-8s %10.2f", label, nr_files * file_mb / elapsed);
+	for (i = 0; i < n; i++) {
+		unsigned long long in = after[i].in - before[i].in;
+		unsigned long long out = after[i].out - before[i].out;
+
+		printf("   %-4s %7.1f %5.2f %7llu %4lu", after[i].name,
+		       in / 1048576.0, in ? (double)out / in : 0,
+		       (after[i].us - before[i].us) / 1000,
+		       after[i].dropped - before[i].dropped);
+	}
+	printf("\n");
+	fflush(stdout);
+
+	for (i = 0; i < nr_files; i++) {
+		snprintf(path, sizeof(path), "%s/ubifs-compr-bench.%d",
+			 dir, i);
+		unlink(path);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	struct compr_stats cs[MAX_COMPR];
+	int opt, i, n;
+
+	while ((opt = getopt(argc, argv, "n:m:h")) != -1) {
+		switch (opt) {
+		case 'n':
+			nr_files = atol(optarg);
+			break;
+		case 'm':
+			file_mb = atol(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind != argc - 1 || nr_files < 1 || file_mb < 1)
+		usage(argv[0]);
+	dir = argv[optind];
+
+	n = read_stats(cs);
+	if (!n)
+		fprintf(stderr, "%s not found, no compressor statistics\n",
+			STATS_PATH);
+
+	fill_pools();
+	printf("%s, %ld files of %ld MB per run\n\n", dir, nr_files, file_mb);
+	printf("%-8s %10s", "data", "MB/s");
+	for (i = 0; i < n; i++)
+		printf("   %-4s %7s %5s %7s %4s", "", "in_MB", "ratio",
+		       "cpu_ms", "drop");
+	printf("\n");
+	run("media", 0);
+	run("text", 1);
+	run("mixed", 2);
+	return 0;
+}